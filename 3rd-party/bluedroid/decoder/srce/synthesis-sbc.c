@@ -240,6 +240,139 @@ PRIVATE void dct2_8(SBC_BUFFER_T * RESTRICT out, OI_INT32 const * RESTRICT x);
 
 typedef void (*SYNTH_FRAME)(OI_CODEC_SBC_DECODER_CONTEXT *context, OI_INT16 *pcm, OI_UINT blkstart, OI_UINT blkcount);
 
+/* BK4BTSTACK_CHANGE START */
+/* Set SBC_SIMD_OPT to FALSE to disable the AVX2/NEON synthesis window. AVX2 is selected at runtime if supported */
+#ifndef SBC_SIMD_OPT
+#define SBC_SIMD_OPT TRUE
+#endif
+
+#if (SBC_SIMD_OPT == TRUE) && !defined(SYNTH80)
+#if defined(__GNUC__) && ((__GNUC__ >= 5) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define SYNTH80_AVX2
+#include <immintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define SYNTH80_NEON
+#include <arm_neon.h>
+#endif
+#endif
+
+#if defined(SYNTH80_AVX2) || defined(SYNTH80_NEON)
+/*
+ * SynthWindow80_generated rearranged for 8 outputs in parallel: pcm[i] sums over j = 0..4
+ * the terms for buffer[16*j + 4 + i] and buffer[16*j + 12 - i]. Each product is shifted
+ * individually as in the generated code, left shifts are folded into the coefficients.
+ */
+static const OI_INT32 synth80_coeff[5][2][8] = {
+    { {       0,   -3263,  -10385,  -16457,   10445,   -8443,  -10337,   -6087 },
+      {    8235,   29293,   24995,   19083,       0,   16913,   11167,    9293 } },
+    { {  -23167,   -5229,   -4944,  -23641,  -10594,   -9632,  -30605,  -23144 },
+      {   26479,   30835,    9161,  -29015,       0,    7374,    7668,    9976 } },
+    { {  -34794,  -54042,  -46126,  -51556,   89196,   41020,   38212,   36110 },
+      {   75192,   63266,   55122,   49160,       0,   61788,   66536,   94684 } },
+    { {   34794,   34638,   18472,   24211,   10603,    9405,   16383,    3494 },
+      {   26479,   26663,   12705,   23469,       0,  -18233,   22117,   11537 } },
+    { {   23167,    4555,    6239,   21223,    9539,   26189,    8603,    8721 },
+      {    8235,   12419,    9251,   26913,       0,    1499,    7543,    1370 } },
+};
+
+static const OI_INT32 synth80_shift_right[5][2][8] = {
+    { { 0, 5, 6, 6, 4, 7, 4, 2 }, { 3, 5, 5, 5, 0, 5, 4, 3 } },
+    { { 3, 0, 0, 2, 0, 0, 1, 0 }, { 2, 3, 3, 4, 0, 0, 0, 0 } },
+    { { 0, 0, 0, 0, 0, 0, 0, 0 }, { 0, 0, 0, 0, 0, 0, 0, 0 } },
+    { { 0, 0, 0, 1, 0, 1, 2, 0 }, { 2, 2, 1, 2, 0, 3, 4, 1 } },
+    { { 3, 1, 3, 8, 4, 7, 6, 7 }, { 3, 4, 4, 6, 0, 1, 3, 0 } },
+};
+#endif
+
+#ifdef SYNTH80_AVX2
+__attribute__((target("avx2")))
+static void SynthWindow80_avx2(OI_INT16 *pcm, SBC_BUFFER_T const * RESTRICT buffer, OI_UINT strideShift)
+{
+    const __m256i reverse = _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+    __m256i sum = _mm256_setzero_si256();
+    __m256i x;
+    __m128i out;
+    OI_INT16 samples[8];
+    OI_UINT i;
+
+    for (i = 0; i < 5; i++) {
+        x = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *) &buffer[16 * i + 4]));
+        x = _mm256_mullo_epi32(x, _mm256_loadu_si256((const __m256i *) synth80_coeff[i][0]));
+        sum = _mm256_add_epi32(sum, _mm256_srav_epi32(x, _mm256_loadu_si256((const __m256i *) synth80_shift_right[i][0])));
+        x = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *) &buffer[16 * i + 5]));
+        x = _mm256_mullo_epi32(_mm256_permutevar8x32_epi32(x, reverse), _mm256_loadu_si256((const __m256i *) synth80_coeff[i][1]));
+        sum = _mm256_add_epi32(sum, _mm256_srav_epi32(x, _mm256_loadu_si256((const __m256i *) synth80_shift_right[i][1])));
+    }
+
+    /* pcm /= 32768 rounds towards zero, packs saturates like CLIP_INT16 */
+    sum = _mm256_add_epi32(sum, _mm256_and_si256(_mm256_srai_epi32(sum, 31), _mm256_set1_epi32(0x7fff)));
+    sum = _mm256_srai_epi32(sum, 15);
+    out = _mm_packs_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+    if (strideShift == 0) {
+        _mm_storeu_si128((__m128i *) pcm, out);
+        return;
+    }
+    _mm_storeu_si128((__m128i *) samples, out);
+    for (i = 0; i < 8; i++) {
+        pcm[i << strideShift] = samples[i];
+    }
+}
+
+static void SynthWindow80_select(OI_INT16 *pcm, SBC_BUFFER_T const * RESTRICT buffer, OI_UINT strideShift);
+static void (*SynthWindow80)(OI_INT16 *pcm, SBC_BUFFER_T const * RESTRICT buffer, OI_UINT strideShift) = SynthWindow80_select;
+
+static void SynthWindow80_select(OI_INT16 *pcm, SBC_BUFFER_T const * RESTRICT buffer, OI_UINT strideShift)
+{
+    if (__builtin_cpu_supports("avx2")) {
+        SynthWindow80 = SynthWindow80_avx2;
+    } else {
+        SynthWindow80 = SynthWindow80_generated;
+    }
+    SynthWindow80(pcm, buffer, strideShift);
+}
+
+#define SYNTH80 SynthWindow80
+#endif
+
+#ifdef SYNTH80_NEON
+static void SynthWindow80_neon(OI_INT16 *pcm, SBC_BUFFER_T const * RESTRICT buffer, OI_UINT strideShift)
+{
+    int32x4_t sum_lo = vdupq_n_s32(0);
+    int32x4_t sum_hi = vdupq_n_s32(0);
+    int16x8_t x;
+    int16x8_t out;
+    OI_INT16 samples[8];
+    OI_UINT i;
+
+    for (i = 0; i < 5; i++) {
+        x = vld1q_s16(&buffer[16 * i + 4]);
+        sum_lo = vaddq_s32(sum_lo, vshlq_s32(vmulq_s32(vmovl_s16(vget_low_s16(x)), vld1q_s32(&synth80_coeff[i][0][0])),
+                                             vnegq_s32(vld1q_s32(&synth80_shift_right[i][0][0]))));
+        sum_hi = vaddq_s32(sum_hi, vshlq_s32(vmulq_s32(vmovl_s16(vget_high_s16(x)), vld1q_s32(&synth80_coeff[i][0][4])),
+                                             vnegq_s32(vld1q_s32(&synth80_shift_right[i][0][4]))));
+        /* reverse buffer[16*i + 5 .. 16*i + 12] */
+        x = vrev64q_s16(vld1q_s16(&buffer[16 * i + 5]));
+        x = vcombine_s16(vget_high_s16(x), vget_low_s16(x));
+        sum_lo = vaddq_s32(sum_lo, vshlq_s32(vmulq_s32(vmovl_s16(vget_low_s16(x)), vld1q_s32(&synth80_coeff[i][1][0])),
+                                             vnegq_s32(vld1q_s32(&synth80_shift_right[i][1][0]))));
+        sum_hi = vaddq_s32(sum_hi, vshlq_s32(vmulq_s32(vmovl_s16(vget_high_s16(x)), vld1q_s32(&synth80_coeff[i][1][4])),
+                                             vnegq_s32(vld1q_s32(&synth80_shift_right[i][1][4]))));
+    }
+
+    /* pcm /= 32768 rounds towards zero, vqmovn saturates like CLIP_INT16 */
+    sum_lo = vaddq_s32(sum_lo, vandq_s32(vshrq_n_s32(sum_lo, 31), vdupq_n_s32(0x7fff)));
+    sum_hi = vaddq_s32(sum_hi, vandq_s32(vshrq_n_s32(sum_hi, 31), vdupq_n_s32(0x7fff)));
+    out = vcombine_s16(vqmovn_s32(vshrq_n_s32(sum_lo, 15)), vqmovn_s32(vshrq_n_s32(sum_hi, 15)));
+    vst1q_s16(samples, out);
+    for (i = 0; i < 8; i++) {
+        pcm[i << strideShift] = samples[i];
+    }
+}
+
+#define SYNTH80 SynthWindow80_neon
+#endif
+/* BK4BTSTACK_CHANGE END */
+
 #ifndef COPY_BACKWARD_32BIT_ALIGNED_72_HALFWORDS
 #define COPY_BACKWARD_32BIT_ALIGNED_72_HALFWORDS(dest, src) do { shift_buffer(dest, src, 72); } while (0)
 #endif
@@ -131,6 +131,14 @@
 #define SBC_FAST_DCT  TRUE
 #endif /*SBC_FAST_DCT */
 
+/* BK4BTSTACK_CHANGE START */
+/* Set SBC_SIMD_OPT to FALSE to disable the SSE2/AVX2/NEON analysis window. The SIMD version is bit-exact, */
+/* it is only used with SBC_IPAQ_OPT and 16 bit window coefficients. AVX2 is selected at runtime if supported */
+#ifndef SBC_SIMD_OPT
+#define SBC_SIMD_OPT  TRUE
+#endif /*SBC_SIMD_OPT */
+/* BK4BTSTACK_CHANGE END */
+
 /* In case we do not use joint stereo mode the flag save some RAM and ROM in case it is set to FALSE */
 #ifndef SBC_JOINT_STE_INCLUDED
 #define SBC_JOINT_STE_INCLUDED TRUE
@@ -196,6 +204,10 @@ typedef struct SBC_ENC_PARAMS_TAG
     UINT16 u16PacketLength;
     /* BK4BTSTACK_CHANGE START */
     UINT8  mSBCEnabled;
+    /* analysis filter state, kept per instance to allow for multiple encoders */
+    SINT16 s16ShiftCounter;
+    SINT16 s16EncMaxShiftCounter;
+    SINT32 s32X[ENC_VX_BUFFER_SIZE/2];
     /* BK4BTSTACK_CHANGE END */
 }SBC_ENC_PARAMS;
 
@@ -156,9 +156,9 @@
 #if (SBC_USE_ARM_PRAGMA==TRUE)
 #pragma arm section zidata = "sbc_s32_analysis_section"
 #endif
-static SINT32   s32DCTY[16]  = {0};
-static SINT32   s32X[ENC_VX_BUFFER_SIZE/2];
-static SINT16   *s16X=(SINT16*) s32X;      /* s16X must be 32 bits aligned cf  SHIFTUP_X8_2*/
+/* BK4BTSTACK_CHANGE START */
+/* s32DCTY, s16X, ShiftCounter and EncMaxShiftCounter are kept per encoder instance, see SBC_ENC_PARAMS */
+/* BK4BTSTACK_CHANGE END */
 #if (SBC_USE_ARM_PRAGMA==TRUE)
 #pragma arm section zidata
 #endif
@@ -897,8 +897,175 @@ static SINT16   *s16X=(SINT16*) s32X;      /* s16X must be 32 bits aligned cf  S
 #endif
 #endif
 
-static SINT16 ShiftCounter=0;
-extern SINT16 EncMaxShiftCounter;
+/* BK4BTSTACK_CHANGE START */
+#if (SBC_SIMD_OPT == TRUE) && (SBC_ARM_ASM_OPT == FALSE) && (SBC_IPAQ_OPT == TRUE) && (SBC_IS_64_MULT_IN_WINDOW_ACCU == FALSE)
+#if defined(__GNUC__) && (defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__)))
+#define SBC_WINDOW_SSE2
+#include <emmintrin.h>
+#if (__GNUC__ >= 5) || defined(__clang__)
+#define SBC_WINDOW_AVX2
+#include <immintrin.h>
+#endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define SBC_WINDOW_NEON
+#include <arm_neon.h>
+#endif
+#endif
+
+#if defined(SBC_WINDOW_SSE2) || defined(SBC_WINDOW_NEON)
+/*
+ * The window macros above written as s32DCTY[k] = sum(j=0..4) coeff[j][k] * s16X[ChOffset+j*2*subbands+k].
+ * All products and sums fit into 32 bit, so the SIMD versions produce exactly the same values.
+ */
+static const SINT16 gas16WindowCoeff4[5][8] = {
+    {                   0, WIND_4_SUBBANDS_1_0, WIND_4_SUBBANDS_2_0, WIND_4_SUBBANDS_3_0,
+      WIND_4_SUBBANDS_4_0, WIND_4_SUBBANDS_3_4, WIND_4_SUBBANDS_2_4, WIND_4_SUBBANDS_1_4 },
+    { WIND_4_SUBBANDS_0_1, WIND_4_SUBBANDS_1_1, WIND_4_SUBBANDS_2_1, WIND_4_SUBBANDS_3_1,
+      WIND_4_SUBBANDS_4_1, WIND_4_SUBBANDS_3_3, WIND_4_SUBBANDS_2_3, WIND_4_SUBBANDS_1_3 },
+    { WIND_4_SUBBANDS_0_2, WIND_4_SUBBANDS_1_2, WIND_4_SUBBANDS_2_2, WIND_4_SUBBANDS_3_2,
+      WIND_4_SUBBANDS_4_2, WIND_4_SUBBANDS_3_2, WIND_4_SUBBANDS_2_2, WIND_4_SUBBANDS_1_2 },
+    { -WIND_4_SUBBANDS_0_2, WIND_4_SUBBANDS_1_3, WIND_4_SUBBANDS_2_3, WIND_4_SUBBANDS_3_3,
+      WIND_4_SUBBANDS_4_1, WIND_4_SUBBANDS_3_1, WIND_4_SUBBANDS_2_1, WIND_4_SUBBANDS_1_1 },
+    { -WIND_4_SUBBANDS_0_1, WIND_4_SUBBANDS_1_4, WIND_4_SUBBANDS_2_4, WIND_4_SUBBANDS_3_4,
+      WIND_4_SUBBANDS_4_0, WIND_4_SUBBANDS_3_0, WIND_4_SUBBANDS_2_0, WIND_4_SUBBANDS_1_0 },
+};
+
+static const SINT16 gas16WindowCoeff8[5][16] = {
+    {                   0, WIND_8_SUBBANDS_1_0, WIND_8_SUBBANDS_2_0, WIND_8_SUBBANDS_3_0,
+      WIND_8_SUBBANDS_4_0, WIND_8_SUBBANDS_5_0, WIND_8_SUBBANDS_6_0, WIND_8_SUBBANDS_7_0,
+      WIND_8_SUBBANDS_8_0, WIND_8_SUBBANDS_7_4, WIND_8_SUBBANDS_6_4, WIND_8_SUBBANDS_5_4,
+      WIND_8_SUBBANDS_4_4, WIND_8_SUBBANDS_3_4, WIND_8_SUBBANDS_2_4, WIND_8_SUBBANDS_1_4 },
+    { WIND_8_SUBBANDS_0_1, WIND_8_SUBBANDS_1_1, WIND_8_SUBBANDS_2_1, WIND_8_SUBBANDS_3_1,
+      WIND_8_SUBBANDS_4_1, WIND_8_SUBBANDS_5_1, WIND_8_SUBBANDS_6_1, WIND_8_SUBBANDS_7_1,
+      WIND_8_SUBBANDS_8_1, WIND_8_SUBBANDS_7_3, WIND_8_SUBBANDS_6_3, WIND_8_SUBBANDS_5_3,
+      WIND_8_SUBBANDS_4_3, WIND_8_SUBBANDS_3_3, WIND_8_SUBBANDS_2_3, WIND_8_SUBBANDS_1_3 },
+    { WIND_8_SUBBANDS_0_2, WIND_8_SUBBANDS_1_2, WIND_8_SUBBANDS_2_2, WIND_8_SUBBANDS_3_2,
+      WIND_8_SUBBANDS_4_2, WIND_8_SUBBANDS_5_2, WIND_8_SUBBANDS_6_2, WIND_8_SUBBANDS_7_2,
+      WIND_8_SUBBANDS_8_2, WIND_8_SUBBANDS_7_2, WIND_8_SUBBANDS_6_2, WIND_8_SUBBANDS_5_2,
+      WIND_8_SUBBANDS_4_2, WIND_8_SUBBANDS_3_2, WIND_8_SUBBANDS_2_2, WIND_8_SUBBANDS_1_2 },
+    { -WIND_8_SUBBANDS_0_2, WIND_8_SUBBANDS_1_3, WIND_8_SUBBANDS_2_3, WIND_8_SUBBANDS_3_3,
+      WIND_8_SUBBANDS_4_3, WIND_8_SUBBANDS_5_3, WIND_8_SUBBANDS_6_3, WIND_8_SUBBANDS_7_3,
+      WIND_8_SUBBANDS_8_1, WIND_8_SUBBANDS_7_1, WIND_8_SUBBANDS_6_1, WIND_8_SUBBANDS_5_1,
+      WIND_8_SUBBANDS_4_1, WIND_8_SUBBANDS_3_1, WIND_8_SUBBANDS_2_1, WIND_8_SUBBANDS_1_1 },
+    { -WIND_8_SUBBANDS_0_1, WIND_8_SUBBANDS_1_4, WIND_8_SUBBANDS_2_4, WIND_8_SUBBANDS_3_4,
+      WIND_8_SUBBANDS_4_4, WIND_8_SUBBANDS_5_4, WIND_8_SUBBANDS_6_4, WIND_8_SUBBANDS_7_4,
+      WIND_8_SUBBANDS_8_0, WIND_8_SUBBANDS_7_0, WIND_8_SUBBANDS_6_0, WIND_8_SUBBANDS_5_0,
+      WIND_8_SUBBANDS_4_0, WIND_8_SUBBANDS_3_0, WIND_8_SUBBANDS_2_0, WIND_8_SUBBANDS_1_0 },
+};
+#endif
+
+#ifdef SBC_WINDOW_SSE2
+/* 8 outputs: pairs of taps are interleaved, so that pmaddwd computes coeff[j][k]*x[j][k] + coeff[j+1][k]*x[j+1][k] */
+static void SbcWindowSse2_8_outputs(const SINT16 *ps16X, SINT32 *ps32DCTY, const SINT16 *ps16Coeff, int s32Stride)
+{
+    __m128i x0 = _mm_loadu_si128((const __m128i *) &ps16X[0]);
+    __m128i x1 = _mm_loadu_si128((const __m128i *) &ps16X[s32Stride]);
+    __m128i x2 = _mm_loadu_si128((const __m128i *) &ps16X[2*s32Stride]);
+    __m128i x3 = _mm_loadu_si128((const __m128i *) &ps16X[3*s32Stride]);
+    __m128i x4 = _mm_loadu_si128((const __m128i *) &ps16X[4*s32Stride]);
+    __m128i c0 = _mm_loadu_si128((const __m128i *) &ps16Coeff[0]);
+    __m128i c1 = _mm_loadu_si128((const __m128i *) &ps16Coeff[s32Stride]);
+    __m128i c2 = _mm_loadu_si128((const __m128i *) &ps16Coeff[2*s32Stride]);
+    __m128i c3 = _mm_loadu_si128((const __m128i *) &ps16Coeff[3*s32Stride]);
+    __m128i c4 = _mm_loadu_si128((const __m128i *) &ps16Coeff[4*s32Stride]);
+    __m128i zero = _mm_setzero_si128();
+    __m128i lo, hi;
+
+    lo = _mm_madd_epi16(_mm_unpacklo_epi16(x0, x1), _mm_unpacklo_epi16(c0, c1));
+    hi = _mm_madd_epi16(_mm_unpackhi_epi16(x0, x1), _mm_unpackhi_epi16(c0, c1));
+    lo = _mm_add_epi32(lo, _mm_madd_epi16(_mm_unpacklo_epi16(x2, x3), _mm_unpacklo_epi16(c2, c3)));
+    hi = _mm_add_epi32(hi, _mm_madd_epi16(_mm_unpackhi_epi16(x2, x3), _mm_unpackhi_epi16(c2, c3)));
+    lo = _mm_add_epi32(lo, _mm_madd_epi16(_mm_unpacklo_epi16(x4, zero), _mm_unpacklo_epi16(c4, zero)));
+    hi = _mm_add_epi32(hi, _mm_madd_epi16(_mm_unpackhi_epi16(x4, zero), _mm_unpackhi_epi16(c4, zero)));
+    _mm_storeu_si128((__m128i *) &ps32DCTY[0], lo);
+    _mm_storeu_si128((__m128i *) &ps32DCTY[4], hi);
+}
+
+static void SbcWindow4Sse2(const SINT16 *ps16X, SINT32 *ps32DCTY)
+{
+    SbcWindowSse2_8_outputs(ps16X, ps32DCTY, &gas16WindowCoeff4[0][0], 8);
+}
+
+static void SbcWindow8Sse2(const SINT16 *ps16X, SINT32 *ps32DCTY)
+{
+    SbcWindowSse2_8_outputs(&ps16X[0], &ps32DCTY[0], &gas16WindowCoeff8[0][0], 16);
+    SbcWindowSse2_8_outputs(&ps16X[8], &ps32DCTY[8], &gas16WindowCoeff8[0][8], 16);
+}
+#endif
+
+#ifdef SBC_WINDOW_AVX2
+/* pmaddwd on 256 bit works per 128 bit lane: lo holds outputs 0-3 and 8-11, hi holds 4-7 and 12-15 */
+__attribute__((target("avx2")))
+static void SbcWindow8Avx2(const SINT16 *ps16X, SINT32 *ps32DCTY)
+{
+    __m256i x0 = _mm256_loadu_si256((const __m256i *) &ps16X[0]);
+    __m256i x1 = _mm256_loadu_si256((const __m256i *) &ps16X[16]);
+    __m256i x2 = _mm256_loadu_si256((const __m256i *) &ps16X[32]);
+    __m256i x3 = _mm256_loadu_si256((const __m256i *) &ps16X[48]);
+    __m256i x4 = _mm256_loadu_si256((const __m256i *) &ps16X[64]);
+    __m256i c0 = _mm256_loadu_si256((const __m256i *) gas16WindowCoeff8[0]);
+    __m256i c1 = _mm256_loadu_si256((const __m256i *) gas16WindowCoeff8[1]);
+    __m256i c2 = _mm256_loadu_si256((const __m256i *) gas16WindowCoeff8[2]);
+    __m256i c3 = _mm256_loadu_si256((const __m256i *) gas16WindowCoeff8[3]);
+    __m256i c4 = _mm256_loadu_si256((const __m256i *) gas16WindowCoeff8[4]);
+    __m256i zero = _mm256_setzero_si256();
+    __m256i lo, hi;
+
+    lo = _mm256_madd_epi16(_mm256_unpacklo_epi16(x0, x1), _mm256_unpacklo_epi16(c0, c1));
+    hi = _mm256_madd_epi16(_mm256_unpackhi_epi16(x0, x1), _mm256_unpackhi_epi16(c0, c1));
+    lo = _mm256_add_epi32(lo, _mm256_madd_epi16(_mm256_unpacklo_epi16(x2, x3), _mm256_unpacklo_epi16(c2, c3)));
+    hi = _mm256_add_epi32(hi, _mm256_madd_epi16(_mm256_unpackhi_epi16(x2, x3), _mm256_unpackhi_epi16(c2, c3)));
+    lo = _mm256_add_epi32(lo, _mm256_madd_epi16(_mm256_unpacklo_epi16(x4, zero), _mm256_unpacklo_epi16(c4, zero)));
+    hi = _mm256_add_epi32(hi, _mm256_madd_epi16(_mm256_unpackhi_epi16(x4, zero), _mm256_unpackhi_epi16(c4, zero)));
+    _mm256_storeu_si256((__m256i *) &ps32DCTY[0], _mm256_permute2x128_si256(lo, hi, 0x20));
+    _mm256_storeu_si256((__m256i *) &ps32DCTY[8], _mm256_permute2x128_si256(lo, hi, 0x31));
+}
+#endif
+
+#ifdef SBC_WINDOW_NEON
+static void SbcWindowNeon_8_outputs(const SINT16 *ps16X, SINT32 *ps32DCTY, const SINT16 *ps16Coeff, int s32Stride)
+{
+    int16x8_t x = vld1q_s16(ps16X);
+    int16x8_t c = vld1q_s16(ps16Coeff);
+    int32x4_t lo = vmull_s16(vget_low_s16(x), vget_low_s16(c));
+    int32x4_t hi = vmull_s16(vget_high_s16(x), vget_high_s16(c));
+    int j;
+    for (j=1;j<5;j++)
+    {
+        x = vld1q_s16(&ps16X[j*s32Stride]);
+        c = vld1q_s16(&ps16Coeff[j*s32Stride]);
+        lo = vmlal_s16(lo, vget_low_s16(x), vget_low_s16(c));
+        hi = vmlal_s16(hi, vget_high_s16(x), vget_high_s16(c));
+    }
+    vst1q_s32(&ps32DCTY[0], lo);
+    vst1q_s32(&ps32DCTY[4], hi);
+}
+
+static void SbcWindow4Neon(const SINT16 *ps16X, SINT32 *ps32DCTY)
+{
+    SbcWindowNeon_8_outputs(ps16X, ps32DCTY, &gas16WindowCoeff4[0][0], 8);
+}
+
+static void SbcWindow8Neon(const SINT16 *ps16X, SINT32 *ps32DCTY)
+{
+    SbcWindowNeon_8_outputs(&ps16X[0], &ps32DCTY[0], &gas16WindowCoeff8[0][0], 16);
+    SbcWindowNeon_8_outputs(&ps16X[8], &ps32DCTY[8], &gas16WindowCoeff8[0][8], 16);
+}
+#endif
+
+#if defined(SBC_WINDOW_SSE2) || defined(SBC_WINDOW_NEON)
+#define SBC_WINDOW_SIMD
+typedef void (*SBC_WINDOW_FUNC)(const SINT16 *ps16X, SINT32 *ps32DCTY);
+#ifdef SBC_WINDOW_SSE2
+static SBC_WINDOW_FUNC SbcWindow4 = SbcWindow4Sse2;
+static SBC_WINDOW_FUNC SbcWindow8 = SbcWindow8Sse2;
+#else
+static SBC_WINDOW_FUNC SbcWindow4 = SbcWindow4Neon;
+static SBC_WINDOW_FUNC SbcWindow8 = SbcWindow8Neon;
+#endif
+#endif
+/* BK4BTSTACK_CHANGE END */
+
 /****************************************************************************
 * SbcAnalysisFilter - performs Analysis of the input audio stream
 *
@@ -912,6 +1079,12 @@ void SbcAnalysisFilter4(SBC_ENC_PARAMS *pstrEncParams)
     SINT32  s32NumOfChannels, s32NumOfBlocks;
     SINT32 i,*ps32X,*ps32X2;
     SINT32 Offset,Offset2,ChOffset;
+    /* BK4BTSTACK_CHANGE START */
+    SINT32  s32DCTY[16];
+    SINT16 *s16X = (SINT16 *) pstrEncParams->s32X;  /* s16X must be 32 bits aligned cf  SHIFTUP_X8_2*/
+    SINT16  ShiftCounter = pstrEncParams->s16ShiftCounter;
+    SINT16  EncMaxShiftCounter = pstrEncParams->s16EncMaxShiftCounter;
+    /* BK4BTSTACK_CHANGE END */
 #if (SBC_ARM_ASM_OPT==TRUE)
     register SINT32 s32Hi,s32Hi2;
 #else
@@ -919,7 +1092,11 @@ void SbcAnalysisFilter4(SBC_ENC_PARAMS *pstrEncParams)
 #if (SBC_IS_64_MULT_IN_WINDOW_ACCU == TRUE)
     register SINT64 s64Temp,s64Temp2;
 #else
+    /* BK4BTSTACK_CHANGE START */
+#ifndef SBC_WINDOW_SIMD
 	register SINT32 s32Temp,s32Temp2;
+#endif
+    /* BK4BTSTACK_CHANGE END */
 #endif
 #else
 
@@ -965,7 +1142,13 @@ void SbcAnalysisFilter4(SBC_ENC_PARAMS *pstrEncParams)
         {
             ChOffset=(s32Ch*Offset2)+Offset;
             
+            /* BK4BTSTACK_CHANGE START */
+#ifdef SBC_WINDOW_SIMD
+            SbcWindow4(&s16X[ChOffset], s32DCTY);
+#else
             WINDOW_PARTIAL_4
+#endif
+            /* BK4BTSTACK_CHANGE END */
 
             SBC_FastIDCT4(s32DCTY, ps32SbBuf);
             ps32SbBuf +=SUB_BANDS_4;
@@ -995,6 +1178,9 @@ void SbcAnalysisFilter4(SBC_ENC_PARAMS *pstrEncParams)
             }
         }
     }
+    /* BK4BTSTACK_CHANGE START */
+    pstrEncParams->s16ShiftCounter = ShiftCounter;
+    /* BK4BTSTACK_CHANGE END */
 }
 
 /* //////////////////////////////////////////////////////////////////////////////////////////////////////////////////// */
@@ -1007,6 +1193,12 @@ void SbcAnalysisFilter8 (SBC_ENC_PARAMS *pstrEncParams)
     SINT32  s32NumOfChannels, s32NumOfBlocks;
     SINT32 i,*ps32X,*ps32X2;
     SINT32 ChOffset;
+    /* BK4BTSTACK_CHANGE START */
+    SINT32  s32DCTY[16];
+    SINT16 *s16X = (SINT16 *) pstrEncParams->s32X;  /* s16X must be 32 bits aligned cf  SHIFTUP_X8_2*/
+    SINT16  ShiftCounter = pstrEncParams->s16ShiftCounter;
+    SINT16  EncMaxShiftCounter = pstrEncParams->s16EncMaxShiftCounter;
+    /* BK4BTSTACK_CHANGE END */
 #if (SBC_ARM_ASM_OPT==TRUE)
     register SINT32 s32Hi,s32Hi2;
 #else
@@ -1014,7 +1206,11 @@ void SbcAnalysisFilter8 (SBC_ENC_PARAMS *pstrEncParams)
 #if (SBC_IS_64_MULT_IN_WINDOW_ACCU == TRUE)
     register SINT64 s64Temp,s64Temp2;
 #else
+    /* BK4BTSTACK_CHANGE START */
+#ifndef SBC_WINDOW_SIMD
 	register SINT32 s32Temp,s32Temp2;
+#endif
+    /* BK4BTSTACK_CHANGE END */
 #endif
 #else
 #if (SBC_IS_64_MULT_IN_WINDOW_ACCU == TRUE)
@@ -1068,7 +1264,13 @@ void SbcAnalysisFilter8 (SBC_ENC_PARAMS *pstrEncParams)
         {
             ChOffset=(s32Ch*Offset2)+Offset;
 
+            /* BK4BTSTACK_CHANGE START */
+#ifdef SBC_WINDOW_SIMD
+            SbcWindow8(&s16X[ChOffset], s32DCTY);
+#else
             WINDOW_PARTIAL_8
+#endif
+            /* BK4BTSTACK_CHANGE END */
 
             SBC_FastIDCT8 (s32DCTY, ps32SbBuf);
 
@@ -1099,10 +1301,23 @@ void SbcAnalysisFilter8 (SBC_ENC_PARAMS *pstrEncParams)
             }
         }
     }
+    /* BK4BTSTACK_CHANGE START */
+    pstrEncParams->s16ShiftCounter = ShiftCounter;
+    /* BK4BTSTACK_CHANGE END */
 }
 
-void SbcAnalysisInit (void)
+/* BK4BTSTACK_CHANGE START */
+void SbcAnalysisInit (SBC_ENC_PARAMS *pstrEncParams)
 {
-    memset(s16X,0,ENC_VX_BUFFER_SIZE*sizeof(SINT16));
-    ShiftCounter=0;
+    memset(pstrEncParams->s32X,0,ENC_VX_BUFFER_SIZE*sizeof(SINT16));
+    pstrEncParams->s16ShiftCounter=0;
+/* BK4BTSTACK_CHANGE END */
+    /* BK4BTSTACK_CHANGE START */
+#ifdef SBC_WINDOW_AVX2
+    if (__builtin_cpu_supports("avx2"))
+    {
+        SbcWindow8 = SbcWindow8Avx2;
+    }
+#endif
+    /* BK4BTSTACK_CHANGE END */
 }
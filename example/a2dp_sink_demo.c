@@ -69,6 +69,7 @@
 #include <string.h>
 
 #include "btstack.h"
+#include "btstack_audio_jitter_buffer.h"
 #include "btstack_resample.h"
 
 //#define AVRCP_BROWSING_ENABLED
@@ -97,13 +98,11 @@
 static btstack_sbc_decoder_state_t state;
 static btstack_sbc_mode_t mode = SBC_MODE_STANDARD;
 
-// ring buffer for SBC Frames
-// below 30: add samples, 30-40: fine, above 40: drop samples
-#define OPTIMAL_FRAMES_MIN 30
-#define OPTIMAL_FRAMES_MAX 40
-#define ADDITIONAL_FRAMES  20
-static uint8_t sbc_frame_storage[(OPTIMAL_FRAMES_MAX + ADDITIONAL_FRAMES) * MAX_SBC_FRAME_SIZE];
-static btstack_ring_buffer_t sbc_frame_ring_buffer;
+// jitter buffer for SBC Frames, playback starts with 35 frames (~100 ms) buffered
+#define JITTER_BUFFER_TARGET_FRAMES 35
+#define JITTER_BUFFER_MAX_FRAMES    60
+static uint8_t sbc_frame_storage[JITTER_BUFFER_MAX_FRAMES * MAX_SBC_FRAME_SIZE];
+static btstack_audio_jitter_buffer_t sbc_jitter_buffer;
 static unsigned int sbc_frame_size;
 
 // rest buffer for not fully used sbc frames, with additional frames for resampling
@@ -322,10 +321,9 @@ static void playback_handler(int16_t * buffer, uint16_t num_audio_frames){
     // then start decoding sbc frames using request_* globals
     request_buffer = buffer;
     request_frames = num_audio_frames;
-    while (request_frames && btstack_ring_buffer_bytes_available(&sbc_frame_ring_buffer) >= sbc_frame_size){
+    uint8_t sbc_frame[MAX_SBC_FRAME_SIZE];
+    while (request_frames && btstack_audio_jitter_buffer_read(&sbc_jitter_buffer, sbc_frame)){
         // decode frame
-        uint8_t sbc_frame[MAX_SBC_FRAME_SIZE];
-        btstack_ring_buffer_read(&sbc_frame_ring_buffer, sbc_frame, sbc_frame_size, &bytes_read);
         btstack_sbc_decoder_process_data(&state, 0, sbc_frame, sbc_frame_size);
     }
 
@@ -382,10 +380,13 @@ static int media_processing_init(avdtp_media_codec_configuration_sbc_t configura
    sbc_file = fopen(sbc_filename, "wb"); 
 #endif
 
-    btstack_ring_buffer_init(&sbc_frame_ring_buffer, sbc_frame_storage, sizeof(sbc_frame_storage));
     btstack_ring_buffer_init(&decoded_audio_ring_buffer, decoded_audio_storage, sizeof(decoded_audio_storage));
     btstack_resample_init(&resample_instance, configuration.num_channels);
 
+    // jitter buffer adjusts resampling factor to compensate for clock drift
+    btstack_audio_jitter_buffer_init(&sbc_jitter_buffer, sbc_frame_storage, sizeof(sbc_frame_storage), JITTER_BUFFER_TARGET_FRAMES);
+    btstack_audio_jitter_buffer_set_resample(&sbc_jitter_buffer, &resample_instance);
+
     // setup audio playback
     const btstack_audio_sink_t * audio = btstack_audio_sink_get_instance();
     if (audio){
@@ -447,8 +448,9 @@ static void media_processing_close(void){
  *
  * @text Media data packets, in this case the audio data, are received through the handle_l2cap_media_data_packet callback.
  * Currently, only the SBC media codec is supported. Hence, the media data consists of the media packet header and the SBC packet.
- * The SBC frame will be stored in a ring buffer for later processing (instead of decoding it to PCM right away which would require a much larger buffer)
- * If the audio stream wasn't started already and there are enough SBC frames in the ring buffer, start playback.
+ * The SBC frame will be stored in a jitter buffer for later processing (instead of decoding it to PCM right away which would require a much larger buffer)
+ * The jitter buffer also estimates the clock drift between source and audio playback and adjusts the resampling factor accordingly.
+ * If the audio stream wasn't started already and there are enough SBC frames in the jitter buffer, start playback.
  */ 
 
 static int read_media_data_header(uint8_t * packet, int size, int * offset, avdtp_media_packet_header_t * media_header);
@@ -477,32 +479,15 @@ static void handle_l2cap_media_data_packet(uint8_t seid, uint8_t *packet, uint16
 
     // store sbc frame size for buffer management
     sbc_frame_size = (size-pos)/ sbc_header.num_frames;
-        
-    int status = btstack_ring_buffer_write(&sbc_frame_ring_buffer, packet+pos, size-pos);
-    if (status){
-        printf("Error storing samples in SBC ring buffer!!!\n");
-    }
-
-    // decide on audio sync drift based on number of sbc frames in queue
-    int sbc_frames_in_buffer = btstack_ring_buffer_bytes_available(&sbc_frame_ring_buffer) / sbc_frame_size;
-    uint32_t resampling_factor;
+    btstack_audio_jitter_buffer_set_frame_size(&sbc_jitter_buffer, sbc_frame_size);
 
-    // nomimal factor (fixed-point 2^16) and compensation offset
-    uint32_t nomimal_factor = 0x10000;
-    uint32_t compensation   = 0x00100;
-
-    if (sbc_frames_in_buffer < OPTIMAL_FRAMES_MIN){
-    	resampling_factor = nomimal_factor - compensation;    // stretch samples
-    } else if (sbc_frames_in_buffer <= OPTIMAL_FRAMES_MAX){
-    	resampling_factor = nomimal_factor;                   // nothing to do
-    } else {
-    	resampling_factor = nomimal_factor + compensation;    // compress samples
+    int status = btstack_audio_jitter_buffer_write(&sbc_jitter_buffer, packet+pos, sbc_header.num_frames);
+    if (status){
+        printf("Error storing samples in SBC jitter buffer!!!\n");
     }
 
-    btstack_resample_set_factor(&resample_instance, resampling_factor);
-
     // start stream if enough frames buffered
-    if (!audio_stream_started && sbc_frames_in_buffer >= OPTIMAL_FRAMES_MIN){
+    if (!audio_stream_started && btstack_audio_jitter_buffer_is_started(&sbc_jitter_buffer)){
         audio_stream_started = 1;
         // setup audio playback
         if (audio){
@@ -81,7 +81,10 @@
 #define AUDIO_TIMEOUT_MS            10 
 #define TABLE_SIZE_441HZ            100
 
-#define SBC_STORAGE_SIZE 1030
+// number of SBC frames in media payload is stored in 4 bits
+#define MAX_SBC_FRAMES_PER_PACKET   15
+// max number of audio frames per SBC frame: 16 blocks * 8 subbands
+#define MAX_SBC_AUDIO_FRAMES        128
 
 typedef enum {
     STREAM_SINE = 0,
@@ -103,8 +106,7 @@ typedef struct {
     uint8_t  streaming;
     int      max_media_payload_size;
     
-    uint8_t  sbc_storage[SBC_STORAGE_SIZE];
-    uint16_t sbc_storage_count;
+    uint8_t  sbc_frames_per_packet;
     uint8_t  sbc_ready_to_send;
 
     uint16_t volume; 
@@ -187,6 +189,9 @@ static btstack_sbc_encoder_state_t sbc_encoder_state;
 static uint8_t media_sbc_codec_configuration[4];
 static a2dp_media_sending_context_t media_tracker;
 
+// audio for all SBC frames of a media packet
+static int16_t pcm_frames[MAX_SBC_FRAMES_PER_PACKET * MAX_SBC_AUDIO_FRAMES * NUM_CHANNELS];
+
 static stream_data_source_t data_source;
 
 static int sine_phase;
@@ -353,22 +358,12 @@ static void a2dp_demo_reconfigure_sample_rate(int new_sample_rate){
         }
     }
     sample_rate = new_sample_rate;
-    media_tracker.sbc_storage_count = 0;
     media_tracker.samples_ready = 0;
     hxcmod_unload(&mod_context);
     hxcmod_setcfg(&mod_context, sample_rate, 16, 1, 1, 1);
     hxcmod_load(&mod_context, (void *) &mod_data, mod_len);
 }
 
-static void a2dp_demo_send_media_packet(void){
-    int num_bytes_in_frame = btstack_sbc_encoder_sbc_buffer_length();
-    int bytes_in_storage = media_tracker.sbc_storage_count;
-    uint8_t num_frames = bytes_in_storage / num_bytes_in_frame;
-    a2dp_source_stream_send_media_payload(media_tracker.a2dp_cid, media_tracker.local_seid, media_tracker.sbc_storage, bytes_in_storage, num_frames, 0);
-    media_tracker.sbc_storage_count = 0;
-    media_tracker.sbc_ready_to_send = 0;
-}
-
 static void produce_sine_audio(int16_t * pcm_buffer, int num_samples_to_write){
     int count;
     for (count = 0; count < num_samples_to_write ; count++){
@@ -424,27 +419,19 @@ static void produce_audio(int16_t * pcm_buffer, int num_samples){
 #endif
 }
 
-static int a2dp_demo_fill_sbc_audio_buffer(a2dp_media_sending_context_t * context){
-    // perform sbc encodin
-    int total_num_bytes_read = 0;
-    unsigned int num_audio_samples_per_sbc_buffer = btstack_sbc_encoder_num_audio_frames();
-    while (context->samples_ready >= num_audio_samples_per_sbc_buffer
-        && (context->max_media_payload_size - context->sbc_storage_count) >= btstack_sbc_encoder_sbc_buffer_length()){
+static void a2dp_demo_send_media_packet(void){
+    media_tracker.sbc_ready_to_send = 0;
 
-        int16_t pcm_frame[256*NUM_CHANNELS];
+    uint8_t * media_payload = a2dp_source_stream_reserve_media_payload(media_tracker.a2dp_cid, media_tracker.local_seid);
+    if (media_payload == NULL) return;
 
-        produce_audio(pcm_frame, num_audio_samples_per_sbc_buffer);
-        btstack_sbc_encoder_process_data(pcm_frame);
-        
-        uint16_t sbc_frame_size = btstack_sbc_encoder_sbc_buffer_length(); 
-        uint8_t * sbc_frame = btstack_sbc_encoder_sbc_buffer();
-        
-        total_num_bytes_read += num_audio_samples_per_sbc_buffer;
-        memcpy(&context->sbc_storage[context->sbc_storage_count], sbc_frame, sbc_frame_size);
-        context->sbc_storage_count += sbc_frame_size;
-        context->samples_ready -= num_audio_samples_per_sbc_buffer;
-    }
-    return total_num_bytes_read;
+    // encode SBC frames directly into outgoing media packet
+    int num_audio_frames_per_sbc_frame = btstack_sbc_encoder_num_audio_frames_ctx(&sbc_encoder_state);
+    uint8_t num_frames = media_tracker.sbc_frames_per_packet;
+    produce_audio(pcm_frames, num_frames * num_audio_frames_per_sbc_frame);
+    uint16_t num_bytes = btstack_sbc_encoder_process_data_batch_ctx(&sbc_encoder_state, pcm_frames, num_frames, media_payload);
+    a2dp_source_stream_send_prepared_media_payload(media_tracker.a2dp_cid, media_tracker.local_seid, num_bytes, num_frames, 0);
+    media_tracker.samples_ready -= num_frames * num_audio_frames_per_sbc_frame;
 }
 
 static void a2dp_demo_audio_timeout_handler(btstack_timer_source_t * timer){
@@ -470,9 +457,8 @@ static void a2dp_demo_audio_timeout_handler(btstack_timer_source_t * timer){
 
     if (context->sbc_ready_to_send) return;
 
-    a2dp_demo_fill_sbc_audio_buffer(context);
-
-    if ((context->sbc_storage_count + btstack_sbc_encoder_sbc_buffer_length()) > context->max_media_payload_size){
+    uint32_t num_audio_frames_per_packet = context->sbc_frames_per_packet * btstack_sbc_encoder_num_audio_frames_ctx(&sbc_encoder_state);
+    if (context->samples_ready >= num_audio_frames_per_packet){
         // schedule sending
         context->sbc_ready_to_send = 1;
         a2dp_source_stream_endpoint_request_can_send_now(context->a2dp_cid, context->local_seid);
@@ -480,8 +466,11 @@ static void a2dp_demo_audio_timeout_handler(btstack_timer_source_t * timer){
 }
 
 static void a2dp_demo_timer_start(a2dp_media_sending_context_t * context){
-    context->max_media_payload_size = btstack_min(a2dp_max_media_payload_size(context->a2dp_cid, context->local_seid), SBC_STORAGE_SIZE);
-    context->sbc_storage_count = 0;
+    context->max_media_payload_size = a2dp_max_media_payload_size(context->a2dp_cid, context->local_seid);
+    // fill media packet with SBC frames, first byte of media payload contains number of frames
+    int sbc_frame_size = btstack_sbc_encoder_sbc_buffer_length_ctx(&sbc_encoder_state);
+    int sbc_frames_per_packet = (context->max_media_payload_size - 1) / sbc_frame_size;
+    context->sbc_frames_per_packet = (uint8_t) btstack_max(1, btstack_min(MAX_SBC_FRAMES_PER_PACKET, sbc_frames_per_packet));
     context->sbc_ready_to_send = 0;
     context->streaming = 1;
     btstack_run_loop_remove_timer(&context->audio_timer);
@@ -496,7 +485,6 @@ static void a2dp_demo_timer_stop(a2dp_media_sending_context_t * context){
     context->acc_num_missed_samples = 0;
     context->samples_ready = 0;
     context->streaming = 1;
-    context->sbc_storage_count = 0;
     context->sbc_ready_to_send = 0;
     btstack_run_loop_remove_timer(&context->audio_timer);
 } 
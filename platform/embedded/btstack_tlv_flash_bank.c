@@ -63,6 +63,15 @@
 //
 // With ENABLE_TLV_FLASH_EXPLICIT_DELETE_FIELD an extra field is reserved to indicate a deleted tag, while keeping main logic
 
+// ENABLE_TLV_FLASH_BANK_INDEX
+//
+// Keep offset and len of valid entries in a RAM index sorted by tag. The index is rebuilt on init and migrate.
+// If more than MAX_NR_TLV_FLASH_BANK_INDEX_ENTRIES tags are stored, tags not in the index are found by scanning the bank.
+
+// ENABLE_TLV_FLASH_BANK_WRITE_BUFFER
+//
+// With btstack_tlv_flash_bank_set_write_delay, small values are kept in RAM and written to flash when the delay expires.
+
 #define BTSTACK_TLV_HEADER_LEN 8
 
 #ifndef BTSTACK_FLASH_ALIGNMENT_MAX
@@ -237,6 +246,71 @@ static void btstack_tlv_flash_bank_erase_bank(btstack_tlv_flash_bank_t * self, i
 	}
 }
 
+#ifdef ENABLE_TLV_FLASH_BANK_INDEX
+
+// @returns position of tag in index or position where it has to be inserted
+static int btstack_tlv_flash_bank_index_search(btstack_tlv_flash_bank_t * self, uint32_t tag, int * found){
+	int low  = 0;
+	int high = self->index_count;
+	while (low < high){
+		int mid = (low + high) / 2;
+		if (self->index[mid].tag < tag){
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+	*found = (low < self->index_count) && (self->index[low].tag == tag);
+	return low;
+}
+
+static const btstack_tlv_flash_bank_index_entry_t * btstack_tlv_flash_bank_index_get(btstack_tlv_flash_bank_t * self, uint32_t tag){
+	int found;
+	int pos = btstack_tlv_flash_bank_index_search(self, tag, &found);
+	return found ? &self->index[pos] : NULL;
+}
+
+static void btstack_tlv_flash_bank_index_set(btstack_tlv_flash_bank_t * self, uint32_t tag, uint32_t offset, uint32_t len){
+	int found;
+	int pos = btstack_tlv_flash_bank_index_search(self, tag, &found);
+	if (!found){
+		if (self->index_count == MAX_NR_TLV_FLASH_BANK_INDEX_ENTRIES){
+			// tag can only be found by scanning the bank
+			self->index_complete = 0;
+			return;
+		}
+		memmove(&self->index[pos+1], &self->index[pos], (self->index_count - pos) * sizeof(btstack_tlv_flash_bank_index_entry_t));
+		self->index_count++;
+		self->index[pos].tag = tag;
+	}
+	self->index[pos].offset = offset;
+	self->index[pos].len    = len;
+}
+
+static void btstack_tlv_flash_bank_index_remove(btstack_tlv_flash_bank_t * self, uint32_t tag){
+	int found;
+	int pos = btstack_tlv_flash_bank_index_search(self, tag, &found);
+	if (!found) return;
+	self->index_count--;
+	memmove(&self->index[pos], &self->index[pos+1], (self->index_count - pos) * sizeof(btstack_tlv_flash_bank_index_entry_t));
+}
+
+static void btstack_tlv_flash_bank_index_rebuild(btstack_tlv_flash_bank_t * self){
+	self->index_count = 0;
+	self->index_complete = 1;
+	tlv_iterator_t it;
+	btstack_tlv_flash_bank_iterator_init(self, &it, self->current_bank);
+	while (btstack_tlv_flash_bank_iterator_has_next(self, &it)){
+		// skip deleted entries
+		if (it.tag) {
+			btstack_tlv_flash_bank_index_set(self, it.tag, it.offset, it.len);
+		}
+		tlv_iterator_fetch_next(self, &it);
+	}
+	log_info("index with %u entries, complete %u", self->index_count, self->index_complete);
+}
+#endif
+
 static void btstack_tlv_flash_bank_migrate(btstack_tlv_flash_bank_t * self){
 
 	int next_bank = 1 - self->current_bank;
@@ -288,6 +362,22 @@ static void btstack_tlv_flash_bank_migrate(btstack_tlv_flash_bank_t * self){
 	btstack_tlv_flash_bank_write_header(self, next_bank, (epoch_buffer + 1) & 3);
 	self->current_bank = next_bank;
 	self->write_offset = next_write_pos;
+
+#ifdef ENABLE_TLV_FLASH_BANK_INDEX
+	btstack_tlv_flash_bank_index_rebuild(self);
+#endif
+}
+
+static void btstack_tlv_flash_bank_delete_entry(btstack_tlv_flash_bank_t * self, uint32_t offset){
+	// mark entry as invalid
+	uint32_t zero_value = 0;
+#ifdef ENABLE_TLV_FLASH_EXPLICIT_DELETE_FIELD
+	// write delete field at offset 8
+	btstack_tlv_flash_bank_write(self, self->current_bank, offset+8, (uint8_t*) &zero_value, sizeof(zero_value));
+#else
+	// overwrite tag with zero value
+	btstack_tlv_flash_bank_write(self, self->current_bank, offset, (uint8_t*) &zero_value, sizeof(zero_value));
+#endif
 }
 
 static void btstack_tlv_flash_bank_delete_tag_until_offset(btstack_tlv_flash_bank_t * self, uint32_t tag, uint32_t offset){
@@ -296,22 +386,69 @@ static void btstack_tlv_flash_bank_delete_tag_until_offset(btstack_tlv_flash_ban
 	while (btstack_tlv_flash_bank_iterator_has_next(self, &it) && it.offset < offset){
 		if (it.tag == tag){
 			log_info("Erase tag '%x' at position %u", tag, it.offset);
+			btstack_tlv_flash_bank_delete_entry(self, it.offset);
+		}
+		tlv_iterator_fetch_next(self, &it);
+	}
+}
 
-			// mark entry as invalid
-			uint32_t zero_value = 0;
-#ifdef ENABLE_TLV_FLASH_EXPLICIT_DELETE_FIELD
-			// write delete field at offset 8
-			btstack_tlv_flash_bank_write(self, self->current_bank, it.offset+8, (uint8_t*) &zero_value, sizeof(zero_value));
-#else
-			// overwrite tag with zero value
-			btstack_tlv_flash_bank_write(self, self->current_bank, it.offset, (uint8_t*) &zero_value, sizeof(zero_value));
+// @returns offset of valid entry for tag or 0 if not found
+static uint32_t btstack_tlv_flash_bank_find_tag(btstack_tlv_flash_bank_t * self, uint32_t tag, uint32_t * tag_len){
+#ifdef ENABLE_TLV_FLASH_BANK_INDEX
+	const btstack_tlv_flash_bank_index_entry_t * index_entry = btstack_tlv_flash_bank_index_get(self, tag);
+	if (index_entry != NULL){
+		*tag_len = index_entry->len;
+		return index_entry->offset;
+	}
+	if (self->index_complete) return 0;
 #endif
-
+	tlv_iterator_t it;
+	btstack_tlv_flash_bank_iterator_init(self, &it, self->current_bank);
+	while (btstack_tlv_flash_bank_iterator_has_next(self, &it)){
+		if (it.tag == tag){
+			log_info("Found tag '%x' at position %u", tag, it.offset);
+			*tag_len = it.len;
+			return it.offset;
 		}
 		tlv_iterator_fetch_next(self, &it);
 	}
+	return 0;
+}
+
+// mark valid entry for tag before write offset as deleted
+static void btstack_tlv_flash_bank_delete_valid_entry(btstack_tlv_flash_bank_t * self, uint32_t tag){
+#ifdef ENABLE_TLV_FLASH_BANK_INDEX
+	const btstack_tlv_flash_bank_index_entry_t * index_entry = btstack_tlv_flash_bank_index_get(self, tag);
+	if (index_entry != NULL){
+		log_info("Erase tag '%x' at position %u", tag, index_entry->offset);
+		btstack_tlv_flash_bank_delete_entry(self, index_entry->offset);
+		btstack_tlv_flash_bank_index_remove(self, tag);
+		return;
+	}
+	if (self->index_complete) return;
+#endif
+	btstack_tlv_flash_bank_delete_tag_until_offset(self, tag, self->write_offset);
 }
 
+#ifdef ENABLE_TLV_FLASH_BANK_WRITE_BUFFER
+static btstack_tlv_flash_bank_write_buffer_entry_t * btstack_tlv_flash_bank_write_buffer_get(btstack_tlv_flash_bank_t * self, uint32_t tag){
+	int i;
+	for (i = 0; i < self->write_buffer_count; i++){
+		if (self->write_buffer[i].tag == tag){
+			return &self->write_buffer[i];
+		}
+	}
+	return NULL;
+}
+
+static void btstack_tlv_flash_bank_write_buffer_remove(btstack_tlv_flash_bank_t * self, uint32_t tag){
+	btstack_tlv_flash_bank_write_buffer_entry_t * entry = btstack_tlv_flash_bank_write_buffer_get(self, tag);
+	if (entry == NULL) return;
+	self->write_buffer_count--;
+	*entry = self->write_buffer[self->write_buffer_count];
+}
+#endif
+
 /**
  * Get Value for Tag
  * @param tag
@@ -323,19 +460,18 @@ static int btstack_tlv_flash_bank_get_tag(void * context, uint32_t tag, uint8_t
 
 	btstack_tlv_flash_bank_t * self = (btstack_tlv_flash_bank_t *) context;
 
-	uint32_t tag_index = 0;
-	uint32_t tag_len   = 0;
-	tlv_iterator_t it;
-	btstack_tlv_flash_bank_iterator_init(self, &it, self->current_bank);
-	while (btstack_tlv_flash_bank_iterator_has_next(self, &it)){
-		if (it.tag == tag){
-			log_info("Found tag '%x' at position %u", tag, it.offset);
-			tag_index = it.offset;
-			tag_len   = it.len;
-			break;
-		}
-		tlv_iterator_fetch_next(self, &it);
+#ifdef ENABLE_TLV_FLASH_BANK_WRITE_BUFFER
+	const btstack_tlv_flash_bank_write_buffer_entry_t * buffer_entry = btstack_tlv_flash_bank_write_buffer_get(self, tag);
+	if (buffer_entry != NULL){
+		if (!buffer) return buffer_entry->len;
+		int buffer_copy_size = btstack_min(buffer_size, buffer_entry->len);
+		memcpy(buffer, buffer_entry->value, buffer_copy_size);
+		return buffer_copy_size;
 	}
+#endif
+
+	uint32_t tag_len   = 0;
+	uint32_t tag_index = btstack_tlv_flash_bank_find_tag(self, tag, &tag_len);
 	if (tag_index == 0) return 0;
 	if (!buffer) return tag_len;
 	int copy_size = btstack_min(buffer_size, tag_len);
@@ -348,15 +484,7 @@ static int btstack_tlv_flash_bank_get_tag(void * context, uint32_t tag, uint8_t
 	return copy_size;
 }
 
-/**
- * Store Tag 
- * @param tag
- * @param data
- * @param data_size
- */
-static int btstack_tlv_flash_bank_store_tag(void * context, uint32_t tag, const uint8_t * data, uint32_t data_size){
-
-	btstack_tlv_flash_bank_t * self = (btstack_tlv_flash_bank_t *) context;
+static int btstack_tlv_flash_bank_write_tag(btstack_tlv_flash_bank_t * self, uint32_t tag, const uint8_t * data, uint32_t data_size){
 
 	// trigger migration if not enough space
 	uint32_t required_space = 8 + self->delete_tag_len + data_size;
@@ -389,7 +517,11 @@ static int btstack_tlv_flash_bank_store_tag(void * context, uint32_t tag, const
 	btstack_tlv_flash_bank_write(self, self->current_bank, self->write_offset, entry, sizeof(entry));
 
 	// overwrite old entries (if exists)
-	btstack_tlv_flash_bank_delete_tag_until_offset(self, tag, self->write_offset);
+	btstack_tlv_flash_bank_delete_valid_entry(self, tag);
+
+#ifdef ENABLE_TLV_FLASH_BANK_INDEX
+	btstack_tlv_flash_bank_index_set(self, tag, self->write_offset, data_size);
+#endif
 
 	// done
 	self->write_offset += sizeof(entry) + btstack_tlv_flash_bank_align_size(self, data_size);
@@ -402,13 +534,78 @@ static int btstack_tlv_flash_bank_store_tag(void * context, uint32_t tag, const
 	return 0;
 }
 
+#ifdef ENABLE_TLV_FLASH_BANK_WRITE_BUFFER
+void btstack_tlv_flash_bank_flush(btstack_tlv_flash_bank_t * self){
+	btstack_run_loop_remove_timer(&self->write_timer);
+	int i;
+	for (i = 0; i < self->write_buffer_count; i++){
+		btstack_tlv_flash_bank_write_buffer_entry_t * entry = &self->write_buffer[i];
+		btstack_tlv_flash_bank_write_tag(self, entry->tag, entry->value, entry->len);
+	}
+	self->write_buffer_count = 0;
+}
+
+static void btstack_tlv_flash_bank_write_timer_handler(btstack_timer_source_t * ts){
+	btstack_tlv_flash_bank_t * self = (btstack_tlv_flash_bank_t *) btstack_run_loop_get_timer_context(ts);
+	btstack_tlv_flash_bank_flush(self);
+}
+
+void btstack_tlv_flash_bank_set_write_delay(btstack_tlv_flash_bank_t * self, uint32_t delay_ms){
+	self->write_delay_ms = delay_ms;
+	if (delay_ms == 0){
+		btstack_tlv_flash_bank_flush(self);
+	}
+}
+
+// @returns true if value was stored in write buffer
+static bool btstack_tlv_flash_bank_write_buffer_store(btstack_tlv_flash_bank_t * self, uint32_t tag, const uint8_t * data, uint32_t data_size){
+	if (self->write_delay_ms == 0) return false;
+	if (data_size > TLV_FLASH_BANK_WRITE_BUFFER_VALUE_SIZE) return false;
+	btstack_tlv_flash_bank_write_buffer_entry_t * entry = btstack_tlv_flash_bank_write_buffer_get(self, tag);
+	if (entry == NULL){
+		if (self->write_buffer_count == MAX_NR_TLV_FLASH_BANK_WRITE_BUFFER_ENTRIES){
+			btstack_tlv_flash_bank_flush(self);
+		}
+		// first value since last flush starts delay
+		if (self->write_buffer_count == 0){
+			btstack_run_loop_set_timer(&self->write_timer, self->write_delay_ms);
+			btstack_run_loop_add_timer(&self->write_timer);
+		}
+		entry = &self->write_buffer[self->write_buffer_count++];
+		entry->tag = tag;
+	}
+	entry->len = data_size;
+	memcpy(entry->value, data, data_size);
+	return true;
+}
+#endif
+
+/**
+ * Store Tag 
+ * @param tag
+ * @param data
+ * @param data_size
+ */
+static int btstack_tlv_flash_bank_store_tag(void * context, uint32_t tag, const uint8_t * data, uint32_t data_size){
+	btstack_tlv_flash_bank_t * self = (btstack_tlv_flash_bank_t *) context;
+#ifdef ENABLE_TLV_FLASH_BANK_WRITE_BUFFER
+	if (btstack_tlv_flash_bank_write_buffer_store(self, tag, data, data_size)) return 0;
+	// drop buffered value, larger value is written directly
+	btstack_tlv_flash_bank_write_buffer_remove(self, tag);
+#endif
+	return btstack_tlv_flash_bank_write_tag(self, tag, data, data_size);
+}
+
 /**
  * Delete Tag
  * @param tag
  */
 static void btstack_tlv_flash_bank_delete_tag(void * context, uint32_t tag){
 	btstack_tlv_flash_bank_t * self = (btstack_tlv_flash_bank_t *) context;
-	btstack_tlv_flash_bank_delete_tag_until_offset(self, tag, self->write_offset);
+#ifdef ENABLE_TLV_FLASH_BANK_WRITE_BUFFER
+	btstack_tlv_flash_bank_write_buffer_remove(self, tag);
+#endif
+	btstack_tlv_flash_bank_delete_valid_entry(self, tag);
 }
 
 static const btstack_tlv_t btstack_tlv_flash_bank = {
@@ -426,6 +623,13 @@ const btstack_tlv_t * btstack_tlv_flash_bank_init_instance(btstack_tlv_flash_ban
 	self->hal_flash_bank_context = hal_flash_bank_context;
 	self->delete_tag_len = 0;
 
+#ifdef ENABLE_TLV_FLASH_BANK_WRITE_BUFFER
+	self->write_buffer_count = 0;
+	self->write_delay_ms = 0;
+	btstack_run_loop_set_timer_handler(&self->write_timer, &btstack_tlv_flash_bank_write_timer_handler);
+	btstack_run_loop_set_timer_context(&self->write_timer, self);
+#endif
+
 #ifdef ENABLE_TLV_FLASH_EXPLICIT_DELETE_FIELD
 	if (hal_flash_bank_impl->get_alignment(hal_flash_bank_context) > 8){
 		log_error("Flash alignment > 8 with ENABLE_TLV_FLASH_EXPLICIT_DELETE_FIELD not supported");
@@ -483,6 +687,10 @@ const btstack_tlv_t * btstack_tlv_flash_bank_init_instance(btstack_tlv_flash_ban
 		self->write_offset = 8;
 	}
 
+#ifdef ENABLE_TLV_FLASH_BANK_INDEX
+	btstack_tlv_flash_bank_index_rebuild(self);
+#endif
+
 	log_info("write offset %u", self->write_offset);
 	return &btstack_tlv_flash_bank;
 }
@@ -40,19 +40,65 @@
 #define BTSTACK_TLV_FLASH_BANK_H
 
 #include <stdint.h>
+#include "btstack_config.h"
 #include "btstack_tlv.h"
 #include "hal_flash_bank.h"
 
+#ifdef ENABLE_TLV_FLASH_BANK_WRITE_BUFFER
+#include "btstack_run_loop.h"
+#endif
+
 #if defined __cplusplus
 extern "C" {
 #endif
 
+#ifdef ENABLE_TLV_FLASH_BANK_INDEX
+#ifndef MAX_NR_TLV_FLASH_BANK_INDEX_ENTRIES
+#define MAX_NR_TLV_FLASH_BANK_INDEX_ENTRIES 32
+#endif
+
+// location of valid entry for tag in current bank, sorted by tag
+typedef struct {
+	uint32_t tag;
+	uint32_t offset;
+	uint32_t len;
+} btstack_tlv_flash_bank_index_entry_t;
+#endif
+
+#ifdef ENABLE_TLV_FLASH_BANK_WRITE_BUFFER
+#ifndef MAX_NR_TLV_FLASH_BANK_WRITE_BUFFER_ENTRIES
+#define MAX_NR_TLV_FLASH_BANK_WRITE_BUFFER_ENTRIES 4
+#endif
+#ifndef TLV_FLASH_BANK_WRITE_BUFFER_VALUE_SIZE
+#define TLV_FLASH_BANK_WRITE_BUFFER_VALUE_SIZE 16
+#endif
+
+// value stored in RAM until next flush
+typedef struct {
+	uint32_t tag;
+	uint32_t len;
+	uint8_t  value[TLV_FLASH_BANK_WRITE_BUFFER_VALUE_SIZE];
+} btstack_tlv_flash_bank_write_buffer_entry_t;
+#endif
+
 typedef struct {
 	const hal_flash_bank_t * hal_flash_bank_impl;
 	void * hal_flash_bank_context;
 	int current_bank;
 	int write_offset;
 	int delete_tag_len;
+#ifdef ENABLE_TLV_FLASH_BANK_INDEX
+	btstack_tlv_flash_bank_index_entry_t index[MAX_NR_TLV_FLASH_BANK_INDEX_ENTRIES];
+	int index_count;
+	// all valid tags in current bank are in index
+	int index_complete;
+#endif
+#ifdef ENABLE_TLV_FLASH_BANK_WRITE_BUFFER
+	btstack_tlv_flash_bank_write_buffer_entry_t write_buffer[MAX_NR_TLV_FLASH_BANK_WRITE_BUFFER_ENTRIES];
+	int write_buffer_count;
+	uint32_t write_delay_ms;
+	btstack_timer_source_t write_timer;
+#endif
 } btstack_tlv_flash_bank_t;
 
 /**
@@ -63,6 +109,23 @@ typedef struct {
  */
 const btstack_tlv_t * btstack_tlv_flash_bank_init_instance(btstack_tlv_flash_bank_t * context, const hal_flash_bank_t * hal_flash_bank_impl, void * hal_flash_bank_context);
 
+#ifdef ENABLE_TLV_FLASH_BANK_WRITE_BUFFER
+/**
+ * Buffer values up to TLV_FLASH_BANK_WRITE_BUFFER_VALUE_SIZE bytes in RAM and write them to flash
+ * at most once per delay. Repeated stores of the same tag within the delay only cause a single flash write.
+ * @note values stored within the delay are lost on reset, call btstack_tlv_flash_bank_flush before power down
+ * @param context btstack_tlv_flash_bank_t
+ * @param delay_ms or 0 to write every value immediately (default)
+ */
+void btstack_tlv_flash_bank_set_write_delay(btstack_tlv_flash_bank_t * context, uint32_t delay_ms);
+
+/**
+ * Write buffered values to flash
+ * @param context btstack_tlv_flash_bank_t
+ */
+void btstack_tlv_flash_bank_flush(btstack_tlv_flash_bank_t * context);
+#endif
+
 #if defined __cplusplus
 }
 #endif
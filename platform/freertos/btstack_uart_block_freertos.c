@@ -168,6 +168,8 @@ static const btstack_uart_block_t btstack_uart_block_freertos = {
     /* int (*get_supported_sleep_modes); */                           NULL,
     /* void (*set_sleep)(btstack_uart_sleep_mode_t sleep_mode); */    NULL,
     /* void (*set_wakeup_handler)(void (*wakeup_handler)(void)); */   NULL,   
+    /* void (*set_bytes_received)(void (*handler)(uint16_t)); */      NULL,
+    /* void (*receive_bytes)(uint8_t *buffer, uint16_t len); */       NULL,
 };
 
 const btstack_uart_block_t * btstack_uart_block_freertos_instance(void){
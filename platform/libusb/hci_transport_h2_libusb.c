@@ -83,6 +83,17 @@
 #define EVENT_IN_BUFFER_COUNT  3
 #define SCO_IN_BUFFER_COUNT   10
 
+// Outgoing ACL packets: with HCI_USB_ACL_OUT_BUFFER_COUNT > 1, ACL packets are copied into a pool of transfers
+// and the upper stack can send the next one while previous ones are in flight. The HCI layer does not send more
+// ACL packets than the Controller has buffers for (acl_packets_total_num), which also bounds the transfers in flight
+#ifndef HCI_USB_ACL_OUT_BUFFER_COUNT
+#define HCI_USB_ACL_OUT_BUFFER_COUNT 1
+#endif
+#define ACL_OUT_BUFFER_COUNT HCI_USB_ACL_OUT_BUFFER_COUNT
+
+// Outgoing HCI Commands: one control transfer for each command the HCI layer is allowed to send
+#define CMD_OUT_BUFFER_COUNT HCI_NUM_CMD_PACKETS_MAX
+
 #define ASYNC_POLLING_INTERVAL_MS 1
 
 //
@@ -147,6 +158,18 @@ typedef enum {
     H2_W4_PAYLOAD,
 } H2_SCO_STATE;
 
+// pool of outgoing transfers, slots are released in submission order
+typedef struct {
+    struct libusb_transfer ** transfers;
+    uint8_t * in_flight;
+    uint8_t   count;
+    // oldest transfer in flight
+    uint8_t   head;
+    uint8_t   num_active;
+    // HCI_EVENT_TRANSPORT_PACKET_SENT is deferred until a slot becomes free
+    uint8_t   packet_sent_pending;
+} usb_out_pool_t;
+
 static libusb_state_t libusb_state = LIB_USB_CLOSED;
 
 // single instance
@@ -160,8 +183,8 @@ static struct libusb_device_descriptor desc;
 #endif
 static libusb_device_handle * handle;
 
-static struct libusb_transfer *command_out_transfer;
-static struct libusb_transfer *acl_out_transfer;
+static struct libusb_transfer *command_out_transfer[CMD_OUT_BUFFER_COUNT];
+static struct libusb_transfer *acl_out_transfer[ACL_OUT_BUFFER_COUNT];
 static struct libusb_transfer *event_in_transfer[EVENT_IN_BUFFER_COUNT];
 static struct libusb_transfer *acl_in_transfer[ACL_IN_BUFFER_COUNT];
 
@@ -198,7 +221,12 @@ static int      sco_enabled;
 #endif
 
 // outgoing buffer for HCI Command packets
-static uint8_t hci_cmd_buffer[3 + 256 + LIBUSB_CONTROL_SETUP_SIZE];
+static uint8_t hci_cmd_buffer[CMD_OUT_BUFFER_COUNT][3 + 256 + LIBUSB_CONTROL_SETUP_SIZE];
+
+#if ACL_OUT_BUFFER_COUNT > 1
+// outgoing buffer for ACL packets
+static uint8_t hci_acl_out_buffer[ACL_OUT_BUFFER_COUNT][HCI_ACL_BUFFER_SIZE];
+#endif
 
 // incoming buffer for HCI Events and ACL Packets
 static uint8_t hci_event_in_buffer[EVENT_IN_BUFFER_COUNT][HCI_ACL_BUFFER_SIZE]; // bigger than largest packet
@@ -212,9 +240,14 @@ static int num_pollfds;
 static btstack_data_source_t * pollfd_data_sources;
 static btstack_timer_source_t usb_timer;
 static int usb_timer_active;
+static btstack_timer_source_t usb_packet_sent_timer;
+static int usb_packet_sent_timer_active;
 
-static int usb_acl_out_active = 0;
-static int usb_command_active = 0;
+// outgoing transfer pools
+static uint8_t        command_out_in_flight[CMD_OUT_BUFFER_COUNT];
+static uint8_t        acl_out_in_flight[ACL_OUT_BUFFER_COUNT];
+static usb_out_pool_t command_out_pool;
+static usb_out_pool_t acl_out_pool;
 
 // endpoint addresses
 static int event_in_addr;
@@ -241,6 +274,92 @@ static int sco_ring_have_space(void){
 }
 #endif
 
+static void usb_out_pool_init(usb_out_pool_t * pool, struct libusb_transfer ** transfers, uint8_t * in_flight, uint8_t count){
+    pool->transfers = transfers;
+    pool->in_flight = in_flight;
+    pool->count = count;
+    pool->head = 0;
+    pool->num_active = 0;
+    pool->packet_sent_pending = 0;
+    memset(in_flight, 0, count);
+}
+
+static int usb_out_pool_have_space(const usb_out_pool_t * pool){
+    return pool->num_active < pool->count;
+}
+
+static int usb_out_pool_get_free_index(const usb_out_pool_t * pool){
+    return (pool->head + pool->num_active) % pool->count;
+}
+
+static int usb_out_pool_get_index(const usb_out_pool_t * pool, const struct libusb_transfer * transfer){
+    int i;
+    for (i = 0; i < pool->count; i++){
+        if (pool->transfers[i] == transfer) return i;
+    }
+    return -1;
+}
+
+// returns true if HCI_EVENT_TRANSPORT_PACKET_SENT can be emitted from the run loop
+static int usb_out_pool_submitted(usb_out_pool_t * pool, int index){
+    pool->in_flight[index] = 1;
+    pool->num_active++;
+    pool->packet_sent_pending = 1;
+    return usb_out_pool_have_space(pool);
+}
+
+// returns true if HCI_EVENT_TRANSPORT_PACKET_SENT is pending and another transfer is available
+static int usb_out_pool_packet_sent_ready(usb_out_pool_t * pool){
+    if (pool->packet_sent_pending == 0) return 0;
+    if (!usb_out_pool_have_space(pool)) return 0;
+    pool->packet_sent_pending = 0;
+    return 1;
+}
+
+// returns true if HCI_EVENT_TRANSPORT_PACKET_SENT should be emitted now
+static int usb_out_pool_completed(usb_out_pool_t * pool, int index){
+    pool->in_flight[index] = 0;
+    // release slots in submission order
+    while ((pool->num_active > 0) && (pool->in_flight[pool->head] == 0)){
+        pool->head = (pool->head + 1) % pool->count;
+        pool->num_active--;
+    }
+    return usb_out_pool_packet_sent_ready(pool);
+}
+
+// cancel transfers in flight and free idle ones, transfers in flight are freed in async_callback
+static void usb_out_pool_cancel(usb_out_pool_t * pool){
+    int i;
+    for (i = 0; i < pool->count; i++){
+        if (pool->transfers[i] == NULL) continue;
+        if (pool->in_flight[i]){
+            log_info("cancel out transfer %p", pool->transfers[i]);
+            libusb_cancel_transfer(pool->transfers[i]);
+        } else {
+            libusb_free_transfer(pool->transfers[i]);
+            pool->transfers[i] = NULL;
+        }
+    }
+}
+
+// returns true if transfer was part of the pool and has been freed
+static int usb_out_pool_free_transfer(usb_out_pool_t * pool, struct libusb_transfer * transfer){
+    int index = usb_out_pool_get_index(pool, transfer);
+    if (index < 0) return 0;
+    pool->in_flight[index] = 0;
+    libusb_free_transfer(transfer);
+    pool->transfers[index] = NULL;
+    return 1;
+}
+
+static int usb_out_pool_all_freed(const usb_out_pool_t * pool){
+    int i;
+    for (i = 0; i < pool->count; i++){
+        if (pool->transfers[i] != NULL) return 0;
+    }
+    return 1;
+}
+
 void hci_transport_usb_set_path(int len, uint8_t * port_numbers){
     if (len > USB_MAX_PATH_LEN || !port_numbers){
         log_error("hci_transport_usb_set_path: len or port numbers invalid");
@@ -317,6 +436,8 @@ LIBUSB_CALL static void async_callback(struct libusb_transfer *transfer){
                 return;
             }
         }
+        if (usb_out_pool_free_transfer(&command_out_pool, transfer)) return;
+        if (usb_out_pool_free_transfer(&acl_out_pool, transfer)) return;
         return;
     }
 
@@ -439,6 +560,34 @@ static void handle_isochronous_data(uint8_t * buffer, uint16_t size){
 }
 #endif
 
+static void usb_emit_packet_sent(void){
+    // notify upper stack that provided buffer can be used again
+    uint8_t event[] = { HCI_EVENT_TRANSPORT_PACKET_SENT, 0};
+    packet_handler(HCI_EVENT_PACKET, &event[0], sizeof(event));
+}
+
+static void usb_packet_sent_handler(btstack_timer_source_t * timer){
+    UNUSED(timer);
+    usb_packet_sent_timer_active = 0;
+    if (libusb_state != LIB_USB_TRANSFERS_ALLOCATED) return;
+    if (usb_out_pool_packet_sent_ready(&command_out_pool)){
+        usb_emit_packet_sent();
+    }
+    if (libusb_state != LIB_USB_TRANSFERS_ALLOCATED) return;
+    if (usb_out_pool_packet_sent_ready(&acl_out_pool)){
+        usb_emit_packet_sent();
+    }
+}
+
+// HCI_EVENT_TRANSPORT_PACKET_SENT must not be emitted from send_packet as hci.c would send the next packet re-entrant
+static void usb_packet_sent_trigger(void){
+    if (usb_packet_sent_timer_active) return;
+    usb_packet_sent_timer_active = 1;
+    btstack_run_loop_set_timer_handler(&usb_packet_sent_timer, &usb_packet_sent_handler);
+    btstack_run_loop_set_timer(&usb_packet_sent_timer, 0);
+    btstack_run_loop_add_timer(&usb_packet_sent_timer);
+}
+
 static void handle_completed_transfer(struct libusb_transfer *transfer){
 
     int resubmit = 0;
@@ -453,12 +602,16 @@ static void handle_completed_transfer(struct libusb_transfer *transfer){
         resubmit = 1;
     } else if (transfer->endpoint == 0){
         // log_info("command done, size %u", transfer->actual_length);
-        usb_command_active = 0;
-        signal_done = 1;
+        int index = usb_out_pool_get_index(&command_out_pool, transfer);
+        if (index >= 0){
+            signal_done = usb_out_pool_completed(&command_out_pool, index);
+        }
     } else if (transfer->endpoint == acl_out_addr){
         // log_info("acl out done, size %u", transfer->actual_length);
-        usb_acl_out_active = 0;
-        signal_done = 1;
+        int index = usb_out_pool_get_index(&acl_out_pool, transfer);
+        if (index >= 0){
+            signal_done = usb_out_pool_completed(&acl_out_pool, index);
+        }
 #ifdef ENABLE_SCO_OVER_HCI
     } else if (transfer->endpoint == sco_in_addr) {
         // log_info("handle_completed_transfer for SCO IN! num packets %u", transfer->NUM_ISO_PACKETS);
@@ -503,9 +656,7 @@ static void handle_completed_transfer(struct libusb_transfer *transfer){
     }
 
     if (signal_done){
-        // notify upper stack that provided buffer can be used again
-        uint8_t event[] = { HCI_EVENT_TRANSPORT_PACKET_SENT, 0};
-        packet_handler(HCI_EVENT_PACKET, &event[0], sizeof(event));
+        usb_emit_packet_sent();
     }
 
     if (libusb_state != LIB_USB_TRANSFERS_ALLOCATED) return;
@@ -930,6 +1081,9 @@ static int usb_open(void){
 
     handle_packet = NULL;
 
+    usb_out_pool_init(&command_out_pool, command_out_transfer, command_out_in_flight, CMD_OUT_BUFFER_COUNT);
+    usb_out_pool_init(&acl_out_pool, acl_out_transfer, acl_out_in_flight, ACL_OUT_BUFFER_COUNT);
+
     // default endpoint addresses
     event_in_addr = 0x81; // EP1, IN interrupt
     acl_in_addr =   0x82; // EP2, IN bulk
@@ -1076,10 +1230,20 @@ static int usb_open(void){
         }
     }
 
-    command_out_transfer = libusb_alloc_transfer(0);
-    acl_out_transfer     = libusb_alloc_transfer(0);
-
-    // TODO check for error
+    for (c = 0 ; c < CMD_OUT_BUFFER_COUNT ; c++) {
+        command_out_transfer[c] = libusb_alloc_transfer(0);
+        if (!command_out_transfer[c]) {
+            usb_close();
+            return LIBUSB_ERROR_NO_MEM;
+        }
+    }
+    for (c = 0 ; c < ACL_OUT_BUFFER_COUNT ; c++) {
+        acl_out_transfer[c] = libusb_alloc_transfer(0);
+        if (!acl_out_transfer[c]) {
+            usb_close();
+            return LIBUSB_ERROR_NO_MEM;
+        }
+    }
 
     libusb_state = LIB_USB_TRANSFERS_ALLOCATED;
 
@@ -1171,6 +1335,11 @@ static int usb_close(void){
                 usb_timer_active = 0;
             }
 
+            if (usb_packet_sent_timer_active){
+                btstack_run_loop_remove_timer(&usb_packet_sent_timer);
+                usb_packet_sent_timer_active = 0;
+            }
+
             if (doing_pollfds){
                 int r;
                 for (r = 0 ; r < num_pollfds ; r++) {
@@ -1198,6 +1367,8 @@ static int usb_close(void){
                     libusb_cancel_transfer(acl_in_transfer[c]);
                 }
             }
+            usb_out_pool_cancel(&command_out_pool);
+            usb_out_pool_cancel(&acl_out_pool);
 #ifdef ENABLE_SCO_OVER_HCI
             for (c = 0 ; c < SCO_IN_BUFFER_COUNT ; c++) {
                 if (sco_in_transfer[c]){
@@ -1249,6 +1420,13 @@ static int usb_close(void){
                     }
                 }
 
+                if (!completed) continue;
+
+                if (!usb_out_pool_all_freed(&command_out_pool) || !usb_out_pool_all_freed(&acl_out_pool)){
+                    log_info("command or acl out transfers still active");
+                    completed = 0;
+                }
+
 #ifdef ENABLE_SCO_OVER_HCI
                 if (!completed) continue;
 
@@ -1299,28 +1477,30 @@ static int usb_send_cmd_packet(uint8_t *packet, int size){
     int r;
 
     if (libusb_state != LIB_USB_TRANSFERS_ALLOCATED) return -1;
+    if (!usb_out_pool_have_space(&command_out_pool)) return -1;
 
     // async
-    libusb_fill_control_setup(hci_cmd_buffer, LIBUSB_REQUEST_TYPE_CLASS | LIBUSB_RECIPIENT_INTERFACE, 0, 0, 0, size);
-    memcpy(hci_cmd_buffer + LIBUSB_CONTROL_SETUP_SIZE, packet, size);
+    int index = usb_out_pool_get_free_index(&command_out_pool);
+    uint8_t * buffer = hci_cmd_buffer[index];
+    libusb_fill_control_setup(buffer, LIBUSB_REQUEST_TYPE_CLASS | LIBUSB_RECIPIENT_INTERFACE, 0, 0, 0, size);
+    memcpy(buffer + LIBUSB_CONTROL_SETUP_SIZE, packet, size);
 
     // prepare transfer
-    int completed = 0;
-    libusb_fill_control_transfer(command_out_transfer, handle, hci_cmd_buffer, async_callback, &completed, 0);
-    command_out_transfer->flags = LIBUSB_TRANSFER_FREE_BUFFER;
-
-    // update stata before submitting transfer
-    usb_command_active = 1;
+    struct libusb_transfer * transfer = command_out_transfer[index];
+    libusb_fill_control_transfer(transfer, handle, buffer, async_callback, NULL, 0);
 
     // submit transfer
-    r = libusb_submit_transfer(command_out_transfer);
+    r = libusb_submit_transfer(transfer);
     
     if (r < 0) {
-        usb_command_active = 0;
         log_error("Error submitting cmd transfer %d", r);
         return -1;
     }
 
+    // command was copied, upper stack can continue if another transfer is available
+    if (usb_out_pool_submitted(&command_out_pool, index)){
+        usb_packet_sent_trigger();
+    }
     return 0;
 }
 
@@ -1328,34 +1508,45 @@ static int usb_send_acl_packet(uint8_t *packet, int size){
     int r;
 
     if (libusb_state != LIB_USB_TRANSFERS_ALLOCATED) return -1;
+    if (!usb_out_pool_have_space(&acl_out_pool)) return -1;
 
     // log_info("usb_send_acl_packet enter, size %u", size);
-    
-    // prepare transfer
-    int completed = 0;
-    libusb_fill_bulk_transfer(acl_out_transfer, handle, acl_out_addr, packet, size,
-        async_callback, &completed, 0);
-    acl_out_transfer->type = LIBUSB_TRANSFER_TYPE_BULK;
 
-    // update stata before submitting transfer
-    usb_acl_out_active = 1;
+    int index = usb_out_pool_get_free_index(&acl_out_pool);
+#if ACL_OUT_BUFFER_COUNT > 1
+    // copy packet to allow for multiple transfers in flight
+    uint8_t * buffer = hci_acl_out_buffer[index];
+    memcpy(buffer, packet, size);
+#else
+    // send packet from buffer of upper stack
+    uint8_t * buffer = packet;
+#endif
+
+    // prepare transfer
+    struct libusb_transfer * transfer = acl_out_transfer[index];
+    libusb_fill_bulk_transfer(transfer, handle, acl_out_addr, buffer, size,
+        async_callback, NULL, 0);
+    transfer->type = LIBUSB_TRANSFER_TYPE_BULK;
 
-    r = libusb_submit_transfer(acl_out_transfer);
+    r = libusb_submit_transfer(transfer);
     if (r < 0) {
-        usb_acl_out_active = 0;
         log_error("Error submitting acl transfer, %d", r);
         return -1;
     }
 
+    // with a single transfer, the upper stack's buffer is released when the transfer is complete
+    if (usb_out_pool_submitted(&acl_out_pool, index)){
+        usb_packet_sent_trigger();
+    }
     return 0;
 }
 
 static int usb_can_send_packet_now(uint8_t packet_type){
     switch (packet_type){
         case HCI_COMMAND_DATA_PACKET:
-            return !usb_command_active;
+            return usb_out_pool_have_space(&command_out_pool);
         case HCI_ACL_DATA_PACKET:
-            return !usb_acl_out_active;
+            return usb_out_pool_have_space(&acl_out_pool);
 #ifdef ENABLE_SCO_OVER_HCI
         case HCI_SCO_DATA_PACKET:
             if (!sco_enabled) return 0;
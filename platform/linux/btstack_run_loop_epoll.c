@@ -0,0 +1,244 @@
+/*
+ * Copyright (C) 2020 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHIAS
+ * RINGWALD OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+#define BTSTACK_FILE__ "btstack_run_loop_epoll.c"
+
+/*
+ *  btstack_run_loop_epoll.c
+ *
+ *  Linux run loop based on epoll. In contrast to the POSIX run loop, which rebuilds its fd_sets
+ *  from all data sources on every iteration, file descriptors are registered with the kernel once
+ *  and only data sources that are ready get dispatched. Timers are managed by btstack_run_loop_base.
+ */
+
+// enable POSIX functions (needed for -std=c99)
+#define _POSIX_C_SOURCE 200809
+
+#include "btstack_run_loop_epoll.h"
+
+#include "btstack_run_loop.h"
+#include "btstack_run_loop_base.h"
+#include "btstack_util.h"
+#include "btstack_linked_list.h"
+#include "btstack_debug.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/epoll.h>
+#include <time.h>
+#include <unistd.h>
+
+// max number of events fetched from the kernel per epoll_wait call
+#ifndef BTSTACK_RUN_LOOP_EPOLL_MAX_EVENTS
+#define BTSTACK_RUN_LOOP_EPOLL_MAX_EVENTS 64
+#endif
+
+// epoll instance
+static int epoll_fd = -1;
+
+// set if data source has been added or removed, events fetched before are stale then
+static int data_sources_modified;
+
+// start time. tv_nsec = 0
+static struct timespec init_ts;
+
+static uint32_t btstack_run_loop_epoll_events_for_flags(uint16_t flags){
+    uint32_t events = 0;
+    if (flags & DATA_SOURCE_CALLBACK_READ){
+        events |= EPOLLIN;
+    }
+    if (flags & DATA_SOURCE_CALLBACK_WRITE){
+        events |= EPOLLOUT;
+    }
+    return events;
+}
+
+static int btstack_run_loop_epoll_ctl(int op, btstack_data_source_t * ds){
+    struct epoll_event event;
+    event.events   = btstack_run_loop_epoll_events_for_flags(ds->flags);
+    event.data.ptr = ds;
+    return epoll_ctl(epoll_fd, op, ds->source.fd, &event);
+}
+
+/**
+ * Add data_source to run_loop
+ */
+static void btstack_run_loop_epoll_add_data_source(btstack_data_source_t *ds){
+    data_sources_modified = 1;
+    btstack_run_loop_base_add_data_source(ds);
+    if (ds->source.fd < 0) return;
+    int err = btstack_run_loop_epoll_ctl(EPOLL_CTL_ADD, ds);
+    if (err){
+        log_error("btstack_run_loop_epoll_add_data_source: fd %d, errno %d", ds->source.fd, errno);
+    }
+}
+
+/**
+ * Remove data_source from run loop
+ */
+static bool btstack_run_loop_epoll_remove_data_source(btstack_data_source_t *ds){
+    data_sources_modified = 1;
+    log_debug("btstack_run_loop_epoll_remove_data_source %p\n", ds);
+    bool removed = btstack_run_loop_base_remove_data_source(ds);
+    if (removed && (ds->source.fd >= 0)){
+        // fails with EBADF if fd has been closed already, which also removed it from the epoll set
+        (void) epoll_ctl(epoll_fd, EPOLL_CTL_DEL, ds->source.fd, NULL);
+    }
+    return removed;
+}
+
+static void btstack_run_loop_epoll_update_data_source(btstack_data_source_t * ds, uint16_t old_flags){
+    if (ds->source.fd < 0) return;
+    if (btstack_run_loop_epoll_events_for_flags(old_flags) == btstack_run_loop_epoll_events_for_flags(ds->flags)) return;
+    // ENOENT: callbacks get enabled before data source is added, flags are used in add_data_source
+    (void) btstack_run_loop_epoll_ctl(EPOLL_CTL_MOD, ds);
+}
+
+static void btstack_run_loop_epoll_enable_data_source_callbacks(btstack_data_source_t * ds, uint16_t callback_types){
+    uint16_t old_flags = ds->flags;
+    btstack_run_loop_base_enable_data_source_callbacks(ds, callback_types);
+    btstack_run_loop_epoll_update_data_source(ds, old_flags);
+}
+
+static void btstack_run_loop_epoll_disable_data_source_callbacks(btstack_data_source_t * ds, uint16_t callback_types){
+    uint16_t old_flags = ds->flags;
+    btstack_run_loop_base_disable_data_source_callbacks(ds, callback_types);
+    btstack_run_loop_epoll_update_data_source(ds, old_flags);
+}
+
+/**
+ * @brief Queries the current time in ms since start
+ */
+static uint32_t btstack_run_loop_epoll_get_time_ms(void){
+    struct timespec now_ts;
+    clock_gettime(CLOCK_MONOTONIC, &now_ts);
+    uint64_t sec_val  = (uint64_t)(now_ts.tv_sec - init_ts.tv_sec);
+    uint64_t nsec_val = (uint64_t)(now_ts.tv_nsec);
+    return (uint32_t) ((sec_val * 1000) + (nsec_val / 1000000));
+}
+
+/**
+ * Execute run_loop
+ */
+static void btstack_run_loop_epoll_execute(void) {
+    struct epoll_event events[BTSTACK_RUN_LOOP_EPOLL_MAX_EVENTS];
+
+    log_info("Linux epoll run loop");
+
+    while (true) {
+
+        // get next timeout, -1 = wait forever
+        int32_t timeout_ms = btstack_run_loop_base_get_time_until_timeout(btstack_run_loop_epoll_get_time_ms());
+        log_debug("btstack_run_loop_epoll_execute next timeout in %d ms", timeout_ms);
+
+        // wait for ready FDs
+        int num_events = epoll_wait(epoll_fd, events, BTSTACK_RUN_LOOP_EPOLL_MAX_EVENTS, timeout_ms);
+        if (num_events < 0){
+            if (errno != EINTR){
+                log_error("btstack_run_loop_epoll_execute: epoll_wait errno %d", errno);
+            }
+            num_events = 0;
+        }
+
+        // dispatch ready data sources. if a data source got added or removed, the remaining events might
+        // refer to a removed data source. as epoll is level-triggered, they are reported again in the next iteration
+        data_sources_modified = 0;
+        int i;
+        for (i = 0; (i < num_events) && !data_sources_modified; i++){
+            btstack_data_source_t *ds = (btstack_data_source_t*) events[i].data.ptr;
+            uint32_t ready = events[i].events;
+            // report errors and hang-up to enabled callbacks, read() or write() will tell the details
+            if (ready & (EPOLLERR | EPOLLHUP)){
+                ready |= EPOLLIN | EPOLLOUT;
+            }
+            if ((ready & EPOLLIN) && (ds->flags & DATA_SOURCE_CALLBACK_READ)){
+                log_debug("btstack_run_loop_epoll_execute: process read ds %p with fd %u\n", ds, ds->source.fd);
+                ds->process(ds, DATA_SOURCE_CALLBACK_READ);
+            }
+            if (data_sources_modified) break;
+            if ((ready & EPOLLOUT) && (ds->flags & DATA_SOURCE_CALLBACK_WRITE)){
+                log_debug("btstack_run_loop_epoll_execute: process write ds %p with fd %u\n", ds, ds->source.fd);
+                ds->process(ds, DATA_SOURCE_CALLBACK_WRITE);
+            }
+        }
+
+        // process timers
+        btstack_run_loop_base_process_timers(btstack_run_loop_epoll_get_time_ms());
+    }
+}
+
+// set timer
+static void btstack_run_loop_epoll_set_timer(btstack_timer_source_t *a, uint32_t timeout_in_ms){
+    uint32_t time_ms = btstack_run_loop_epoll_get_time_ms();
+    a->timeout = time_ms + timeout_in_ms;
+    log_debug("btstack_run_loop_epoll_set_timer to %u ms (now %u, timeout %u)", a->timeout, time_ms, timeout_in_ms);
+}
+
+static void btstack_run_loop_epoll_init(void){
+    btstack_run_loop_base_init();
+    if (epoll_fd >= 0){
+        close(epoll_fd);
+    }
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd < 0){
+        log_error("btstack_run_loop_epoll_init: epoll_create1 failed, errno %d", errno);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &init_ts);
+    init_ts.tv_nsec = 0;
+}
+
+static const btstack_run_loop_t btstack_run_loop_epoll = {
+    &btstack_run_loop_epoll_init,
+    &btstack_run_loop_epoll_add_data_source,
+    &btstack_run_loop_epoll_remove_data_source,
+    &btstack_run_loop_epoll_enable_data_source_callbacks,
+    &btstack_run_loop_epoll_disable_data_source_callbacks,
+    &btstack_run_loop_epoll_set_timer,
+    &btstack_run_loop_base_add_timer,
+    &btstack_run_loop_base_remove_timer,
+    &btstack_run_loop_epoll_execute,
+    &btstack_run_loop_base_dump_timer,
+    &btstack_run_loop_epoll_get_time_ms,
+};
+
+/**
+ * Provide btstack_run_loop_epoll instance
+ */
+const btstack_run_loop_t * btstack_run_loop_epoll_get_instance(void){
+    return &btstack_run_loop_epoll;
+}
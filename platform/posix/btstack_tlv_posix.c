@@ -41,6 +41,15 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <stdio.h>
+
+#ifdef _WIN32
+#include <io.h>
+#define fsync(fd) _commit(fd)
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 // Header:
 // - Magic: 'BTstack'
@@ -53,45 +62,270 @@
 // - Len: 32 bit
 // - Value: Len in bytes
 
+// Deleted tags are stored as entry with len 0. Entries that have been replaced or deleted are garbage.
+// The file is compacted by writing all valid entries into a temp file, which then replaces the db file.
+
 #define BTSTACK_TLV_HEADER_LEN 8
 static const char * btstack_tlv_header_magic = "BTstack";
 
+// compact file if garbage exceeds size of valid entries and this minimum
+#ifndef BTSTACK_TLV_POSIX_COMPACTION_MIN_GARBAGE
+#define BTSTACK_TLV_POSIX_COMPACTION_MIN_GARBAGE 16384
+#endif
+
+#define BTSTACK_TLV_POSIX_MIN_BUCKETS 16
+
 #define DUMMY_SIZE 4
-typedef struct tlv_entry {
-	void   * next;
+typedef struct btstack_tlv_posix_entry {
+	struct btstack_tlv_posix_entry * next;
 	uint32_t tag;
 	uint32_t len;
 	uint8_t  value[DUMMY_SIZE];	// dummy size
 } tlv_entry_t;
 
-static int btstack_tlv_posix_append_tag(btstack_tlv_posix_t * self, uint32_t tag, const uint8_t * data, uint32_t data_size){
+static uint32_t btstack_tlv_posix_hash(btstack_tlv_posix_t * self, uint32_t tag){
+	// multiplicative hashing, num_buckets is power of two
+	return (tag * 2654435761u) & (self->num_buckets - 1u);
+}
 
-	if (!self->file) return 1;
+static tlv_entry_t * btstack_tlv_posix_find_entry(btstack_tlv_posix_t * self, uint32_t tag){
+	if (self->num_buckets == 0u) return NULL;
+	tlv_entry_t * entry = self->buckets[btstack_tlv_posix_hash(self, tag)];
+	while (entry != NULL){
+		if (entry->tag == tag) return entry;
+		entry = entry->next;
+	}
+	return NULL;
+}
 
-	log_info("append tag %04x, len %u", tag, data_size);
+static void btstack_tlv_posix_remove_entry(btstack_tlv_posix_t * self, uint32_t tag){
+	if (self->num_buckets == 0u) return;
+	tlv_entry_t ** prev = &self->buckets[btstack_tlv_posix_hash(self, tag)];
+	while (*prev != NULL){
+		tlv_entry_t * entry = *prev;
+		if (entry->tag == tag){
+			*prev = entry->next;
+			self->num_entries--;
+			self->live_size -= 8u + entry->len;
+			free(entry);
+			return;
+		}
+		prev = &entry->next;
+	}
+}
+
+// double number of buckets if load factor exceeds 1, returns false if out of memory
+static bool btstack_tlv_posix_grow_buckets(btstack_tlv_posix_t * self){
+	if (self->num_entries < self->num_buckets) return true;
+	uint32_t num_buckets = btstack_max(BTSTACK_TLV_POSIX_MIN_BUCKETS, self->num_buckets * 2u);
+	tlv_entry_t ** buckets = (tlv_entry_t **) calloc(num_buckets, sizeof(tlv_entry_t *));
+	if (buckets == NULL) return false;
+	uint32_t old_num_buckets = self->num_buckets;
+	tlv_entry_t ** old_buckets = self->buckets;
+	self->buckets = buckets;
+	self->num_buckets = num_buckets;
+	uint32_t i;
+	for (i = 0; i < old_num_buckets; i++){
+		tlv_entry_t * entry = old_buckets[i];
+		while (entry != NULL){
+			tlv_entry_t * next = entry->next;
+			uint32_t bucket = btstack_tlv_posix_hash(self, entry->tag);
+			entry->next = buckets[bucket];
+			buckets[bucket] = entry;
+			entry = next;
+		}
+	}
+	free(old_buckets);
+	return true;
+}
+
+// replaces existing entry with same tag
+static bool btstack_tlv_posix_add_entry(btstack_tlv_posix_t * self, tlv_entry_t * new_entry){
+	btstack_tlv_posix_remove_entry(self, new_entry->tag);
+	if (btstack_tlv_posix_grow_buckets(self) == false) return false;
+	uint32_t bucket = btstack_tlv_posix_hash(self, new_entry->tag);
+	new_entry->next = self->buckets[bucket];
+	self->buckets[bucket] = new_entry;
+	self->num_entries++;
+	self->live_size += 8u + new_entry->len;
+	return true;
+}
+
+static void btstack_tlv_posix_free_entries(btstack_tlv_posix_t * self){
+	uint32_t i;
+	for (i = 0; i < self->num_buckets; i++){
+		tlv_entry_t * entry = self->buckets[i];
+		while (entry != NULL){
+			tlv_entry_t * next = entry->next;
+			free(entry);
+			entry = next;
+		}
+	}
+	free(self->buckets);
+	self->buckets = NULL;
+	self->num_buckets = 0;
+	self->num_entries = 0;
+	self->live_size = BTSTACK_TLV_HEADER_LEN;
+}
 
+static void btstack_tlv_posix_sync_file(FILE * file){
+	fflush(file);
+	fsync(fileno(file));
+}
+
+static void btstack_tlv_posix_sync_timer_handler(btstack_timer_source_t * ts){
+	btstack_tlv_posix_t * self = (btstack_tlv_posix_t *) btstack_run_loop_get_timer_context(ts);
+	btstack_tlv_posix_flush(self);
+}
+
+static int btstack_tlv_posix_write_tag(FILE * file, uint32_t tag, const uint8_t * data, uint32_t data_size){
 	uint8_t header[8];
 	big_endian_store_32(header, 0, tag);
 	big_endian_store_32(header, 4, data_size);
-	size_t written_header = fwrite(header, 1, sizeof(header), self->file);
+	size_t written_header = fwrite(header, 1, sizeof(header), file);
 	if (written_header != sizeof(header)) return 1;
 	if (data_size > 0) {
-		size_t written_value = fwrite(data, 1, data_size, self->file);
+		size_t written_value = fwrite(data, 1, data_size, file);
 		if (written_value != data_size) return 1;
 	}
-	fflush(self->file);
-	return 1;
+	return 0;
 }
 
-static tlv_entry_t * btstack_tlv_posix_find_entry(btstack_tlv_posix_t * self, uint32_t tag){
-	btstack_linked_list_iterator_t it;
-	btstack_linked_list_iterator_init(&it, &self->entry_list);
-	while (btstack_linked_list_iterator_has_next(&it)){
-		tlv_entry_t * entry = (tlv_entry_t*) btstack_linked_list_iterator_next(&it);
-		if (entry->tag != tag) continue;
-		return entry;
+static int btstack_tlv_posix_write_header(FILE * file){
+	uint8_t header[BTSTACK_TLV_HEADER_LEN];
+	memset(header, 0, sizeof(header));
+	strcpy((char *)header, btstack_tlv_header_magic);
+	size_t written_header = fwrite(header, 1, sizeof(header), file);
+	return (written_header == sizeof(header)) ? 0 : 1;
+}
+
+static int btstack_tlv_posix_write_entries(btstack_tlv_posix_t * self, FILE * file){
+	uint32_t i;
+	for (i = 0; i < self->num_buckets; i++){
+		tlv_entry_t * entry = self->buckets[i];
+		while (entry != NULL){
+			int err = btstack_tlv_posix_write_tag(file, entry->tag, &entry->value[0], entry->len);
+			if (err != 0) return err;
+			entry = entry->next;
+		}
 	}
-	return NULL;
+	return 0;
+}
+
+#ifndef _WIN32
+// sync directory to persist rename
+static void btstack_tlv_posix_sync_directory(const char * path){
+	char * dir_path = strdup(path);
+	if (dir_path == NULL) return;
+	char * separator = strrchr(dir_path, '/');
+	if (separator == NULL){
+		strcpy(dir_path, ".");
+	} else if (separator == dir_path){
+		separator[1] = 0;
+	} else {
+		*separator = 0;
+	}
+	int fd = open(dir_path, O_RDONLY);
+	if (fd >= 0){
+		fsync(fd);
+		close(fd);
+	}
+	free(dir_path);
+}
+#endif
+
+// write valid entries into temp file and replace db file
+static void btstack_tlv_posix_compact(btstack_tlv_posix_t * self){
+	log_info("compact db, file size %u, valid entries %u bytes", (unsigned int) self->file_size, (unsigned int) self->live_size);
+
+	size_t path_len = strlen(self->db_path);
+	char * temp_path = (char *) malloc(path_len + 5u);
+	if (temp_path == NULL) return;
+	memcpy(temp_path, self->db_path, path_len);
+	memcpy(&temp_path[path_len], ".tmp", 5);
+
+	FILE * temp_file = fopen(temp_path, "w+b");
+	if (temp_file == NULL){
+		log_error("compact: cannot create %s", temp_path);
+		free(temp_path);
+		return;
+	}
+	int err = btstack_tlv_posix_write_header(temp_file);
+	if (err == 0){
+		err = btstack_tlv_posix_write_entries(self, temp_file);
+	}
+	if (err == 0){
+		btstack_tlv_posix_sync_file(temp_file);
+	}
+	fclose(temp_file);
+	if (err != 0){
+		log_error("compact: write failed");
+		remove(temp_path);
+		free(temp_path);
+		return;
+	}
+
+	// replace db file with temp file
+	btstack_tlv_posix_sync_file(self->file);
+	fclose(self->file);
+#ifdef _WIN32
+	// rename does not replace existing files on Windows
+	remove(self->db_path);
+#endif
+	if (rename(temp_path, self->db_path) != 0){
+		log_error("compact: rename failed");
+		remove(temp_path);
+	}
+#ifndef _WIN32
+	btstack_tlv_posix_sync_directory(self->db_path);
+#endif
+	free(temp_path);
+
+	// continue appending to compacted file
+	self->file = fopen(self->db_path, "r+b");
+	if (self->file == NULL){
+		log_error("compact: cannot open %s", self->db_path);
+		return;
+	}
+	fseek(self->file, 0, SEEK_END);
+	self->file_size = (uint32_t) ftell(self->file);
+}
+
+static int btstack_tlv_posix_append_tag(btstack_tlv_posix_t * self, uint32_t tag, const uint8_t * data, uint32_t data_size){
+
+	if (!self->file) return 1;
+
+	log_info("append tag %04x, len %u", tag, data_size);
+
+	int err = btstack_tlv_posix_write_tag(self->file, tag, data, data_size);
+	if (err != 0) return err;
+	self->file_size += 8u + data_size;
+
+	switch (self->sync_mode){
+		case BTSTACK_TLV_POSIX_SYNC_FSYNC:
+			btstack_tlv_posix_sync_file(self->file);
+			break;
+		case BTSTACK_TLV_POSIX_SYNC_DEFERRED:
+			// sync after delay, writes in between are batched
+			if (self->sync_pending == false){
+				self->sync_pending = true;
+				btstack_run_loop_set_timer_handler(&self->sync_timer, &btstack_tlv_posix_sync_timer_handler);
+				btstack_run_loop_set_timer_context(&self->sync_timer, self);
+				btstack_run_loop_set_timer(&self->sync_timer, self->sync_delay_ms);
+				btstack_run_loop_add_timer(&self->sync_timer);
+			}
+			break;
+		default:
+			fflush(self->file);
+			break;
+	}
+
+	// compact if garbage exceeds valid entries
+	uint32_t garbage_size = self->file_size - self->live_size;
+	if ((garbage_size >= BTSTACK_TLV_POSIX_COMPACTION_MIN_GARBAGE) && (garbage_size >= self->live_size)){
+		btstack_tlv_posix_compact(self);
+	}
+	return 0;
 }
 
 /**
@@ -100,16 +334,9 @@ static tlv_entry_t * btstack_tlv_posix_find_entry(btstack_tlv_posix_t * self, ui
  */
 static void btstack_tlv_posix_delete_tag(void * context, uint32_t tag){
 	btstack_tlv_posix_t * self = (btstack_tlv_posix_t *) context;
-	btstack_linked_list_iterator_t it;
-	btstack_linked_list_iterator_init(&it, &self->entry_list);
-	while (btstack_linked_list_iterator_has_next(&it)){
-		tlv_entry_t * entry = (tlv_entry_t*) btstack_linked_list_iterator_next(&it);
-		if (entry->tag != tag) continue;
-		btstack_linked_list_iterator_remove(&it);
-		free(entry);
-		btstack_tlv_posix_append_tag(self, tag, NULL, 0);
-		return;
-	}
+	if (btstack_tlv_posix_find_entry(self, tag) == NULL) return;
+	btstack_tlv_posix_remove_entry(self, tag);
+	btstack_tlv_posix_append_tag(self, tag, NULL, 0);
 }
 
 /**
@@ -141,13 +368,6 @@ static int btstack_tlv_posix_get_tag(void * context, uint32_t tag, uint8_t * buf
 static int btstack_tlv_posix_store_tag(void * context, uint32_t tag, const uint8_t * data, uint32_t data_size){
 	btstack_tlv_posix_t * self = (btstack_tlv_posix_t *) context;
 
-	// remove old entry
-	tlv_entry_t * old_entry = btstack_tlv_posix_find_entry(self, tag);
-	if (old_entry){
-		btstack_linked_list_remove(&self->entry_list, (btstack_linked_item_t *) old_entry);
-		free(old_entry);
-	}
-
 	// create new entry
 	uint32_t entry_size = sizeof(tlv_entry_t) - DUMMY_SIZE + data_size;
 	tlv_entry_t * new_entry = (tlv_entry_t *) malloc(entry_size);
@@ -157,8 +377,11 @@ static int btstack_tlv_posix_store_tag(void * context, uint32_t tag, const uint8
 	new_entry->len = data_size;
 	memcpy(&new_entry->value[0], data, data_size);
 
-	// append new entry
-	btstack_linked_list_add(&self->entry_list, (btstack_linked_item_t *) new_entry);
+	// replace old entry
+	if (btstack_tlv_posix_add_entry(self, new_entry) == false){
+		free(new_entry);
+		return 0;
+	}
 
 	// write new tag
 	btstack_tlv_posix_append_tag(self, tag, data, data_size);
@@ -170,7 +393,7 @@ static int btstack_tlv_posix_store_tag(void * context, uint32_t tag, const uint8
 static int btstack_tlv_posix_read_db(btstack_tlv_posix_t * self){
 	// open file
 	log_info("open db %s", self->db_path);
-    self->file = fopen(self->db_path,"r+");
+    self->file = fopen(self->db_path,"r+b");
     uint8_t header[BTSTACK_TLV_HEADER_LEN];
     if (self->file){
     	// checker header
@@ -179,6 +402,7 @@ static int btstack_tlv_posix_read_db(btstack_tlv_posix_t * self){
 	    if (objects_read == BTSTACK_TLV_HEADER_LEN){
 	    	if (memcmp(header, btstack_tlv_header_magic, strlen(btstack_tlv_header_magic)) == 0){
 		    	log_info("BTstack Magic Header found");
+		    	self->file_size = BTSTACK_TLV_HEADER_LEN;
 		    	// read entries
 		    	while (true){
 					uint8_t entry[8];
@@ -206,19 +430,20 @@ static int btstack_tlv_posix_read_db(btstack_tlv_posix_t * self){
 
                         // read
                         size_t value_read = fread(&new_entry->value[0], 1, len, self->file);
-                        if (value_read != len) break;
-                    }
-
-                    // remove old entry
-                    tlv_entry_t * old_entry = btstack_tlv_posix_find_entry(self, tag);
-                    if (old_entry){
-                        btstack_linked_list_remove(&self->entry_list, (btstack_linked_item_t *) old_entry);
-                        free(old_entry);
+                        if (value_read != len) {
+                            free(new_entry);
+                            break;
+                        }
                     }
+                    self->file_size += 8u + len;
 
-                    // append new entry
+                    // replace old entry or delete it
                     if (new_entry){
-	                    btstack_linked_list_add(&self->entry_list, (btstack_linked_item_t *) new_entry);
+                        if (btstack_tlv_posix_add_entry(self, new_entry) == false){
+                            free(new_entry);
+                        }
+                    } else {
+                        btstack_tlv_posix_remove_entry(self, tag);
                     }
 		    	}
 	    	}
@@ -231,17 +456,19 @@ static int btstack_tlv_posix_read_db(btstack_tlv_posix_t * self){
     }
     if (!self->file){
     	// create truncate file
-	    self->file = fopen(self->db_path,"w+");
-	    memset(header, 0, sizeof(header));
-	    strcpy((char *)header, btstack_tlv_header_magic);
-	    fwrite(header, 1, sizeof(header), self->file);
+	    self->file = fopen(self->db_path,"w+b");
+	    if (!self->file) return 1;
+	    btstack_tlv_posix_write_header(self->file);
 	    // write out all valid entries (if any)
-		btstack_linked_list_iterator_t it;
-		btstack_linked_list_iterator_init(&it, &self->entry_list);
-		while (btstack_linked_list_iterator_has_next(&it)){
-			tlv_entry_t * entry = (tlv_entry_t*) btstack_linked_list_iterator_next(&it);
-			btstack_tlv_posix_append_tag(self, entry->tag, &entry->value[0], entry->len);
-		}
+	    btstack_tlv_posix_write_entries(self, self->file);
+	    fflush(self->file);
+	    self->file_size = self->live_size;
+    } else {
+    	// compact if garbage exceeds valid entries
+    	uint32_t garbage_size = self->file_size - self->live_size;
+    	if ((garbage_size >= BTSTACK_TLV_POSIX_COMPACTION_MIN_GARBAGE) && (garbage_size >= self->live_size)){
+    		btstack_tlv_posix_compact(self);
+    	}
     }
 	return 0;
 }
@@ -258,9 +485,35 @@ static const btstack_tlv_t btstack_tlv_posix = {
 const btstack_tlv_t * btstack_tlv_posix_init_instance(btstack_tlv_posix_t * self, const char * db_path){
 	memset(self, 0, sizeof(btstack_tlv_posix_t));
 	self->db_path = db_path;
+	self->live_size = BTSTACK_TLV_HEADER_LEN;
 
 	// read DB
 	btstack_tlv_posix_read_db(self);
 	return &btstack_tlv_posix;
 }
 
+void btstack_tlv_posix_set_sync_mode(btstack_tlv_posix_t * self, btstack_tlv_posix_sync_mode_t sync_mode, uint32_t sync_delay_ms){
+	self->sync_mode = sync_mode;
+	self->sync_delay_ms = sync_delay_ms;
+	if (sync_mode != BTSTACK_TLV_POSIX_SYNC_DEFERRED){
+		btstack_tlv_posix_flush(self);
+	}
+}
+
+void btstack_tlv_posix_flush(btstack_tlv_posix_t * self){
+	if (self->sync_pending){
+		self->sync_pending = false;
+		btstack_run_loop_remove_timer(&self->sync_timer);
+	}
+	if (self->file == NULL) return;
+	btstack_tlv_posix_sync_file(self->file);
+}
+
+void btstack_tlv_posix_deinit(btstack_tlv_posix_t * self){
+	btstack_tlv_posix_flush(self);
+	if (self->file != NULL){
+		fclose(self->file);
+		self->file = NULL;
+	}
+	btstack_tlv_posix_free_entries(self);
+}
@@ -33,7 +33,7 @@
  *  btstack_tlv_posix.h
  *
  *  Implementation for BTstack's Tag Value Length Persistent Storage implementations
- *  using in-memory storage (RAM & malloc) and append-only log files on disc
+ *  using in-memory storage (RAM & malloc) and append-only log files on disc that get compacted
  */
 
 #ifndef BTSTACK_TLV_POSIX_H
@@ -42,16 +42,33 @@
 #include <stdint.h>
 #include <stdio.h>
 #include "btstack_tlv.h"
-#include "btstack_linked_list.h"
+#include "btstack_run_loop.h"
 
 #if defined __cplusplus
 extern "C" {
 #endif
 
+typedef enum {
+	BTSTACK_TLV_POSIX_SYNC_FLUSH = 0,	// flush stdio buffer after each write (default)
+	BTSTACK_TLV_POSIX_SYNC_FSYNC,		// flush and fsync after each write
+	BTSTACK_TLV_POSIX_SYNC_DEFERRED,	// flush and fsync once after delay, batches all writes in between
+} btstack_tlv_posix_sync_mode_t;
+
 typedef struct {
-	btstack_linked_list_t entry_list;
+	// hash table of entries
+	struct btstack_tlv_posix_entry ** buckets;
+	uint32_t num_buckets;
+	uint32_t num_entries;
 	const char * db_path;
 	FILE * file;
+	// size of file and size of header and valid entries, difference is garbage
+	uint32_t file_size;
+	uint32_t live_size;
+	// sync
+	btstack_tlv_posix_sync_mode_t sync_mode;
+	uint32_t sync_delay_ms;
+	bool     sync_pending;
+	btstack_timer_source_t sync_timer;
 } btstack_tlv_posix_t;
 
 /**
@@ -61,6 +78,26 @@ typedef struct {
  */
 const btstack_tlv_t * btstack_tlv_posix_init_instance(btstack_tlv_posix_t * context, const char * db_path);
 
+/**
+ * Set durability of writes
+ * @param context btstack_tlv_posix_t
+ * @param sync_mode
+ * @param sync_delay_ms for BTSTACK_TLV_POSIX_SYNC_DEFERRED, requires run loop
+ */
+void btstack_tlv_posix_set_sync_mode(btstack_tlv_posix_t * context, btstack_tlv_posix_sync_mode_t sync_mode, uint32_t sync_delay_ms);
+
+/**
+ * Flush and fsync pending writes
+ * @param context btstack_tlv_posix_t
+ */
+void btstack_tlv_posix_flush(btstack_tlv_posix_t * context);
+
+/**
+ * Flush pending writes, close file and free entries
+ * @param context btstack_tlv_posix_t
+ */
+void btstack_tlv_posix_deinit(btstack_tlv_posix_t * context);
+
 #if defined __cplusplus
 }
 #endif
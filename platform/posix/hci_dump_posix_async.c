@@ -0,0 +1,309 @@
+/*
+ * Copyright (C) 2020 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHIAS
+ * RINGWALD OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+#define BTSTACK_FILE__ "hci_dump_posix_async.c"
+
+/*
+ *  hci_dump_posix_async.c
+ *
+ *  Asynchronous writer for binary HCI dump formats (PacketLogger/BlueZ)
+ *
+ *  The run loop thread copies the header and packet as a single record into a preallocated ring buffer
+ *  and never blocks on file i/o. If the ring buffer is full, the packet is dropped and counted.
+ *
+ *  A writer thread wakes up every HCI_DUMP_POSIX_ASYNC_FLUSH_INTERVAL_MS or when the ring buffer
+ *  is half full, and writes all queued records with writev(). Instead of truncating the file,
+ *  it is renamed to <filename>.1 when it would grow beyond the configured max file size.
+ *
+ *  Record format: 16-bit length in host byte order followed by the data. A record does not wrap around
+ *  the end of the ring buffer, the remaining space is marked by a length of 0xffff.
+ */
+
+#include "btstack_config.h"
+
+// enable POSIX functions (needed for -std=c99)
+#define _POSIX_C_SOURCE 200809
+
+#include "hci_dump_posix_async.h"
+
+#include "btstack_util.h"
+
+#include <errno.h>
+#include <fcntl.h>        // open
+#include <pthread.h>
+#include <stdio.h>        // rename, snprintf
+#include <string.h>
+#include <sys/stat.h>     // for mode flags
+#include <sys/uio.h>      // writev
+#include <time.h>
+#include <unistd.h>       // close
+
+#ifndef HCI_DUMP_POSIX_ASYNC_BUFFER_SIZE
+#define HCI_DUMP_POSIX_ASYNC_BUFFER_SIZE 65536
+#endif
+
+#if (HCI_DUMP_POSIX_ASYNC_BUFFER_SIZE & (HCI_DUMP_POSIX_ASYNC_BUFFER_SIZE - 1)) != 0
+#error "HCI_DUMP_POSIX_ASYNC_BUFFER_SIZE must be a power of two"
+#endif
+
+#ifndef HCI_DUMP_POSIX_ASYNC_FLUSH_INTERVAL_MS
+#define HCI_DUMP_POSIX_ASYNC_FLUSH_INTERVAL_MS 50
+#endif
+
+#ifndef HCI_DUMP_POSIX_ASYNC_MAX_FILENAME_LEN
+#define HCI_DUMP_POSIX_ASYNC_MAX_FILENAME_LEN 255
+#endif
+
+#define RING_BUFFER_MASK        (HCI_DUMP_POSIX_ASYNC_BUFFER_SIZE - 1u)
+#define RING_BUFFER_HALF        (HCI_DUMP_POSIX_ASYNC_BUFFER_SIZE / 2u)
+#define RECORD_HEADER_LEN       2u
+#define RECORD_PADDING          0xffffu
+#define MAX_IOVECS              64
+
+// ring buffer, positions are free running and only written by producer (write) or consumer (read)
+static uint8_t  ring_buffer[HCI_DUMP_POSIX_ASYNC_BUFFER_SIZE];
+static uint32_t ring_write_pos;
+static uint32_t ring_read_pos;
+static uint32_t dropped_packets;
+
+// writer thread
+static pthread_t       writer_thread;
+static pthread_mutex_t writer_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  writer_cond  = PTHREAD_COND_INITIALIZER;
+static bool            writer_running;
+static bool            writer_started;
+
+// file, only accessed by writer thread after open
+static int         dump_fd = -1;
+static char        dump_filename[HCI_DUMP_POSIX_ASYNC_MAX_FILENAME_LEN + 1];
+static uint32_t    dump_file_size;
+static uint32_t    max_file_size;
+
+static int hci_dump_posix_async_open_file(void){
+    int oflags = O_WRONLY | O_CREAT | O_TRUNC;
+    return open(dump_filename, oflags, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+}
+
+static void hci_dump_posix_async_rotate(void){
+    char rotated_filename[sizeof(dump_filename) + 2];
+    close(dump_fd);
+    snprintf(rotated_filename, sizeof(rotated_filename), "%s.1", dump_filename);
+    rename(dump_filename, rotated_filename);
+    dump_fd = hci_dump_posix_async_open_file();
+    dump_file_size = 0;
+}
+
+static void hci_dump_posix_async_writev(struct iovec * iov, int iovcnt){
+    while (iovcnt > 0){
+        ssize_t res = writev(dump_fd, iov, iovcnt);
+        if (res < 0){
+            if (errno == EINTR) continue;
+            // drop data on error
+            return;
+        }
+        // skip written iovecs and adjust partially written one
+        size_t written = (size_t) res;
+        while ((iovcnt > 0) && (written >= iov->iov_len)){
+            written -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0){
+            iov->iov_base = ((uint8_t *) iov->iov_base) + written;
+            iov->iov_len -= written;
+        }
+    }
+}
+
+// write all queued records, called on writer thread
+static void hci_dump_posix_async_write_queued(void){
+    struct iovec iov[MAX_IOVECS];
+    int      num_iovecs = 0;
+    uint32_t batch_size = 0;
+    uint32_t max_size   = __atomic_load_n(&max_file_size, __ATOMIC_RELAXED);
+    uint32_t read_pos   = ring_read_pos;
+    uint32_t write_pos  = __atomic_load_n(&ring_write_pos, __ATOMIC_ACQUIRE);
+
+    while (read_pos != write_pos){
+        uint32_t offset     = read_pos & RING_BUFFER_MASK;
+        uint32_t contiguous = HCI_DUMP_POSIX_ASYNC_BUFFER_SIZE - offset;
+        uint16_t len = RECORD_PADDING;
+        if (contiguous >= RECORD_HEADER_LEN){
+            memcpy(&len, &ring_buffer[offset], RECORD_HEADER_LEN);
+        }
+        if (len == RECORD_PADDING){
+            read_pos += contiguous;
+            continue;
+        }
+
+        bool rotate = (max_size > 0u) && ((dump_file_size + batch_size) > 0u) && ((dump_file_size + batch_size + len) > max_size);
+        if (rotate || (num_iovecs == MAX_IOVECS)){
+            hci_dump_posix_async_writev(iov, num_iovecs);
+            dump_file_size += batch_size;
+            num_iovecs = 0;
+            batch_size = 0;
+            __atomic_store_n(&ring_read_pos, read_pos, __ATOMIC_RELEASE);
+            if (rotate){
+                hci_dump_posix_async_rotate();
+            }
+        }
+
+        iov[num_iovecs].iov_base = &ring_buffer[offset + RECORD_HEADER_LEN];
+        iov[num_iovecs].iov_len  = len;
+        num_iovecs++;
+        batch_size += len;
+        read_pos += RECORD_HEADER_LEN + len;
+    }
+
+    hci_dump_posix_async_writev(iov, num_iovecs);
+    dump_file_size += batch_size;
+    __atomic_store_n(&ring_read_pos, read_pos, __ATOMIC_RELEASE);
+}
+
+static void * hci_dump_posix_async_writer_thread(void * arg){
+    (void) arg;
+    while (true){
+        // check before writing to get all records queued before close
+        bool running = __atomic_load_n(&writer_running, __ATOMIC_ACQUIRE);
+        hci_dump_posix_async_write_queued();
+        if (!running) break;
+
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += HCI_DUMP_POSIX_ASYNC_FLUSH_INTERVAL_MS * 1000000L;
+        deadline.tv_sec  += deadline.tv_nsec / 1000000000L;
+        deadline.tv_nsec %= 1000000000L;
+
+        // wait unless buffer got half full in the meantime, producer signals with mutex held
+        pthread_mutex_lock(&writer_mutex);
+        uint32_t used = __atomic_load_n(&ring_write_pos, __ATOMIC_ACQUIRE) - ring_read_pos;
+        if (writer_running && (used <= RING_BUFFER_HALF)){
+            pthread_cond_timedwait(&writer_cond, &writer_mutex, &deadline);
+        }
+        pthread_mutex_unlock(&writer_mutex);
+    }
+    return NULL;
+}
+
+static void hci_dump_posix_async_wake_writer(void){
+    pthread_mutex_lock(&writer_mutex);
+    pthread_cond_signal(&writer_cond);
+    pthread_mutex_unlock(&writer_mutex);
+}
+
+int hci_dump_posix_async_open(const char * filename){
+    hci_dump_posix_async_close();
+
+    if (strlen(filename) > HCI_DUMP_POSIX_ASYNC_MAX_FILENAME_LEN) return -1;
+    btstack_strcpy(dump_filename, sizeof(dump_filename), filename);
+    dump_file_size = 0;
+    dump_fd = hci_dump_posix_async_open_file();
+    if (dump_fd < 0) return dump_fd;
+
+    ring_write_pos  = 0;
+    ring_read_pos   = 0;
+    dropped_packets = 0;
+    writer_running  = true;
+    if (pthread_create(&writer_thread, NULL, &hci_dump_posix_async_writer_thread, NULL) != 0){
+        writer_running = false;
+        close(dump_fd);
+        dump_fd = -1;
+        return dump_fd;
+    }
+    writer_started = true;
+    return dump_fd;
+}
+
+void hci_dump_posix_async_set_max_file_size(uint32_t max_size){
+    __atomic_store_n(&max_file_size, max_size, __ATOMIC_RELAXED);
+}
+
+bool hci_dump_posix_async_write(const uint8_t * header, uint16_t header_len, const uint8_t * packet, uint16_t packet_len){
+    uint32_t data_len   = (uint32_t) header_len + packet_len;
+    uint32_t record_len = RECORD_HEADER_LEN + data_len;
+    uint32_t write_pos  = ring_write_pos;
+    uint32_t used       = write_pos - __atomic_load_n(&ring_read_pos, __ATOMIC_ACQUIRE);
+    uint32_t offset     = write_pos & RING_BUFFER_MASK;
+    uint32_t contiguous = HCI_DUMP_POSIX_ASYNC_BUFFER_SIZE - offset;
+    uint32_t padding    = (contiguous < record_len) ? contiguous : 0u;
+
+    if ((data_len >= RECORD_PADDING) || (record_len > RING_BUFFER_HALF) || ((used + padding + record_len) > HCI_DUMP_POSIX_ASYNC_BUFFER_SIZE)){
+        __atomic_store_n(&dropped_packets, dropped_packets + 1u, __ATOMIC_RELAXED);
+        return false;
+    }
+
+    // skip remaining space at end of buffer
+    if (padding > 0u){
+        if (padding >= RECORD_HEADER_LEN){
+            uint16_t marker = RECORD_PADDING;
+            memcpy(&ring_buffer[offset], &marker, RECORD_HEADER_LEN);
+        }
+        offset = 0;
+    }
+
+    uint16_t len = (uint16_t) data_len;
+    memcpy(&ring_buffer[offset], &len, RECORD_HEADER_LEN);
+    memcpy(&ring_buffer[offset + RECORD_HEADER_LEN], header, header_len);
+    memcpy(&ring_buffer[offset + RECORD_HEADER_LEN + header_len], packet, packet_len);
+    __atomic_store_n(&ring_write_pos, write_pos + padding + record_len, __ATOMIC_RELEASE);
+
+    // don't wait for flush interval if buffer gets half full
+    if ((used <= RING_BUFFER_HALF) && ((used + padding + record_len) > RING_BUFFER_HALF)){
+        hci_dump_posix_async_wake_writer();
+    }
+    return true;
+}
+
+uint32_t hci_dump_posix_async_get_dropped_packets(void){
+    return __atomic_load_n(&dropped_packets, __ATOMIC_RELAXED);
+}
+
+void hci_dump_posix_async_close(void){
+    if (!writer_started) return;
+    writer_started = false;
+
+    pthread_mutex_lock(&writer_mutex);
+    __atomic_store_n(&writer_running, false, __ATOMIC_RELEASE);
+    pthread_cond_signal(&writer_cond);
+    pthread_mutex_unlock(&writer_mutex);
+    pthread_join(writer_thread, NULL);
+
+    if (dump_fd >= 0){
+        close(dump_fd);
+    }
+    dump_fd = -1;
+}
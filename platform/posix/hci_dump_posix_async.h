@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2020 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHIAS
+ * RINGWALD OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+/*
+ *  hci_dump_posix_async.h
+ *
+ *  Asynchronous writer for binary HCI dump formats (PacketLogger/BlueZ)
+ *
+ *  Packets are copied into a preallocated single-producer/single-consumer ring buffer
+ *  by the run loop thread and written by a dedicated writer thread using writev().
+ *  Used by hci_dump.c if ENABLE_HCI_DUMP_POSIX_ASYNC is defined.
+ */
+
+#ifndef HCI_DUMP_POSIX_ASYNC_H
+#define HCI_DUMP_POSIX_ASYNC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#if defined __cplusplus
+extern "C" {
+#endif
+
+/* API_START */
+
+/**
+ * @brief Open file and start writer thread
+ * @param filename is copied, up to HCI_DUMP_POSIX_ASYNC_MAX_FILENAME_LEN (default 255) characters
+ * @return file descriptor or negative value on error
+ */
+int hci_dump_posix_async_open(const char * filename);
+
+/**
+ * @brief Rotate file when it would grow beyond max_file_size. The current file is renamed to <filename>.1
+ * @param max_file_size in bytes, 0 for unlimited (default)
+ */
+void hci_dump_posix_async_set_max_file_size(uint32_t max_file_size);
+
+/**
+ * @brief Queue header and packet for writing. Must only be called from a single thread.
+ * @param header
+ * @param header_len
+ * @param packet
+ * @param packet_len
+ * @return true if queued, false if ring buffer was full and the packet was dropped
+ */
+bool hci_dump_posix_async_write(const uint8_t * header, uint16_t header_len, const uint8_t * packet, uint16_t packet_len);
+
+/**
+ * @brief Get number of packets dropped since open
+ * @return dropped packets
+ */
+uint32_t hci_dump_posix_async_get_dropped_packets(void);
+
+/**
+ * @brief Write queued packets, stop writer thread and close file
+ */
+void hci_dump_posix_async_close(void);
+
+/* API_END */
+
+#if defined __cplusplus
+}
+#endif
+
+#endif // HCI_DUMP_POSIX_ASYNC_H
@@ -0,0 +1,987 @@
+/*
+ * Copyright (C) 2020 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHIAS
+ * RINGWALD OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+#define BTSTACK_FILE__ "hci_transport_virtual.c"
+
+/*
+ *  hci_transport_virtual.c
+ *
+ *  HCI Transport with emulated Controller to run the host stack without radio.
+ *
+ *  Two instances, usually in two processes, are connected by a SOCK_SEQPACKET socket that represents the air
+ *  interface. The emulated Controller supports Classic and LE connection setup, ACL data with Number Of Completed
+ *  Packets events, LE Rand and LE Encrypt. Outgoing ACL packets occupy one of the configured Controller buffers
+ *  until their air time, based on the configured bit rate, has passed.
+ *
+ *  Classic pairing (SSP Just Works) and encryption are emulated locally by each Controller without involving the peer.
+ *  Remote features are assumed to match the local ones. There's no support for inquiry, scanning, SCO or LE encryption.
+ */
+
+#include "btstack_config.h"
+
+// enable POSIX functions (needed for -std=c99)
+#define _POSIX_C_SOURCE 200809
+
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+
+#include "bluetooth_company_id.h"
+#include "btstack_debug.h"
+#include "btstack_run_loop.h"
+#include "btstack_util.h"
+#include "hci.h"
+#include "hci_transport.h"
+#include "rijndael.h"
+
+// handles of the single Classic and LE connection
+#define VIRTUAL_CLASSIC_CON_HANDLE      0x0001
+#define VIRTUAL_LE_CON_HANDLE           0x0040
+
+#define VIRTUAL_EVENT_QUEUE_SIZE        32
+#define VIRTUAL_ACL_BUFFERS_MAX         16
+
+// link message: type, link type/status, payload
+#define VIRTUAL_LINK_HEADER_SIZE        2
+#define VIRTUAL_LINK_BUFFER_SIZE        (VIRTUAL_LINK_HEADER_SIZE + HCI_ACL_BUFFER_SIZE)
+
+typedef enum {
+    VIRTUAL_LINK_CLASSIC_CONNECT = 1,
+    VIRTUAL_LINK_CLASSIC_CONNECT_COMPLETE,
+    VIRTUAL_LINK_LE_CONNECT,
+    VIRTUAL_LINK_LE_CONNECT_CANCEL,
+    VIRTUAL_LINK_LE_CONNECT_COMPLETE,
+    VIRTUAL_LINK_DISCONNECT,
+    VIRTUAL_LINK_ACL,
+} virtual_link_message_t;
+
+typedef enum {
+    VIRTUAL_LINK_TYPE_CLASSIC = 0,
+    VIRTUAL_LINK_TYPE_LE,
+    VIRTUAL_LINK_TYPE_NUM,
+    VIRTUAL_LINK_TYPE_INVALID = 0xff
+} virtual_link_type_t;
+
+typedef enum {
+    VIRTUAL_CONNECTION_IDLE,
+    VIRTUAL_CONNECTION_W4_PEER,
+    VIRTUAL_CONNECTION_W4_HOST_ACCEPT,
+    VIRTUAL_CONNECTION_OPEN,
+} virtual_connection_state_t;
+
+typedef struct {
+    virtual_connection_state_t state;
+    hci_con_handle_t con_handle;
+    uint8_t          peer_addr[6];
+    uint16_t         num_completed_packets;
+    // LE connection parameters
+    uint16_t         conn_interval;
+    uint16_t         conn_latency;
+    uint16_t         supervision_timeout;
+} virtual_connection_t;
+
+typedef struct {
+    uint16_t size;
+    uint8_t  packet[HCI_EVENT_BUFFER_SIZE];
+} virtual_event_t;
+
+typedef struct {
+    uint64_t done_us;
+    uint16_t size;
+    uint8_t  buffer[VIRTUAL_LINK_BUFFER_SIZE];
+} virtual_acl_buffer_t;
+
+// prototypes
+static void virtual_controller_timer_handler(btstack_timer_source_t * ts);
+static void hci_transport_virtual_process_link(btstack_data_source_t * ds, btstack_data_source_callback_type_t callback_type);
+
+// config
+static hci_transport_config_virtual_t hci_transport_virtual_config;
+
+static void (*packet_handler)(uint8_t packet_type, uint8_t *packet, uint16_t size);
+
+// public address in HCI byte order, as used in commands, events and link messages
+static uint8_t virtual_controller_bd_addr[6];
+
+static btstack_data_source_t  hci_transport_virtual_link_data_source;
+static btstack_timer_source_t virtual_controller_timer;
+static int                    virtual_controller_timer_active;
+
+// events queued for host
+static virtual_event_t virtual_controller_events[VIRTUAL_EVENT_QUEUE_SIZE];
+static uint16_t        virtual_controller_events_head;
+static uint16_t        virtual_controller_events_count;
+
+// ACL packets in Controller buffers, transmitted in order
+static virtual_acl_buffer_t virtual_controller_acl_buffers[2 * VIRTUAL_ACL_BUFFERS_MAX];
+static uint16_t             virtual_controller_acl_buffers_head;
+static uint16_t             virtual_controller_acl_buffers_count;
+static uint64_t             virtual_controller_air_busy_until_us;
+
+static virtual_connection_t virtual_controller_connections[VIRTUAL_LINK_TYPE_NUM];
+
+// LE state
+static int      virtual_controller_le_advertising_enabled;
+static int      virtual_controller_le_connect_pending;
+static uint8_t  virtual_controller_le_connect_request[VIRTUAL_LINK_BUFFER_SIZE];
+
+static uint32_t virtual_controller_random_state;
+
+// receive buffer with space for incoming pre-buffer
+static uint8_t  hci_transport_virtual_link_buffer[HCI_INCOMING_PRE_BUFFER_SIZE + VIRTUAL_LINK_BUFFER_SIZE];
+
+static uint64_t virtual_controller_get_time_us(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t) ts.tv_sec * 1000000u) + ((uint64_t) ts.tv_nsec / 1000u);
+}
+
+static uint32_t virtual_controller_random(void){
+    // xorshift32
+    uint32_t x = virtual_controller_random_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    virtual_controller_random_state = x;
+    return x;
+}
+
+// events
+
+static uint8_t * virtual_controller_event_reserve(uint16_t size){
+    if (virtual_controller_events_count == VIRTUAL_EVENT_QUEUE_SIZE){
+        log_error("virtual: event queue full, dropping event");
+        return NULL;
+    }
+    uint16_t pos = (virtual_controller_events_head + virtual_controller_events_count) % VIRTUAL_EVENT_QUEUE_SIZE;
+    virtual_controller_events_count++;
+    virtual_controller_events[pos].size = size;
+    return virtual_controller_events[pos].packet;
+}
+
+static void virtual_controller_emit_event(uint8_t event_type, const uint8_t * params, uint8_t params_len){
+    uint8_t * event = virtual_controller_event_reserve(2 + params_len);
+    if (event == NULL) return;
+    event[0] = event_type;
+    event[1] = params_len;
+    if (params_len > 0){
+        (void)memcpy(&event[2], params, params_len);
+    }
+}
+
+static void virtual_controller_emit_command_complete(uint16_t opcode, const uint8_t * return_params, uint8_t return_params_len){
+    uint8_t * event = virtual_controller_event_reserve(5 + return_params_len);
+    if (event == NULL) return;
+    event[0] = HCI_EVENT_COMMAND_COMPLETE;
+    event[1] = 3 + return_params_len;
+    event[2] = 1;
+    little_endian_store_16(event, 3, opcode);
+    (void)memcpy(&event[5], return_params, return_params_len);
+}
+
+static void virtual_controller_emit_command_complete_status(uint16_t opcode, uint8_t status){
+    virtual_controller_emit_command_complete(opcode, &status, 1);
+}
+
+static void virtual_controller_emit_command_complete_bd_addr(uint16_t opcode, const uint8_t * bd_addr){
+    uint8_t return_params[7];
+    return_params[0] = ERROR_CODE_SUCCESS;
+    (void)memcpy(&return_params[1], bd_addr, 6);
+    virtual_controller_emit_command_complete(opcode, return_params, sizeof(return_params));
+}
+
+static void virtual_controller_emit_command_status(uint16_t opcode, uint8_t status){
+    uint8_t params[4];
+    params[0] = status;
+    params[1] = 1;
+    little_endian_store_16(params, 2, opcode);
+    virtual_controller_emit_event(HCI_EVENT_COMMAND_STATUS, params, sizeof(params));
+}
+
+static void virtual_controller_emit_bd_addr_event(uint8_t event_type, const uint8_t * bd_addr){
+    virtual_controller_emit_event(event_type, bd_addr, 6);
+}
+
+static void virtual_controller_emit_connection_complete(uint8_t status, const virtual_connection_t * connection){
+    uint8_t params[11];
+    params[0] = status;
+    little_endian_store_16(params, 1, connection->con_handle);
+    (void)memcpy(&params[3], connection->peer_addr, 6);
+    params[9]  = 1;     // ACL
+    params[10] = 0;     // encryption disabled
+    virtual_controller_emit_event(HCI_EVENT_CONNECTION_COMPLETE, params, sizeof(params));
+}
+
+static void virtual_controller_emit_le_connection_complete(uint8_t status, const virtual_connection_t * connection, uint8_t role){
+    uint8_t params[19];
+    params[0] = HCI_SUBEVENT_LE_CONNECTION_COMPLETE;
+    params[1] = status;
+    little_endian_store_16(params, 2, connection->con_handle);
+    params[4] = role;
+    params[5] = 0;      // public address
+    (void)memcpy(&params[6], connection->peer_addr, 6);
+    little_endian_store_16(params, 12, connection->conn_interval);
+    little_endian_store_16(params, 14, connection->conn_latency);
+    little_endian_store_16(params, 16, connection->supervision_timeout);
+    params[18] = 0;     // master clock accuracy
+    virtual_controller_emit_event(HCI_EVENT_LE_META, params, sizeof(params));
+}
+
+static void virtual_controller_emit_disconnection_complete(hci_con_handle_t con_handle, uint8_t reason){
+    uint8_t params[4];
+    params[0] = ERROR_CODE_SUCCESS;
+    little_endian_store_16(params, 1, con_handle);
+    params[3] = reason;
+    virtual_controller_emit_event(HCI_EVENT_DISCONNECTION_COMPLETE, params, sizeof(params));
+}
+
+static void virtual_controller_emit_authentication_complete(uint8_t status, hci_con_handle_t con_handle){
+    uint8_t params[3];
+    params[0] = status;
+    little_endian_store_16(params, 1, con_handle);
+    virtual_controller_emit_event(HCI_EVENT_AUTHENTICATION_COMPLETE_EVENT, params, sizeof(params));
+}
+
+static void virtual_controller_emit_simple_pairing_complete(uint8_t status, const uint8_t * bd_addr){
+    uint8_t params[7];
+    params[0] = status;
+    (void)memcpy(&params[1], bd_addr, 6);
+    virtual_controller_emit_event(HCI_EVENT_SIMPLE_PAIRING_COMPLETE, params, sizeof(params));
+}
+
+static void virtual_controller_deliver_events(void){
+    while (virtual_controller_events_count > 0){
+        virtual_event_t * event = &virtual_controller_events[virtual_controller_events_head];
+        virtual_controller_events_head = (virtual_controller_events_head + 1) % VIRTUAL_EVENT_QUEUE_SIZE;
+        virtual_controller_events_count--;
+        // slot is not reused before handler returns, as it was the oldest one
+        packet_handler(HCI_EVENT_PACKET, event->packet, event->size);
+    }
+}
+
+// scheduling
+
+static void virtual_controller_schedule(void){
+    uint32_t timeout_ms;
+    if (virtual_controller_events_count > 0){
+        timeout_ms = 0;
+    } else if (virtual_controller_acl_buffers_count > 0){
+        uint64_t done_us = virtual_controller_acl_buffers[virtual_controller_acl_buffers_head].done_us;
+        uint64_t now_us  = virtual_controller_get_time_us();
+        timeout_ms = (done_us > now_us) ? (uint32_t) ((done_us - now_us + 999u) / 1000u) : 0;
+    } else {
+        return;
+    }
+    if (virtual_controller_timer_active){
+        btstack_run_loop_remove_timer(&virtual_controller_timer);
+    }
+    btstack_run_loop_set_timer(&virtual_controller_timer, timeout_ms);
+    btstack_run_loop_add_timer(&virtual_controller_timer);
+    virtual_controller_timer_active = 1;
+}
+
+// link
+
+static void virtual_controller_link_send(const uint8_t * message, uint16_t size){
+    ssize_t res = send(hci_transport_virtual_config.link_fd, message, size, 0);
+    if (res != (ssize_t) size){
+        log_error("virtual: link send failed, errno %d", errno);
+    }
+}
+
+static void virtual_controller_link_send_message(virtual_link_message_t type, uint8_t info, const uint8_t * payload, uint16_t payload_len){
+    uint8_t message[VIRTUAL_LINK_HEADER_SIZE + 32];
+    btstack_assert(payload_len <= 32);
+    message[0] = (uint8_t) type;
+    message[1] = info;
+    if (payload_len > 0){
+        (void)memcpy(&message[VIRTUAL_LINK_HEADER_SIZE], payload, payload_len);
+    }
+    virtual_controller_link_send(message, VIRTUAL_LINK_HEADER_SIZE + payload_len);
+}
+
+static virtual_link_type_t virtual_controller_link_type_for_handle(hci_con_handle_t con_handle){
+    int i;
+    for (i=0;i<VIRTUAL_LINK_TYPE_NUM;i++){
+        if (virtual_controller_connections[i].state == VIRTUAL_CONNECTION_IDLE) continue;
+        if (virtual_controller_connections[i].con_handle != con_handle) continue;
+        return (virtual_link_type_t) i;
+    }
+    return VIRTUAL_LINK_TYPE_INVALID;
+}
+
+static void virtual_controller_connection_closed(virtual_link_type_t link_type){
+    // drop queued packets, completed packets are not reported after disconnect
+    uint16_t i;
+    for (i=0;i<virtual_controller_acl_buffers_count;i++){
+        virtual_acl_buffer_t * acl_buffer = &virtual_controller_acl_buffers[(virtual_controller_acl_buffers_head + i) % (2 * VIRTUAL_ACL_BUFFERS_MAX)];
+        if (acl_buffer->buffer[1] == (uint8_t) link_type){
+            acl_buffer->buffer[1] = VIRTUAL_LINK_TYPE_INVALID;
+        }
+    }
+    virtual_connection_t * connection = &virtual_controller_connections[link_type];
+    connection->state = VIRTUAL_CONNECTION_IDLE;
+    connection->num_completed_packets = 0;
+}
+
+static void virtual_controller_transmit_acl(void){
+    uint64_t now_us = virtual_controller_get_time_us();
+    while (virtual_controller_acl_buffers_count > 0){
+        virtual_acl_buffer_t * acl_buffer = &virtual_controller_acl_buffers[virtual_controller_acl_buffers_head];
+        if (acl_buffer->done_us > now_us) break;
+        virtual_link_type_t link_type = (virtual_link_type_t) acl_buffer->buffer[1];
+        if (link_type != VIRTUAL_LINK_TYPE_INVALID){
+            virtual_controller_link_send(acl_buffer->buffer, acl_buffer->size);
+            virtual_controller_connections[link_type].num_completed_packets++;
+        }
+        virtual_controller_acl_buffers_head = (virtual_controller_acl_buffers_head + 1) % (2 * VIRTUAL_ACL_BUFFERS_MAX);
+        virtual_controller_acl_buffers_count--;
+    }
+
+    // report completed packets for all connections in a single event
+    uint8_t params[1 + (VIRTUAL_LINK_TYPE_NUM * 4)];
+    uint8_t num_handles = 0;
+    int i;
+    for (i=0;i<VIRTUAL_LINK_TYPE_NUM;i++){
+        virtual_connection_t * connection = &virtual_controller_connections[i];
+        if (connection->num_completed_packets == 0) continue;
+        little_endian_store_16(params, 1 + (num_handles * 4), connection->con_handle);
+        little_endian_store_16(params, 3 + (num_handles * 4), connection->num_completed_packets);
+        connection->num_completed_packets = 0;
+        num_handles++;
+    }
+    if (num_handles == 0) return;
+    params[0] = num_handles;
+    virtual_controller_emit_event(HCI_EVENT_NUMBER_OF_COMPLETED_PACKETS, params, 1 + (num_handles * 4));
+}
+
+static void virtual_controller_timer_handler(btstack_timer_source_t * ts){
+    UNUSED(ts);
+    virtual_controller_timer_active = 0;
+    virtual_controller_deliver_events();
+    virtual_controller_transmit_acl();
+    virtual_controller_deliver_events();
+    virtual_controller_schedule();
+}
+
+// connection management
+
+static void virtual_controller_le_accept_connection(void){
+    virtual_connection_t * connection = &virtual_controller_connections[VIRTUAL_LINK_TYPE_LE];
+    const uint8_t * request = &virtual_controller_le_connect_request[VIRTUAL_LINK_HEADER_SIZE];
+    virtual_controller_le_connect_pending = 0;
+
+    // advertising stops on connection
+    virtual_controller_le_advertising_enabled = 0;
+    connection->state = VIRTUAL_CONNECTION_OPEN;
+    connection->con_handle = VIRTUAL_LE_CON_HANDLE;
+    (void)memcpy(connection->peer_addr, &request[0], 6);
+    connection->conn_interval       = little_endian_read_16(request, 12);
+    connection->conn_latency        = little_endian_read_16(request, 14);
+    connection->supervision_timeout = little_endian_read_16(request, 16);
+    virtual_controller_emit_le_connection_complete(ERROR_CODE_SUCCESS, connection, HCI_ROLE_SLAVE);
+
+    uint8_t payload[6];
+    (void)memcpy(payload, virtual_controller_bd_addr, 6);
+    virtual_controller_link_send_message(VIRTUAL_LINK_LE_CONNECT_COMPLETE, ERROR_CODE_SUCCESS, payload, sizeof(payload));
+}
+
+static void virtual_controller_handle_link_message(uint8_t * message, uint16_t size){
+    if (size < VIRTUAL_LINK_HEADER_SIZE) return;
+    virtual_link_message_t type = (virtual_link_message_t) message[0];
+    uint8_t info = message[1];
+    uint8_t * payload = &message[VIRTUAL_LINK_HEADER_SIZE];
+    uint16_t payload_len = size - VIRTUAL_LINK_HEADER_SIZE;
+    virtual_connection_t * connection;
+    uint8_t params[10];
+
+    switch (type){
+        case VIRTUAL_LINK_CLASSIC_CONNECT:
+            // payload: peer address, class of device
+            if (payload_len < 9) break;
+            connection = &virtual_controller_connections[VIRTUAL_LINK_TYPE_CLASSIC];
+            if (connection->state != VIRTUAL_CONNECTION_IDLE){
+                virtual_controller_link_send_message(VIRTUAL_LINK_CLASSIC_CONNECT_COMPLETE, ERROR_CODE_CONNECTION_REJECTED_DUE_TO_LIMITED_RESOURCES, NULL, 0);
+                break;
+            }
+            connection->state = VIRTUAL_CONNECTION_W4_HOST_ACCEPT;
+            connection->con_handle = VIRTUAL_CLASSIC_CON_HANDLE;
+            (void)memcpy(connection->peer_addr, payload, 6);
+            (void)memcpy(params, payload, 9);
+            params[9] = 1;  // ACL
+            virtual_controller_emit_event(HCI_EVENT_CONNECTION_REQUEST, params, 10);
+            break;
+
+        case VIRTUAL_LINK_CLASSIC_CONNECT_COMPLETE:
+            connection = &virtual_controller_connections[VIRTUAL_LINK_TYPE_CLASSIC];
+            if (connection->state != VIRTUAL_CONNECTION_W4_PEER) break;
+            if (info == ERROR_CODE_SUCCESS){
+                connection->state = VIRTUAL_CONNECTION_OPEN;
+            } else {
+                connection->state = VIRTUAL_CONNECTION_IDLE;
+            }
+            virtual_controller_emit_connection_complete(info, connection);
+            break;
+
+        case VIRTUAL_LINK_LE_CONNECT:
+            // payload: initiator address, target address or all zero for whitelist, connection parameters
+            if ((size > sizeof(virtual_controller_le_connect_request)) || (payload_len < 18)) break;
+            if (virtual_controller_connections[VIRTUAL_LINK_TYPE_LE].state != VIRTUAL_CONNECTION_IDLE) break;
+            (void)memcpy(virtual_controller_le_connect_request, message, size);
+            virtual_controller_le_connect_pending = 1;
+            // initiator keeps scanning until we advertise
+            if (virtual_controller_le_advertising_enabled){
+                virtual_controller_le_accept_connection();
+            }
+            break;
+
+        case VIRTUAL_LINK_LE_CONNECT_CANCEL:
+            virtual_controller_le_connect_pending = 0;
+            break;
+
+        case VIRTUAL_LINK_LE_CONNECT_COMPLETE:
+            // payload: peer address
+            if (payload_len < 6) break;
+            connection = &virtual_controller_connections[VIRTUAL_LINK_TYPE_LE];
+            if (connection->state != VIRTUAL_CONNECTION_W4_PEER) break;
+            connection->state = VIRTUAL_CONNECTION_OPEN;
+            (void)memcpy(connection->peer_addr, payload, 6);
+            virtual_controller_emit_le_connection_complete(ERROR_CODE_SUCCESS, connection, HCI_ROLE_MASTER);
+            break;
+
+        case VIRTUAL_LINK_DISCONNECT:
+            // info: link type, payload: reason
+            if ((payload_len < 1) || (info >= VIRTUAL_LINK_TYPE_NUM)) break;
+            connection = &virtual_controller_connections[info];
+            if (connection->state != VIRTUAL_CONNECTION_OPEN) break;
+            virtual_controller_emit_disconnection_complete(connection->con_handle, payload[0]);
+            virtual_controller_connection_closed((virtual_link_type_t) info);
+            break;
+
+        case VIRTUAL_LINK_ACL: {
+            // info: link type, payload: ACL packet
+            if ((payload_len < HCI_ACL_HEADER_SIZE) || (info >= VIRTUAL_LINK_TYPE_NUM)) break;
+            connection = &virtual_controller_connections[info];
+            if (connection->state != VIRTUAL_CONNECTION_OPEN) break;
+            // use local handle and report first fragment as flushable
+            uint16_t flags = little_endian_read_16(payload, 0) >> 12;
+            if ((flags & 0x03u) == 0u){
+                flags |= 0x02u;
+            }
+            little_endian_store_16(payload, 0, (flags << 12) | connection->con_handle);
+            // deliver events first to keep order, e.g. Connection Complete before first ACL packet
+            virtual_controller_deliver_events();
+            packet_handler(HCI_ACL_DATA_PACKET, payload, payload_len);
+            break;
+        }
+        default:
+            log_error("virtual: unknown link message %u", type);
+            break;
+    }
+}
+
+static void virtual_controller_link_lost(void){
+    int i;
+    for (i=0;i<VIRTUAL_LINK_TYPE_NUM;i++){
+        virtual_connection_t * connection = &virtual_controller_connections[i];
+        if (connection->state != VIRTUAL_CONNECTION_OPEN) continue;
+        virtual_controller_emit_disconnection_complete(connection->con_handle, ERROR_CODE_CONNECTION_TIMEOUT);
+        virtual_controller_connection_closed((virtual_link_type_t) i);
+    }
+}
+
+static void hci_transport_virtual_process_link(btstack_data_source_t * ds, btstack_data_source_callback_type_t callback_type){
+    UNUSED(callback_type);
+    uint8_t * message = &hci_transport_virtual_link_buffer[HCI_INCOMING_PRE_BUFFER_SIZE];
+    // process all pending messages
+    while (true){
+        ssize_t res = recv(ds->source.fd, message, VIRTUAL_LINK_BUFFER_SIZE, MSG_DONTWAIT);
+        if (res < 0){
+            if ((errno != EAGAIN) && (errno != EWOULDBLOCK)){
+                log_error("virtual: link recv failed, errno %d", errno);
+            }
+            break;
+        }
+        if (res == 0){
+            log_info("virtual: link closed by peer");
+            btstack_run_loop_remove_data_source(ds);
+            virtual_controller_link_lost();
+            break;
+        }
+        virtual_controller_handle_link_message(message, (uint16_t) res);
+    }
+    virtual_controller_schedule();
+}
+
+// commands
+
+static void virtual_controller_read_local_supported_features(uint8_t * features){
+    memset(features, 0, 8);
+    features[0] = 0x03;     // 3 and 5 slot packets
+    features[3] = 0x06;     // EDR ACL 2 and 3 Mbps
+    features[4] = 0x40;     // LE Supported (Controller)
+    features[6] = 0x08;     // Secure Simple Pairing (Controller)
+}
+
+static void virtual_controller_link_key(const uint8_t * peer_addr, uint8_t * link_key){
+    // same key on both sides, SSP is not emulated over the link
+    int i;
+    for (i=0;i<16;i++){
+        link_key[i] = (uint8_t) (virtual_controller_bd_addr[i % 6] ^ peer_addr[i % 6] ^ i);
+    }
+}
+
+static virtual_connection_t * virtual_controller_classic_connection_for_bd_addr(const uint8_t * bd_addr){
+    virtual_connection_t * connection = &virtual_controller_connections[VIRTUAL_LINK_TYPE_CLASSIC];
+    if (connection->state == VIRTUAL_CONNECTION_IDLE) return NULL;
+    if (memcmp(connection->peer_addr, bd_addr, 6) != 0) return NULL;
+    return connection;
+}
+
+static void virtual_controller_handle_pairing_command(uint16_t opcode, const uint8_t * params){
+    uint8_t link_key[16];
+    uint8_t event_params[23];
+    virtual_controller_emit_command_complete_bd_addr(opcode, params);
+    virtual_connection_t * connection = virtual_controller_classic_connection_for_bd_addr(params);
+    if (connection == NULL) return;
+    switch (opcode){
+        case HCI_OPCODE_HCI_LINK_KEY_REQUEST_REPLY:
+            virtual_controller_emit_authentication_complete(ERROR_CODE_SUCCESS, connection->con_handle);
+            break;
+        case HCI_OPCODE_HCI_LINK_KEY_REQUEST_NEGATIVE_REPLY:
+            virtual_controller_emit_bd_addr_event(HCI_EVENT_IO_CAPABILITY_REQUEST, connection->peer_addr);
+            break;
+        case HCI_OPCODE_HCI_IO_CAPABILITY_REQUEST_REPLY:
+            // peer: no input, no output, no oob data, general bonding
+            (void)memcpy(event_params, connection->peer_addr, 6);
+            event_params[6] = SSP_IO_CAPABILITY_NO_INPUT_NO_OUTPUT;
+            event_params[7] = 0;
+            event_params[8] = SSP_IO_AUTHREQ_MITM_PROTECTION_NOT_REQUIRED_GENERAL_BONDING;
+            virtual_controller_emit_event(HCI_EVENT_IO_CAPABILITY_RESPONSE, event_params, 9);
+            little_endian_store_32(event_params, 6, 0);
+            virtual_controller_emit_event(HCI_EVENT_USER_CONFIRMATION_REQUEST, event_params, 10);
+            break;
+        case HCI_OPCODE_HCI_USER_CONFIRMATION_REQUEST_REPLY:
+            virtual_controller_emit_simple_pairing_complete(ERROR_CODE_SUCCESS, connection->peer_addr);
+            virtual_controller_link_key(connection->peer_addr, link_key);
+            (void)memcpy(event_params, connection->peer_addr, 6);
+            (void)memcpy(&event_params[6], link_key, 16);
+            event_params[22] = UNAUTHENTICATED_COMBINATION_KEY_GENERATED_FROM_P192;
+            virtual_controller_emit_event(HCI_EVENT_LINK_KEY_NOTIFICATION, event_params, 23);
+            virtual_controller_emit_authentication_complete(ERROR_CODE_SUCCESS, connection->con_handle);
+            break;
+        default:
+            // negative replies
+            virtual_controller_emit_simple_pairing_complete(ERROR_CODE_AUTHENTICATION_FAILURE, connection->peer_addr);
+            virtual_controller_emit_authentication_complete(ERROR_CODE_AUTHENTICATION_FAILURE, connection->con_handle);
+            break;
+    }
+}
+
+static void virtual_controller_handle_command(const uint8_t * packet, uint16_t size){
+    if (size < 3) return;
+    uint16_t opcode = little_endian_read_16(packet, 0);
+    const uint8_t * params = &packet[3];
+    uint8_t  return_params[65];
+    uint8_t  event_params[11];
+    uint8_t  key[16];
+    uint8_t  plaintext[16];
+    uint8_t  ciphertext[16];
+    uint32_t rk[RKLENGTH(KEYBITS)];
+    uint8_t  payload[20];
+    virtual_connection_t * connection;
+    virtual_link_type_t link_type;
+
+    switch (opcode){
+        case HCI_OPCODE_HCI_RESET:
+            memset(virtual_controller_connections, 0, sizeof(virtual_controller_connections));
+            virtual_controller_acl_buffers_count = 0;
+            virtual_controller_le_advertising_enabled = 0;
+            virtual_controller_le_connect_pending = 0;
+            virtual_controller_emit_command_complete_status(opcode, ERROR_CODE_SUCCESS);
+            break;
+        case HCI_OPCODE_HCI_READ_LOCAL_VERSION_INFORMATION:
+            return_params[0] = ERROR_CODE_SUCCESS;
+            return_params[1] = 0x09;        // HCI Version 5.0
+            little_endian_store_16(return_params, 2, 0);
+            return_params[4] = 0x09;        // LMP Version 5.0
+            little_endian_store_16(return_params, 5, BLUETOOTH_COMPANY_ID_BLUEKITCHEN_GMBH);
+            little_endian_store_16(return_params, 7, 0);
+            virtual_controller_emit_command_complete(opcode, return_params, 9);
+            break;
+        case HCI_OPCODE_HCI_READ_LOCAL_NAME: {
+            uint8_t * event = virtual_controller_event_reserve(5 + 1 + 248);
+            if (event == NULL) break;
+            event[0] = HCI_EVENT_COMMAND_COMPLETE;
+            event[1] = 3 + 1 + 248;
+            event[2] = 1;
+            little_endian_store_16(event, 3, opcode);
+            event[5] = ERROR_CODE_SUCCESS;
+            memset(&event[6], 0, 248);
+            strcpy((char *) &event[6], "BTstack Virtual");
+            break;
+        }
+        case HCI_OPCODE_HCI_READ_LOCAL_SUPPORTED_COMMANDS:
+            memset(return_params, 0, 65);
+            return_params[1 + 14] = 0x80;   // Read Buffer Size
+            return_params[1 + 24] = 0x40;   // Write LE Host Supported
+            virtual_controller_emit_command_complete(opcode, return_params, 65);
+            break;
+        case HCI_OPCODE_HCI_READ_LOCAL_SUPPORTED_FEATURES:
+            return_params[0] = ERROR_CODE_SUCCESS;
+            virtual_controller_read_local_supported_features(&return_params[1]);
+            virtual_controller_emit_command_complete(opcode, return_params, 9);
+            break;
+        case HCI_OPCODE_HCI_READ_BD_ADDR:
+            return_params[0] = ERROR_CODE_SUCCESS;
+            (void)memcpy(&return_params[1], virtual_controller_bd_addr, 6);
+            virtual_controller_emit_command_complete(opcode, return_params, 7);
+            break;
+        case HCI_OPCODE_HCI_READ_BUFFER_SIZE:
+            return_params[0] = ERROR_CODE_SUCCESS;
+            little_endian_store_16(return_params, 1, hci_transport_virtual_config.acl_data_packet_length);
+            return_params[3] = 0;   // no SCO
+            little_endian_store_16(return_params, 4, hci_transport_virtual_config.acl_packets_total_num);
+            little_endian_store_16(return_params, 6, 0);
+            virtual_controller_emit_command_complete(opcode, return_params, 8);
+            break;
+        case HCI_OPCODE_HCI_LE_READ_BUFFER_SIZE:
+            return_params[0] = ERROR_CODE_SUCCESS;
+            little_endian_store_16(return_params, 1, hci_transport_virtual_config.le_acl_data_packet_length);
+            return_params[3] = hci_transport_virtual_config.le_acl_packets_total_num;
+            virtual_controller_emit_command_complete(opcode, return_params, 4);
+            break;
+        case HCI_OPCODE_HCI_LE_READ_WHITE_LIST_SIZE:
+            return_params[0] = ERROR_CODE_SUCCESS;
+            return_params[1] = 8;
+            virtual_controller_emit_command_complete(opcode, return_params, 2);
+            break;
+        case HCI_OPCODE_HCI_LE_RAND:
+            return_params[0] = ERROR_CODE_SUCCESS;
+            little_endian_store_32(return_params, 1, virtual_controller_random());
+            little_endian_store_32(return_params, 5, virtual_controller_random());
+            virtual_controller_emit_command_complete(opcode, return_params, 9);
+            break;
+        case HCI_OPCODE_HCI_LE_ENCRYPT:
+            // key and plaintext are sent little endian
+            reverse_128(&params[0],  key);
+            reverse_128(&params[16], plaintext);
+            rijndaelEncrypt(rk, rijndaelSetupEncrypt(rk, key, KEYBITS), plaintext, ciphertext);
+            return_params[0] = ERROR_CODE_SUCCESS;
+            reverse_128(ciphertext, &return_params[1]);
+            virtual_controller_emit_command_complete(opcode, return_params, 17);
+            break;
+        case HCI_OPCODE_HCI_LE_SET_ADVERTISE_ENABLE:
+            virtual_controller_le_advertising_enabled = params[0];
+            virtual_controller_emit_command_complete_status(opcode, ERROR_CODE_SUCCESS);
+            if (virtual_controller_le_advertising_enabled && virtual_controller_le_connect_pending){
+                virtual_controller_le_accept_connection();
+            }
+            break;
+
+        // Classic connections
+        case HCI_OPCODE_HCI_CREATE_CONNECTION:
+            connection = &virtual_controller_connections[VIRTUAL_LINK_TYPE_CLASSIC];
+            if (connection->state != VIRTUAL_CONNECTION_IDLE){
+                virtual_controller_emit_command_status(opcode, ERROR_CODE_COMMAND_DISALLOWED);
+                break;
+            }
+            connection->state = VIRTUAL_CONNECTION_W4_PEER;
+            connection->con_handle = VIRTUAL_CLASSIC_CON_HANDLE;
+            (void)memcpy(connection->peer_addr, params, 6);
+            virtual_controller_emit_command_status(opcode, ERROR_CODE_SUCCESS);
+            (void)memcpy(payload, virtual_controller_bd_addr, 6);
+            little_endian_store_24(payload, 6, 0);
+            virtual_controller_link_send_message(VIRTUAL_LINK_CLASSIC_CONNECT, 0, payload, 9);
+            break;
+        case HCI_OPCODE_HCI_ACCEPT_CONNECTION_REQUEST:
+        case HCI_OPCODE_HCI_REJECT_CONNECTION_REQUEST:
+            connection = &virtual_controller_connections[VIRTUAL_LINK_TYPE_CLASSIC];
+            if ((connection->state != VIRTUAL_CONNECTION_W4_HOST_ACCEPT) || (memcmp(connection->peer_addr, params, 6) != 0)){
+                virtual_controller_emit_command_status(opcode, ERROR_CODE_UNKNOWN_CONNECTION_IDENTIFIER);
+                break;
+            }
+            virtual_controller_emit_command_status(opcode, ERROR_CODE_SUCCESS);
+            if (opcode == HCI_OPCODE_HCI_ACCEPT_CONNECTION_REQUEST){
+                connection->state = VIRTUAL_CONNECTION_OPEN;
+                virtual_controller_emit_connection_complete(ERROR_CODE_SUCCESS, connection);
+                virtual_controller_link_send_message(VIRTUAL_LINK_CLASSIC_CONNECT_COMPLETE, ERROR_CODE_SUCCESS, NULL, 0);
+            } else {
+                connection->state = VIRTUAL_CONNECTION_IDLE;
+                virtual_controller_emit_connection_complete(params[6], connection);
+                virtual_controller_link_send_message(VIRTUAL_LINK_CLASSIC_CONNECT_COMPLETE, params[6], NULL, 0);
+            }
+            break;
+        case HCI_OPCODE_HCI_READ_REMOTE_SUPPORTED_FEATURES_COMMAND:
+            link_type = virtual_controller_link_type_for_handle(little_endian_read_16(params, 0));
+            if (link_type != VIRTUAL_LINK_TYPE_CLASSIC){
+                virtual_controller_emit_command_status(opcode, ERROR_CODE_UNKNOWN_CONNECTION_IDENTIFIER);
+                break;
+            }
+            virtual_controller_emit_command_status(opcode, ERROR_CODE_SUCCESS);
+            event_params[0] = ERROR_CODE_SUCCESS;
+            little_endian_store_16(event_params, 1, VIRTUAL_CLASSIC_CON_HANDLE);
+            virtual_controller_read_local_supported_features(&event_params[3]);
+            virtual_controller_emit_event(HCI_EVENT_READ_REMOTE_SUPPORTED_FEATURES_COMPLETE, event_params, 11);
+            break;
+
+        // Classic pairing and encryption
+        case HCI_OPCODE_HCI_AUTHENTICATION_REQUESTED:
+            link_type = virtual_controller_link_type_for_handle(little_endian_read_16(params, 0));
+            if (link_type != VIRTUAL_LINK_TYPE_CLASSIC){
+                virtual_controller_emit_command_status(opcode, ERROR_CODE_UNKNOWN_CONNECTION_IDENTIFIER);
+                break;
+            }
+            virtual_controller_emit_command_status(opcode, ERROR_CODE_SUCCESS);
+            virtual_controller_emit_bd_addr_event(HCI_EVENT_LINK_KEY_REQUEST, virtual_controller_connections[link_type].peer_addr);
+            break;
+        case HCI_OPCODE_HCI_LINK_KEY_REQUEST_REPLY:
+        case HCI_OPCODE_HCI_LINK_KEY_REQUEST_NEGATIVE_REPLY:
+        case HCI_OPCODE_HCI_IO_CAPABILITY_REQUEST_REPLY:
+        case HCI_OPCODE_HCI_IO_CAPABILITY_REQUEST_NEGATIVE_REPLY:
+        case HCI_OPCODE_HCI_USER_CONFIRMATION_REQUEST_REPLY:
+        case HCI_OPCODE_HCI_USER_CONFIRMATION_REQUEST_NEGATIVE_REPLY:
+        case HCI_OPCODE_HCI_USER_PASSKEY_REQUEST_NEGATIVE_REPLY:
+            virtual_controller_handle_pairing_command(opcode, params);
+            break;
+        case HCI_OPCODE_HCI_SET_CONNECTION_ENCRYPTION:
+            link_type = virtual_controller_link_type_for_handle(little_endian_read_16(params, 0));
+            if (link_type != VIRTUAL_LINK_TYPE_CLASSIC){
+                virtual_controller_emit_command_status(opcode, ERROR_CODE_UNKNOWN_CONNECTION_IDENTIFIER);
+                break;
+            }
+            virtual_controller_emit_command_status(opcode, ERROR_CODE_SUCCESS);
+            event_params[0] = ERROR_CODE_SUCCESS;
+            little_endian_store_16(event_params, 1, VIRTUAL_CLASSIC_CON_HANDLE);
+            event_params[3] = params[2];
+            virtual_controller_emit_event(HCI_EVENT_ENCRYPTION_CHANGE, event_params, 4);
+            break;
+
+        // LE connections
+        case HCI_OPCODE_HCI_LE_CREATE_CONNECTION:
+            connection = &virtual_controller_connections[VIRTUAL_LINK_TYPE_LE];
+            if (connection->state != VIRTUAL_CONNECTION_IDLE){
+                virtual_controller_emit_command_status(opcode, ERROR_CODE_COMMAND_DISALLOWED);
+                break;
+            }
+            connection->state = VIRTUAL_CONNECTION_W4_PEER;
+            connection->con_handle = VIRTUAL_LE_CON_HANDLE;
+            connection->conn_interval       = little_endian_read_16(params, 13);
+            connection->conn_latency        = little_endian_read_16(params, 17);
+            connection->supervision_timeout = little_endian_read_16(params, 19);
+            virtual_controller_emit_command_status(opcode, ERROR_CODE_SUCCESS);
+            (void)memcpy(&payload[0], virtual_controller_bd_addr, 6);
+            if (params[4] == 0){
+                (void)memcpy(&payload[6], &params[6], 6);
+            } else {
+                // whitelist: connect to peer
+                memset(&payload[6], 0, 6);
+            }
+            little_endian_store_16(payload, 12, connection->conn_interval);
+            little_endian_store_16(payload, 14, connection->conn_latency);
+            little_endian_store_16(payload, 16, connection->supervision_timeout);
+            virtual_controller_link_send_message(VIRTUAL_LINK_LE_CONNECT, 0, payload, 18);
+            break;
+        case HCI_OPCODE_HCI_LE_CREATE_CONNECTION_CANCEL:
+            connection = &virtual_controller_connections[VIRTUAL_LINK_TYPE_LE];
+            if (connection->state != VIRTUAL_CONNECTION_W4_PEER){
+                virtual_controller_emit_command_complete_status(opcode, ERROR_CODE_COMMAND_DISALLOWED);
+                break;
+            }
+            connection->state = VIRTUAL_CONNECTION_IDLE;
+            virtual_controller_link_send_message(VIRTUAL_LINK_LE_CONNECT_CANCEL, 0, NULL, 0);
+            virtual_controller_emit_command_complete_status(opcode, ERROR_CODE_SUCCESS);
+            virtual_controller_emit_le_connection_complete(ERROR_CODE_UNKNOWN_CONNECTION_IDENTIFIER, connection, HCI_ROLE_MASTER);
+            break;
+
+        case HCI_OPCODE_HCI_DISCONNECT:
+            link_type = virtual_controller_link_type_for_handle(little_endian_read_16(params, 0));
+            if ((link_type == VIRTUAL_LINK_TYPE_INVALID) || (virtual_controller_connections[link_type].state != VIRTUAL_CONNECTION_OPEN)){
+                virtual_controller_emit_command_status(opcode, ERROR_CODE_UNKNOWN_CONNECTION_IDENTIFIER);
+                break;
+            }
+            virtual_controller_emit_command_status(opcode, ERROR_CODE_SUCCESS);
+            virtual_controller_link_send_message(VIRTUAL_LINK_DISCONNECT, (uint8_t) link_type, &params[2], 1);
+            virtual_controller_emit_disconnection_complete(virtual_controller_connections[link_type].con_handle, ERROR_CODE_CONNECTION_TERMINATED_BY_LOCAL_HOST);
+            virtual_controller_connection_closed(link_type);
+            break;
+
+        default:
+            // reject other link control commands as they would need a Command Status and further events
+            if ((opcode >> 10) == OGF_LINK_CONTROL){
+                log_info("virtual: unsupported command %04x", opcode);
+                virtual_controller_emit_command_status(opcode, ERROR_CODE_UNKNOWN_HCI_COMMAND);
+                break;
+            }
+            virtual_controller_emit_command_complete_status(opcode, ERROR_CODE_SUCCESS);
+            break;
+    }
+}
+
+static void virtual_controller_handle_acl(const uint8_t * packet, uint16_t size){
+    if (size < HCI_ACL_HEADER_SIZE) return;
+    hci_con_handle_t con_handle = little_endian_read_16(packet, 0) & 0x0fffu;
+    virtual_link_type_t link_type = virtual_controller_link_type_for_handle(con_handle);
+    if ((link_type == VIRTUAL_LINK_TYPE_INVALID) || (virtual_controller_connections[link_type].state != VIRTUAL_CONNECTION_OPEN)){
+        // host may send packets before it processed the Disconnection Complete event
+        log_info("virtual: ACL for unknown handle 0x%04x", con_handle);
+        return;
+    }
+    if ((size > HCI_ACL_BUFFER_SIZE) || (virtual_controller_acl_buffers_count == (2 * VIRTUAL_ACL_BUFFERS_MAX))){
+        log_error("virtual: ACL packet too large or no free Controller buffer");
+        return;
+    }
+
+    // schedule transmission after previous packets and own air time
+    uint64_t now_us = virtual_controller_get_time_us();
+    uint64_t start_us = (virtual_controller_air_busy_until_us > now_us) ? virtual_controller_air_busy_until_us : now_us;
+    uint32_t air_bit_rate = (link_type == VIRTUAL_LINK_TYPE_LE) ? hci_transport_virtual_config.le_acl_air_bit_rate : hci_transport_virtual_config.acl_air_bit_rate;
+    uint64_t air_time_us = 0;
+    if (air_bit_rate > 0){
+        air_time_us = ((uint64_t) (size - HCI_ACL_HEADER_SIZE) * 8u * 1000000u) / air_bit_rate;
+    }
+    virtual_controller_air_busy_until_us = start_us + air_time_us;
+
+    uint16_t pos = (virtual_controller_acl_buffers_head + virtual_controller_acl_buffers_count) % (2 * VIRTUAL_ACL_BUFFERS_MAX);
+    virtual_acl_buffer_t * acl_buffer = &virtual_controller_acl_buffers[pos];
+    acl_buffer->buffer[0] = VIRTUAL_LINK_ACL;
+    acl_buffer->buffer[1] = (uint8_t) link_type;
+    (void)memcpy(&acl_buffer->buffer[VIRTUAL_LINK_HEADER_SIZE], packet, size);
+    acl_buffer->size = VIRTUAL_LINK_HEADER_SIZE + size;
+    acl_buffer->done_us = virtual_controller_air_busy_until_us;
+    virtual_controller_acl_buffers_count++;
+}
+
+// HCI Transport API
+
+static void hci_transport_virtual_init(const void * transport_config){
+    btstack_assert(transport_config != NULL);
+    btstack_assert(((const hci_transport_config_t *) transport_config)->type == HCI_TRANSPORT_CONFIG_VIRTUAL);
+    (void)memcpy(&hci_transport_virtual_config, transport_config, sizeof(hci_transport_config_virtual_t));
+
+    // defaults
+    if (hci_transport_virtual_config.acl_data_packet_length == 0){
+        hci_transport_virtual_config.acl_data_packet_length = 1021;
+    }
+    if (hci_transport_virtual_config.acl_packets_total_num == 0){
+        hci_transport_virtual_config.acl_packets_total_num = 8;
+    }
+    if (hci_transport_virtual_config.le_acl_data_packet_length == 0){
+        hci_transport_virtual_config.le_acl_data_packet_length = 251;
+    }
+    if (hci_transport_virtual_config.le_acl_packets_total_num == 0){
+        hci_transport_virtual_config.le_acl_packets_total_num = 8;
+    }
+    hci_transport_virtual_config.acl_packets_total_num = btstack_min(hci_transport_virtual_config.acl_packets_total_num, VIRTUAL_ACL_BUFFERS_MAX);
+    hci_transport_virtual_config.le_acl_packets_total_num = btstack_min(hci_transport_virtual_config.le_acl_packets_total_num, VIRTUAL_ACL_BUFFERS_MAX);
+
+    reverse_bd_addr(hci_transport_virtual_config.bd_addr, virtual_controller_bd_addr);
+    virtual_controller_random_state = 0x12345678u ^ little_endian_read_32(virtual_controller_bd_addr, 0);
+}
+
+static int hci_transport_virtual_open(void){
+    virtual_controller_events_head = 0;
+    virtual_controller_events_count = 0;
+    virtual_controller_acl_buffers_head = 0;
+    virtual_controller_acl_buffers_count = 0;
+    virtual_controller_air_busy_until_us = 0;
+    memset(virtual_controller_connections, 0, sizeof(virtual_controller_connections));
+
+    btstack_run_loop_set_timer_handler(&virtual_controller_timer, &virtual_controller_timer_handler);
+    virtual_controller_timer_active = 0;
+
+    btstack_run_loop_set_data_source_fd(&hci_transport_virtual_link_data_source, hci_transport_virtual_config.link_fd);
+    btstack_run_loop_set_data_source_handler(&hci_transport_virtual_link_data_source, &hci_transport_virtual_process_link);
+    btstack_run_loop_enable_data_source_callbacks(&hci_transport_virtual_link_data_source, DATA_SOURCE_CALLBACK_READ);
+    btstack_run_loop_add_data_source(&hci_transport_virtual_link_data_source);
+    return 0;
+}
+
+static int hci_transport_virtual_close(void){
+    btstack_run_loop_remove_data_source(&hci_transport_virtual_link_data_source);
+    if (virtual_controller_timer_active){
+        btstack_run_loop_remove_timer(&virtual_controller_timer);
+        virtual_controller_timer_active = 0;
+    }
+    return 0;
+}
+
+static void hci_transport_virtual_register_packet_handler(void (*handler)(uint8_t packet_type, uint8_t *packet, uint16_t size)){
+    packet_handler = handler;
+}
+
+static int hci_transport_virtual_can_send_now(uint8_t packet_type){
+    UNUSED(packet_type);
+    // Controller flow control is done by HCI layer
+    return 1;
+}
+
+static int hci_transport_virtual_send_packet(uint8_t packet_type, uint8_t * packet, int size){
+    // packets are copied, packet sent and responses are delivered from run loop
+    virtual_controller_emit_event(HCI_EVENT_TRANSPORT_PACKET_SENT, NULL, 0);
+    switch (packet_type){
+        case HCI_COMMAND_DATA_PACKET:
+            virtual_controller_handle_command(packet, (uint16_t) size);
+            break;
+        case HCI_ACL_DATA_PACKET:
+            virtual_controller_handle_acl(packet, (uint16_t) size);
+            break;
+        default:
+            log_error("virtual: unsupported packet type %u", packet_type);
+            break;
+    }
+    virtual_controller_schedule();
+    return 0;
+}
+
+static const hci_transport_t hci_transport_virtual = {
+    /* const char * name; */                                        "VIRTUAL",
+    /* void   (*init) (const void *transport_config); */            &hci_transport_virtual_init,
+    /* int    (*open)(void); */                                     &hci_transport_virtual_open,
+    /* int    (*close)(void); */                                    &hci_transport_virtual_close,
+    /* void   (*register_packet_handler)(void (*handler)(...); */   &hci_transport_virtual_register_packet_handler,
+    /* int    (*can_send_packet_now)(uint8_t packet_type); */       &hci_transport_virtual_can_send_now,
+    /* int    (*send_packet)(...); */                               &hci_transport_virtual_send_packet,
+    /* int    (*set_baudrate)(uint32_t baudrate); */                NULL,
+    /* void   (*reset_link)(void); */                               NULL,
+    /* void   (*set_sco_config)(uint16_t voice_setting, int num_connections); */ NULL,
+};
+
+const hci_transport_t * hci_transport_virtual_instance(void){
+    return &hci_transport_virtual;
+}
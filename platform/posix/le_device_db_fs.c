@@ -96,6 +96,7 @@ const  char * csv_header = "# addr_type, addr, irk, ltk, ediv, rand[8], key_size
 static char db_path[sizeof(DB_PATH_TEMPLATE) - 2 + 17 + 1];
 
 static le_device_memory_db_t le_devices[LE_DEVICE_MEMORY_SIZE];
+static uint32_t le_device_db_generation;
 
 static char bd_addr_to_dash_str_buffer[6*3];  // 12-45-78-01-34-67\0
 static char * bd_addr_to_dash_str(bd_addr_t addr){
@@ -258,6 +259,7 @@ void le_device_db_init(void){
         le_devices[i].addr_type = BD_ADDR_TYPE_UNKNOWN;
     }
     sprintf(db_path, DB_PATH_TEMPLATE, "00-00-00-00-00-00");
+    le_device_db_generation++;
 }
 
 void le_device_db_set_local_bd_addr(bd_addr_t addr){
@@ -265,6 +267,7 @@ void le_device_db_set_local_bd_addr(bd_addr_t addr){
     log_info("le_device_db_fs: path %s", db_path);
     le_device_db_read();
     le_device_db_dump();
+    le_device_db_generation++;
 }
 
 // @returns number of device in db
@@ -281,10 +284,15 @@ int le_device_db_max_count(void){
     return LE_DEVICE_MEMORY_SIZE;
 }
 
+uint32_t le_device_db_generation_get(void){
+    return le_device_db_generation;
+}
+
 // free device
 void le_device_db_remove(int index){
     le_devices[index].addr_type = BD_ADDR_TYPE_UNKNOWN;
     le_device_db_store();
+    le_device_db_generation++;
 }
 
 int le_device_db_add(int addr_type, bd_addr_t addr, sm_key_t irk){
@@ -311,6 +319,7 @@ int le_device_db_add(int addr_type, bd_addr_t addr, sm_key_t irk){
     le_devices[index].remote_counter = 0; 
 #endif
     le_device_db_store();
+    le_device_db_generation++;
 
     return index;
 }
@@ -83,6 +83,7 @@ typedef struct le_device_nvm {
 } le_device_nvm_t;
 
 static uint32_t start_of_le_device_db;
+static uint32_t le_device_db_generation;
 
 // calculate address
 static int le_device_db_address_for_absolute_index(int abolute_index){
@@ -172,6 +173,7 @@ static int le_device_db_get_absolute_index_for_device_index(int device_index){
 void le_device_db_wiced_dct_set_start_address(uint32_t start_address){
 	log_info("set start address: %"PRIu32, start_address);	
 	start_of_le_device_db = start_address;
+	le_device_db_generation++;
 }
 
 void le_device_db_init(void){
@@ -195,6 +197,10 @@ int le_device_db_max_count(void){
     return NVM_NUM_LE_DEVICES;
 }
 
+uint32_t le_device_db_generation_get(void){
+    return le_device_db_generation;
+}
+
 // get device information: addr type and address
 void le_device_db_info(int device_index, int * addr_type, bd_addr_t addr, sm_key_t irk){
 	int absolute_index = le_device_db_get_absolute_index_for_device_index(device_index);
@@ -218,6 +224,7 @@ void le_device_db_remove(int device_index){
 	le_device_nvm_t entry;
 	memset(&entry, 0, sizeof(le_device_nvm_t));
 	le_device_db_entry_write(absolute_index, &entry);
+	le_device_db_generation++;
 }
 
 // custom function
@@ -228,6 +235,7 @@ void le_device_db_wiced_dct_delete_all(void){
 	for (i=0;i<NVM_NUM_LE_DEVICES;i++){
 		le_device_db_entry_write(i, &entry);
 	}
+	le_device_db_generation++;
 }
 
 int le_device_db_add(int addr_type, bd_addr_t addr, sm_key_t irk){
@@ -246,6 +254,7 @@ int le_device_db_add(int addr_type, bd_addr_t addr, sm_key_t irk){
     memcpy(entry.irk, irk, 16);
 
     le_device_db_entry_write(absolute_index, &entry);
+    le_device_db_generation++;
 
     return absolute_index;
 }
@@ -56,10 +56,10 @@ typedef enum {
 } att_operation_t;
 
 
-static int is_Bluetooth_Base_UUID(uint8_t const *uuid){
-    // Bluetooth Base UUID 00000000-0000-1000-8000-00805F9B34FB in little endian
-    static const uint8_t bluetooth_base_uuid[] = { 0xfb, 0x34, 0x9b, 0x5f, 0x80, 0x00, 0x00, 0x80, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 };
+// Bluetooth Base UUID 00000000-0000-1000-8000-00805F9B34FB in little endian
+static const uint8_t bluetooth_base_uuid[] = { 0xfb, 0x34, 0x9b, 0x5f, 0x80, 0x00, 0x00, 0x80, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 };
 
+static int is_Bluetooth_Base_UUID(uint8_t const *uuid){
     if (memcmp(&uuid[0],  &bluetooth_base_uuid[0], 12) != 0) return false;
     if (memcmp(&uuid[14], &bluetooth_base_uuid[14], 2) != 0) return false;
     return true;
@@ -74,10 +74,22 @@ static uint16_t uuid16_from_uuid(uint16_t uuid_len, uint8_t * uuid){
 
 // ATT Database
 
+#ifdef ENABLE_ATT_DB_INDEX
+// max number of UUIDs an iterator can filter for
+#define ATT_ITERATOR_MAX_UUIDS 3
+#endif
+
 // new java-style iterator
 typedef struct att_iterator {
     // private
     uint8_t const * att_ptr;
+#ifdef ENABLE_ATT_DB_INDEX
+    uint16_t start_position;
+    uint16_t end_position;
+    uint8_t  num_uuids;
+    uint16_t uuid_list_index[ATT_ITERATOR_MAX_UUIDS];
+    uint16_t uuid_list_end[ATT_ITERATOR_MAX_UUIDS];
+#endif
     // public
     uint16_t size;
     uint16_t flags;
@@ -85,6 +97,8 @@ typedef struct att_iterator {
     uint8_t  const * uuid;
     uint16_t value_len;
     uint8_t  const * value;
+    // handle of attribute stored before the current one
+    uint16_t previous_handle;
 } att_iterator_t;
 
 static void att_persistent_ccc_cache(att_iterator_t * it);
@@ -99,8 +113,274 @@ static uint16_t att_prepare_write_error_handle = 0x0000;
 static uint16_t att_persistent_ccc_handle;
 static uint16_t att_persistent_ccc_uuid16;
 
+#ifdef ENABLE_ATT_DB_INDEX
+// ATT DB index: offsets of all attributes in handle order plus end marker,
+// followed by a list of attribute positions sorted by UUID (UUID16 expanded to UUID128) and position
+static uint16_t * att_db_index_buffer;
+static uint32_t   att_db_index_buffer_len;
+static const uint16_t * att_db_index_precompiled;
+static uint32_t   att_db_index_precompiled_len;
+static uint16_t   att_db_index_num_attributes;
+static const uint16_t * att_db_index_offsets;
+static const uint16_t * att_db_index_uuid_list;
+static bool       att_db_index_valid;
+
+static uint8_t const * att_db_index_attribute(uint16_t position){
+    return &att_db[att_db_index_offsets[position]];
+}
+
+static uint16_t att_db_index_handle(uint16_t position){
+    return little_endian_read_16(att_db_index_attribute(position), 4);
+}
+
+// get UUID128 in little endian, UUID16 are expanded with Bluetooth Base UUID
+static void att_uuid_to_uuid128(uint8_t const * uuid, uint16_t uuid_len, uint8_t * uuid128){
+    if (uuid_len == 16u){
+        (void)memcpy(uuid128, uuid, 16);
+    } else {
+        (void)memcpy(uuid128, bluetooth_base_uuid, 16);
+        uuid128[12] = uuid[0];
+        uuid128[13] = uuid[1];
+    }
+}
+
+static void att_db_index_get_uuid128(uint16_t position, uint8_t * uuid128){
+    uint8_t const * attribute = att_db_index_attribute(position);
+    uint16_t flags = little_endian_read_16(attribute, 2);
+    att_uuid_to_uuid128(&attribute[6], ((flags & ATT_PROPERTY_UUID128) != 0u) ? 16u : 2u, uuid128);
+}
+
+// compare attribute at position with (uuid128, other_position)
+static int att_db_index_compare(uint16_t position, uint8_t const * uuid128, uint16_t other_position){
+    uint8_t attribute_uuid128[16];
+    att_db_index_get_uuid128(position, attribute_uuid128);
+    int res = memcmp(attribute_uuid128, uuid128, 16);
+    if (res != 0) return res;
+    return (int) position - (int) other_position;
+}
+
+static int att_db_index_compare_positions(uint16_t position_a, uint16_t position_b){
+    uint8_t uuid128_b[16];
+    att_db_index_get_uuid128(position_b, uuid128_b);
+    return att_db_index_compare(position_a, uuid128_b, position_b);
+}
+
+static void att_db_index_sift_down(uint16_t * list, uint16_t root, uint16_t len){
+    while (true){
+        uint32_t child = (2u * root) + 1u;
+        if (child >= len) break;
+        if (((child + 1u) < len) && (att_db_index_compare_positions(list[child], list[child + 1u]) < 0)){
+            child++;
+        }
+        if (att_db_index_compare_positions(list[root], list[child]) >= 0) break;
+        uint16_t tmp = list[root];
+        list[root] = list[child];
+        list[child] = tmp;
+        root = (uint16_t) child;
+    }
+}
+
+// heap sort, no extra memory needed
+static void att_db_index_sort(uint16_t * list, uint16_t len){
+    uint16_t i;
+    for (i = len / 2u; i > 0u; i--){
+        att_db_index_sift_down(list, i - 1u, len);
+    }
+    for (i = len; i > 1u; i--){
+        uint16_t tmp = list[0];
+        list[0] = list[i - 1u];
+        list[i - 1u] = tmp;
+        att_db_index_sift_down(list, 0, i - 1u);
+    }
+}
+
+// get number of attributes, returns false if handles are not ascending or db is larger than 64 kB
+static bool att_db_index_count_attributes(uint8_t const * db, uint16_t * num_attributes){
+    uint32_t offset = 0;
+    uint16_t last_handle = 0;
+    *num_attributes = 0;
+    while (true){
+        if (offset > 0xffffu) return false;
+        uint16_t size = little_endian_read_16(db, offset);
+        if (size == 0u) break;
+        uint16_t handle = little_endian_read_16(db, offset + 4u);
+        if (handle <= last_handle) return false;
+        last_handle = handle;
+        offset += size;
+        (*num_attributes)++;
+    }
+    return true;
+}
+
+// check that offsets of precompiled index match the attributes in the ATT DB, including end marker
+static bool att_db_index_precompiled_offsets_valid(uint16_t num_attributes){
+    uint32_t offset = 0;
+    uint16_t position;
+    for (position = 0; position <= num_attributes; position++){
+        if (offset > 0xffffu) return false;
+        if (att_db_index_precompiled[position] != offset) return false;
+        uint16_t size = little_endian_read_16(att_db, offset);
+        if (position == num_attributes) return size == 0u;
+        if (size == 0u) return false;
+        offset += size;
+    }
+    return false;
+}
+
+// check that uuid list of precompiled index only contains valid positions in strictly ascending order,
+// requires valid offsets
+static bool att_db_index_precompiled_uuid_list_valid(uint16_t num_attributes){
+    const uint16_t * uuid_list = &att_db_index_precompiled[num_attributes + 1u];
+    uint16_t i;
+    for (i = 0; i < num_attributes; i++){
+        if (uuid_list[i] >= num_attributes) return false;
+        if ((i > 0u) && (att_db_index_compare_positions(uuid_list[i - 1u], uuid_list[i]) >= 0)) return false;
+    }
+    return true;
+}
+
+// use index generated by compile_gatt.py --index after verifying it against the ATT DB
+static void att_db_index_use_precompiled(void){
+    if (((att_db_index_precompiled_len & 1u) == 0u) || (att_db_index_precompiled_len > 0x1ffffu)){
+        log_error("ATT DB index: invalid precompiled index len %u", (unsigned int) att_db_index_precompiled_len);
+        return;
+    }
+    uint16_t num_attributes = (uint16_t) ((att_db_index_precompiled_len - 1u) / 2u);
+    if (att_db_index_precompiled_offsets_valid(num_attributes) == false){
+        log_error("ATT DB index: precompiled index does not match ATT DB");
+        return;
+    }
+    // uuid list comparison uses att_db_index_offsets
+    att_db_index_offsets = att_db_index_precompiled;
+    if (att_db_index_precompiled_uuid_list_valid(num_attributes) == false){
+        log_error("ATT DB index: invalid UUID list in precompiled index");
+        return;
+    }
+    att_db_index_uuid_list = &att_db_index_precompiled[num_attributes + 1u];
+    att_db_index_num_attributes = num_attributes;
+    att_db_index_valid = true;
+}
+
+static void att_db_index_build(void){
+    att_db_index_valid = false;
+    if (att_db == NULL) return;
+    if (att_db_index_precompiled != NULL){
+        att_db_index_use_precompiled();
+        return;
+    }
+    if (att_db_index_buffer == NULL) return;
+
+    uint16_t num_attributes;
+    if (att_db_index_count_attributes(att_db, &num_attributes) == false){
+        log_error("ATT DB index: handles not ascending or ATT DB too large");
+        return;
+    }
+    uint32_t required_len = (2u * (uint32_t) num_attributes) + 1u;
+    if (required_len > att_db_index_buffer_len){
+        log_error("ATT DB index: buffer too small, %u entries required", (unsigned int) required_len);
+        return;
+    }
+
+    uint16_t * offsets   = att_db_index_buffer;
+    uint16_t * uuid_list = &att_db_index_buffer[num_attributes + 1u];
+    uint16_t offset = 0;
+    uint16_t position;
+    for (position = 0; position < num_attributes; position++){
+        offsets[position]   = offset;
+        uuid_list[position] = position;
+        offset += little_endian_read_16(att_db, offset);
+    }
+    offsets[num_attributes] = offset;
+
+    att_db_index_offsets = offsets;
+    att_db_index_uuid_list = uuid_list;
+    att_db_index_num_attributes = num_attributes;
+    att_db_index_sort(uuid_list, num_attributes);
+    att_db_index_valid = true;
+    log_info("ATT DB index: %u attributes", num_attributes);
+}
+
+// get position of first attribute with handle >= given handle
+static uint16_t att_db_index_find_position(uint16_t handle){
+    uint16_t low  = 0;
+    uint16_t high = att_db_index_num_attributes;
+    while (low < high){
+        uint16_t mid = low + ((high - low) / 2u);
+        if (att_db_index_handle(mid) < handle){
+            low = mid + 1u;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+// get index of first entry in uuid list that is >= (uuid128, position)
+static uint16_t att_db_index_uuid_list_lower_bound(uint8_t const * uuid128, uint16_t position){
+    uint16_t low  = 0;
+    uint16_t high = att_db_index_num_attributes;
+    while (low < high){
+        uint16_t mid = low + ((high - low) / 2u);
+        if (att_db_index_compare(att_db_index_uuid_list[mid], uuid128, position) < 0){
+            low = mid + 1u;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+#endif
+
 static void att_iterator_init(att_iterator_t *it){
     it->att_ptr = att_db;
+    it->handle  = 0;
+#ifdef ENABLE_ATT_DB_INDEX
+    it->start_position = 0;
+    it->end_position = att_db_index_num_attributes;
+    it->num_uuids = 0;
+#endif
+}
+
+// skip attributes with handle < start_handle if index is available. With UUID filter, the first attribute
+// with handle > end_handle is returned like the unfiltered iterator would, so callers stop at the same attribute
+static void att_iterator_init_with_handle_range(att_iterator_t *it, uint16_t start_handle, uint16_t end_handle){
+    att_iterator_init(it);
+#ifdef ENABLE_ATT_DB_INDEX
+    if (att_db_index_valid){
+        it->start_position = att_db_index_find_position(start_handle);
+        it->att_ptr = att_db_index_attribute(it->start_position);
+        if (end_handle < 0xffffu){
+            it->end_position = att_db_index_find_position(end_handle + 1u);
+        }
+    }
+#else
+    UNUSED(start_handle);
+    UNUSED(end_handle);
+#endif
+}
+
+// only return attributes with one of the added UUIDs, followed by end marker, if index is available.
+// Without index, all attributes are returned. The caller has to check the UUID in both cases.
+static void att_iterator_add_uuid(att_iterator_t *it, uint8_t const * uuid, uint16_t uuid_len){
+#ifdef ENABLE_ATT_DB_INDEX
+    if (att_db_index_valid == false) return;
+    btstack_assert(it->num_uuids < ATT_ITERATOR_MAX_UUIDS);
+    uint8_t uuid128[16];
+    att_uuid_to_uuid128(uuid, uuid_len, uuid128);
+    it->uuid_list_index[it->num_uuids] = att_db_index_uuid_list_lower_bound(uuid128, it->start_position);
+    it->uuid_list_end[it->num_uuids]   = att_db_index_uuid_list_lower_bound(uuid128, att_db_index_num_attributes);
+    it->num_uuids++;
+#else
+    UNUSED(it);
+    UNUSED(uuid);
+    UNUSED(uuid_len);
+#endif
+}
+
+static void att_iterator_add_uuid16(att_iterator_t *it, uint16_t uuid16){
+    uint8_t uuid[2];
+    little_endian_store_16(uuid, 0, uuid16);
+    att_iterator_add_uuid(it, uuid, 2);
 }
 
 static bool att_iterator_has_next(att_iterator_t *it){
@@ -108,6 +388,26 @@ static bool att_iterator_has_next(att_iterator_t *it){
 }
 
 static void att_iterator_fetch_next(att_iterator_t *it){
+    it->previous_handle = it->handle;
+#ifdef ENABLE_ATT_DB_INDEX
+    if (it->num_uuids > 0u){
+        // find lowest position of all uuid lists, use first attribute after handle range or end marker if all lists are done
+        uint16_t position = it->end_position;
+        uint8_t i;
+        for (i = 0; i < it->num_uuids; i++){
+            if (it->uuid_list_index[i] < it->uuid_list_end[i]){
+                position = btstack_min(position, att_db_index_uuid_list[it->uuid_list_index[i]]);
+            }
+        }
+        for (i = 0; i < it->num_uuids; i++){
+            if ((it->uuid_list_index[i] < it->uuid_list_end[i]) && (att_db_index_uuid_list[it->uuid_list_index[i]] == position)){
+                it->uuid_list_index[i]++;
+            }
+        }
+        it->att_ptr = att_db_index_attribute(position);
+        it->previous_handle = (position > 0u) ? att_db_index_handle(position - 1u) : 0u;
+    }
+#endif
     it->size   = little_endian_read_16(it->att_ptr, 0);
     if (it->size == 0u){
         it->flags = 0;
@@ -160,6 +460,16 @@ static int att_iterator_match_uuid(att_iterator_t *it, uint8_t *uuid, uint16_t u
 
 static int att_find_handle(att_iterator_t *it, uint16_t handle){
     if (handle == 0u) return 0u;
+#ifdef ENABLE_ATT_DB_INDEX
+    if (att_db_index_valid){
+        uint16_t position = att_db_index_find_position(handle);
+        if (position == att_db_index_num_attributes) return 0;
+        att_iterator_init(it);
+        it->att_ptr = att_db_index_attribute(position);
+        att_iterator_fetch_next(it);
+        return it->handle == handle;
+    }
+#endif
     att_iterator_init(it);
     while (att_iterator_has_next(it)){
         att_iterator_fetch_next(it);
@@ -210,7 +520,34 @@ void att_set_db(uint8_t const * db){
         return;
     }
     att_db = db;
+#ifdef ENABLE_ATT_DB_INDEX
+    att_db_index_build();
+#endif
+}
+
+#ifdef ENABLE_ATT_DB_INDEX
+uint32_t att_db_index_get_buffer_len(uint8_t const * db){
+    if (db == NULL) return 0;
+    if (*db++ != ATT_DB_VERSION) return 0;
+    uint16_t num_attributes;
+    if (att_db_index_count_attributes(db, &num_attributes) == false) return 0;
+    return (2u * (uint32_t) num_attributes) + 1u;
+}
+
+void att_set_db_index_buffer(uint16_t * buffer, uint32_t buffer_len){
+    att_db_index_precompiled = NULL;
+    att_db_index_buffer = buffer;
+    att_db_index_buffer_len = buffer_len;
+    att_db_index_build();
+}
+
+void att_set_db_index(const uint16_t * index, uint32_t index_len){
+    att_db_index_buffer = NULL;
+    att_db_index_precompiled = index;
+    att_db_index_precompiled_len = index_len;
+    att_db_index_build();
 }
+#endif
 
 void att_set_read_callback(att_read_callback_t callback){
     att_read_callback = callback;
@@ -396,7 +733,7 @@ static uint16_t handle_find_information_request2(att_connection_t * att_connecti
     uint16_t uuid_len = 0;
     
     att_iterator_t it;
-    att_iterator_init(&it);
+    att_iterator_init_with_handle_range(&it, start_handle, end_handle);
     while (att_iterator_has_next(&it)){
         att_iterator_fetch_next(&it);
         if (!it.handle) break;
@@ -486,10 +823,12 @@ static uint16_t handle_find_by_type_value_request(att_connection_t * att_connect
 
     uint16_t offset      = 1;
     uint16_t in_group    = 0;
-    uint16_t prev_handle = 0;
 
     att_iterator_t it;
-    att_iterator_init(&it);
+    att_iterator_init_with_handle_range(&it, start_handle, end_handle);
+    att_iterator_add_uuid16(&it, attribute_type);
+    att_iterator_add_uuid16(&it, GATT_PRIMARY_SERVICE_UUID);
+    att_iterator_add_uuid16(&it, GATT_SECONDARY_SERVICE_UUID);
     while (att_iterator_has_next(&it)){
         att_iterator_fetch_next(&it);
 
@@ -500,8 +839,8 @@ static uint16_t handle_find_by_type_value_request(att_connection_t * att_connect
         if (in_group &&
             ((it.handle == 0u) || att_iterator_match_uuid16(&it, GATT_PRIMARY_SERVICE_UUID) || att_iterator_match_uuid16(&it, GATT_SECONDARY_SERVICE_UUID))){
 
-            log_info("End of group, handle 0x%04x", prev_handle);
-            little_endian_store_16(response_buffer, offset, prev_handle);
+            log_info("End of group, handle 0x%04x", it.previous_handle);
+            little_endian_store_16(response_buffer, offset, it.previous_handle);
             offset += 2u;
             in_group = 0;
 
@@ -511,9 +850,6 @@ static uint16_t handle_find_by_type_value_request(att_connection_t * att_connect
             }
         }
 
-        // keep track of previous handle
-        prev_handle = it.handle;
-
         // does current attribute match
         if (it.handle && att_iterator_match_uuid16(&it, attribute_type) && (attribute_len == it.value_len) && (memcmp(attribute_value, it.value, it.value_len) == 0)){
             log_info("Begin of group, handle 0x%04x", it.handle);
@@ -550,7 +886,8 @@ static uint16_t handle_read_by_type_request2(att_connection_t * att_connection,
     uint16_t pair_len = 0;
 
     att_iterator_t it;
-    att_iterator_init(&it);
+    att_iterator_init_with_handle_range(&it, start_handle, end_handle);
+    att_iterator_add_uuid(&it, attribute_type, attribute_type_len);
     uint8_t error_code = 0;
     uint16_t first_matching_but_unreadable_handle = 0;
 
@@ -875,10 +1212,11 @@ static uint16_t handle_read_by_group_type_request2(att_connection_t * att_connec
     uint16_t in_group = 0;
     uint16_t group_start_handle = 0;
     uint8_t const * group_start_value = NULL;
-    uint16_t prev_handle = 0;
 
     att_iterator_t it;
-    att_iterator_init(&it);
+    att_iterator_init_with_handle_range(&it, start_handle, end_handle);
+    att_iterator_add_uuid16(&it, GATT_PRIMARY_SERVICE_UUID);
+    att_iterator_add_uuid16(&it, GATT_SECONDARY_SERVICE_UUID);
     while (att_iterator_has_next(&it)){
         att_iterator_fetch_next(&it);
         
@@ -890,11 +1228,11 @@ static uint16_t handle_read_by_group_type_request2(att_connection_t * att_connec
         // close current tag, if within a group and a new service definition starts or we reach end of att db
         if (in_group &&
             ((it.handle == 0u) || att_iterator_match_uuid16(&it, GATT_PRIMARY_SERVICE_UUID) || att_iterator_match_uuid16(&it, GATT_SECONDARY_SERVICE_UUID))){
-            // log_info("End of group, handle 0x%04x, val_len: %u", prev_handle, pair_len - 4);
+            // log_info("End of group, handle 0x%04x, val_len: %u", it.previous_handle, pair_len - 4);
             
             little_endian_store_16(response_buffer, offset, group_start_handle);
             offset += 2u;
-            little_endian_store_16(response_buffer, offset, prev_handle);
+            little_endian_store_16(response_buffer, offset, it.previous_handle);
             offset += 2u;
             (void)memcpy(response_buffer + offset, group_start_value,
                          pair_len - 4u);
@@ -907,9 +1245,6 @@ static uint16_t handle_read_by_group_type_request2(att_connection_t * att_connec
             }
         }
         
-        // keep track of previous handle
-        prev_handle = it.handle;
-        
         // does current attribute match
         // log_info("compare: %04x == %04x", *(uint16_t*) context->attribute_type, *(uint16_t*) uuid);
         if (it.handle && att_iterator_match_uuid(&it, attribute_type, attribute_type_len)) {
@@ -1225,7 +1560,6 @@ uint16_t att_handle_request(att_connection_t * att_connection,
 // returns 1 if service found. only primary service.
 bool gatt_server_get_get_handle_range_for_service_with_uuid16(uint16_t uuid16, uint16_t * start_handle, uint16_t * end_handle){
     uint16_t in_group    = 0;
-    uint16_t prev_handle = 0;
 
     uint8_t attribute_value[2];
     int attribute_len = sizeof(attribute_value);
@@ -1233,6 +1567,8 @@ bool gatt_server_get_get_handle_range_for_service_with_uuid16(uint16_t uuid16, u
 
     att_iterator_t it;
     att_iterator_init(&it);
+    att_iterator_add_uuid16(&it, GATT_PRIMARY_SERVICE_UUID);
+    att_iterator_add_uuid16(&it, GATT_SECONDARY_SERVICE_UUID);
     while (att_iterator_has_next(&it)){
         att_iterator_fetch_next(&it);
         int new_service_started = att_iterator_match_uuid16(&it, GATT_PRIMARY_SERVICE_UUID) || att_iterator_match_uuid16(&it, GATT_SECONDARY_SERVICE_UUID);
@@ -1240,13 +1576,10 @@ bool gatt_server_get_get_handle_range_for_service_with_uuid16(uint16_t uuid16, u
         // close current tag, if within a group and a new service definition starts or we reach end of att db
         if (in_group &&
             ((it.handle == 0u) || new_service_started)){
-            *end_handle = prev_handle;
+            *end_handle = it.previous_handle;
             return true;
         }
         
-        // keep track of previous handle
-        prev_handle = it.handle;
-        
         // check if found
         if (it.handle && new_service_started && (attribute_len == it.value_len) && (memcmp(attribute_value, it.value, it.value_len) == 0)){
             *start_handle = it.handle;
@@ -1259,7 +1592,8 @@ bool gatt_server_get_get_handle_range_for_service_with_uuid16(uint16_t uuid16, u
 // returns false if not found
 uint16_t gatt_server_get_value_handle_for_characteristic_with_uuid16(uint16_t start_handle, uint16_t end_handle, uint16_t uuid16){
     att_iterator_t it;
-    att_iterator_init(&it);
+    att_iterator_init_with_handle_range(&it, start_handle, end_handle);
+    att_iterator_add_uuid16(&it, uuid16);
     while (att_iterator_has_next(&it)){
         att_iterator_fetch_next(&it);
         if (it.handle && (it.handle < start_handle)) continue;
@@ -1272,7 +1606,7 @@ uint16_t gatt_server_get_value_handle_for_characteristic_with_uuid16(uint16_t st
 
 uint16_t gatt_server_get_descriptor_handle_for_characteristic_with_uuid16(uint16_t start_handle, uint16_t end_handle, uint16_t characteristic_uuid16, uint16_t descriptor_uuid16){
     att_iterator_t it;
-    att_iterator_init(&it);
+    att_iterator_init_with_handle_range(&it, start_handle, end_handle);
     int characteristic_found = 0;
     while (att_iterator_has_next(&it)){
         att_iterator_fetch_next(&it);
@@ -1309,7 +1643,6 @@ uint16_t gatt_server_get_server_configuration_handle_for_characteristic_with_uui
 // returns 1 if service found. only primary service.
 int gatt_server_get_get_handle_range_for_service_with_uuid128(const uint8_t * uuid128, uint16_t * start_handle, uint16_t * end_handle){
     uint16_t in_group    = 0;
-    uint16_t prev_handle = 0;
 
     uint8_t attribute_value[16];
     int attribute_len = sizeof(attribute_value);
@@ -1317,6 +1650,8 @@ int gatt_server_get_get_handle_range_for_service_with_uuid128(const uint8_t * uu
 
     att_iterator_t it;
     att_iterator_init(&it);
+    att_iterator_add_uuid16(&it, GATT_PRIMARY_SERVICE_UUID);
+    att_iterator_add_uuid16(&it, GATT_SECONDARY_SERVICE_UUID);
     while (att_iterator_has_next(&it)){
         att_iterator_fetch_next(&it);
         int new_service_started = att_iterator_match_uuid16(&it, GATT_PRIMARY_SERVICE_UUID) || att_iterator_match_uuid16(&it, GATT_SECONDARY_SERVICE_UUID);
@@ -1324,13 +1659,10 @@ int gatt_server_get_get_handle_range_for_service_with_uuid128(const uint8_t * uu
         // close current tag, if within a group and a new service definition starts or we reach end of att db
         if (in_group &&
             ((it.handle == 0u) || new_service_started)){
-            *end_handle = prev_handle;
+            *end_handle = it.previous_handle;
             return 1;
         }
         
-        // keep track of previous handle
-        prev_handle = it.handle;
-        
         // check if found
         if (it.handle && new_service_started && (attribute_len == it.value_len) && (memcmp(attribute_value, it.value, it.value_len) == 0)){
             *start_handle = it.handle;
@@ -1345,7 +1677,8 @@ uint16_t gatt_server_get_value_handle_for_characteristic_with_uuid128(uint16_t s
     uint8_t attribute_value[16];
     reverse_128(uuid128, attribute_value);
     att_iterator_t it;
-    att_iterator_init(&it);
+    att_iterator_init_with_handle_range(&it, start_handle, end_handle);
+    att_iterator_add_uuid(&it, attribute_value, 16);
     while (att_iterator_has_next(&it)){
         att_iterator_fetch_next(&it);
         if (it.handle && (it.handle < start_handle)) continue;
@@ -1361,7 +1694,7 @@ uint16_t gatt_server_get_client_configuration_handle_for_characteristic_with_uui
     uint8_t attribute_value[16];
     reverse_128(uuid128, attribute_value);
     att_iterator_t it;
-    att_iterator_init(&it);
+    att_iterator_init_with_handle_range(&it, start_handle, end_handle);
     int characteristic_found = 0;
     while (att_iterator_has_next(&it)){
         att_iterator_fetch_next(&it);
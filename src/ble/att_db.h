@@ -162,6 +162,29 @@ typedef struct att_service_handler {
  */
 void att_set_db(uint8_t const * db);
 
+/*
+ * @brief get number of uint16_t entries required to index ATT database
+ * @param db
+ * @returns buffer len, or 0 if db cannot be indexed
+ */
+uint32_t att_db_index_get_buffer_len(uint8_t const * db);
+
+/*
+ * @brief provide buffer for ATT database index used for handle and UUID lookups, requires ENABLE_ATT_DB_INDEX
+ * @note  the index is built by att_set_db, att_set_db needs to be called again after the database was modified
+ * @param buffer
+ * @param buffer_len in uint16_t entries, see att_db_index_get_buffer_len
+ */
+void att_set_db_index_buffer(uint16_t * buffer, uint32_t buffer_len);
+
+/*
+ * @brief use ATT database index generated by compile_gatt.py --index, requires ENABLE_ATT_DB_INDEX
+ * @note  index can be placed in ROM, it needs to be generated together with the ATT database. It is verified by att_set_db and ignored if it does not match
+ * @param index e.g. profile_data_index
+ * @param index_len in uint16_t entries, e.g. sizeof(profile_data_index) / sizeof(uint16_t)
+ */
+void att_set_db_index(const uint16_t * index, uint32_t index_len);
+
 /*
  * @brief set callback for read of dynamic attributes
  * @param callback
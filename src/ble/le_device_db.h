@@ -95,6 +95,12 @@ int le_device_db_count(void);
  */
 int le_device_db_max_count(void);
 
+/**
+ * @brief get generation counter, changes whenever devices are added or removed
+ * @returns generation counter
+ */
+uint32_t le_device_db_generation_get(void);
+
 /**
  * @brief get device information: addr type and address needed to identify device
  * @param index
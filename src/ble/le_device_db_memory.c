@@ -82,6 +82,7 @@ typedef struct le_device_memory_db {
 #endif
 
 static le_device_memory_db_t le_devices[MAX_NR_LE_DEVICE_DB_ENTRIES];
+static uint32_t le_device_db_generation;
 
 void le_device_db_init(void){
     int i;
@@ -108,9 +109,14 @@ int le_device_db_max_count(void){
     return MAX_NR_LE_DEVICE_DB_ENTRIES;
 }
 
+uint32_t le_device_db_generation_get(void){
+    return le_device_db_generation;
+}
+
 // free device
 void le_device_db_remove(int index){
     le_devices[index].addr_type = BD_ADDR_TYPE_UNKNOWN;
+    le_device_db_generation++;
 }
 
 int le_device_db_add(int addr_type, bd_addr_t addr, sm_key_t irk){
@@ -134,6 +140,7 @@ int le_device_db_add(int addr_type, bd_addr_t addr, sm_key_t irk){
 #ifdef ENABLE_LE_SIGNED_WRITE
     le_devices[index].remote_counter = 0; 
 #endif
+    le_device_db_generation++;
     return index;
 }
 
@@ -96,6 +96,7 @@ typedef struct le_device_db_entry_t {
 // only stores if entry present
 static uint8_t  entry_map[NVM_NUM_DEVICE_DB_ENTRIES];
 static uint32_t num_valid_entries;
+static uint32_t le_device_db_generation;
 
 static const btstack_tlv_t * le_device_db_tlv_btstack_tlv_impl;
 static       void *          le_device_db_tlv_btstack_tlv_context;
@@ -179,6 +180,10 @@ int le_device_db_max_count(void){
     return NVM_NUM_DEVICE_DB_ENTRIES;
 }
 
+uint32_t le_device_db_generation_get(void){
+    return le_device_db_generation;
+}
+
 void le_device_db_remove(int index){
     // check if entry exists
     if (entry_map[index] == 0u) return; 
@@ -191,6 +196,7 @@ void le_device_db_remove(int index){
 
     // keep track
     num_valid_entries--;
+    le_device_db_generation++;
 }
 
 int le_device_db_add(int addr_type, bd_addr_t addr, sm_key_t irk){
@@ -269,6 +275,7 @@ int le_device_db_add(int addr_type, bd_addr_t addr, sm_key_t irk){
     if (index_for_addr < 0){
         num_valid_entries++;
     }
+    le_device_db_generation++;
 
     return index_to_use;
 }
@@ -470,4 +477,5 @@ void le_device_db_tlv_configure(const btstack_tlv_t * btstack_tlv_impl, void * b
 	le_device_db_tlv_btstack_tlv_impl = btstack_tlv_impl;
 	le_device_db_tlv_btstack_tlv_context = btstack_tlv_context;
     le_device_db_tlv_scan();
+    le_device_db_generation++;
 }
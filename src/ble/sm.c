@@ -171,6 +171,30 @@ typedef uint8_t sm_key24_t[3];
 typedef uint8_t sm_key56_t[7];
 typedef uint8_t sm_key256_t[32];
 
+// with software AES128, ah() is evaluated for all IRKs in a single pass
+#if defined(ENABLE_SOFTWARE_AES128) || defined(HAVE_AES128)
+#define USE_SM_ADDRESS_RESOLUTION_BATCH
+#endif
+
+#ifdef ENABLE_SM_ADDRESS_RESOLUTION_CACHE
+#ifndef SM_ADDRESS_RESOLUTION_CACHE_SIZE
+#define SM_ADDRESS_RESOLUTION_CACHE_SIZE 16
+#endif
+// RPA rotation period, recommended value is 15 minutes
+#ifndef SM_ADDRESS_RESOLUTION_CACHE_TIMEOUT_MS
+#define SM_ADDRESS_RESOLUTION_CACHE_TIMEOUT_MS (15 * 60 * 1000)
+#endif
+
+// result of address resolution for RPA, le_db_index is -1 if no IRK matched
+typedef struct {
+    bd_addr_t address;
+    int16_t   le_db_index;
+    uint32_t  le_db_generation;
+    uint32_t  resolved_ms;
+    uint32_t  last_used;
+} sm_address_resolution_cache_entry_t;
+#endif
+
 //
 // GLOBAL DATA
 //
@@ -251,6 +275,11 @@ static void *    sm_address_resolution_context;
 static address_resolution_mode_t sm_address_resolution_mode;
 static btstack_linked_list_t sm_address_resolution_general_queue;
 
+#ifdef ENABLE_SM_ADDRESS_RESOLUTION_CACHE
+static sm_address_resolution_cache_entry_t sm_address_resolution_cache[SM_ADDRESS_RESOLUTION_CACHE_SIZE];
+static uint32_t sm_address_resolution_cache_use_counter;
+#endif
+
 // aes128 crypto engine.
 static sm_aes128_state_t  sm_aes128_state;
 
@@ -263,7 +292,9 @@ static btstack_crypto_ecc_p256_t sm_crypto_ecc_p256_request;
 
 // temp storage for random data
 static uint8_t sm_random_data[8];
+#ifndef USE_SM_ADDRESS_RESOLUTION_BATCH
 static uint8_t sm_aes128_key[16];
+#endif
 static uint8_t sm_aes128_plaintext[16];
 static uint8_t sm_aes128_ciphertext[16];
 
@@ -382,7 +413,10 @@ static void sm_done_for_handle(hci_con_handle_t con_handle);
 static sm_connection_t * sm_get_connection_for_handle(hci_con_handle_t con_handle);
 static inline int sm_calc_actual_encryption_key_size(int other);
 static int sm_validate_stk_generation_method(void);
+#ifndef USE_SM_ADDRESS_RESOLUTION_BATCH
 static void sm_handle_encryption_result_address_resolution(void *arg);
+#endif
+static void sm_address_resolution_handle_event(address_resolution_event_t event);
 static void sm_handle_encryption_result_dkg_dhk(void *arg);
 static void sm_handle_encryption_result_dkg_irk(void *arg);
 static void sm_handle_encryption_result_enc_a(void *arg);
@@ -848,6 +882,60 @@ static int sm_address_resolution_idle(void){
     return sm_address_resolution_mode == ADDRESS_RESOLUTION_IDLE;
 }
 
+#ifdef ENABLE_SM_ADDRESS_RESOLUTION_CACHE
+static bool sm_address_resolution_is_rpa(uint8_t addr_type, const bd_addr_t addr){
+    return (addr_type == BD_ADDR_TYPE_LE_RANDOM) && ((addr[0] & 0xc0u) == 0x40u);
+}
+
+// @return entry for address if it was resolved within RPA rotation period and le_device_db didn't change
+static sm_address_resolution_cache_entry_t * sm_address_resolution_cache_get(const bd_addr_t addr){
+    uint32_t now = btstack_run_loop_get_time_ms();
+    int i;
+    for (i = 0; i < SM_ADDRESS_RESOLUTION_CACHE_SIZE; i++){
+        sm_address_resolution_cache_entry_t * entry = &sm_address_resolution_cache[i];
+        if (entry->last_used == 0u) continue;
+        if (memcmp(entry->address, addr, 6) != 0) continue;
+        if (((now - entry->resolved_ms) >= SM_ADDRESS_RESOLUTION_CACHE_TIMEOUT_MS) || (entry->le_db_generation != le_device_db_generation_get())){
+            entry->last_used = 0;
+            return NULL;
+        }
+        entry->last_used = ++sm_address_resolution_cache_use_counter;
+        return entry;
+    }
+    return NULL;
+}
+
+static void sm_address_resolution_cache_add(const bd_addr_t addr, int le_db_index){
+    sm_address_resolution_cache_entry_t * entry = &sm_address_resolution_cache[0];
+    bool found = false;
+    int i;
+    for (i = 0; i < SM_ADDRESS_RESOLUTION_CACHE_SIZE; i++){
+        sm_address_resolution_cache_entry_t * candidate = &sm_address_resolution_cache[i];
+        if ((candidate->last_used != 0u) && (memcmp(candidate->address, addr, 6) == 0)){
+            entry = candidate;
+            found = true;
+            break;
+        }
+        // free or least recently used entry
+        if (candidate->last_used < entry->last_used){
+            entry = candidate;
+        }
+    }
+    // keep resolution time of existing entry
+    if (!found){
+        (void)memcpy(entry->address, addr, 6);
+        entry->resolved_ms = btstack_run_loop_get_time_ms();
+    }
+    entry->le_db_index      = (int16_t) le_db_index;
+    entry->le_db_generation = le_device_db_generation_get();
+    entry->last_used        = ++sm_address_resolution_cache_use_counter;
+}
+
+static void sm_address_resolution_cache_flush(void){
+    memset(sm_address_resolution_cache, 0, sizeof(sm_address_resolution_cache));
+}
+#endif
+
 static void sm_address_resolution_start_lookup(uint8_t addr_type, hci_con_handle_t con_handle, bd_addr_t addr, address_resolution_mode_t mode, void * context){
     (void)memcpy(sm_address_resolution_address, addr, 6);
     sm_address_resolution_addr_type = addr_type;
@@ -855,6 +943,18 @@ static void sm_address_resolution_start_lookup(uint8_t addr_type, hci_con_handle
     sm_address_resolution_mode = mode;
     sm_address_resolution_context = context;
     sm_notify_client_base(SM_EVENT_IDENTITY_RESOLVING_STARTED, con_handle, addr_type, addr);
+#ifdef ENABLE_SM_ADDRESS_RESOLUTION_CACHE
+    if (!sm_address_resolution_is_rpa(addr_type, addr)) return;
+    const sm_address_resolution_cache_entry_t * entry = sm_address_resolution_cache_get(addr);
+    if (entry == NULL) return;
+    log_info("LE Device Lookup: cached result %d", entry->le_db_index);
+    if (entry->le_db_index >= 0){
+        sm_address_resolution_test = entry->le_db_index;
+        sm_address_resolution_handle_event(ADDRESS_RESOLUTION_SUCEEDED);
+    } else {
+        sm_address_resolution_handle_event(ADDRESS_RESOLUTION_FAILED);
+    }
+#endif
 }
 
 int sm_address_resolution_lookup(uint8_t address_type, bd_addr_t address){
@@ -1159,6 +1259,12 @@ static void sm_address_resolution_handle_event(address_resolution_event_t event)
     address_resolution_mode_t mode = sm_address_resolution_mode;
     void * context = sm_address_resolution_context;
 
+#ifdef ENABLE_SM_ADDRESS_RESOLUTION_CACHE
+    if (sm_address_resolution_is_rpa(sm_address_resolution_addr_type, sm_address_resolution_address)){
+        sm_address_resolution_cache_add(sm_address_resolution_address, (event == ADDRESS_RESOLUTION_SUCEEDED) ? matched_device_id : -1);
+    }
+#endif
+
     // reset context
     sm_address_resolution_mode = ADDRESS_RESOLUTION_IDLE;
     sm_address_resolution_context = NULL;
@@ -1307,6 +1413,11 @@ static void sm_key_distribution_handle_all_received(sm_connection_t * sm_conn){
             le_db_index = le_device_db_add(setup->sm_peer_addr_type, setup->sm_peer_address, setup->sm_peer_irk);
         }
 
+#ifdef ENABLE_SM_ADDRESS_RESOLUTION_CACHE
+        // IRK added or updated, cached results might be wrong
+        sm_address_resolution_cache_flush();
+#endif
+
         if (le_db_index >= 0){
 
             sm_notify_client_index(SM_EVENT_IDENTITY_CREATED, sm_conn->sm_handle, setup->sm_peer_addr_type, setup->sm_peer_address, le_db_index);
@@ -1908,9 +2019,9 @@ static bool sm_run_csrk(void){
             hci_connection_t * hci_connection = (hci_connection_t *) btstack_linked_list_iterator_next(&it);
             sm_connection_t  * sm_connection  = &hci_connection->sm_connection;
             if (sm_connection->sm_irk_lookup_state == IRK_LOOKUP_W4_READY){
-                // and start lookup
-                sm_address_resolution_start_lookup(sm_connection->sm_peer_addr_type, sm_connection->sm_handle, sm_connection->sm_peer_address, ADDRESS_RESOLUTION_FOR_CONNECTION, sm_connection);
+                // and start lookup, cached result might complete it right away
                 sm_connection->sm_irk_lookup_state = IRK_LOOKUP_STARTED;
+                sm_address_resolution_start_lookup(sm_connection->sm_peer_addr_type, sm_connection->sm_handle, sm_connection->sm_peer_address, ADDRESS_RESOLUTION_FOR_CONNECTION, sm_connection);
                 break;
             }
         }
@@ -1929,6 +2040,10 @@ static bool sm_run_csrk(void){
     // -- Continue with CSRK device lookup by public or resolvable private address
     if (!sm_address_resolution_idle()){
         log_info("LE Device Lookup: device %u/%u", sm_address_resolution_test, le_device_db_max_count());
+#ifdef USE_SM_ADDRESS_RESOLUTION_BATCH
+        sm_key_t r_prime;
+        sm_ah_r_prime(sm_address_resolution_address, r_prime);
+#endif
         while (sm_address_resolution_test < le_device_db_max_count()){
             int addr_type = BD_ADDR_TYPE_UNKNOWN;
             bd_addr_t addr;
@@ -1954,6 +2069,17 @@ static bool sm_run_csrk(void){
                 continue;
             }
 
+#ifdef USE_SM_ADDRESS_RESOLUTION_BATCH
+            // calculate AH synchronously and continue with next device
+            sm_key_t hash;
+            btstack_aes128_calc(irk, r_prime, hash);
+            if (memcmp(&sm_address_resolution_address[3], &hash[13], 3) == 0){
+                log_info("LE Device Lookup: matched resolvable private address");
+                sm_address_resolution_handle_event(ADDRESS_RESOLUTION_SUCEEDED);
+                break;
+            }
+            sm_address_resolution_test++;
+#else
             if (sm_aes128_state == SM_AES128_ACTIVE) break;
 
             log_info("LE Device Lookup: calculate AH");
@@ -1965,6 +2091,7 @@ static bool sm_run_csrk(void){
             sm_aes128_state = SM_AES128_ACTIVE;
             btstack_crypto_aes128_encrypt(&sm_crypto_aes128_request, sm_aes128_key, sm_aes128_plaintext, sm_aes128_ciphertext, sm_handle_encryption_result_address_resolution, NULL);
             return true;
+#endif
         }
 
         if (sm_address_resolution_test >= le_device_db_max_count()){
@@ -2931,6 +3058,7 @@ static void sm_handle_encryption_result_enc_ph4_ltk(void *arg){
 }
 #endif
 
+#ifndef USE_SM_ADDRESS_RESOLUTION_BATCH
 static void sm_handle_encryption_result_address_resolution(void *arg){
     UNUSED(arg);
     sm_aes128_state = SM_AES128_IDLE;
@@ -2948,6 +3076,7 @@ static void sm_handle_encryption_result_address_resolution(void *arg){
     sm_address_resolution_test++;
     sm_run();
 }
+#endif
 
 static void sm_handle_encryption_result_dkg_irk(void *arg){
     UNUSED(arg);
@@ -4092,6 +4221,9 @@ void sm_init(void){
     sm_address_resolution_ah_calculation_active = 0;
     sm_address_resolution_mode = ADDRESS_RESOLUTION_IDLE;
     sm_address_resolution_general_queue = NULL;
+#ifdef ENABLE_SM_ADDRESS_RESOLUTION_CACHE
+    sm_address_resolution_cache_flush();
+#endif
 
     gap_random_adress_update_period = 15 * 60 * 1000L;
     sm_active_connection_handle = HCI_CON_HANDLE_INVALID;
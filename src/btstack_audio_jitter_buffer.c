@@ -0,0 +1,178 @@
+/*
+ * Copyright (C) 2020 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHIAS
+ * RINGWALD OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+#define BTSTACK_FILE__ "btstack_audio_jitter_buffer.c"
+
+/*
+ *  btstack_audio_jitter_buffer.c
+ *
+ */
+
+#include <stddef.h>
+
+#include "btstack_audio_jitter_buffer.h"
+
+#include "bluetooth.h"
+
+// controller is tuned for one read every few milliseconds, e.g. 128 audio frames per SBC frame at 44.1 kHz
+
+// fill level average over 256 reads
+#define FILL_LEVEL_AVERAGE_SHIFT 8
+// proportional term: compensation per frame deviation from target
+#define CONTROLLER_KP            32
+// integral term: compensation per accumulated deviation
+#define CONTROLLER_KI_SHIFT      15
+
+#define FILL_LEVEL_ERROR_SUM_MAX (BTSTACK_AUDIO_JITTER_BUFFER_MAX_COMPENSATION << CONTROLLER_KI_SHIFT)
+
+static int32_t btstack_audio_jitter_buffer_clamp(int32_t value, int32_t limit){
+    if (value >  limit) return  limit;
+    if (value < -limit) return -limit;
+    return value;
+}
+
+void btstack_audio_jitter_buffer_init(btstack_audio_jitter_buffer_t * jitter_buffer, uint8_t * storage, uint32_t storage_size, uint16_t target_frames){
+    btstack_ring_buffer_init(&jitter_buffer->ring_buffer, storage, storage_size);
+    jitter_buffer->resample = NULL;
+    jitter_buffer->frame_size = 0;
+    jitter_buffer->target_frames = target_frames;
+    jitter_buffer->started = false;
+    jitter_buffer->fill_level_average = target_frames << 8;
+    jitter_buffer->fill_level_error_sum = 0;
+    jitter_buffer->resampling_factor = 0x10000;
+    jitter_buffer->num_underruns = 0;
+    jitter_buffer->num_frames_dropped = 0;
+}
+
+void btstack_audio_jitter_buffer_set_resample(btstack_audio_jitter_buffer_t * jitter_buffer, btstack_resample_t * resample){
+    jitter_buffer->resample = resample;
+    if (resample != NULL){
+        btstack_resample_set_factor(resample, jitter_buffer->resampling_factor);
+    }
+}
+
+void btstack_audio_jitter_buffer_set_frame_size(btstack_audio_jitter_buffer_t * jitter_buffer, uint16_t frame_size){
+    if (frame_size == jitter_buffer->frame_size) return;
+    jitter_buffer->frame_size = frame_size;
+    btstack_audio_jitter_buffer_reset(jitter_buffer);
+}
+
+void btstack_audio_jitter_buffer_reset(btstack_audio_jitter_buffer_t * jitter_buffer){
+    btstack_ring_buffer_init(&jitter_buffer->ring_buffer, jitter_buffer->ring_buffer.storage, jitter_buffer->ring_buffer.size);
+    jitter_buffer->started = false;
+}
+
+uint16_t btstack_audio_jitter_buffer_frames_available(btstack_audio_jitter_buffer_t * jitter_buffer){
+    if (jitter_buffer->frame_size == 0) return 0;
+    return btstack_ring_buffer_bytes_available(&jitter_buffer->ring_buffer) / jitter_buffer->frame_size;
+}
+
+int btstack_audio_jitter_buffer_write(btstack_audio_jitter_buffer_t * jitter_buffer, const uint8_t * frames, uint16_t num_frames){
+    if (jitter_buffer->frame_size == 0) return ERROR_CODE_COMMAND_DISALLOWED;
+
+    // store as many frames as possible, drop the rest
+    uint32_t frames_free = btstack_ring_buffer_bytes_free(&jitter_buffer->ring_buffer) / jitter_buffer->frame_size;
+    uint16_t frames_to_store = (num_frames < frames_free) ? num_frames : (uint16_t) frames_free;
+    if (frames_to_store > 0){
+        btstack_ring_buffer_write(&jitter_buffer->ring_buffer, (uint8_t *) frames, frames_to_store * jitter_buffer->frame_size);
+    }
+
+    // start playback at target fill level
+    if (!jitter_buffer->started && (btstack_audio_jitter_buffer_frames_available(jitter_buffer) >= jitter_buffer->target_frames)){
+        jitter_buffer->started = true;
+        jitter_buffer->fill_level_average = jitter_buffer->target_frames << 8;
+    }
+
+    if (frames_to_store < num_frames){
+        jitter_buffer->num_frames_dropped += num_frames - frames_to_store;
+        return ERROR_CODE_MEMORY_CAPACITY_EXCEEDED;
+    }
+    return ERROR_CODE_SUCCESS;
+}
+
+// PI controller on averaged fill level, the integral term converges to the source/sink clock ratio
+static void btstack_audio_jitter_buffer_update_resampling_factor(btstack_audio_jitter_buffer_t * jitter_buffer, uint16_t frames_available){
+    int32_t fill_level = ((int32_t) frames_available) << 8;
+    jitter_buffer->fill_level_average += (fill_level - jitter_buffer->fill_level_average) >> FILL_LEVEL_AVERAGE_SHIFT;
+
+    int32_t error = jitter_buffer->fill_level_average - (((int32_t) jitter_buffer->target_frames) << 8);
+    jitter_buffer->fill_level_error_sum = btstack_audio_jitter_buffer_clamp(jitter_buffer->fill_level_error_sum + error, FILL_LEVEL_ERROR_SUM_MAX);
+
+    int32_t compensation = ((error * CONTROLLER_KP) >> 8) + (jitter_buffer->fill_level_error_sum >> CONTROLLER_KI_SHIFT);
+    compensation = btstack_audio_jitter_buffer_clamp(compensation, BTSTACK_AUDIO_JITTER_BUFFER_MAX_COMPENSATION);
+
+    uint32_t resampling_factor = (uint32_t) (0x10000 + compensation);
+    if (resampling_factor == jitter_buffer->resampling_factor) return;
+    jitter_buffer->resampling_factor = resampling_factor;
+    if (jitter_buffer->resample != NULL){
+        btstack_resample_set_factor(jitter_buffer->resample, resampling_factor);
+    }
+}
+
+bool btstack_audio_jitter_buffer_read(btstack_audio_jitter_buffer_t * jitter_buffer, uint8_t * frame){
+    if (!jitter_buffer->started) return false;
+
+    uint16_t frames_available = btstack_audio_jitter_buffer_frames_available(jitter_buffer);
+    if (frames_available == 0){
+        // underrun, wait for target fill level again
+        jitter_buffer->started = false;
+        jitter_buffer->num_underruns++;
+        return false;
+    }
+
+    btstack_audio_jitter_buffer_update_resampling_factor(jitter_buffer, frames_available);
+
+    uint32_t bytes_read;
+    btstack_ring_buffer_read(&jitter_buffer->ring_buffer, frame, jitter_buffer->frame_size, &bytes_read);
+    return true;
+}
+
+bool btstack_audio_jitter_buffer_is_started(btstack_audio_jitter_buffer_t * jitter_buffer){
+    return jitter_buffer->started;
+}
+
+uint32_t btstack_audio_jitter_buffer_get_resampling_factor(btstack_audio_jitter_buffer_t * jitter_buffer){
+    return jitter_buffer->resampling_factor;
+}
+
+uint32_t btstack_audio_jitter_buffer_get_num_underruns(btstack_audio_jitter_buffer_t * jitter_buffer){
+    return jitter_buffer->num_underruns;
+}
+
+uint32_t btstack_audio_jitter_buffer_get_num_frames_dropped(btstack_audio_jitter_buffer_t * jitter_buffer){
+    return jitter_buffer->num_frames_dropped;
+}
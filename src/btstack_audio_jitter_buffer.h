@@ -0,0 +1,171 @@
+/*
+ * Copyright (C) 2020 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHIAS
+ * RINGWALD OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+#ifndef BTSTACK_AUDIO_JITTER_BUFFER_H
+#define BTSTACK_AUDIO_JITTER_BUFFER_H
+
+#include <stdint.h>
+
+#include "btstack_bool.h"
+#include "btstack_resample.h"
+#include "btstack_ring_buffer.h"
+
+#if defined __cplusplus
+extern "C" {
+#endif
+
+/*
+ *  btstack_audio_jitter_buffer.h
+ *
+ *  Jitter buffer for fixed-size audio frames, e.g. SBC frames or blocks of decoded PCM samples.
+ *
+ *  Playback starts once the target number of frames has been buffered. After that, the fill level is
+ *  averaged on every read and the ratio between source and sink clock is estimated by a
+ *  proportional-integral controller. The resulting resampling factor keeps the fill level at the
+ *  target and is applied to an optional btstack_resample_t instance.
+ *
+ *  Reads are expected at a regular rate from the playback callback, writes can arrive in bursts.
+ *  After an underrun, playback is paused until the target number of frames is available again,
+ *  the clock ratio estimate is kept.
+ */
+
+// max deviation of resampling factor from 1.0 (0x10000), ~0.8%
+#define BTSTACK_AUDIO_JITTER_BUFFER_MAX_COMPENSATION 0x200
+
+typedef struct {
+    btstack_ring_buffer_t ring_buffer;
+    btstack_resample_t *  resample;
+    uint16_t frame_size;
+    uint16_t target_frames;
+    bool     started;
+    // fill level in frames, exponential moving average, Q8
+    int32_t  fill_level_average;
+    // accumulated deviation from target, Q8
+    int32_t  fill_level_error_sum;
+    uint32_t resampling_factor;
+    // statistics
+    uint32_t num_underruns;
+    uint32_t num_frames_dropped;
+} btstack_audio_jitter_buffer_t;
+
+/**
+ * @brief Init jitter buffer
+ * @param jitter_buffer
+ * @param storage for frames
+ * @param storage_size in bytes
+ * @param target_frames number of frames buffered before playback starts, sets latency
+ */
+void btstack_audio_jitter_buffer_init(btstack_audio_jitter_buffer_t * jitter_buffer, uint8_t * storage, uint32_t storage_size, uint16_t target_frames);
+
+/**
+ * @brief Set resampler that gets configured with the estimated resampling factor
+ * @param jitter_buffer
+ * @param resample instance or NULL
+ */
+void btstack_audio_jitter_buffer_set_resample(btstack_audio_jitter_buffer_t * jitter_buffer, btstack_resample_t * resample);
+
+/**
+ * @brief Set size of a single frame, drops buffered frames if the frame size changes
+ * @param jitter_buffer
+ * @param frame_size in bytes
+ */
+void btstack_audio_jitter_buffer_set_frame_size(btstack_audio_jitter_buffer_t * jitter_buffer, uint16_t frame_size);
+
+/**
+ * @brief Drop all buffered frames and wait for target number of frames before playback starts again
+ * @note keeps clock ratio estimate
+ * @param jitter_buffer
+ */
+void btstack_audio_jitter_buffer_reset(btstack_audio_jitter_buffer_t * jitter_buffer);
+
+/**
+ * @brief Store received frames
+ * @param jitter_buffer
+ * @param frames
+ * @param num_frames
+ * @return 0 if ok, ERROR_CODE_MEMORY_CAPACITY_EXCEEDED if frames were dropped
+ */
+int btstack_audio_jitter_buffer_write(btstack_audio_jitter_buffer_t * jitter_buffer, const uint8_t * frames, uint16_t num_frames);
+
+/**
+ * @brief Get next frame for playback and update resampling factor
+ * @param jitter_buffer
+ * @param frame buffer of frame_size bytes
+ * @return true if frame was read, false if playback has not started yet or on underrun
+ */
+bool btstack_audio_jitter_buffer_read(btstack_audio_jitter_buffer_t * jitter_buffer, uint8_t * frame);
+
+/**
+ * @brief Get number of buffered frames
+ * @param jitter_buffer
+ * @return num frames
+ */
+uint16_t btstack_audio_jitter_buffer_frames_available(btstack_audio_jitter_buffer_t * jitter_buffer);
+
+/**
+ * @brief Check if target number of frames has been buffered and playback can start
+ * @param jitter_buffer
+ * @return true if started
+ */
+bool btstack_audio_jitter_buffer_is_started(btstack_audio_jitter_buffer_t * jitter_buffer);
+
+/**
+ * @brief Get current resampling factor, 0x10000 for equal source and sink clock
+ * @param jitter_buffer
+ * @return resampling factor in 16.16 fixed point
+ */
+uint32_t btstack_audio_jitter_buffer_get_resampling_factor(btstack_audio_jitter_buffer_t * jitter_buffer);
+
+/**
+ * @brief Get number of underruns since init
+ * @param jitter_buffer
+ * @return num underruns
+ */
+uint32_t btstack_audio_jitter_buffer_get_num_underruns(btstack_audio_jitter_buffer_t * jitter_buffer);
+
+/**
+ * @brief Get number of frames dropped as buffer was full since init
+ * @param jitter_buffer
+ * @return num frames
+ */
+uint32_t btstack_audio_jitter_buffer_get_num_frames_dropped(btstack_audio_jitter_buffer_t * jitter_buffer);
+
+#if defined __cplusplus
+}
+#endif
+
+#endif // BTSTACK_AUDIO_JITTER_BUFFER_H
@@ -60,6 +60,11 @@
 #ifdef ENABLE_SOFTWARE_AES128
 #define HAVE_AES128
 #include "rijndael.h"
+// use AES-NI on x86_64 if enabled by compiler, e.g. -maes or -march=native
+#if defined(__x86_64__) && defined(__AES__)
+#define USE_AES_NI
+#include <wmmintrin.h>
+#endif
 #endif
 
 #ifdef HAVE_AES128
@@ -132,6 +137,14 @@ static btstack_linked_list_t btstack_crypto_operations;
 static btstack_packet_callback_registration_t hci_event_callback_registration;
 static uint8_t btstack_crypto_wait_for_hci_result;
 
+// HCI LE Encrypt commands in flight, up to HCI_NUM_CMD_PACKETS_MAX for different operations
+// Command Complete events are received in order
+#ifndef USE_BTSTACK_AES128
+static btstack_crypto_t * btstack_crypto_le_encrypt_in_flight[HCI_NUM_CMD_PACKETS_MAX];
+static uint8_t btstack_crypto_le_encrypt_in_flight_pos;
+static uint8_t btstack_crypto_le_encrypt_in_flight_count;
+#endif
+
 // state for AES-CMAC
 #ifndef USE_BTSTACK_AES128
 static btstack_crypto_cmac_state_t btstack_crypto_cmac_state;
@@ -165,16 +178,86 @@ static mbedtls_ecp_group   mbedtls_ec_group;
 #endif /* ENABLE_ECC_P256 */
 
 #ifdef ENABLE_SOFTWARE_AES128
-// AES128 using public domain rijndael implementation
+
+#ifdef USE_AES_NI
+// AES128 using AES-NI instructions, round keys are stored unaligned in key schedule
+static __m128i btstack_crypto_aes128_expand_round_key(__m128i key, __m128i key_gen){
+    key_gen = _mm_shuffle_epi32(key_gen, 0xff);
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    return _mm_xor_si128(key, key_gen);
+}
+
+#define AES128_EXPAND_ROUND_KEY(ROUND, RCON) \
+    rk[ROUND] = btstack_crypto_aes128_expand_round_key(rk[ROUND-1], _mm_aeskeygenassist_si128(rk[ROUND-1], RCON))
+
+static void btstack_crypto_aes128_setup_key(btstack_crypto_aes128_key_schedule_t * key_schedule, const uint8_t * key){
+    __m128i rk[11];
+    rk[0] = _mm_loadu_si128((const __m128i *) key);
+    AES128_EXPAND_ROUND_KEY( 1, 0x01);
+    AES128_EXPAND_ROUND_KEY( 2, 0x02);
+    AES128_EXPAND_ROUND_KEY( 3, 0x04);
+    AES128_EXPAND_ROUND_KEY( 4, 0x08);
+    AES128_EXPAND_ROUND_KEY( 5, 0x10);
+    AES128_EXPAND_ROUND_KEY( 6, 0x20);
+    AES128_EXPAND_ROUND_KEY( 7, 0x40);
+    AES128_EXPAND_ROUND_KEY( 8, 0x80);
+    AES128_EXPAND_ROUND_KEY( 9, 0x1b);
+    AES128_EXPAND_ROUND_KEY(10, 0x36);
+    (void)memcpy(key_schedule->round_keys, rk, sizeof(rk));
+}
+
+static void btstack_crypto_aes128_encrypt_block(const btstack_crypto_aes128_key_schedule_t * key_schedule, const uint8_t * plaintext, uint8_t * ciphertext){
+    const __m128i * rk = (const __m128i *) key_schedule->round_keys;
+    __m128i block = _mm_xor_si128(_mm_loadu_si128((const __m128i *) plaintext), _mm_loadu_si128(&rk[0]));
+    int round;
+    for (round = 1; round < 10; round++){
+        block = _mm_aesenc_si128(block, _mm_loadu_si128(&rk[round]));
+    }
+    block = _mm_aesenclast_si128(block, _mm_loadu_si128(&rk[10]));
+    _mm_storeu_si128((__m128i *) ciphertext, block);
+}
+#else
+// AES128 using public domain rijndael implementation with T-tables
+static void btstack_crypto_aes128_setup_key(btstack_crypto_aes128_key_schedule_t * key_schedule, const uint8_t * key){
+    (void) rijndaelSetupEncrypt(key_schedule->round_keys, key, KEYBITS);
+}
+
+static void btstack_crypto_aes128_encrypt_block(const btstack_crypto_aes128_key_schedule_t * key_schedule, const uint8_t * plaintext, uint8_t * ciphertext){
+    rijndaelEncrypt(key_schedule->round_keys, NROUNDS(KEYBITS), plaintext, ciphertext);
+}
+#endif
+
+// CMAC and CCM use the same key for all blocks, only expand key if it differs from the one in the key schedule
+static void btstack_crypto_aes128_calc_with_key_schedule(btstack_crypto_aes128_key_schedule_t * key_schedule, const uint8_t * key, const uint8_t * plaintext, uint8_t * ciphertext){
+    if ((key_schedule->valid == 0u) || (memcmp(key_schedule->key, key, 16) != 0)){
+        (void)memcpy(key_schedule->key, key, 16);
+        btstack_crypto_aes128_setup_key(key_schedule, key);
+        key_schedule->valid = 1;
+    }
+    btstack_crypto_aes128_encrypt_block(key_schedule, plaintext, ciphertext);
+}
+
 void btstack_aes128_calc(const uint8_t * key, const uint8_t * plaintext, uint8_t * ciphertext){
-    uint32_t rk[RKLENGTH(KEYBITS)];
-    int nrounds = rijndaelSetupEncrypt(rk, &key[0], KEYBITS);
-    rijndaelEncrypt(rk, nrounds, plaintext, ciphertext);
+    btstack_crypto_aes128_key_schedule_t key_schedule;
+    btstack_crypto_aes128_setup_key(&key_schedule, key);
+    btstack_crypto_aes128_encrypt_block(&key_schedule, plaintext, ciphertext);
+}
+#elif defined(HAVE_AES128)
+// custom AES128 implementation handles key expansion
+typedef struct {
+    uint8_t valid;
+} btstack_crypto_aes128_key_schedule_t;
+
+static void btstack_crypto_aes128_calc_with_key_schedule(btstack_crypto_aes128_key_schedule_t * key_schedule, const uint8_t * key, const uint8_t * plaintext, uint8_t * ciphertext){
+    UNUSED(key_schedule);
+    btstack_aes128_calc(key, plaintext, ciphertext);
 }
 #endif
 
 static void btstack_crypto_done(btstack_crypto_t * btstack_crypto){
-    btstack_linked_list_pop(&btstack_crypto_operations);
+    btstack_linked_list_remove(&btstack_crypto_operations, (btstack_linked_item_t *) btstack_crypto);
     (*btstack_crypto->context_callback.callback)(btstack_crypto->context_callback.context);
 }
 
@@ -215,7 +298,11 @@ static void btstack_crypto_cmac_calc(btstack_crypto_aes128_cmac_t * btstack_cryp
     sm_key_t k0, k1, k2;
     uint16_t i;
 
-    btstack_aes128_calc(btstack_crypto_cmac->key, zero, k0);
+    // all blocks use the same key
+    btstack_crypto_aes128_key_schedule_t key_schedule;
+    key_schedule.valid = 0;
+
+    btstack_crypto_aes128_calc_with_key_schedule(&key_schedule, btstack_crypto_cmac->key, zero, k0);
     btstack_crypto_cmac_calc_subkeys(k0, k1, k2);
 
     uint16_t cmac_block_count = (btstack_crypto_cmac->size + 15) / 16;
@@ -233,10 +320,17 @@ static void btstack_crypto_cmac_calc(btstack_crypto_aes128_cmac_t * btstack_cryp
     sm_key_t cmac_y;
     int block;
     for (block = 0 ; block < cmac_block_count-1 ; block++){
-        for (i=0;i<16;i++){
-            cmac_y[i] = cmac_x[i] ^ btstack_crypto_cmac_get_byte(btstack_crypto_cmac, (block*16) + i);
+        if (btstack_crypto_cmac->btstack_crypto.operation == BTSTACK_CRYPTO_CMAC_MESSAGE){
+            const uint8_t * message_block = &btstack_crypto_cmac->data.message[block*16];
+            for (i=0;i<16;i++){
+                cmac_y[i] = cmac_x[i] ^ message_block[i];
+            }
+        } else {
+            for (i=0;i<16;i++){
+                cmac_y[i] = cmac_x[i] ^ btstack_crypto_cmac_get_byte(btstack_crypto_cmac, (block*16) + i);
+            }
         }
-        btstack_aes128_calc(btstack_crypto_cmac->key, cmac_y, cmac_x);
+        btstack_crypto_aes128_calc_with_key_schedule(&key_schedule, btstack_crypto_cmac->key, cmac_y, cmac_x);
     }
 
     // step 4: set m_last
@@ -266,16 +360,35 @@ static void btstack_crypto_cmac_calc(btstack_crypto_aes128_cmac_t * btstack_cryp
     }
 
     // Step 7
-    btstack_aes128_calc(btstack_crypto_cmac->key, cmac_y, btstack_crypto_cmac->hash);
+    btstack_crypto_aes128_calc_with_key_schedule(&key_schedule, btstack_crypto_cmac->key, cmac_y, btstack_crypto_cmac->hash);
 }
 #else
 
-static void btstack_crypto_aes128_start(const sm_key_t key, const sm_key_t plaintext){
+static bool btstack_crypto_le_encrypt_is_in_flight(btstack_crypto_t * btstack_crypto){
+    uint8_t i;
+    for (i = 0; i < btstack_crypto_le_encrypt_in_flight_count; i++){
+        uint8_t pos = (btstack_crypto_le_encrypt_in_flight_pos + i) % HCI_NUM_CMD_PACKETS_MAX;
+        if (btstack_crypto_le_encrypt_in_flight[pos] == btstack_crypto) return true;
+    }
+    return false;
+}
+
+static btstack_crypto_t * btstack_crypto_le_encrypt_in_flight_pop(void){
+    if (btstack_crypto_le_encrypt_in_flight_count == 0u) return NULL;
+    btstack_crypto_t * btstack_crypto = btstack_crypto_le_encrypt_in_flight[btstack_crypto_le_encrypt_in_flight_pos];
+    btstack_crypto_le_encrypt_in_flight_pos = (btstack_crypto_le_encrypt_in_flight_pos + 1u) % HCI_NUM_CMD_PACKETS_MAX;
+    btstack_crypto_le_encrypt_in_flight_count--;
+    return btstack_crypto;
+}
+
+static void btstack_crypto_aes128_start(btstack_crypto_t * btstack_crypto, const sm_key_t key, const sm_key_t plaintext){
     uint8_t key_flipped[16];
     uint8_t plaintext_flipped[16];
     reverse_128(key, key_flipped);
     reverse_128(plaintext, plaintext_flipped);
-    btstack_crypto_wait_for_hci_result = 1;
+    uint8_t pos = (btstack_crypto_le_encrypt_in_flight_pos + btstack_crypto_le_encrypt_in_flight_count) % HCI_NUM_CMD_PACKETS_MAX;
+    btstack_crypto_le_encrypt_in_flight[pos] = btstack_crypto;
+    btstack_crypto_le_encrypt_in_flight_count++;
     hci_send_cmd(&hci_le_encrypt, key_flipped, plaintext_flipped);
 }
 
@@ -293,7 +406,7 @@ static void btstack_crypto_cmac_handle_aes_engine_ready(btstack_crypto_aes128_cm
     switch (btstack_crypto_cmac_state){
         case CMAC_CALC_SUBKEYS: {
             btstack_crypto_cmac_next_state();
-            btstack_crypto_aes128_start(btstack_crypto_cmac_k, zero);
+            btstack_crypto_aes128_start(&btstack_crypto_cmac->btstack_crypto, btstack_crypto_cmac_k, zero);
             break;
         }
         case CMAC_CALC_MI: {
@@ -304,7 +417,7 @@ static void btstack_crypto_cmac_handle_aes_engine_ready(btstack_crypto_aes128_cm
             }
             btstack_crypto_cmac_block_current++;
             btstack_crypto_cmac_next_state();
-            btstack_crypto_aes128_start(btstack_crypto_cmac_k, y);
+            btstack_crypto_aes128_start(&btstack_crypto_cmac->btstack_crypto, btstack_crypto_cmac_k, y);
             break;
         }
         case CMAC_CALC_MLAST: {
@@ -352,7 +465,7 @@ static void btstack_crypto_cmac_handle_aes_engine_ready(btstack_crypto_aes128_cm
             }
             btstack_crypto_cmac_block_current++;
             btstack_crypto_cmac_next_state();
-            btstack_crypto_aes128_start(btstack_crypto_cmac_k, y);
+            btstack_crypto_aes128_start(&btstack_crypto_cmac->btstack_crypto, btstack_crypto_cmac_k, y);
             break;
         }
         default:
@@ -378,8 +491,7 @@ static void btstack_crypto_cmac_handle_encryption_result(btstack_crypto_aes128_c
             btstack_crypto_cmac_state = CMAC_IDLE;
             log_info_key("CMAC", data);
             (void)memcpy(btstack_crypto_cmac->hash, data, 16);
-			btstack_linked_list_pop(&btstack_crypto_operations);
-			(*btstack_crypto_cmac->btstack_crypto.context_callback.callback)(btstack_crypto_cmac->btstack_crypto.context_callback.context);
+            btstack_crypto_done(&btstack_crypto_cmac->btstack_crypto);
             break;
         default:
             log_info("btstack_crypto_cmac_handle_encryption_result called in state %u", btstack_crypto_cmac_state);
@@ -702,6 +814,17 @@ static void btstack_crypto_ccm_handle_xn(btstack_crypto_ccm_t * btstack_crypto_c
     }
 }
 
+#ifdef USE_BTSTACK_AES128
+static void btstack_crypto_ccm_aes128_calc(btstack_crypto_ccm_t * btstack_crypto_ccm, const uint8_t * plaintext, uint8_t * ciphertext){
+#ifdef ENABLE_SOFTWARE_AES128
+    // expanded key is kept in CCM request as all blocks use the same key
+    btstack_crypto_aes128_calc_with_key_schedule(&btstack_crypto_ccm->key_schedule, btstack_crypto_ccm->key, plaintext, ciphertext);
+#else
+    btstack_aes128_calc(btstack_crypto_ccm->key, plaintext, ciphertext);
+#endif
+}
+#endif
+
 static void btstack_crypto_ccm_calc_s0(btstack_crypto_ccm_t * btstack_crypto_ccm){
 #ifdef DEBUG_CCM
     printf("btstack_crypto_ccm_calc_s0\n");
@@ -710,10 +833,10 @@ static void btstack_crypto_ccm_calc_s0(btstack_crypto_ccm_t * btstack_crypto_ccm
     btstack_crypto_ccm_setup_a_i(btstack_crypto_ccm, 0);
 #ifdef USE_BTSTACK_AES128
     uint8_t data[16];
-    btstack_aes128_calc(btstack_crypto_ccm->key, btstack_crypto_ccm_s, data);
+    btstack_crypto_ccm_aes128_calc(btstack_crypto_ccm, btstack_crypto_ccm_s, data);
     btstack_crypto_ccm_handle_s0(btstack_crypto_ccm, data);
 #else
-    btstack_crypto_aes128_start(btstack_crypto_ccm->key, btstack_crypto_ccm_s);
+    btstack_crypto_aes128_start(&btstack_crypto_ccm->btstack_crypto, btstack_crypto_ccm->key, btstack_crypto_ccm_s);
 #endif
 }
 
@@ -725,10 +848,10 @@ static void btstack_crypto_ccm_calc_sn(btstack_crypto_ccm_t * btstack_crypto_ccm
     btstack_crypto_ccm_setup_a_i(btstack_crypto_ccm, btstack_crypto_ccm->counter);
 #ifdef USE_BTSTACK_AES128
     uint8_t data[16];
-    btstack_aes128_calc(btstack_crypto_ccm->key, btstack_crypto_ccm_s, data);
+    btstack_crypto_ccm_aes128_calc(btstack_crypto_ccm, btstack_crypto_ccm_s, data);
     btstack_crypto_ccm_handle_sn(btstack_crypto_ccm, data);
 #else
-    btstack_crypto_aes128_start(btstack_crypto_ccm->key, btstack_crypto_ccm_s);
+    btstack_crypto_aes128_start(&btstack_crypto_ccm->btstack_crypto, btstack_crypto_ccm->key, btstack_crypto_ccm_s);
 #endif
 }
 
@@ -737,10 +860,10 @@ static void btstack_crypto_ccm_calc_x1(btstack_crypto_ccm_t * btstack_crypto_ccm
     btstack_crypto_ccm->state = CCM_W4_X1;
     btstack_crypto_ccm_setup_b_0(btstack_crypto_ccm, btstack_crypto_ccm_buffer);
 #ifdef USE_BTSTACK_AES128
-    btstack_aes128_calc(btstack_crypto_ccm->key, btstack_crypto_ccm_buffer, btstack_crypto_ccm->x_i);
+    btstack_crypto_ccm_aes128_calc(btstack_crypto_ccm, btstack_crypto_ccm_buffer, btstack_crypto_ccm->x_i);
     btstack_crypto_ccm_handle_x1(btstack_crypto_ccm);
 #else
-    btstack_crypto_aes128_start(btstack_crypto_ccm->key, btstack_crypto_ccm_buffer);
+    btstack_crypto_aes128_start(&btstack_crypto_ccm->btstack_crypto, btstack_crypto_ccm->key, btstack_crypto_ccm_buffer);
 #endif
 }
 
@@ -769,10 +892,10 @@ static void btstack_crypto_ccm_calc_xn(btstack_crypto_ccm_t * btstack_crypto_ccm
 #endif
 
 #ifdef USE_BTSTACK_AES128
-    btstack_aes128_calc(btstack_crypto_ccm->key, btstack_crypto_ccm_buffer, btstack_crypto_ccm->x_i);
+    btstack_crypto_ccm_aes128_calc(btstack_crypto_ccm, btstack_crypto_ccm_buffer, btstack_crypto_ccm->x_i);
     btstack_crypto_ccm_handle_xn(btstack_crypto_ccm);
 #else
-    btstack_crypto_aes128_start(btstack_crypto_ccm->key, btstack_crypto_ccm_buffer);
+    btstack_crypto_aes128_start(&btstack_crypto_ccm->btstack_crypto, btstack_crypto_ccm->key, btstack_crypto_ccm_buffer);
 #endif
 }
 
@@ -817,25 +940,145 @@ static void btstack_crypto_ccm_calc_aad_xn(btstack_crypto_ccm_t * btstack_crypto
     btstack_crypto_ccm->aad_remainder_len = 0;
     btstack_crypto_ccm->state = CCM_W4_AAD_XN;
 #ifdef USE_BTSTACK_AES128
-    btstack_aes128_calc(btstack_crypto_ccm->key, btstack_crypto_ccm->x_i, btstack_crypto_ccm->x_i);
+    btstack_crypto_ccm_aes128_calc(btstack_crypto_ccm, btstack_crypto_ccm->x_i, btstack_crypto_ccm->x_i);
     btstack_crypto_ccm_handle_aad_xn(btstack_crypto_ccm);
 #else
-    btstack_crypto_aes128_start(btstack_crypto_ccm->key, btstack_crypto_ccm->x_i);
+    btstack_crypto_aes128_start(&btstack_crypto_ccm->btstack_crypto, btstack_crypto_ccm->key, btstack_crypto_ccm->x_i);
 #endif
 }
 
-static void btstack_crypto_run(void){
+// @return false if operation is waiting for AES128 result
+static bool btstack_crypto_ccm_run(btstack_crypto_ccm_t * btstack_crypto_ccm){
+    switch (btstack_crypto_ccm->state){
+        case CCM_CALCULATE_AAD_XN:
+#ifdef DEBUG_CCM
+            printf("CCM_CALCULATE_AAD_XN\n");
+#endif
+            btstack_crypto_ccm_calc_aad_xn(btstack_crypto_ccm);
+            return true;
+        case CCM_CALCULATE_X1:
+#ifdef DEBUG_CCM
+            printf("CCM_CALCULATE_X1\n");
+#endif
+            btstack_crypto_ccm_calc_x1(btstack_crypto_ccm);
+            return true;
+        case CCM_CALCULATE_S0:
+#ifdef DEBUG_CCM
+            printf("CCM_CALCULATE_S0\n");
+#endif
+            btstack_crypto_ccm_calc_s0(btstack_crypto_ccm);
+            return true;
+        case CCM_CALCULATE_SN:
+#ifdef DEBUG_CCM
+            printf("CCM_CALCULATE_SN\n");
+#endif
+            btstack_crypto_ccm_calc_sn(btstack_crypto_ccm);
+            return true;
+        case CCM_CALCULATE_XN:
+#ifdef DEBUG_CCM
+            printf("CCM_CALCULATE_XN\n");
+#endif
+            btstack_crypto_ccm_calc_xn(btstack_crypto_ccm, (btstack_crypto_ccm->btstack_crypto.operation == BTSTACK_CRYPTO_CCM_ENCRYPT_BLOCK) ? btstack_crypto_ccm->input : btstack_crypto_ccm->output);
+            return true;
+        default:
+            return false;
+    }
+}
+
+#ifdef USE_BTSTACK_AES128
+// AES128, CMAC and CCM are complete in a single call without HCI Controller
+// @return true if operation was processed
+static bool btstack_crypto_run_aes128_synchronous(btstack_crypto_t * btstack_crypto){
+    btstack_crypto_aes128_t        * btstack_crypto_aes128;
+    btstack_crypto_aes128_cmac_t   * btstack_crypto_cmac;
+    btstack_crypto_ccm_t           * btstack_crypto_ccm;
 
+    switch (btstack_crypto->operation){
+        case BTSTACK_CRYPTO_AES128:
+            btstack_crypto_aes128 = (btstack_crypto_aes128_t *) btstack_crypto;
+            btstack_aes128_calc(btstack_crypto_aes128->key, btstack_crypto_aes128->plaintext, btstack_crypto_aes128->ciphertext);
+            btstack_crypto_done(btstack_crypto);
+            return true;
+        case BTSTACK_CRYPTO_CMAC_MESSAGE:
+        case BTSTACK_CRYPTO_CMAC_GENERATOR:
+            btstack_crypto_cmac = (btstack_crypto_aes128_cmac_t *) btstack_crypto;
+            btstack_crypto_cmac_calc(btstack_crypto_cmac);
+            btstack_crypto_done(btstack_crypto);
+            return true;
+        case BTSTACK_CRYPTO_CCM_DIGEST_BLOCK:
+        case BTSTACK_CRYPTO_CCM_ENCRYPT_BLOCK:
+        case BTSTACK_CRYPTO_CCM_DECRYPT_BLOCK:
+            btstack_crypto_ccm = (btstack_crypto_ccm_t *) btstack_crypto;
+            // process all blocks until operation is done and removed from queue
+            while (btstack_linked_list_get_first_item(&btstack_crypto_operations) == (btstack_linked_item_t *) btstack_crypto){
+                if (!btstack_crypto_ccm_run(btstack_crypto_ccm)) break;
+            }
+            return true;
+        default:
+            return false;
+    }
+}
+#endif
+
+#ifndef USE_BTSTACK_AES128
+// start next AES128 for operations that are not waiting for a result. Independent AES128, CMAC, and CCM operations
+// can overlap, while random and ECC operations are processed in order
+// @return true if LE Encrypt was sent or operation is complete
+static bool btstack_crypto_run_le_encrypt(void){
     btstack_crypto_aes128_t        * btstack_crypto_aes128;
     btstack_crypto_ccm_t           * btstack_crypto_ccm;
     btstack_crypto_aes128_cmac_t   * btstack_crypto_cmac;
+
+    if (btstack_crypto_le_encrypt_in_flight_count >= HCI_NUM_CMD_PACKETS_MAX) return false;
+
+    // only one CMAC can be active
+    bool cmac_found = false;
+
+    btstack_linked_list_iterator_t it;
+    btstack_linked_list_iterator_init(&it, &btstack_crypto_operations);
+    while (btstack_linked_list_iterator_has_next(&it)){
+        btstack_crypto_t * btstack_crypto = (btstack_crypto_t *) btstack_linked_list_iterator_next(&it);
+        switch (btstack_crypto->operation){
+            case BTSTACK_CRYPTO_AES128:
+                if (btstack_crypto_le_encrypt_is_in_flight(btstack_crypto)) break;
+                btstack_crypto_aes128 = (btstack_crypto_aes128_t *) btstack_crypto;
+                btstack_crypto_aes128_start(btstack_crypto, btstack_crypto_aes128->key, btstack_crypto_aes128->plaintext);
+                return true;
+
+            case BTSTACK_CRYPTO_CMAC_MESSAGE:
+            case BTSTACK_CRYPTO_CMAC_GENERATOR:
+                if (cmac_found) break;
+                cmac_found = true;
+                if (btstack_crypto_le_encrypt_is_in_flight(btstack_crypto)) break;
+                btstack_crypto_cmac = (btstack_crypto_aes128_cmac_t *) btstack_crypto;
+                if (btstack_crypto_cmac_state == CMAC_IDLE){
+                    btstack_crypto_cmac_start(btstack_crypto_cmac);
+                } else {
+                    btstack_crypto_cmac_handle_aes_engine_ready(btstack_crypto_cmac);
+                }
+                return true;
+
+            case BTSTACK_CRYPTO_CCM_DIGEST_BLOCK:
+            case BTSTACK_CRYPTO_CCM_ENCRYPT_BLOCK:
+            case BTSTACK_CRYPTO_CCM_DECRYPT_BLOCK:
+                if (btstack_crypto_le_encrypt_is_in_flight(btstack_crypto)) break;
+                btstack_crypto_ccm = (btstack_crypto_ccm_t *) btstack_crypto;
+                return btstack_crypto_ccm_run(btstack_crypto_ccm);
+
+            default:
+                return false;
+        }
+    }
+    return false;
+}
+#endif
+
+static void btstack_crypto_run(void){
+
 #ifdef ENABLE_ECC_P256
     btstack_crypto_ecc_p256_t      * btstack_crypto_ec_p192;
 #endif
 
-    // stack up and running?
-    if (hci_get_state() != HCI_STATE_WORKING) return;
-
     // try to do as much as possible
     while (true){
 
@@ -845,81 +1088,32 @@ static void btstack_crypto_run(void){
         // already active?
         if (btstack_crypto_wait_for_hci_result) return;
 
+        // ok, find next task
+    	btstack_crypto_t * btstack_crypto = (btstack_crypto_t*) btstack_linked_list_get_first_item(&btstack_crypto_operations);
+
+#ifdef USE_BTSTACK_AES128
+        // AES128, CMAC and CCM don't need the Controller
+        if (btstack_crypto_run_aes128_synchronous(btstack_crypto)) continue;
+#endif
+
+        // stack up and running?
+        if (hci_get_state() != HCI_STATE_WORKING) return;
+
         // can send a command?
         if (!hci_can_send_command_packet_now()) return;
 
-        // ok, find next task
-    	btstack_crypto_t * btstack_crypto = (btstack_crypto_t*) btstack_linked_list_get_first_item(&btstack_crypto_operations);
+#ifndef USE_BTSTACK_AES128
+        if (btstack_crypto_run_le_encrypt()) continue;
+
+        // random and ECC operations wait for all LE Encrypt results
+        if (btstack_crypto_le_encrypt_in_flight_count > 0u) return;
+#endif
+
     	switch (btstack_crypto->operation){
     		case BTSTACK_CRYPTO_RANDOM:
     			btstack_crypto_wait_for_hci_result = 1;
     		    hci_send_cmd(&hci_le_rand);
     		    break;
-    		case BTSTACK_CRYPTO_AES128:
-                btstack_crypto_aes128 = (btstack_crypto_aes128_t *) btstack_crypto;
-#ifdef USE_BTSTACK_AES128
-                btstack_aes128_calc(btstack_crypto_aes128->key, btstack_crypto_aes128->plaintext, btstack_crypto_aes128->ciphertext);
-                btstack_crypto_done(btstack_crypto);
-#else
-                btstack_crypto_aes128_start(btstack_crypto_aes128->key, btstack_crypto_aes128->plaintext);
-#endif
-    		    break;
-
-    		case BTSTACK_CRYPTO_CMAC_MESSAGE:
-    		case BTSTACK_CRYPTO_CMAC_GENERATOR:
-                btstack_crypto_cmac = (btstack_crypto_aes128_cmac_t *) btstack_crypto;
-#ifdef USE_BTSTACK_AES128
-                btstack_crypto_cmac_calc( btstack_crypto_cmac );
-                btstack_crypto_done(btstack_crypto);
-#else
-    			btstack_crypto_wait_for_hci_result = 1;
-    			if (btstack_crypto_cmac_state == CMAC_IDLE){
-    				btstack_crypto_cmac_start(btstack_crypto_cmac);
-    			} else {
-    				btstack_crypto_cmac_handle_aes_engine_ready(btstack_crypto_cmac);
-    			}
-#endif
-    			break;
-
-            case BTSTACK_CRYPTO_CCM_DIGEST_BLOCK:
-            case BTSTACK_CRYPTO_CCM_ENCRYPT_BLOCK:
-            case BTSTACK_CRYPTO_CCM_DECRYPT_BLOCK:
-                btstack_crypto_ccm = (btstack_crypto_ccm_t *) btstack_crypto;
-                switch (btstack_crypto_ccm->state){
-                    case CCM_CALCULATE_AAD_XN:
-#ifdef DEBUG_CCM
-                        printf("CCM_CALCULATE_AAD_XN\n");
-#endif
-                        btstack_crypto_ccm_calc_aad_xn(btstack_crypto_ccm);
-                        break;
-                    case CCM_CALCULATE_X1:
-#ifdef DEBUG_CCM
-                        printf("CCM_CALCULATE_X1\n");
-#endif
-                        btstack_crypto_ccm_calc_x1(btstack_crypto_ccm);
-                        break;
-                    case CCM_CALCULATE_S0:
-#ifdef DEBUG_CCM
-                        printf("CCM_CALCULATE_S0\n");
-#endif
-                        btstack_crypto_ccm_calc_s0(btstack_crypto_ccm);
-                        break;
-                    case CCM_CALCULATE_SN:
-#ifdef DEBUG_CCM
-                        printf("CCM_CALCULATE_SN\n");
-#endif
-                        btstack_crypto_ccm_calc_sn(btstack_crypto_ccm);
-                        break;
-                    case CCM_CALCULATE_XN:
-#ifdef DEBUG_CCM
-                        printf("CCM_CALCULATE_XN\n");
-#endif
-                        btstack_crypto_ccm_calc_xn(btstack_crypto_ccm, (btstack_crypto->operation == BTSTACK_CRYPTO_CCM_ENCRYPT_BLOCK) ? btstack_crypto_ccm->input : btstack_crypto_ccm->output);
-                        break;
-                    default:
-                        break;
-                }
-                break;
 
 #ifdef ENABLE_ECC_P256
             case BTSTACK_CRYPTO_ECC_P256_GENERATE_KEY:
@@ -1017,30 +1211,28 @@ static void btstack_crypto_handle_random_data(const uint8_t * data, uint16_t len
 }
 
 #ifndef USE_BTSTACK_AES128
-static void btstack_crypto_handle_encryption_result(const uint8_t * data){
+static void btstack_crypto_handle_encryption_result(btstack_crypto_t * btstack_crypto, const uint8_t * data){
 	btstack_crypto_aes128_t      * btstack_crypto_aes128;
 	btstack_crypto_aes128_cmac_t * btstack_crypto_cmac;
     btstack_crypto_ccm_t         * btstack_crypto_ccm;
 	uint8_t result[16];
 
-    btstack_crypto_t * btstack_crypto = (btstack_crypto_t*) btstack_linked_list_get_first_item(&btstack_crypto_operations);
-	if (!btstack_crypto) return;
 	switch (btstack_crypto->operation){
 		case BTSTACK_CRYPTO_AES128:
-			btstack_crypto_aes128 = (btstack_crypto_aes128_t*) btstack_linked_list_get_first_item(&btstack_crypto_operations);
+			btstack_crypto_aes128 = (btstack_crypto_aes128_t*) btstack_crypto;
 		    reverse_128(data, btstack_crypto_aes128->ciphertext);
             btstack_crypto_done(btstack_crypto);
 			break;
 		case BTSTACK_CRYPTO_CMAC_GENERATOR:
 		case BTSTACK_CRYPTO_CMAC_MESSAGE:
-			btstack_crypto_cmac = (btstack_crypto_aes128_cmac_t*) btstack_linked_list_get_first_item(&btstack_crypto_operations);
+			btstack_crypto_cmac = (btstack_crypto_aes128_cmac_t*) btstack_crypto;
 		    reverse_128(data, result);
 		    btstack_crypto_cmac_handle_encryption_result(btstack_crypto_cmac, result);
 			break;
         case BTSTACK_CRYPTO_CCM_DIGEST_BLOCK:
         case BTSTACK_CRYPTO_CCM_ENCRYPT_BLOCK:
         case BTSTACK_CRYPTO_CCM_DECRYPT_BLOCK:
-            btstack_crypto_ccm = (btstack_crypto_ccm_t*) btstack_linked_list_get_first_item(&btstack_crypto_operations);
+            btstack_crypto_ccm = (btstack_crypto_ccm_t*) btstack_crypto;
             switch (btstack_crypto_ccm->state){
                 case CCM_W4_X1:
                     reverse_128(data, btstack_crypto_ccm->x_i);
@@ -1086,7 +1278,11 @@ static void btstack_crypto_event_handler(uint8_t packet_type, uint16_t cid, uint
         case BTSTACK_EVENT_STATE:
             log_info("BTSTACK_EVENT_STATE");
             if (btstack_event_state_get_state(packet) != HCI_STATE_HALTING) break;
+#ifdef USE_BTSTACK_AES128
             if (!btstack_crypto_wait_for_hci_result) break;
+#else
+            if (!btstack_crypto_wait_for_hci_result && (btstack_crypto_le_encrypt_in_flight_count == 0u)) break;
+#endif
             // request stack to defer shutdown a bit
             hci_halting_defer();
             break;
@@ -1094,9 +1290,9 @@ static void btstack_crypto_event_handler(uint8_t packet_type, uint16_t cid, uint
         case HCI_EVENT_COMMAND_COMPLETE:
 #ifndef USE_BTSTACK_AES128
     	    if (HCI_EVENT_IS_COMMAND_COMPLETE(packet, hci_le_encrypt)){
-                if (!btstack_crypto_wait_for_hci_result) return;
-                btstack_crypto_wait_for_hci_result = 0;
-    	        btstack_crypto_handle_encryption_result(&packet[6]);
+                btstack_crypto_t * btstack_crypto = btstack_crypto_le_encrypt_in_flight_pop();
+                if (btstack_crypto == NULL) return;
+    	        btstack_crypto_handle_encryption_result(btstack_crypto, &packet[6]);
     	    }
 #endif
     	    if (HCI_EVENT_IS_COMMAND_COMPLETE(packet, hci_le_rand)){
@@ -1292,6 +1488,9 @@ int btstack_crypto_ecc_p256_validate_public_key(const uint8_t * public_key){
 
 void btstack_crypto_ccm_init(btstack_crypto_ccm_t * request, const uint8_t * key, const uint8_t * nonce, uint16_t message_len, uint16_t additional_authenticated_data_len, uint8_t auth_len){
     request->key         = key;
+#ifdef ENABLE_SOFTWARE_AES128
+    request->key_schedule.valid = 0;
+#endif
     request->nonce       = nonce;
     request->message_len = message_len;
     request->aad_len     = additional_authenticated_data_len;
@@ -1365,4 +1564,8 @@ int btstack_crypto_idle(void){
 void btstack_crypto_reset(void){
     btstack_crypto_operations = NULL;
     btstack_crypto_wait_for_hci_result = 0;
+#ifndef USE_BTSTACK_AES128
+    btstack_crypto_le_encrypt_in_flight_pos = 0;
+    btstack_crypto_le_encrypt_in_flight_count = 0;
+#endif
 }
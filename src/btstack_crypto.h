@@ -114,10 +114,22 @@ typedef enum {
     CCM_W4_SN,
 } btstack_crypto_ccm_state_t;
 
+#ifdef ENABLE_SOFTWARE_AES128
+// expanded AES128 key used by software AES128 implementation
+typedef struct {
+	uint32_t round_keys[44];
+	uint8_t  key[16];
+	uint8_t  valid;
+} btstack_crypto_aes128_key_schedule_t;
+#endif
+
 typedef struct {
 	btstack_crypto_t btstack_crypto;
 	btstack_crypto_ccm_state_t state;
 	const uint8_t * key;
+#ifdef ENABLE_SOFTWARE_AES128
+	btstack_crypto_aes128_key_schedule_t key_schedule;
+#endif
 	const uint8_t * nonce;
 	const uint8_t * input;
 	uint8_t       * output;
@@ -274,7 +286,7 @@ void btstack_crypto_ccm_decrypt_block(btstack_crypto_ccm_t * request, uint16_t l
 #if defined(ENABLE_SOFTWARE_AES128) || defined (HAVE_AES128)
 /** 
  * Encrypt plaintext using AES128
- * @note Prototype for custom AES128 implementation
+ * @note Prototype for custom AES128 implementation, needs to be reentrant as it can be called outside of the run loop
  * @param key (16 bytes)
  * @param plaintext (16 bytes)
  * @param ciphertext (16 bytes)
@@ -101,6 +101,52 @@ void btstack_memory_hci_connection_free(hci_connection_t *hci_connection){
 #endif
 
 
+// MARK: hci_acl_recombination_buffer_t
+#if !defined(HAVE_MALLOC) && !defined(MAX_NR_HCI_ACL_RECOMBINATION_BUFFERS)
+    #if defined(MAX_NO_HCI_ACL_RECOMBINATION_BUFFERS)
+        #error "Deprecated MAX_NO_HCI_ACL_RECOMBINATION_BUFFERS defined instead of MAX_NR_HCI_ACL_RECOMBINATION_BUFFERS. Please update your btstack_config.h to use MAX_NR_HCI_ACL_RECOMBINATION_BUFFERS."
+    #else
+        #define MAX_NR_HCI_ACL_RECOMBINATION_BUFFERS 0
+    #endif
+#endif
+
+#ifdef MAX_NR_HCI_ACL_RECOMBINATION_BUFFERS
+#if MAX_NR_HCI_ACL_RECOMBINATION_BUFFERS > 0
+static hci_acl_recombination_buffer_t hci_acl_recombination_buffer_storage[MAX_NR_HCI_ACL_RECOMBINATION_BUFFERS];
+static btstack_memory_pool_t hci_acl_recombination_buffer_pool;
+hci_acl_recombination_buffer_t * btstack_memory_hci_acl_recombination_buffer_get(void){
+    void * buffer = btstack_memory_pool_get(&hci_acl_recombination_buffer_pool);
+    if (buffer){
+        memset(buffer, 0, sizeof(hci_acl_recombination_buffer_t));
+    }
+    return (hci_acl_recombination_buffer_t *) buffer;
+}
+void btstack_memory_hci_acl_recombination_buffer_free(hci_acl_recombination_buffer_t *hci_acl_recombination_buffer){
+    btstack_memory_pool_free(&hci_acl_recombination_buffer_pool, hci_acl_recombination_buffer);
+}
+#else
+hci_acl_recombination_buffer_t * btstack_memory_hci_acl_recombination_buffer_get(void){
+    return NULL;
+}
+void btstack_memory_hci_acl_recombination_buffer_free(hci_acl_recombination_buffer_t *hci_acl_recombination_buffer){
+    // silence compiler warning about unused parameter in a portable way
+    (void) hci_acl_recombination_buffer;
+};
+#endif
+#elif defined(HAVE_MALLOC)
+hci_acl_recombination_buffer_t * btstack_memory_hci_acl_recombination_buffer_get(void){
+    void * buffer = malloc(sizeof(hci_acl_recombination_buffer_t));
+    if (buffer){
+        memset(buffer, 0, sizeof(hci_acl_recombination_buffer_t));
+    }
+    return (hci_acl_recombination_buffer_t *) buffer;
+}
+void btstack_memory_hci_acl_recombination_buffer_free(hci_acl_recombination_buffer_t *hci_acl_recombination_buffer){
+    free(hci_acl_recombination_buffer);
+}
+#endif
+
+
 
 // MARK: l2cap_service_t
 #if !defined(HAVE_MALLOC) && !defined(MAX_NR_L2CAP_SERVICES)
@@ -1182,6 +1228,9 @@ void btstack_memory_init(void){
 #if MAX_NR_HCI_CONNECTIONS > 0
     btstack_memory_pool_create(&hci_connection_pool, hci_connection_storage, MAX_NR_HCI_CONNECTIONS, sizeof(hci_connection_t));
 #endif
+#if MAX_NR_HCI_ACL_RECOMBINATION_BUFFERS > 0
+    btstack_memory_pool_create(&hci_acl_recombination_buffer_pool, hci_acl_recombination_buffer_storage, MAX_NR_HCI_ACL_RECOMBINATION_BUFFERS, sizeof(hci_acl_recombination_buffer_t));
+#endif
 #if MAX_NR_L2CAP_SERVICES > 0
     btstack_memory_pool_create(&l2cap_service_pool, l2cap_service_storage, MAX_NR_L2CAP_SERVICES, sizeof(l2cap_service_t));
 #endif
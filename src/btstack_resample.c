@@ -37,22 +37,122 @@
 
 #define BTSTACK_FILE__ "btstack_resample.c"
 
+#include <string.h>
+
 #include "btstack_bool.h"
 #include "btstack_resample.h"
 
+// use SIMD for interleaved stereo if enabled by compiler
+#if defined(__SSE2__)
+#define USE_RESAMPLE_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define USE_RESAMPLE_NEON
+#include <arm_neon.h>
+#endif
+
+#define POLYPHASE_HISTORY           (BTSTACK_RESAMPLE_POLYPHASE_TAPS - 1)
+#define POLYPHASE_PHASES            32
+#define POLYPHASE_COEFFICIENT_BITS  14
+
+// Kaiser windowed sinc (beta 7, cutoff 0.9 * fs/2) for source position phase / POLYPHASE_PHASES.
+// Tap k is applied to frame k - 7 relative to the position, coefficients of each phase sum up to 1 << 14.
+static const int16_t polyphase_coefficients[POLYPHASE_PHASES + 1][BTSTACK_RESAMPLE_POLYPHASE_TAPS] = {
+    {    24,    -96,    256,   -523,    878,  -1248,   1531,  14740,   1531,  -1248,    878,   -523,    256,    -96,     24,      0 },
+    {    24,    -95,    248,   -495,    801,  -1068,   1072,  14725,   2010,  -1426,    950,   -548,    261,    -96,     23,     -2 },
+    {    24,    -94,    239,   -464,    722,   -887,    635,  14664,   2507,  -1600,   1017,   -570,    265,    -95,     23,     -2 },
+    {    24,    -91,    228,   -431,    639,   -706,    220,  14564,   3021,  -1769,   1079,   -587,    267,    -93,     21,     -2 },
+    {    24,    -88,    216,   -395,    555,   -528,   -171,  14426,   3549,  -1931,   1134,   -601,    266,    -90,     20,     -2 },
+    {    23,    -85,    203,   -358,    470,   -353,   -536,  14248,   4089,  -2084,   1182,   -609,    263,    -86,     18,     -1 },
+    {    22,    -81,    188,   -319,    384,   -183,   -876,  14039,   4639,  -2228,   1222,   -613,    257,    -81,     15,     -1 },
+    {    21,    -76,    173,   -280,    299,    -18,  -1189,  13787,   5198,  -2359,   1253,   -612,    249,    -75,     13,      0 },
+    {    20,    -71,    157,   -240,    215,    140,  -1474,  13503,   5761,  -2477,   1275,   -606,    238,    -68,     10,      1 },
+    {    19,    -66,    141,   -200,    132,    290,  -1732,  13187,   6328,  -2580,   1287,   -594,    225,    -60,      6,      1 },
+    {    18,    -61,    124,   -160,     52,    432,  -1962,  12835,   6896,  -2667,   1290,   -577,    209,    -50,      3,      2 },
+    {    16,    -55,    107,   -120,    -25,    564,  -2164,  12455,   7461,  -2735,   1281,   -553,    190,    -40,     -1,      3 },
+    {    15,    -49,     90,    -82,    -99,    687,  -2338,  12047,   8023,  -2784,   1261,   -525,    169,    -29,     -6,      4 },
+    {    13,    -43,     74,    -44,   -170,    799,  -2484,  11612,   8577,  -2813,   1230,   -490,    145,    -16,    -11,      5 },
+    {    12,    -38,     57,     -8,   -236,    900,  -2603,  11153,   9121,  -2819,   1188,   -450,    119,     -3,    -16,      7 },
+    {    11,    -32,     41,     27,   -297,    989,  -2695,  10672,   9654,  -2803,   1133,   -404,     90,     11,    -21,      8 },
+    {     9,    -26,     26,     60,   -353,   1067,  -2762,  10171,  10171,  -2762,   1067,   -353,     60,     26,    -26,      9 },
+    {     8,    -21,     11,     90,   -404,   1133,  -2803,   9654,  10672,  -2695,    989,   -297,     27,     41,    -32,     11 },
+    {     7,    -16,     -3,    119,   -450,   1188,  -2819,   9121,  11153,  -2603,    900,   -236,     -8,     57,    -38,     12 },
+    {     5,    -11,    -16,    145,   -490,   1230,  -2813,   8577,  11612,  -2484,    799,   -170,    -44,     74,    -43,     13 },
+    {     4,     -6,    -29,    169,   -525,   1261,  -2784,   8023,  12047,  -2338,    687,    -99,    -82,     90,    -49,     15 },
+    {     3,     -1,    -40,    190,   -553,   1281,  -2735,   7461,  12455,  -2164,    564,    -25,   -120,    107,    -55,     16 },
+    {     2,      3,    -50,    209,   -577,   1290,  -2667,   6896,  12835,  -1962,    432,     52,   -160,    124,    -61,     18 },
+    {     1,      6,    -60,    225,   -594,   1287,  -2580,   6328,  13187,  -1732,    290,    132,   -200,    141,    -66,     19 },
+    {     1,     10,    -68,    238,   -606,   1275,  -2477,   5761,  13503,  -1474,    140,    215,   -240,    157,    -71,     20 },
+    {     0,     13,    -75,    249,   -612,   1253,  -2359,   5198,  13787,  -1189,    -18,    299,   -280,    173,    -76,     21 },
+    {    -1,     15,    -81,    257,   -613,   1222,  -2228,   4639,  14039,   -876,   -183,    384,   -319,    188,    -81,     22 },
+    {    -1,     18,    -86,    263,   -609,   1182,  -2084,   4089,  14248,   -536,   -353,    470,   -358,    203,    -85,     23 },
+    {    -2,     20,    -90,    266,   -601,   1134,  -1931,   3549,  14426,   -171,   -528,    555,   -395,    216,    -88,     24 },
+    {    -2,     21,    -93,    267,   -587,   1079,  -1769,   3021,  14564,    220,   -706,    639,   -431,    228,    -91,     24 },
+    {    -2,     23,    -95,    265,   -570,   1017,  -1600,   2507,  14664,    635,   -887,    722,   -464,    239,    -94,     24 },
+    {    -2,     23,    -96,    261,   -548,    950,  -1426,   2010,  14725,   1072,  -1068,    801,   -495,    248,    -95,     24 },
+    {     0,     24,    -96,    256,   -523,    878,  -1248,   1531,  14740,   1531,  -1248,    878,   -523,    256,    -96,     24 }
+};
+
 void btstack_resample_init(btstack_resample_t * context, int num_channels){
     context->src_pos = 0;
     context->src_step = 0x10000;  // default resampling 1.0
     context->last_sample[0] = 0;
     context->last_sample[1] = 0;
     context->num_channels   = num_channels;
+    context->mode = BTSTACK_RESAMPLE_MODE_LINEAR;
+    memset(context->history, 0, sizeof(context->history));
 }
 
 void btstack_resample_set_factor(btstack_resample_t * context, uint32_t src_step){
     context->src_step = src_step;
 }
 
-uint16_t btstack_resample_block(btstack_resample_t * context, const int16_t * input_buffer, uint32_t num_frames, int16_t * output_buffer){
+void btstack_resample_set_mode(btstack_resample_t * context, btstack_resample_mode_t mode){
+    context->mode = mode;
+    context->src_pos = 0;
+    context->last_sample[0] = 0;
+    context->last_sample[1] = 0;
+    memset(context->history, 0, sizeof(context->history));
+}
+
+#ifdef USE_RESAMPLE_SSE2
+// linear interpolation of two stereo frames, returns L/R of both frames as 32 bit values.
+// madd needs 16 bit weights, so s1 * (0x10000 - t) + s2 * t is calculated as
+// 2 * (s1 * (0x7fff - (t >> 1)) + s2 * (t >> 1) + s1) + (t & 1) * (s2 - s1)
+static __m128i btstack_resample_linear_stereo_sse2(const int16_t * input_buffer, uint32_t pos_0, uint32_t pos_1){
+    const int16_t half_t_0 = (int16_t) ((pos_0 & 0xffffu) >> 1);
+    const int16_t half_t_1 = (int16_t) ((pos_1 & 0xffffu) >> 1);
+    // L1 R1 L2 R2 of both frames -> L1 L2 R1 R2
+    __m128i x = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i *) &input_buffer[(pos_0 >> 16) * 2]),
+                                   _mm_loadl_epi64((const __m128i *) &input_buffer[(pos_1 >> 16) * 2]));
+    x = _mm_shufflehi_epi16(_mm_shufflelo_epi16(x, _MM_SHUFFLE(3,1,2,0)), _MM_SHUFFLE(3,1,2,0));
+    const __m128i weights = _mm_set_epi16(half_t_1, 0x7fff - half_t_1, half_t_1, 0x7fff - half_t_1,
+                                          half_t_0, 0x7fff - half_t_0, half_t_0, 0x7fff - half_t_0);
+    const __m128i odd = _mm_set_epi32(-(int32_t)(pos_1 & 1u), -(int32_t)(pos_1 & 1u), -(int32_t)(pos_0 & 1u), -(int32_t)(pos_0 & 1u));
+    const __m128i s1 = _mm_srai_epi32(_mm_slli_epi32(x, 16), 16);
+    const __m128i s2 = _mm_srai_epi32(x, 16);
+    __m128i sum = _mm_add_epi32(_mm_madd_epi16(x, weights), s1);
+    sum = _mm_add_epi32(_mm_add_epi32(sum, sum), _mm_and_si128(_mm_sub_epi32(s2, s1), odd));
+    return _mm_srai_epi32(sum, 16);
+}
+#endif
+
+#ifdef USE_RESAMPLE_NEON
+// linear interpolation of two stereo frames
+static int16x4_t btstack_resample_linear_stereo_neon(const int16_t * input_buffer, uint32_t pos_0, uint32_t pos_1){
+    const int16x4_t frames_0 = vld1_s16(&input_buffer[(pos_0 >> 16) * 2]);
+    const int16x4_t frames_1 = vld1_s16(&input_buffer[(pos_1 >> 16) * 2]);
+    // val[0] = first L/R of both positions, val[1] = second L/R of both positions
+    const int32x2x2_t frames = vuzp_s32(vreinterpret_s32_s16(frames_0), vreinterpret_s32_s16(frames_1));
+    const int32x4_t s1 = vmovl_s16(vreinterpret_s16_s32(frames.val[0]));
+    const int32x4_t s2 = vmovl_s16(vreinterpret_s16_s32(frames.val[1]));
+    const int32x4_t t  = vcombine_s32(vdup_n_s32((int32_t)(pos_0 & 0xffffu)), vdup_n_s32((int32_t)(pos_1 & 0xffffu)));
+    const int32x4_t sum = vmlaq_s32(vmulq_s32(s1, vsubq_s32(vdupq_n_s32(0x10000), t)), s2, t);
+    return vshrn_n_s32(sum, 16);
+}
+#endif
+
+static uint16_t btstack_resample_block_linear(btstack_resample_t * context, const int16_t * input_buffer, uint32_t num_frames, int16_t * output_buffer){
     uint16_t dest_frames = 0;
     uint16_t dest_samples = 0;
     // samples between last sample of previous block and first sample in current block 
@@ -68,6 +168,29 @@ uint16_t btstack_resample_block(btstack_resample_t * context, const int16_t * in
         dest_frames++;
         context->src_pos += context->src_step;
     }
+#if defined(USE_RESAMPLE_SSE2) || defined(USE_RESAMPLE_NEON)
+    // four stereo frames at a time as long as all source frames are in current block
+    if (context->num_channels == 2){
+        while (((context->src_pos + (3u * context->src_step)) >> 16) < (num_frames - 1u)){
+            const uint32_t pos_0 = context->src_pos;
+            const uint32_t pos_1 = pos_0 + context->src_step;
+            const uint32_t pos_2 = pos_1 + context->src_step;
+            const uint32_t pos_3 = pos_2 + context->src_step;
+#ifdef USE_RESAMPLE_SSE2
+            const __m128i frames_01 = btstack_resample_linear_stereo_sse2(input_buffer, pos_0, pos_1);
+            const __m128i frames_23 = btstack_resample_linear_stereo_sse2(input_buffer, pos_2, pos_3);
+            _mm_storeu_si128((__m128i *) &output_buffer[dest_samples], _mm_packs_epi32(frames_01, frames_23));
+#else
+            const int16x4_t frames_01 = btstack_resample_linear_stereo_neon(input_buffer, pos_0, pos_1);
+            const int16x4_t frames_23 = btstack_resample_linear_stereo_neon(input_buffer, pos_2, pos_3);
+            vst1q_s16(&output_buffer[dest_samples], vcombine_s16(frames_01, frames_23));
+#endif
+            dest_samples += 8;
+            dest_frames  += 4;
+            context->src_pos = pos_3 + context->src_step;
+        }
+    }
+#endif
     // process current block
     while (true){
         const uint16_t src_pos = context->src_pos >> 16;
@@ -95,3 +218,151 @@ uint16_t btstack_resample_block(btstack_resample_t * context, const int16_t * in
     }
     return dest_frames;
 }
+
+// filter coefficients for fractional source position, linear interpolation between adjacent phases
+static void btstack_resample_polyphase_coefficients(uint16_t t, int16_t * coefficients){
+    const int16_t * coefficients_0 = polyphase_coefficients[t >> 11];
+    const int16_t * coefficients_1 = polyphase_coefficients[(t >> 11) + 1];
+    const int32_t   fraction       = (t & 0x7ffu) << 4;
+    int i;
+    for (i=0;i<BTSTACK_RESAMPLE_POLYPHASE_TAPS;i++){
+        coefficients[i] = coefficients_0[i] + (int16_t)((2 * (coefficients_1[i] - coefficients_0[i]) * fraction) >> 16);
+    }
+}
+
+static int16_t btstack_resample_polyphase_sample(const int16_t * input, int num_channels, const int16_t * coefficients){
+    int32_t sum = 1 << (POLYPHASE_COEFFICIENT_BITS - 1);
+    int i;
+    for (i=0;i<BTSTACK_RESAMPLE_POLYPHASE_TAPS;i++){
+        sum += input[i * num_channels] * coefficients[i];
+    }
+    sum >>= POLYPHASE_COEFFICIENT_BITS;
+    if (sum > 32767)  return 32767;
+    if (sum < -32768) return -32768;
+    return (int16_t) sum;
+}
+
+#ifdef USE_RESAMPLE_SSE2
+static void btstack_resample_polyphase_stereo_sse2(const int16_t * input, uint16_t t, int16_t * output){
+    // interpolate coefficients between phases as in btstack_resample_polyphase_coefficients
+    const int16_t * coefficients_0 = polyphase_coefficients[t >> 11];
+    const int16_t * coefficients_1 = polyphase_coefficients[(t >> 11) + 1];
+    const __m128i fraction = _mm_set1_epi16((int16_t)((t & 0x7ffu) << 4));
+    __m128i coefficients[2];
+    int i;
+    for (i=0;i<2;i++){
+        const __m128i c0 = _mm_loadu_si128((const __m128i *) &coefficients_0[i * 8]);
+        const __m128i c1 = _mm_loadu_si128((const __m128i *) &coefficients_1[i * 8]);
+        const __m128i delta = _mm_sub_epi16(c1, c0);
+        coefficients[i] = _mm_add_epi16(c0, _mm_mulhi_epi16(_mm_add_epi16(delta, delta), fraction));
+    }
+    // four frames per step: L0 R0 L1 R1 L2 R2 L3 R3 -> L0 L1 R0 R1 L2 L3 R2 R3 with coefficients c0 c1 c0 c1 c2 c3 c2 c3
+    __m128i sum = _mm_setzero_si128();
+    for (i=0;i<4;i++){
+        __m128i x = _mm_loadu_si128((const __m128i *) &input[i * 8]);
+        x = _mm_shufflehi_epi16(_mm_shufflelo_epi16(x, _MM_SHUFFLE(3,1,2,0)), _MM_SHUFFLE(3,1,2,0));
+        const __m128i c = (i & 1) ? _mm_unpackhi_epi32(coefficients[i >> 1], coefficients[i >> 1])
+                                  : _mm_unpacklo_epi32(coefficients[i >> 1], coefficients[i >> 1]);
+        sum = _mm_add_epi32(sum, _mm_madd_epi16(x, c));
+    }
+    // L R L R -> L R
+    sum = _mm_add_epi32(sum, _mm_srli_si128(sum, 8));
+    sum = _mm_add_epi32(sum, _mm_set1_epi32(1 << (POLYPHASE_COEFFICIENT_BITS - 1)));
+    sum = _mm_packs_epi32(_mm_srai_epi32(sum, POLYPHASE_COEFFICIENT_BITS), sum);
+    output[0] = (int16_t) _mm_extract_epi16(sum, 0);
+    output[1] = (int16_t) _mm_extract_epi16(sum, 1);
+}
+#endif
+
+#ifdef USE_RESAMPLE_NEON
+static void btstack_resample_polyphase_stereo_neon(const int16_t * input, uint16_t t, int16_t * output){
+    // interpolate coefficients between phases as in btstack_resample_polyphase_coefficients
+    const int16_t * coefficients_0 = polyphase_coefficients[t >> 11];
+    const int16_t * coefficients_1 = polyphase_coefficients[(t >> 11) + 1];
+    const int16_t   fraction       = (int16_t)((t & 0x7ffu) << 4);
+    const int16x8_t c0_lo = vld1q_s16(&coefficients_0[0]);
+    const int16x8_t c0_hi = vld1q_s16(&coefficients_0[8]);
+    const int16x8_t c_lo = vaddq_s16(c0_lo, vqdmulhq_n_s16(vsubq_s16(vld1q_s16(&coefficients_1[0]), c0_lo), fraction));
+    const int16x8_t c_hi = vaddq_s16(c0_hi, vqdmulhq_n_s16(vsubq_s16(vld1q_s16(&coefficients_1[8]), c0_hi), fraction));
+    // deinterleave taps 0..7 and 8..15 into left and right
+    const int16x8x2_t x_lo = vld2q_s16(&input[0]);
+    const int16x8x2_t x_hi = vld2q_s16(&input[16]);
+    int32x4_t left  = vmull_s16(vget_low_s16(x_lo.val[0]), vget_low_s16(c_lo));
+    int32x4_t right = vmull_s16(vget_low_s16(x_lo.val[1]), vget_low_s16(c_lo));
+    left  = vmlal_s16(left,  vget_high_s16(x_lo.val[0]), vget_high_s16(c_lo));
+    right = vmlal_s16(right, vget_high_s16(x_lo.val[1]), vget_high_s16(c_lo));
+    left  = vmlal_s16(left,  vget_low_s16(x_hi.val[0]),  vget_low_s16(c_hi));
+    right = vmlal_s16(right, vget_low_s16(x_hi.val[1]),  vget_low_s16(c_hi));
+    left  = vmlal_s16(left,  vget_high_s16(x_hi.val[0]), vget_high_s16(c_hi));
+    right = vmlal_s16(right, vget_high_s16(x_hi.val[1]), vget_high_s16(c_hi));
+    const int32x2_t sum = vpadd_s32(vadd_s32(vget_low_s32(left),  vget_high_s32(left)),
+                                    vadd_s32(vget_low_s32(right), vget_high_s32(right)));
+    const int16x4_t result = vqrshrn_n_s32(vcombine_s32(sum, sum), POLYPHASE_COEFFICIENT_BITS);
+    output[0] = vget_lane_s16(result, 0);
+    output[1] = vget_lane_s16(result, 1);
+}
+#endif
+
+// process all source positions before frame 'end', input[0] is the frame at position 'start'
+static uint16_t btstack_resample_polyphase_run(btstack_resample_t * context, const int16_t * input, uint32_t start, uint32_t end, int16_t * output_buffer){
+    const int num_channels = context->num_channels;
+    uint16_t dest_frames = 0;
+    int16_t coefficients[BTSTACK_RESAMPLE_POLYPHASE_TAPS];
+    while ((context->src_pos >> 16) < end){
+        const int16_t * frames = &input[((context->src_pos >> 16) - start) * num_channels];
+        const uint16_t t = context->src_pos & 0xffffu;
+#if defined(USE_RESAMPLE_SSE2) || defined(USE_RESAMPLE_NEON)
+        if (num_channels == 2){
+#ifdef USE_RESAMPLE_SSE2
+            btstack_resample_polyphase_stereo_sse2(frames, t, output_buffer);
+#else
+            btstack_resample_polyphase_stereo_neon(frames, t, output_buffer);
+#endif
+            output_buffer += 2;
+            dest_frames++;
+            context->src_pos += context->src_step;
+            continue;
+        }
+#endif
+        btstack_resample_polyphase_coefficients(t, coefficients);
+        int i;
+        for (i=0;i<num_channels;i++){
+            *output_buffer++ = btstack_resample_polyphase_sample(&frames[i], num_channels, coefficients);
+        }
+        dest_frames++;
+        context->src_pos += context->src_step;
+    }
+    return dest_frames;
+}
+
+// source positions are relative to the history, i.e. the first frame of the current block is at POLYPHASE_HISTORY
+static uint16_t btstack_resample_block_polyphase(btstack_resample_t * context, const int16_t * input_buffer, uint32_t num_frames, int16_t * output_buffer){
+    const int num_channels = context->num_channels;
+    const uint32_t num_frames_edge = (num_frames < POLYPHASE_HISTORY) ? num_frames : POLYPHASE_HISTORY;
+    int16_t edge[2 * POLYPHASE_HISTORY * BTSTACK_RESAMPLE_MAX_CHANNELS];
+    uint16_t dest_frames;
+
+    // filter windows that include history
+    memcpy(edge, context->history, POLYPHASE_HISTORY * num_channels * sizeof(int16_t));
+    memcpy(&edge[POLYPHASE_HISTORY * num_channels], input_buffer, num_frames_edge * num_channels * sizeof(int16_t));
+    dest_frames  = btstack_resample_polyphase_run(context, edge, 0, num_frames_edge, output_buffer);
+
+    // filter windows within current block
+    dest_frames += btstack_resample_polyphase_run(context, input_buffer, POLYPHASE_HISTORY, num_frames, &output_buffer[dest_frames * num_channels]);
+    context->src_pos -= num_frames << 16;
+
+    // keep last frames
+    if (num_frames >= POLYPHASE_HISTORY){
+        memcpy(context->history, &input_buffer[(num_frames - POLYPHASE_HISTORY) * num_channels], POLYPHASE_HISTORY * num_channels * sizeof(int16_t));
+    } else {
+        memcpy(context->history, &edge[num_frames * num_channels], POLYPHASE_HISTORY * num_channels * sizeof(int16_t));
+    }
+    return dest_frames;
+}
+
+uint16_t btstack_resample_block(btstack_resample_t * context, const int16_t * input_buffer, uint32_t num_frames, int16_t * output_buffer){
+    if (context->mode == BTSTACK_RESAMPLE_MODE_POLYPHASE){
+        return btstack_resample_block_polyphase(context, input_buffer, num_frames, output_buffer);
+    }
+    return btstack_resample_block_linear(context, input_buffer, num_frames, output_buffer);
+}
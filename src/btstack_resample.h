@@ -47,16 +47,29 @@ extern "C" {
 /*
  *  btstack_resample.h
  *
- *  Linear resampling for 16-bit audio code samples using 16 bit/16 bit fixed point math
+ *  Resampling for 16-bit audio code samples using 16 bit/16 bit fixed point math,
+ *  either by linear interpolation or with a polyphase windowed-sinc filter
  */
 
 #define BTSTACK_RESAMPLE_MAX_CHANNELS 2
 
+// number of filter taps in polyphase mode
+#define BTSTACK_RESAMPLE_POLYPHASE_TAPS 16
+
+typedef enum {
+    BTSTACK_RESAMPLE_MODE_LINEAR = 0,
+    // higher quality, output is delayed by BTSTACK_RESAMPLE_POLYPHASE_TAPS / 2 frames
+    BTSTACK_RESAMPLE_MODE_POLYPHASE,
+} btstack_resample_mode_t;
+
 typedef struct {
     uint32_t src_pos;
     uint32_t src_step;
     int16_t  last_sample[BTSTACK_RESAMPLE_MAX_CHANNELS];
     int      num_channels;
+    btstack_resample_mode_t mode;
+    // last input frames for polyphase mode
+    int16_t  history[(BTSTACK_RESAMPLE_POLYPHASE_TAPS - 1) * BTSTACK_RESAMPLE_MAX_CHANNELS];
 } btstack_resample_t;
 
 /**
@@ -72,6 +85,12 @@ void btstack_resample_init(btstack_resample_t * context, int num_channels);
  */
 void btstack_resample_set_factor(btstack_resample_t * context, uint32_t factor);
 
+/**
+ * @brief Select resampling mode, resets resampling position
+ * @param mode
+ */
+void btstack_resample_set_mode(btstack_resample_t * context, btstack_resample_mode_t mode);
+
 /**
  * @brief Process block of input samples
  * @note size of output buffer is not checked
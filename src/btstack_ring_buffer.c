@@ -49,21 +49,53 @@
 
 #define ERROR_CODE_MEMORY_CAPACITY_EXCEEDED 0x07
 
+// producer owns last_written_index, consumer owns last_read_index. the index of the other side is loaded with
+// acquire semantics, an updated own index is stored with release semantics, so that storage accesses are ordered
+#ifdef ENABLE_RING_BUFFER_SPSC
+#define RING_BUFFER_LOAD_OWN(index)             __atomic_load_n(&(index), __ATOMIC_RELAXED)
+#define RING_BUFFER_LOAD_OTHER(index)           __atomic_load_n(&(index), __ATOMIC_ACQUIRE)
+#define RING_BUFFER_STORE_OWN(index, value)     __atomic_store_n(&(index), (value), __ATOMIC_RELEASE)
+#else
+#define RING_BUFFER_LOAD_OWN(index)             (index)
+#define RING_BUFFER_LOAD_OTHER(index)           (index)
+#define RING_BUFFER_STORE_OWN(index, value)     ((index) = (value))
+#endif
 
 // init ring buffer
 void btstack_ring_buffer_init(btstack_ring_buffer_t * ring_buffer, uint8_t * storage, uint32_t storage_size){
     ring_buffer->storage = storage;
     ring_buffer->size = storage_size;
-    ring_buffer->last_read_index = 0;
-    ring_buffer->last_written_index = 0;   
-    ring_buffer->full = 0;
+    RING_BUFFER_STORE_OWN(ring_buffer->last_read_index, 0);
+    RING_BUFFER_STORE_OWN(ring_buffer->last_written_index, 0);
+}
+
+static uint32_t btstack_ring_buffer_distance(btstack_ring_buffer_t * ring_buffer, uint32_t write_index, uint32_t read_index){
+    if (write_index >= read_index) return write_index - read_index;
+    return write_index + (2u * ring_buffer->size) - read_index;
+}
+
+static uint32_t btstack_ring_buffer_advance(btstack_ring_buffer_t * ring_buffer, uint32_t index, uint32_t length){
+    index += length;
+    if (index >= (2u * ring_buffer->size)){
+        index -= 2u * ring_buffer->size;
+    }
+    return index;
+}
+
+// get up to two regions starting at index
+static void btstack_ring_buffer_spans(btstack_ring_buffer_t * ring_buffer, uint32_t index, uint32_t length, btstack_ring_buffer_span_t spans[2]){
+    uint32_t offset = (index >= ring_buffer->size) ? (index - ring_buffer->size) : index;
+    uint32_t bytes_until_end = ring_buffer->size - offset;
+    spans[0].data = &ring_buffer->storage[offset];
+    spans[0].len  = btstack_min(bytes_until_end, length);
+    spans[1].data = ring_buffer->storage;
+    spans[1].len  = length - spans[0].len;
 }
 
 uint32_t btstack_ring_buffer_bytes_available(btstack_ring_buffer_t * ring_buffer){
-    if (ring_buffer->full) return ring_buffer->size;
-    int diff = ring_buffer->last_written_index - ring_buffer->last_read_index;
-    if (diff >= 0) return diff;
-    return diff + ring_buffer->size;
+    uint32_t read_index  = RING_BUFFER_LOAD_OTHER(ring_buffer->last_read_index);
+    uint32_t write_index = RING_BUFFER_LOAD_OTHER(ring_buffer->last_written_index);
+    return btstack_ring_buffer_distance(ring_buffer, write_index, read_index);
 }
 
 // test if ring buffer is empty
@@ -76,72 +108,65 @@ uint32_t btstack_ring_buffer_bytes_free(btstack_ring_buffer_t * ring_buffer){
     return ring_buffer->size - btstack_ring_buffer_bytes_available(ring_buffer);
 }
 
+uint32_t btstack_ring_buffer_reserve(btstack_ring_buffer_t * ring_buffer, uint32_t length, btstack_ring_buffer_span_t spans[2]){
+    uint32_t write_index = RING_BUFFER_LOAD_OWN(ring_buffer->last_written_index);
+    uint32_t read_index  = RING_BUFFER_LOAD_OTHER(ring_buffer->last_read_index);
+    uint32_t bytes_free  = ring_buffer->size - btstack_ring_buffer_distance(ring_buffer, write_index, read_index);
+    length = btstack_min(length, bytes_free);
+    btstack_ring_buffer_spans(ring_buffer, write_index, length, spans);
+    return length;
+}
+
+void btstack_ring_buffer_commit(btstack_ring_buffer_t * ring_buffer, uint32_t length){
+    uint32_t write_index = RING_BUFFER_LOAD_OWN(ring_buffer->last_written_index);
+    RING_BUFFER_STORE_OWN(ring_buffer->last_written_index, btstack_ring_buffer_advance(ring_buffer, write_index, length));
+}
+
+uint32_t btstack_ring_buffer_peek(btstack_ring_buffer_t * ring_buffer, uint32_t length, btstack_ring_buffer_span_t spans[2]){
+    uint32_t read_index  = RING_BUFFER_LOAD_OWN(ring_buffer->last_read_index);
+    uint32_t write_index = RING_BUFFER_LOAD_OTHER(ring_buffer->last_written_index);
+    length = btstack_min(length, btstack_ring_buffer_distance(ring_buffer, write_index, read_index));
+    btstack_ring_buffer_spans(ring_buffer, read_index, length, spans);
+    return length;
+}
+
+void btstack_ring_buffer_consume(btstack_ring_buffer_t * ring_buffer, uint32_t length){
+    uint32_t read_index = RING_BUFFER_LOAD_OWN(ring_buffer->last_read_index);
+    RING_BUFFER_STORE_OWN(ring_buffer->last_read_index, btstack_ring_buffer_advance(ring_buffer, read_index, length));
+}
+
 // add byte block to ring buffer, 
 int btstack_ring_buffer_write(btstack_ring_buffer_t * ring_buffer, uint8_t * data, uint32_t data_length){
-    if (btstack_ring_buffer_bytes_free(ring_buffer) < data_length){
+    btstack_ring_buffer_span_t spans[2];
+    if (btstack_ring_buffer_reserve(ring_buffer, data_length, spans) < data_length){
         return ERROR_CODE_MEMORY_CAPACITY_EXCEEDED;
     }
 
     // simplify logic below by asserting data_length > 0
     if (data_length == 0u) return 0u;
 
-    // copy first chunk
-    unsigned int bytes_until_end = ring_buffer->size - ring_buffer->last_written_index;
-    unsigned int bytes_to_copy = btstack_min(bytes_until_end, data_length);
-    (void)memcpy(&ring_buffer->storage[ring_buffer->last_written_index],
-                 data, bytes_to_copy);
-    data_length -= bytes_to_copy;
-    data += bytes_to_copy;
-
-    // update last written index
-    ring_buffer->last_written_index += bytes_to_copy;
-    if (ring_buffer->last_written_index == ring_buffer->size){
-        ring_buffer->last_written_index = 0;
-    }
-
-    // copy second chunk
-    if (data_length) {
-        (void)memcpy(&ring_buffer->storage[0], data, data_length);
-        ring_buffer->last_written_index += data_length;
-    }
-
-    // mark buffer as full
-    if (ring_buffer->last_written_index == ring_buffer->last_read_index){
-        ring_buffer->full = 1;
+    (void)memcpy(spans[0].data, data, spans[0].len);
+    if (spans[1].len) {
+        (void)memcpy(spans[1].data, &data[spans[0].len], spans[1].len);
     }
+    btstack_ring_buffer_commit(ring_buffer, data_length);
     return 0;
 } 
 
 // fetch data_length bytes from ring buffer
 void btstack_ring_buffer_read(btstack_ring_buffer_t * ring_buffer, uint8_t * data, uint32_t data_length, uint32_t * number_of_bytes_read){
     // limit data to get and report
-    data_length = btstack_min(data_length, btstack_ring_buffer_bytes_available(ring_buffer));
+    btstack_ring_buffer_span_t spans[2];
+    data_length = btstack_ring_buffer_peek(ring_buffer, data_length, spans);
     *number_of_bytes_read = data_length;
 
     // simplify logic below by asserting data_length > 0
     if (data_length == 0u) return;
 
-    // copy first chunk
-    unsigned int bytes_until_end = ring_buffer->size - ring_buffer->last_read_index;
-    unsigned int bytes_to_copy = btstack_min(bytes_until_end, data_length);
-    (void)memcpy(data, &ring_buffer->storage[ring_buffer->last_read_index],
-                 bytes_to_copy);
-    data_length -= bytes_to_copy;
-    data += bytes_to_copy;
-
-    // update last read index
-    ring_buffer->last_read_index += bytes_to_copy;
-    if (ring_buffer->last_read_index == ring_buffer->size){
-        ring_buffer->last_read_index = 0;
+    (void)memcpy(data, spans[0].data, spans[0].len);
+    if (spans[1].len) {
+        (void)memcpy(&data[spans[0].len], spans[1].data, spans[1].len);
     }
-
-    // copy second chunk
-    if (data_length) {
-        (void)memcpy(data, &ring_buffer->storage[0], data_length);
-        ring_buffer->last_read_index += data_length;
-    }
-
-    // clear full flag
-    ring_buffer->full = 0;
+    btstack_ring_buffer_consume(ring_buffer, data_length);
 } 
 
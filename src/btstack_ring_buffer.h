@@ -37,30 +37,45 @@
 
 /*
  *  btstack_ring_buffer.h
+ *
+ *  Byte ring buffer with copying read/write and zero-copy access via reserve/commit and peek/consume.
+ *
+ *  With ENABLE_RING_BUFFER_SPSC, read and write index are accessed atomically. Then, a single producer
+ *  (write, reserve/commit) and a single consumer (read, peek/consume) can use the ring buffer from
+ *  different threads or interrupt context without further locking.
  */
 
 #ifndef BTSTACK_RING_BUFFER_H
 #define BTSTACK_RING_BUFFER_H
 
+#include "btstack_config.h"
+
+#include <stdint.h>
+
 #if defined __cplusplus
 extern "C" {
 #endif
 
-#include <stdint.h>
-
 typedef struct btstack_ring_buffer {
     uint8_t  * storage;
-    uint32_t size;    
+    uint32_t size;
+    // indices in range [0, 2 * size) to distinguish full from empty buffer
+    // with ENABLE_RING_BUFFER_SPSC, only accessed via atomic load/store in btstack_ring_buffer.c
     uint32_t last_read_index;
     uint32_t last_written_index;
-    uint8_t  full;
 } btstack_ring_buffer_t;
 
+// contiguous region in ring buffer storage
+typedef struct {
+    uint8_t * data;
+    uint32_t  len;
+} btstack_ring_buffer_span_t;
+
 /**
  * Init ring buffer
  * @param ring_buffer object
  * @param storage
- * @param storage_size in bytes
+ * @param storage_size in bytes, max 2^31
  */
 void btstack_ring_buffer_init(btstack_ring_buffer_t * ring_buffer, uint8_t * storage, uint32_t storage_size);
 
@@ -103,6 +118,38 @@ int btstack_ring_buffer_write(btstack_ring_buffer_t * ring_buffer, uint8_t * dat
  */
 void btstack_ring_buffer_read(btstack_ring_buffer_t * ring_buffer, uint8_t * buffer, uint32_t length, uint32_t * number_of_bytes_read); 
 
+/**
+ * Get free space for writing in place, up to two regions if free space wraps around the end of storage
+ * @param ring_buffer object
+ * @param length requested
+ * @param spans receives regions, second region has len 0 if not needed
+ * @return number of bytes reserved, less than length if not enough space in buffer
+ */
+uint32_t btstack_ring_buffer_reserve(btstack_ring_buffer_t * ring_buffer, uint32_t length, btstack_ring_buffer_span_t spans[2]);
+
+/**
+ * Make bytes written into reserved regions available for read
+ * @param ring_buffer object
+ * @param length not larger than reserved
+ */
+void btstack_ring_buffer_commit(btstack_ring_buffer_t * ring_buffer, uint32_t length);
+
+/**
+ * Get data for reading in place, up to two regions if data wraps around the end of storage
+ * @param ring_buffer object
+ * @param length requested
+ * @param spans receives regions, second region has len 0 if not needed
+ * @return number of bytes available in spans, less than length if not enough data in buffer
+ */
+uint32_t btstack_ring_buffer_peek(btstack_ring_buffer_t * ring_buffer, uint32_t length, btstack_ring_buffer_span_t spans[2]);
+
+/**
+ * Release bytes returned by peek
+ * @param ring_buffer object
+ * @param length not larger than peeked
+ */
+void btstack_ring_buffer_consume(btstack_ring_buffer_t * ring_buffer, uint32_t length);
+
 #if defined __cplusplus
 }
 #endif
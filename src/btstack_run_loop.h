@@ -92,6 +92,10 @@ typedef struct btstack_timer_source {
     // will be called when timer fired
     void  (*process)(struct btstack_timer_source *ts); 
     void * context;
+#ifdef ENABLE_RUN_LOOP_TIMER_WHEEL
+    // timer wheel slot the timer has been added to, only valid while timer is active
+    uint16_t wheel_slot;
+#endif
 } btstack_timer_source_t;
 
 typedef struct btstack_run_loop {
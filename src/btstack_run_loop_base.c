@@ -49,13 +49,74 @@
 
 #include "btstack_run_loop_base.h"
 
+#include <string.h>
+
 // private data (access only by run loop implementations)
 btstack_linked_list_t btstack_run_loop_base_timers;
 btstack_linked_list_t btstack_run_loop_base_data_sources;
 
+#ifdef ENABLE_RUN_LOOP_TIMER_WHEEL
+
+/*
+ * Hashed timer wheel: timers are stored in the slot given by the lower bits of their timeout,
+ * each slot list is sorted by timeout. With timers spread over the wheel, add and remove only
+ * need to look at a few timers. Processing advances the wheel time slot by slot up to now,
+ * at most one revolution per call.
+ */
+
+#ifndef BTSTACK_RUN_LOOP_TIMER_WHEEL_SIZE
+#define BTSTACK_RUN_LOOP_TIMER_WHEEL_SIZE 256
+#endif
+
+#if (BTSTACK_RUN_LOOP_TIMER_WHEEL_SIZE & (BTSTACK_RUN_LOOP_TIMER_WHEEL_SIZE - 1)) != 0
+#error "BTSTACK_RUN_LOOP_TIMER_WHEEL_SIZE must be a power of two"
+#endif
+
+#define TIMER_WHEEL_MASK (BTSTACK_RUN_LOOP_TIMER_WHEEL_SIZE - 1)
+
+// timers that already expired when added are kept in an additional slot
+#define TIMER_WHEEL_SLOT_EXPIRED BTSTACK_RUN_LOOP_TIMER_WHEEL_SIZE
+
+static btstack_linked_list_t timer_wheel[BTSTACK_RUN_LOOP_TIMER_WHEEL_SIZE + 1];
+
+// all timers with timeout up to timer_wheel_time have been processed
+static uint32_t timer_wheel_time;
+static uint32_t timer_wheel_num_timers;
+
+// cached earliest timeout
+static bool     timer_wheel_next_timeout_valid;
+static uint32_t timer_wheel_next_timeout;
+
+#endif
+
+// insert timer into list sorted by timeout, after timers with the same timeout
+static bool btstack_run_loop_base_insert_timer(btstack_linked_list_t * timers, btstack_timer_source_t *ts){
+    btstack_linked_item_t *it;
+    for (it = (btstack_linked_item_t *) timers; it->next ; it = it->next){
+        // don't add timer that's already in there
+        if ((btstack_timer_source_t *) it->next == ts){
+            log_error( "btstack_run_loop_timer_add error: timer to add already in list!");
+            return false;
+        }
+        // exit if list timeout is after new timeout
+        uint32_t list_timeout = ((btstack_timer_source_t *) it->next)->timeout;
+        int32_t delta = btstack_time_delta(ts->timeout, list_timeout);
+        if (delta < 0) break;
+    }
+    ts->item.next = it->next;
+    it->next = (btstack_linked_item_t *) ts;
+    return true;
+}
+
 void btstack_run_loop_base_init(void){
     btstack_run_loop_base_timers = NULL;
     btstack_run_loop_base_data_sources = NULL;    
+#ifdef ENABLE_RUN_LOOP_TIMER_WHEEL
+    memset(timer_wheel, 0, sizeof(timer_wheel));
+    timer_wheel_time = 0;
+    timer_wheel_num_timers = 0;
+    timer_wheel_next_timeout_valid = false;
+#endif
 }
 
 void btstack_run_loop_base_add_data_source(btstack_data_source_t *ds){
@@ -74,26 +135,132 @@ void btstack_run_loop_base_disable_data_source_callbacks(btstack_data_source_t *
     ds->flags &= ~callback_types;
 }
 
+#ifdef ENABLE_RUN_LOOP_TIMER_WHEEL
 
 bool btstack_run_loop_base_remove_timer(btstack_timer_source_t *ts){
-    return btstack_linked_list_remove(&btstack_run_loop_base_timers, (btstack_linked_item_t *) ts);
+    // wheel_slot is only valid if timer is active, if not, timer isn't in the slot either
+    if (ts->wheel_slot > TIMER_WHEEL_SLOT_EXPIRED) return false;
+    bool removed = btstack_linked_list_remove(&timer_wheel[ts->wheel_slot], (btstack_linked_item_t *) ts);
+    if (!removed) return false;
+    timer_wheel_num_timers--;
+    // timeout might have been changed while timer was active, cached earliest timeout could belong to this timer
+    timer_wheel_next_timeout_valid = false;
+    return true;
 }
 
 void btstack_run_loop_base_add_timer(btstack_timer_source_t *ts){
-    btstack_linked_item_t *it;
-    for (it = (btstack_linked_item_t *) &btstack_run_loop_base_timers; it->next ; it = it->next){
-        // don't add timer that's already in there
-        if ((btstack_timer_source_t *) it->next == ts){
-            log_error( "btstack_run_loop_timer_add error: timer to add already in list!");
-            return;
+    uint16_t slot;
+    if (btstack_time_delta(ts->timeout, timer_wheel_time) <= 0){
+        slot = TIMER_WHEEL_SLOT_EXPIRED;
+    } else {
+        slot = ts->timeout & TIMER_WHEEL_MASK;
+    }
+    if (!btstack_run_loop_base_insert_timer(&timer_wheel[slot], ts)){
+        // timer already active, its timeout might have been changed
+        timer_wheel_next_timeout_valid = false;
+        return;
+    }
+    ts->wheel_slot = slot;
+    timer_wheel_num_timers++;
+    if (timer_wheel_num_timers == 1){
+        timer_wheel_next_timeout_valid = true;
+        timer_wheel_next_timeout = ts->timeout;
+    } else if (timer_wheel_next_timeout_valid && (btstack_time_delta(ts->timeout, timer_wheel_next_timeout) < 0)){
+        timer_wheel_next_timeout = ts->timeout;
+    }
+}
+
+// get first timer in slot if it expired at given time
+static btstack_timer_source_t * btstack_run_loop_base_get_expired_timer(uint16_t slot, uint32_t time){
+    btstack_timer_source_t * ts = (btstack_timer_source_t *) timer_wheel[slot];
+    if (ts == NULL) return NULL;
+    if (btstack_time_delta(ts->timeout, time) > 0) return NULL;
+    return ts;
+}
+
+void  btstack_run_loop_base_process_timers(uint32_t now){
+    // sync wheel time if there are no timers
+    if (timer_wheel_num_timers == 0){
+        timer_wheel_time = now;
+        return;
+    }
+
+    // advance at most one revolution
+    int32_t steps = btstack_time_delta(now, timer_wheel_time);
+    if (steps < 0){
+        steps = 0;
+    }
+    if (steps >= BTSTACK_RUN_LOOP_TIMER_WHEEL_SIZE){
+        timer_wheel_time = now - BTSTACK_RUN_LOOP_TIMER_WHEEL_SIZE;
+        steps = BTSTACK_RUN_LOOP_TIMER_WHEEL_SIZE;
+    }
+
+    while (true){
+        // process expired timers first, then timers in current slot. timers added by the timer handler get processed, too
+        btstack_timer_source_t * ts = btstack_run_loop_base_get_expired_timer(TIMER_WHEEL_SLOT_EXPIRED, timer_wheel_time);
+        if (ts == NULL){
+            ts = btstack_run_loop_base_get_expired_timer(timer_wheel_time & TIMER_WHEEL_MASK, timer_wheel_time);
         }
-        // exit if list timeout is after new timeout
-        uint32_t list_timeout = ((btstack_timer_source_t *) it->next)->timeout;
-        int32_t delta = btstack_time_delta(ts->timeout, list_timeout);
-        if (delta < 0) break;
+        if (ts != NULL){
+            btstack_run_loop_base_remove_timer(ts);
+            ts->process(ts);
+            continue;
+        }
+        if (steps == 0) break;
+        steps--;
+        timer_wheel_time++;
     }
-    ts->item.next = it->next;
-    it->next = (btstack_linked_item_t *) ts;
+}
+
+/**
+ * @brief Get time until first timer fires
+ * @returns -1 if no timers, time until next timeout otherwise
+ */
+int32_t btstack_run_loop_base_get_time_until_timeout(uint32_t now){
+    if (timer_wheel_num_timers == 0) {
+        timer_wheel_time = now;
+        return -1;
+    }
+    if (timer_wheel_next_timeout_valid == false){
+        // each slot is sorted, find earliest timeout among first timers
+        uint16_t slot;
+        for (slot = 0; slot <= TIMER_WHEEL_SLOT_EXPIRED; slot++){
+            btstack_timer_source_t * ts = (btstack_timer_source_t *) timer_wheel[slot];
+            if (ts == NULL) continue;
+            if ((timer_wheel_next_timeout_valid == false) || (btstack_time_delta(ts->timeout, timer_wheel_next_timeout) < 0)){
+                timer_wheel_next_timeout = ts->timeout;
+                timer_wheel_next_timeout_valid = true;
+            }
+        }
+    }
+    int32_t delta = btstack_time_delta(timer_wheel_next_timeout, now);
+    if (delta < 0){
+        delta = 0;
+    }
+    return delta;
+}
+
+void btstack_run_loop_base_dump_timer(void){
+#ifdef ENABLE_LOG_INFO
+    uint16_t slot;
+    for (slot = 0; slot <= TIMER_WHEEL_SLOT_EXPIRED; slot++){
+        btstack_linked_item_t *it;
+        for (it = (btstack_linked_item_t *) timer_wheel[slot]; it ; it = it->next){
+            btstack_timer_source_t *ts = (btstack_timer_source_t*) it;
+            log_info("timer %p, slot %u, timeout %u\n", ts, slot, (unsigned int) ts->timeout);
+        }
+    }
+#endif
+}
+
+#else
+
+bool btstack_run_loop_base_remove_timer(btstack_timer_source_t *ts){
+    return btstack_linked_list_remove(&btstack_run_loop_base_timers, (btstack_linked_item_t *) ts);
+}
+
+void btstack_run_loop_base_add_timer(btstack_timer_source_t *ts){
+    (void) btstack_run_loop_base_insert_timer(&btstack_run_loop_base_timers, ts);
 }
 
 void  btstack_run_loop_base_process_timers(uint32_t now){
@@ -121,3 +288,16 @@ int32_t btstack_run_loop_base_get_time_until_timeout(uint32_t now){
     }
     return delta;
 }
+
+void btstack_run_loop_base_dump_timer(void){
+#ifdef ENABLE_LOG_INFO
+    btstack_linked_item_t *it;
+    uint16_t i = 0;
+    for (it = (btstack_linked_item_t *) btstack_run_loop_base_timers; it ; it = it->next){
+        btstack_timer_source_t *ts = (btstack_timer_source_t*) it;
+        log_info("timer %u (%p): timeout %u\n", i++, ts, (unsigned int) ts->timeout);
+    }
+#endif
+}
+
+#endif
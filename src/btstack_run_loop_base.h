@@ -55,6 +55,7 @@ extern "C" {
 #endif
 
 // private data (access only by run loop implementations)
+// timers are only stored in btstack_run_loop_base_timers if ENABLE_RUN_LOOP_TIMER_WHEEL is not defined
 extern btstack_linked_list_t btstack_run_loop_base_timers;
 extern btstack_linked_list_t btstack_run_loop_base_data_sources;
 	
@@ -88,6 +89,11 @@ void  btstack_run_loop_base_process_timers(uint32_t now);
  */
 int32_t btstack_run_loop_base_get_time_until_timeout(uint32_t now);
 
+/**
+ * @brief Log all active timers
+ */
+void btstack_run_loop_base_dump_timer(void);
+
 /**
  * @brief Add data source to run loop
  * @param data_source to add
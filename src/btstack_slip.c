@@ -42,6 +42,8 @@
  *  SLIP encoder/decoder
  */
 
+#include <string.h>
+
 #include "btstack_slip.h"
 #include "btstack_debug.h"
 
@@ -73,8 +75,59 @@ static uint16_t  decoder_max_size;
 static uint16_t  decoder_pos;
 
 
+// returns offset of first SOF or ESC byte, or len if data does not contain any
+static uint16_t btstack_slip_find_special_byte(const uint8_t * data, uint16_t len){
+    uint16_t pos = 0;
+    // test four bytes at a time: a byte matches if (byte ^ pattern) is zero
+    while ((pos + 4u) <= len){
+        uint32_t word;
+        (void)memcpy(&word, &data[pos], 4);
+        uint32_t sof = word ^ 0xc0c0c0c0u;
+        uint32_t esc = word ^ 0xdbdbdbdbu;
+        uint32_t zero_bytes = ((sof - 0x01010101u) & ~sof) | ((esc - 0x01010101u) & ~esc);
+        if ((zero_bytes & 0x80808080u) != 0u) break;
+        pos += 4u;
+    }
+    while (pos < len){
+        if ((data[pos] == BTSTACK_SLIP_SOF) || (data[pos] == 0xdbu)) break;
+        pos++;
+    }
+    return pos;
+}
+
 // ENCODER
 
+/**
+ * @brief Encode data into buffer in a single pass
+ * @param buffer for encoded data
+ * @param size of buffer, 2 * len is sufficient for any data
+ * @param data to encode
+ * @param len of data
+ * @return number of bytes stored in buffer, 0 if buffer is too small
+ */
+uint16_t btstack_slip_encode(uint8_t * buffer, uint16_t size, const uint8_t * data, uint16_t len){
+    uint16_t pos_in  = 0;
+    uint16_t pos_out = 0;
+    while (pos_in < len){
+        // copy regular bytes
+        uint16_t run = btstack_slip_find_special_byte(&data[pos_in], len - pos_in);
+        if (run > (size - pos_out)) break;
+        (void)memcpy(&buffer[pos_out], &data[pos_in], run);
+        pos_in  += run;
+        pos_out += run;
+        if (pos_in == len) return pos_out;
+        // escape SOF or ESC
+        if ((pos_out + 2u) > size) break;
+        buffer[pos_out++] = 0xdb;
+        buffer[pos_out++] = (data[pos_in++] == BTSTACK_SLIP_SOF) ? 0xdc : 0xdd;
+    }
+    if (pos_in < len){
+        log_error("btstack_slip_encode: buffer too small");
+        return 0;
+    }
+    return pos_out;
+}
+
 /**
  * @brief Initialise SLIP encoder with data
  * @param data
@@ -143,6 +196,17 @@ static void btstack_slip_decoder_store_byte(uint8_t input){
 	decoder_buffer[decoder_pos++] = input;
 }
 
+static void btstack_slip_decoder_store_bytes(const uint8_t * data, uint16_t len){
+	if ((decoder_max_size - decoder_pos) < len){
+	    log_error("btstack_slip_decoder_store_bytes: packet to long");
+	    // drop frame, wait for next SOF
+	    btstack_slip_decoder_reset();
+	    return;
+	}
+	(void)memcpy(&decoder_buffer[decoder_pos], data, len);
+	decoder_pos += len;
+}
+
 /**
  * @brief Initialise SLIP decoder with buffer
  * @param buffer to store received data
@@ -218,6 +282,31 @@ void btstack_slip_decoder_process(uint8_t input){
     }
 }
 
+/**
+ * @brief Process block of received bytes, stops after a complete frame
+ * @param data
+ * @param len
+ * @return number of bytes consumed
+ */
+uint16_t btstack_slip_decoder_process_block(const uint8_t * data, uint16_t len){
+	uint16_t pos = 0;
+	while (pos < len){
+		if (decoder_state == SLIP_DECODER_COMPLETE) break;
+		if ((decoder_state == SLIP_DECODER_ACTIVE) || (decoder_state == SLIP_DECODER_X_C0)){
+			// copy regular bytes straight into decoder buffer
+			uint16_t run = btstack_slip_find_special_byte(&data[pos], len - pos);
+			if (run > 0u){
+				decoder_state = SLIP_DECODER_ACTIVE;
+				btstack_slip_decoder_store_bytes(&data[pos], run);
+				pos += run;
+				continue;
+			}
+		}
+		btstack_slip_decoder_process(data[pos++]);
+	}
+	return pos;
+}
+
 /**
  * @brief Get size of decoded frame
  * @return size of frame. Size = 0 => frame not complete
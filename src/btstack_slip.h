@@ -53,6 +53,16 @@ extern "C" {
 
 // ENCODER
 
+/**
+ * @brief Encode data into buffer in a single pass
+ * @param buffer for encoded data
+ * @param size of buffer, 2 * len is sufficient for any data
+ * @param data to encode
+ * @param len of data
+ * @return number of bytes stored in buffer, 0 if buffer is too small
+ */
+uint16_t btstack_slip_encode(uint8_t * buffer, uint16_t size, const uint8_t * data, uint16_t len);
+
 /**
  * @brief Initialise SLIP encoder with data
  * @param data
@@ -88,6 +98,14 @@ void btstack_slip_decoder_init(uint8_t * buffer, uint16_t max_size);
 
 void btstack_slip_decoder_process(uint8_t input);
 
+/**
+ * @brief Process block of received bytes, stops after a complete frame
+ * @param data
+ * @param len
+ * @return number of bytes consumed. If frame is complete, btstack_slip_decoder_frame_size returns its size
+ */
+uint16_t btstack_slip_decoder_process_block(const uint8_t * data, uint16_t len);
+
 /**
  * @brief Get size of decoded frame
  * @return size of frame. Size = 0 => frame not complete
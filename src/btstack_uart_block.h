@@ -143,6 +143,18 @@ typedef struct {
      */
     void (*set_wakeup_handler)(void (*wakeup_handler)(void));
 
+    // optional support for partial reads, e.g. to decode SLIP frames in H5 from larger blocks
+
+    /**
+     * set callback for receive_bytes
+     */
+    void (*set_bytes_received)(void (*bytes_handler)(uint16_t num_bytes));
+
+    /**
+     * receive up to len bytes, bytes_handler is called as soon as at least one byte has been received
+     */
+    void (*receive_bytes)(uint8_t *buffer, uint16_t len);
+
 } btstack_uart_block_t;
 
 // common implementations
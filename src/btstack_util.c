@@ -420,6 +420,14 @@ int count_set_bits_uint32(uint32_t x){
     return x;
 }
 
+uint16_t btstack_strcpy(char * dst, uint16_t dst_size, const char * src){
+    if (dst_size == 0u) return 0;
+    uint16_t bytes_to_copy = (uint16_t) btstack_min((uint32_t) dst_size - 1u, (uint32_t) strlen(src));
+    (void) memcpy(dst, src, bytes_to_copy);
+    dst[bytes_to_copy] = 0;
+    return bytes_to_copy + 1u;
+}
+
 /*  
  * CRC (reversed crc) lookup table as calculated by the table generator in ETSI TS 101 369 V6.3.0.
  */
@@ -281,6 +281,16 @@ int string_len_for_uint32(uint32_t i);
  */
 int count_set_bits_uint32(uint32_t x);
 
+/**
+ * @brief Copy string (up to dst_size-1 characters) from src into dst buffer with terminating '\0'
+ * @note replaces strncpy + dst[dst_size-1] = '\0'
+ * @param dst
+ * @param dst_size
+ * @param src
+ * @return bytes_copied including trailing 0
+ */
+uint16_t btstack_strcpy(char * dst, uint16_t dst_size, const char * src);
+
 /**
  * CRC8 functions using ETSI TS 101 369 V6.3.0.
  * Only used by RFCOMM
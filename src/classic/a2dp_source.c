@@ -627,3 +627,11 @@ int a2dp_max_media_payload_size(uint16_t a2dp_cid, uint8_t local_seid){
 int a2dp_source_stream_send_media_payload(uint16_t a2dp_cid, uint8_t local_seid, uint8_t * storage, int num_bytes_to_copy, uint8_t num_frames, uint8_t marker){
     return avdtp_source_stream_send_media_payload(a2dp_cid, local_seid, storage, num_bytes_to_copy, num_frames, marker);
 }
+
+uint8_t * a2dp_source_stream_reserve_media_payload(uint16_t a2dp_cid, uint8_t local_seid){
+    return avdtp_source_stream_reserve_media_payload(a2dp_cid, local_seid);
+}
+
+uint8_t a2dp_source_stream_send_prepared_media_payload(uint16_t a2dp_cid, uint8_t local_seid, int num_bytes, uint8_t num_frames, uint8_t marker){
+    return avdtp_source_stream_send_prepared_media_payload(a2dp_cid, local_seid, num_bytes, num_frames, marker);
+}
@@ -168,6 +168,28 @@ int 	a2dp_max_media_payload_size(uint16_t a2dp_cid, uint8_t local_seid);
  */
 int  	a2dp_source_stream_send_media_payload(uint16_t a2dp_cid, uint8_t local_seid, uint8_t * storage, int num_bytes_to_copy, uint8_t num_frames, uint8_t marker);
 
+/**
+ * @brief Reserve outgoing buffer and return pointer to media payload, which follows the media header and the number of frames.
+ * @note  Call on reception of A2DP_SUBEVENT_STREAMING_CAN_SEND_MEDIA_PACKET_NOW event, then fill in up to
+ *        a2dp_max_media_payload_size() - 1 bytes, e.g. with btstack_sbc_encoder_process_data_batch_ctx,
+ *        and call a2dp_source_stream_send_prepared_media_payload.
+ * @param a2dp_cid 			A2DP channel identifyer.
+ * @param local_seid  		ID of a local stream endpoint.
+ * @return pointer to media payload or NULL if no media connection or buffer already reserved
+ */
+uint8_t * a2dp_source_stream_reserve_media_payload(uint16_t a2dp_cid, uint8_t local_seid);
+
+/**
+ * @brief Send media payload prepared in buffer returned by a2dp_source_stream_reserve_media_payload.
+ * @param a2dp_cid 			A2DP channel identifyer.
+ * @param local_seid  		ID of a local stream endpoint.
+ * @param num_bytes         size of media payload
+ * @param num_frames
+ * @param marker
+ * @return status ERROR_CODE_SUCCESS if successful
+ */
+uint8_t a2dp_source_stream_send_prepared_media_payload(uint16_t a2dp_cid, uint8_t local_seid, int num_bytes, uint8_t num_frames, uint8_t marker);
+
 /* API_END */
 
 #if defined __cplusplus
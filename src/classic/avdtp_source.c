@@ -231,6 +231,54 @@ int avdtp_source_stream_send_media_payload(uint16_t avdtp_cid, uint8_t local_sei
     return size;
 }
 
+uint8_t * avdtp_source_stream_reserve_media_payload(uint16_t avdtp_cid, uint8_t local_seid){
+    UNUSED(avdtp_cid);
+
+    avdtp_stream_endpoint_t * stream_endpoint = avdtp_get_stream_endpoint_for_seid(local_seid);
+    if (!stream_endpoint) {
+        log_error("avdtp source: no stream_endpoint with seid %d", local_seid);
+        return NULL;
+    }
+
+    if (stream_endpoint->l2cap_media_cid == 0){
+        log_error("avdtp source: no media connection for seid %d", local_seid);
+        return NULL;
+    }
+
+    if (!l2cap_reserve_packet_buffer()){
+        return NULL;
+    }
+
+    // payload starts after media header and frame count
+    return l2cap_get_outgoing_buffer() + AVDTP_MEDIA_PAYLOAD_HEADER_SIZE + 1;
+}
+
+uint8_t avdtp_source_stream_send_prepared_media_payload(uint16_t avdtp_cid, uint8_t local_seid, int num_bytes, uint8_t num_frames, uint8_t marker){
+    UNUSED(avdtp_cid);
+
+    avdtp_stream_endpoint_t * stream_endpoint = avdtp_get_stream_endpoint_for_seid(local_seid);
+    if ((stream_endpoint == NULL) || (stream_endpoint->l2cap_media_cid == 0)){
+        log_error("avdtp source: no media connection for seid %d", local_seid);
+        l2cap_release_packet_buffer();
+        return ERROR_CODE_UNKNOWN_CONNECTION_IDENTIFIER;
+    }
+
+    int size = btstack_min(l2cap_get_remote_mtu_for_local_cid(stream_endpoint->l2cap_media_cid), l2cap_max_mtu());
+    if (size < (AVDTP_MEDIA_PAYLOAD_HEADER_SIZE + 1 + num_bytes)){
+        log_error("small outgoing buffer: buffer size %u, but need %u", size, AVDTP_MEDIA_PAYLOAD_HEADER_SIZE + 1 + num_bytes);
+        l2cap_release_packet_buffer();
+        return ERROR_CODE_INVALID_HCI_COMMAND_PARAMETERS;
+    }
+
+    int offset = 0;
+    uint8_t * media_packet = l2cap_get_outgoing_buffer();
+    avdtp_source_setup_media_header(media_packet, size, &offset, marker, stream_endpoint->sequence_number);
+    media_packet[offset++] = num_frames;
+    offset += num_bytes;
+    stream_endpoint->sequence_number++;
+    return (uint8_t) l2cap_send_prepared(stream_endpoint->l2cap_media_cid, offset);
+}
+
 void avdtp_source_stream_endpoint_request_can_send_now(uint16_t avdtp_cid, uint8_t local_seid){
     UNUSED(avdtp_cid);
     
@@ -256,5 +304,6 @@ int avdtp_max_media_payload_size(uint16_t avdtp_cid, uint8_t local_seid){
         log_error("A2DP source: no media connection for seid %d", local_seid);
         return 0;
     }  
-    return l2cap_get_remote_mtu_for_local_cid(stream_endpoint->l2cap_media_cid) - AVDTP_MEDIA_PAYLOAD_HEADER_SIZE;
+    // media payload is written into outgoing buffer, which might be smaller than remote MTU
+    return btstack_min(l2cap_get_remote_mtu_for_local_cid(stream_endpoint->l2cap_media_cid), l2cap_max_mtu()) - AVDTP_MEDIA_PAYLOAD_HEADER_SIZE;
 }
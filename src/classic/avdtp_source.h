@@ -243,6 +243,27 @@ avdtp_stream_endpoint_t * avdtp_source_create_stream_endpoint(avdtp_sep_type_t s
  */
 int avdtp_source_stream_send_media_payload(uint16_t avdtp_cid, uint8_t local_seid, uint8_t * storage, int num_bytes_to_copy, uint8_t num_frames, uint8_t marker);
 
+/**
+ * @brief Reserve outgoing buffer and return pointer to media payload, which follows the media header and the number of frames.
+ * @note  Call on reception of AVDTP_SUBEVENT_STREAMING_CAN_SEND_MEDIA_PACKET_NOW event, then fill in up to
+ *        avdtp_max_media_payload_size() - 1 bytes and call avdtp_source_stream_send_prepared_media_payload.
+ * @param avdtp_cid         AVDTP channel identifyer.
+ * @param local_seid        ID of a local stream endpoint.
+ * @return pointer to media payload or NULL if no media connection or buffer already reserved
+ */
+uint8_t * avdtp_source_stream_reserve_media_payload(uint16_t avdtp_cid, uint8_t local_seid);
+
+/**
+ * @brief Send media payload prepared in buffer returned by avdtp_source_stream_reserve_media_payload.
+ * @param avdtp_cid         AVDTP channel identifyer.
+ * @param local_seid        ID of a local stream endpoint.
+ * @param num_bytes         size of media payload
+ * @param num_frames
+ * @param marker
+ * @return status ERROR_CODE_SUCCESS if successful
+ */
+uint8_t avdtp_source_stream_send_prepared_media_payload(uint16_t avdtp_cid, uint8_t local_seid, int num_bytes, uint8_t num_frames, uint8_t marker);
+
 /**
  * @brief Request to send a media packet. Packet can be then sent on reception of AVDTP_SUBEVENT_STREAMING_CAN_SEND_MEDIA_PACKET_NOW event.
  * @param avdtp_cid         AVDTP channel identifyer.
@@ -69,10 +69,19 @@ typedef struct {
     int zero_frames_nr;
 } btstack_sbc_decoder_state_t;
 
+// size of per-instance SBC encoder storage, verified at compile time by the encoder implementation
+#ifndef BTSTACK_SBC_ENCODER_STORAGE_SIZE
+#define BTSTACK_SBC_ENCODER_STORAGE_SIZE 2816
+#endif
+
 typedef struct {
     // private
     void * encoder_state;
     btstack_sbc_mode_t mode;
+    union {
+        void *  alignment;
+        uint8_t data[BTSTACK_SBC_ENCODER_STORAGE_SIZE];
+    } storage;
 } btstack_sbc_encoder_state_t;
 
 /* API_START */
@@ -116,6 +125,9 @@ int btstack_sbc_decoder_sample_rate(btstack_sbc_decoder_state_t * state);
 /* BTstack SBC Encoder */
 /**
  * @brief Init SBC encoder
+ * @note  Each state is an independent encoder instance with its own buffers. Different instances
+ *        can be used in parallel, e.g. from different threads. The functions without _ctx suffix
+ *        operate on the state most recently passed to btstack_sbc_encoder_init.
  * @param state
  * @param mode 
  * @param blocks
@@ -150,6 +162,44 @@ uint16_t  btstack_sbc_encoder_sbc_buffer_length(void);
  */
 int  btstack_sbc_encoder_num_audio_frames(void);
 
+/**
+ * @brief Encode PCM data using given encoder instance
+ * @param state
+ * @param buffer with samples in host endianess
+ */
+void btstack_sbc_encoder_process_data_ctx(btstack_sbc_encoder_state_t * state, int16_t * input_buffer);
+
+/**
+ * @brief Return SBC frame of given encoder instance
+ * @param state
+ */
+uint8_t * btstack_sbc_encoder_sbc_buffer_ctx(btstack_sbc_encoder_state_t * state);
+
+/**
+ * @brief Return SBC frame length of given encoder instance
+ * @note  valid after btstack_sbc_encoder_init, the length is constant for a given configuration
+ * @param state
+ */
+uint16_t  btstack_sbc_encoder_sbc_buffer_length_ctx(btstack_sbc_encoder_state_t * state);
+
+/**
+ * @brief Return number of audio frames required for one SBC packet of given encoder instance
+ * @note  each audio frame contains 2 sample values in stereo modes
+ * @param state
+ */
+int  btstack_sbc_encoder_num_audio_frames_ctx(btstack_sbc_encoder_state_t * state);
+
+/**
+ * @brief Encode multiple SBC frames directly into provided buffer, e.g. an outgoing media packet
+ * @note  btstack_sbc_encoder_sbc_buffer_ctx does not return the frames encoded by this function
+ * @param state
+ * @param input_buffer with num_sbc_frames * btstack_sbc_encoder_num_audio_frames_ctx audio frames in host endianess
+ * @param num_sbc_frames
+ * @param sbc_buffer with space for num_sbc_frames * btstack_sbc_encoder_sbc_buffer_length_ctx bytes
+ * @return number of bytes written to sbc_buffer
+ */
+uint16_t btstack_sbc_encoder_process_data_batch_ctx(btstack_sbc_encoder_state_t * state, int16_t * input_buffer, uint8_t num_sbc_frames, uint8_t * sbc_buffer);
+
 /* API_END */
 
 // testing only
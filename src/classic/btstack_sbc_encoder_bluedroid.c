@@ -68,69 +68,92 @@ typedef struct {
     uint8_t sbc_packet[1000];
 } bludroid_encoder_state_t;
 
+// bluedroid encoder state is stored in btstack_sbc_encoder_state_t, fails to compile if storage is too small
+typedef char btstack_sbc_encoder_storage_size_check[(sizeof(bludroid_encoder_state_t) <= BTSTACK_SBC_ENCODER_STORAGE_SIZE) ? 1 : -1];
+
+// state used by functions without _ctx suffix
 static btstack_sbc_encoder_state_t * sbc_encoder_state_singleton = NULL;
-static bludroid_encoder_state_t bd_encoder_state;
 
+static SBC_ENC_PARAMS * btstack_sbc_encoder_context(btstack_sbc_encoder_state_t * state){
+    return &((bludroid_encoder_state_t *)state->encoder_state)->context;
+}
+
+// SBC frame length according to A2DP specification, 12.9
+static uint16_t btstack_sbc_encoder_frame_length(const SBC_ENC_PARAMS * context){
+    int num_subbands = context->s16NumOfSubBands;
+    int num_channels = context->s16NumOfChannels;
+    int num_bits;
+    switch (context->s16ChannelMode){
+        case SBC_JOINT_STEREO:
+            num_bits = num_subbands + (context->s16NumOfBlocks * context->s16BitPool);
+            break;
+        case SBC_STEREO:
+            num_bits = context->s16NumOfBlocks * context->s16BitPool;
+            break;
+        default:
+            num_bits = context->s16NumOfBlocks * num_channels * context->s16BitPool;
+            break;
+    }
+    return (uint16_t) (4 + ((4 * num_subbands * num_channels) / 8) + ((num_bits + 7) / 8));
+}
 
 void btstack_sbc_encoder_init(btstack_sbc_encoder_state_t * state, btstack_sbc_mode_t mode, 
                         int blocks, int subbands, int allmethod, int sample_rate, int bitpool, int channel_mode){
 
-    if (sbc_encoder_state_singleton && (sbc_encoder_state_singleton != state) ){
-        log_error("SBC encoder: different sbc decoder state is allready registered");
-    } 
-    
-    sbc_encoder_state_singleton = state;
-
-    if (!sbc_encoder_state_singleton){
+    if (!state){
         log_error("SBC encoder init: sbc state is NULL");
+        return;
     }
 
-    sbc_encoder_state_singleton->mode = mode;
+    sbc_encoder_state_singleton = state;
+
+    bludroid_encoder_state_t * bd_encoder_state = (bludroid_encoder_state_t *) &state->storage;
+    memset(bd_encoder_state, 0, sizeof(bludroid_encoder_state_t));
 
-    switch (sbc_encoder_state_singleton->mode){
+    state->mode = mode;
+
+    switch (state->mode){
         case SBC_MODE_STANDARD:
-            bd_encoder_state.context.s16NumOfBlocks = blocks;                          
-            bd_encoder_state.context.s16NumOfSubBands = subbands;                       
-            bd_encoder_state.context.s16AllocationMethod = allmethod;                     
-            bd_encoder_state.context.s16BitPool = bitpool;  
-            bd_encoder_state.context.mSBCEnabled = 0;
-            bd_encoder_state.context.s16ChannelMode = channel_mode;
-            bd_encoder_state.context.s16NumOfChannels = 2;
-            if (bd_encoder_state.context.s16ChannelMode == SBC_MONO){
-                bd_encoder_state.context.s16NumOfChannels = 1;
+            bd_encoder_state->context.s16NumOfBlocks = blocks;                          
+            bd_encoder_state->context.s16NumOfSubBands = subbands;                       
+            bd_encoder_state->context.s16AllocationMethod = allmethod;                     
+            bd_encoder_state->context.s16BitPool = bitpool;  
+            bd_encoder_state->context.mSBCEnabled = 0;
+            bd_encoder_state->context.s16ChannelMode = channel_mode;
+            bd_encoder_state->context.s16NumOfChannels = 2;
+            if (bd_encoder_state->context.s16ChannelMode == SBC_MONO){
+                bd_encoder_state->context.s16NumOfChannels = 1;
             }
             switch(sample_rate){
-                case 16000: bd_encoder_state.context.s16SamplingFreq = SBC_sf16000; break;
-                case 32000: bd_encoder_state.context.s16SamplingFreq = SBC_sf32000; break;
-                case 44100: bd_encoder_state.context.s16SamplingFreq = SBC_sf44100; break;
-                case 48000: bd_encoder_state.context.s16SamplingFreq = SBC_sf48000; break;
-                default: bd_encoder_state.context.s16SamplingFreq = 0; break;
+                case 16000: bd_encoder_state->context.s16SamplingFreq = SBC_sf16000; break;
+                case 32000: bd_encoder_state->context.s16SamplingFreq = SBC_sf32000; break;
+                case 44100: bd_encoder_state->context.s16SamplingFreq = SBC_sf44100; break;
+                case 48000: bd_encoder_state->context.s16SamplingFreq = SBC_sf48000; break;
+                default: bd_encoder_state->context.s16SamplingFreq = 0; break;
             }
             break;
         case SBC_MODE_mSBC:
-            bd_encoder_state.context.s16NumOfBlocks    = 15;
-            bd_encoder_state.context.s16NumOfSubBands  = 8;
-            bd_encoder_state.context.s16AllocationMethod = SBC_LOUDNESS;
-            bd_encoder_state.context.s16BitPool   = 26;
-            bd_encoder_state.context.s16ChannelMode = SBC_MONO;
-            bd_encoder_state.context.s16NumOfChannels = 1;
-            bd_encoder_state.context.mSBCEnabled = 1;
-            bd_encoder_state.context.s16SamplingFreq = SBC_sf16000;
+            bd_encoder_state->context.s16NumOfBlocks    = 15;
+            bd_encoder_state->context.s16NumOfSubBands  = 8;
+            bd_encoder_state->context.s16AllocationMethod = SBC_LOUDNESS;
+            bd_encoder_state->context.s16BitPool   = 26;
+            bd_encoder_state->context.s16ChannelMode = SBC_MONO;
+            bd_encoder_state->context.s16NumOfChannels = 1;
+            bd_encoder_state->context.mSBCEnabled = 1;
+            bd_encoder_state->context.s16SamplingFreq = SBC_sf16000;
             break;
     }
-    bd_encoder_state.context.pu8Packet = bd_encoder_state.sbc_packet;
+    bd_encoder_state->context.pu8Packet = bd_encoder_state->sbc_packet;
     
-    sbc_encoder_state_singleton->encoder_state = &bd_encoder_state;
-    SBC_ENC_PARAMS * context = &((bludroid_encoder_state_t *)sbc_encoder_state_singleton->encoder_state)->context;
-    SBC_Encoder_Init(context);
-}
+    state->encoder_state = bd_encoder_state;
+    SBC_Encoder_Init(&bd_encoder_state->context);
 
+    // provide frame length before first frame gets encoded
+    bd_encoder_state->context.u16PacketLength = btstack_sbc_encoder_frame_length(&bd_encoder_state->context);
+}
 
-void btstack_sbc_encoder_process_data(int16_t * input_buffer){
-    if (!sbc_encoder_state_singleton){
-        log_error("SBC encoder: sbc state is NULL, call btstack_sbc_encoder_init to initialize it");
-    }
-    SBC_ENC_PARAMS * context = &((bludroid_encoder_state_t *)sbc_encoder_state_singleton->encoder_state)->context;
+void btstack_sbc_encoder_process_data_ctx(btstack_sbc_encoder_state_t * state, int16_t * input_buffer){
+    SBC_ENC_PARAMS * context = btstack_sbc_encoder_context(state);
     context->ps16PcmBuffer = input_buffer;
     if (context->mSBCEnabled){
         context->pu8Packet[0] = 0xad;
@@ -138,17 +161,50 @@ void btstack_sbc_encoder_process_data(int16_t * input_buffer){
     SBC_Encoder(context);
 }
 
-int btstack_sbc_encoder_num_audio_frames(void){
-    SBC_ENC_PARAMS * context = &((bludroid_encoder_state_t *)sbc_encoder_state_singleton->encoder_state)->context;
+uint16_t btstack_sbc_encoder_process_data_batch_ctx(btstack_sbc_encoder_state_t * state, int16_t * input_buffer, uint8_t num_sbc_frames, uint8_t * sbc_buffer){
+    if (num_sbc_frames == 0) return 0;
+    SBC_ENC_PARAMS * context = btstack_sbc_encoder_context(state);
+    // let encoder write all frames into sbc_buffer
+    uint8_t * sbc_packet = context->pu8Packet;
+    context->pu8Packet = sbc_buffer;
+    context->ps16PcmBuffer = input_buffer;
+    context->u8NumPacketToEncode = num_sbc_frames;
+    SBC_Encoder(context);
+    context->pu8Packet = sbc_packet;
+    return (uint16_t) (context->pu8NextPacket - sbc_buffer);
+}
+
+int btstack_sbc_encoder_num_audio_frames_ctx(btstack_sbc_encoder_state_t * state){
+    SBC_ENC_PARAMS * context = btstack_sbc_encoder_context(state);
     return context->s16NumOfSubBands * context->s16NumOfBlocks;
 }
 
-uint8_t * btstack_sbc_encoder_sbc_buffer(void){
-    SBC_ENC_PARAMS * context = &((bludroid_encoder_state_t *)sbc_encoder_state_singleton->encoder_state)->context;
+uint8_t * btstack_sbc_encoder_sbc_buffer_ctx(btstack_sbc_encoder_state_t * state){
+    SBC_ENC_PARAMS * context = btstack_sbc_encoder_context(state);
     return context->pu8Packet;
 }
 
-uint16_t  btstack_sbc_encoder_sbc_buffer_length(void){
-    SBC_ENC_PARAMS * context = &((bludroid_encoder_state_t *)sbc_encoder_state_singleton->encoder_state)->context;
+uint16_t  btstack_sbc_encoder_sbc_buffer_length_ctx(btstack_sbc_encoder_state_t * state){
+    SBC_ENC_PARAMS * context = btstack_sbc_encoder_context(state);
     return context->u16PacketLength;
 }
+
+void btstack_sbc_encoder_process_data(int16_t * input_buffer){
+    if (!sbc_encoder_state_singleton){
+        log_error("SBC encoder: sbc state is NULL, call btstack_sbc_encoder_init to initialize it");
+        return;
+    }
+    btstack_sbc_encoder_process_data_ctx(sbc_encoder_state_singleton, input_buffer);
+}
+
+int btstack_sbc_encoder_num_audio_frames(void){
+    return btstack_sbc_encoder_num_audio_frames_ctx(sbc_encoder_state_singleton);
+}
+
+uint8_t * btstack_sbc_encoder_sbc_buffer(void){
+    return btstack_sbc_encoder_sbc_buffer_ctx(sbc_encoder_state_singleton);
+}
+
+uint16_t  btstack_sbc_encoder_sbc_buffer_length(void){
+    return btstack_sbc_encoder_sbc_buffer_length_ctx(sbc_encoder_state_singleton);
+}
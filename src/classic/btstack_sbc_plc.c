@@ -50,6 +50,15 @@
 #include "btstack_sbc_plc.h"
 #include "btstack_debug.h"
 
+// use SIMD for pattern matching if enabled by compiler
+#if defined(__SSE2__)
+#define USE_PLC_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define USE_PLC_NEON
+#include <arm_neon.h>
+#endif
+
 #define SAMPLE_FORMAT int16_t
 
 static uint8_t indices0[] = { 0xad, 0x00, 0x00, 0xc5, 0x00, 0x00, 0x00, 0x00, 0x77, 0x6d,
@@ -65,56 +74,68 @@ static float rcos[SBC_OLAL] = {
     0.45386582f,0.36316850f,0.27713082f,0.19868268f, 
     0.13049554f,0.07489143f,0.03376389f,0.00851345f};
 
-// taken from http://www.codeproject.com/Articles/69941/Best-Square-Root-Method-Algorithm-Function-Precisi
-// Algorithm: Babylonian Method + some manipulations on IEEE 32 bit floating point representation
-static float sqrt3(const float x){
-    union {
-        int i;
-        float x;
-    } u;
-    u.x = x;
-    u.i = (1<<29) + (u.i >> 1) - (1<<22); 
-
-    // Two Babylonian Steps (simplified from:)
-    // u.x = 0.5f * (u.x + x/u.x);
-    // u.x = 0.5f * (u.x + x/u.x);
-    u.x =       u.x + (x/u.x);
-    u.x = (0.25f*u.x) + (x/u.x);
-
-    return u.x;
-}
-
 static float absolute(float x){
      if (x < 0) x = -x;
      return x;
 }
 
-static float CrossCorrelation(SAMPLE_FORMAT *x, SAMPLE_FORMAT *y){
-    float num = 0;
-    float den = 0;
-    float x2 = 0;
-    float y2 = 0;
-    int   m;
+// sum of x[m]*y[m] for m < SBC_M, exact in 64 bit
+static int64_t DotProduct(const SAMPLE_FORMAT *x, const SAMPLE_FORMAT *y){
+    int m;
+#if defined(USE_PLC_SSE2)
+    const __m128i overflow = _mm_set1_epi32(INT32_MIN);
+    __m128i sum = _mm_setzero_si128();
+    for (m=0;m<SBC_M;m+=8){
+        __m128i products = _mm_madd_epi16(_mm_loadu_si128((const __m128i *) &x[m]), _mm_loadu_si128((const __m128i *) &y[m]));
+        // sign extend pairwise sums to 64 bit. INT32_MIN only results from 2 * (-32768 * -32768), i.e. +2^31
+        __m128i sign = _mm_andnot_si128(_mm_cmpeq_epi32(products, overflow), _mm_srai_epi32(products, 31));
+        sum = _mm_add_epi64(sum, _mm_unpacklo_epi32(products, sign));
+        sum = _mm_add_epi64(sum, _mm_unpackhi_epi32(products, sign));
+    }
+    int64_t lanes[2];
+    _mm_storeu_si128((__m128i *) lanes, sum);
+    return lanes[0] + lanes[1];
+#elif defined(USE_PLC_NEON)
+    int64x2_t sum = vdupq_n_s64(0);
+    for (m=0;m<SBC_M;m+=8){
+        int16x8_t vx = vld1q_s16(&x[m]);
+        int16x8_t vy = vld1q_s16(&y[m]);
+        sum = vpadalq_s32(sum, vmull_s16(vget_low_s16(vx),  vget_low_s16(vy)));
+        sum = vpadalq_s32(sum, vmull_s16(vget_high_s16(vx), vget_high_s16(vy)));
+    }
+    return vgetq_lane_s64(sum, 0) + vgetq_lane_s64(sum, 1);
+#else
+    int64_t sum = 0;
     for (m=0;m<SBC_M;m++){
-        num+=((float)x[m])*y[m];
-        x2+=((float)x[m])*x[m];
-        y2+=((float)y[m])*y[m];
+        sum += (int32_t) x[m] * y[m];
     }
-    den = (float)sqrt3(x2*y2);
-    return num/den;
+    return sum;
+#endif
 }
 
+// Find n with max normalized cross correlation num / sqrt(x2 * y2) between template at end of history and y[n..n+M-1].
+// x2 is the same for all n and y2 is updated incrementally. Instead of num / sqrt(y2), num * |num| / y2 is compared
+// by cross-multiplication, which avoids square root and division.
 static int PatternMatch(SAMPLE_FORMAT *y){
-    float maxCn = -999999.0;  // large negative number
+    const SAMPLE_FORMAT *x = &y[SBC_LHIST-SBC_M];
+    int64_t y2 = 0;
+    int     m;
+    for (m=0;m<SBC_M;m++){
+        y2 += (int32_t) y[m] * y[m];
+    }
     int   bestmatch = 0;
-    float Cn;
+    float best_num  = 0;
+    float best_y2   = 1;
     int   n;
     for (n=0;n<SBC_N;n++){
-        Cn = CrossCorrelation(&y[SBC_LHIST-SBC_M], &y[n]); 
-        if (Cn>maxCn){
-            bestmatch=n;
-            maxCn = Cn; 
+        float num  = (float) DotProduct(x, &y[n]);
+        float y2_n = (y2 > 0) ? (float) y2 : 1.0f;
+        if ((n == 0) || ((num * absolute(num) * best_y2) > (best_num * absolute(best_num) * y2_n))){
+            bestmatch = n;
+            best_num  = num;
+            best_y2   = y2_n;
         }
+        y2 += ((int32_t) y[n+SBC_M] * y[n+SBC_M]) - ((int32_t) y[n] * y[n]);
     }
     return bestmatch;
 }
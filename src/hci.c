@@ -74,6 +74,7 @@
 #include "gap.h"
 #include "hci.h"
 #include "hci_cmd.h"
+#include "hci_cmd_builder.h"
 #include "hci_dump.h"
 #include "ad_parser.h"
 
@@ -154,6 +155,8 @@ static void hci_emit_dedicated_bonding_result(bd_addr_t address, uint8_t status)
 static void hci_emit_event(uint8_t * event, uint16_t size, int dump);
 static void hci_emit_acl_packet(uint8_t * packet, uint16_t size);
 static void hci_run(void);
+static uint8_t * hci_cmd_buffer_reserve(void);
+static int  hci_send_cmd_buffer(uint16_t size);
 static int  hci_is_le_connection(hci_connection_t * connection);
 static int  hci_number_free_acl_slots_for_connection_type( bd_addr_type_t address_type);
 
@@ -830,6 +833,25 @@ int hci_send_sco_packet_buffer(int size){
 }
 #endif
 
+static uint8_t * hci_acl_recombination_buffer(hci_connection_t * conn){
+#ifdef ENABLE_ACL_RECOMBINATION_BUFFER_POOL
+    return conn->acl_recombination_buffer->buffer;
+#else
+    return conn->acl_recombination_buffer;
+#endif
+}
+
+static void hci_acl_recombination_reset(hci_connection_t * conn){
+    conn->acl_recombination_length = 0;
+    conn->acl_recombination_pos = 0;
+#ifdef ENABLE_ACL_RECOMBINATION_BUFFER_POOL
+    if (conn->acl_recombination_buffer != NULL){
+        btstack_memory_hci_acl_recombination_buffer_free(conn->acl_recombination_buffer);
+        conn->acl_recombination_buffer = NULL;
+    }
+#endif
+}
+
 static void acl_handler(uint8_t *packet, uint16_t size){
 
     // get info
@@ -873,21 +895,20 @@ static void acl_handler(uint8_t *packet, uint16_t size){
             if ((conn->acl_recombination_pos + acl_length) > (4u + HCI_ACL_BUFFER_SIZE)){
                 log_error( "ACL Cont Fragment to large: combined packet %u > buffer size %u for handle 0x%02x",
                     conn->acl_recombination_pos + acl_length, 4 + HCI_ACL_BUFFER_SIZE, con_handle);
-                conn->acl_recombination_pos = 0;
+                hci_acl_recombination_reset(conn);
                 return;
             }
 
             // append fragment payload (header already stored)
-            (void)memcpy(&conn->acl_recombination_buffer[HCI_INCOMING_PRE_BUFFER_SIZE + conn->acl_recombination_pos],
+            (void)memcpy(&hci_acl_recombination_buffer(conn)[HCI_INCOMING_PRE_BUFFER_SIZE + conn->acl_recombination_pos],
                          &packet[4], acl_length);
             conn->acl_recombination_pos += acl_length;
 
             // forward complete L2CAP packet if complete. 
             if (conn->acl_recombination_pos >= (conn->acl_recombination_length + 4u + 4u)){ // pos already incl. ACL header
-                hci_emit_acl_packet(&conn->acl_recombination_buffer[HCI_INCOMING_PRE_BUFFER_SIZE], conn->acl_recombination_pos);
+                hci_emit_acl_packet(&hci_acl_recombination_buffer(conn)[HCI_INCOMING_PRE_BUFFER_SIZE], conn->acl_recombination_pos);
                 // reset recombination buffer
-                conn->acl_recombination_length = 0;
-                conn->acl_recombination_pos = 0;
+                hci_acl_recombination_reset(conn);
             }
             break;
             
@@ -896,7 +917,7 @@ static void acl_handler(uint8_t *packet, uint16_t size){
             // sanity check
             if (conn->acl_recombination_pos) {
                 log_error( "ACL First Fragment but data in buffer for handle 0x%02x, dropping stale fragments", con_handle);
-                conn->acl_recombination_pos = 0;
+                hci_acl_recombination_reset(conn);
             }
 
             // peek into L2CAP packet!
@@ -914,12 +935,21 @@ static void acl_handler(uint8_t *packet, uint16_t size){
                     return;
                 }
 
+#ifdef ENABLE_ACL_RECOMBINATION_BUFFER_POOL
+                // get recombination buffer from pool
+                conn->acl_recombination_buffer = btstack_memory_hci_acl_recombination_buffer_get();
+                if (conn->acl_recombination_buffer == NULL){
+                    log_error( "ACL First Fragment but no recombination buffer available for handle 0x%02x, dropping packet", con_handle);
+                    return;
+                }
+#endif
+
                 // store first fragment and tweak acl length for complete package
-                (void)memcpy(&conn->acl_recombination_buffer[HCI_INCOMING_PRE_BUFFER_SIZE],
+                (void)memcpy(&hci_acl_recombination_buffer(conn)[HCI_INCOMING_PRE_BUFFER_SIZE],
                              packet, acl_length + 4u);
                 conn->acl_recombination_pos    = acl_length + 4u;
                 conn->acl_recombination_length = l2cap_length;
-                little_endian_store_16(conn->acl_recombination_buffer, HCI_INCOMING_PRE_BUFFER_SIZE + 2u, l2cap_length +4u);
+                little_endian_store_16(hci_acl_recombination_buffer(conn), HCI_INCOMING_PRE_BUFFER_SIZE + 2u, l2cap_length +4u);
             }
             break;
             
@@ -943,6 +973,8 @@ static void hci_shutdown_connection(hci_connection_t *conn){
 #endif
 
     btstack_run_loop_remove_timer(&conn->timeout);
+
+    hci_acl_recombination_reset(conn);
     
     btstack_linked_list_remove(&hci_stack->connections, (btstack_linked_item_t *) conn);
     btstack_memory_hci_connection_free( conn );
@@ -1525,11 +1557,14 @@ static void hci_initializing_run(void){
             hci_stack->substate = HCI_INIT_W4_READ_WHITE_LIST_SIZE;
             hci_send_cmd(&hci_le_read_white_list_size);
             break;
-        case HCI_INIT_LE_SET_SCAN_PARAMETERS:
+        case HCI_INIT_LE_SET_SCAN_PARAMETERS: {
             // LE Scan Parameters: active scanning, 300 ms interval, 30 ms window, own address type, accept all advs
+            uint8_t * packet = hci_cmd_buffer_reserve();
+            if (packet == NULL) return;
             hci_stack->substate = HCI_INIT_W4_LE_SET_SCAN_PARAMETERS;
-            hci_send_cmd(&hci_le_set_scan_parameters, 1, hci_stack->le_scan_interval, hci_stack->le_scan_window, hci_stack->le_own_addr_type, 0);
+            hci_send_cmd_buffer(hci_cmd_create_le_set_scan_parameters(packet, 1, hci_stack->le_scan_interval, hci_stack->le_scan_window, hci_stack->le_own_addr_type, 0));
             break;
+        }
 #endif
         default:
             return;
@@ -1981,8 +2016,8 @@ static void handle_command_complete_event(uint8_t * packet, uint16_t size){
     hci_connection_t * conn;
     uint8_t status;
 #endif
-    // get num cmd packets - limit to 1 to reduce complexity
-    hci_stack->num_cmd_packets = packet[2] ? 1 : 0;
+    // get num cmd packets - limit to HCI_NUM_CMD_PACKETS_MAX to reduce complexity
+    hci_stack->num_cmd_packets = (uint8_t) btstack_min(packet[2], HCI_NUM_CMD_PACKETS_MAX);
 
     uint16_t opcode = hci_event_command_complete_get_command_opcode(packet);
     switch (opcode){
@@ -2157,8 +2192,8 @@ static void event_handler(uint8_t *packet, uint16_t size){
             break;
             
         case HCI_EVENT_COMMAND_STATUS:
-            // get num cmd packets - limit to 1 to reduce complexity
-            hci_stack->num_cmd_packets = packet[3] ? 1 : 0;
+            // get num cmd packets - limit to HCI_NUM_CMD_PACKETS_MAX to reduce complexity
+            hci_stack->num_cmd_packets = (uint8_t) btstack_min(packet[3], HCI_NUM_CMD_PACKETS_MAX);
 
             // check command status to detected failed outgoing connections
             create_connection_cmd = 0;
@@ -3602,20 +3637,24 @@ static bool hci_run_general_gap_le(void){
 #ifdef ENABLE_LE_CENTRAL
     // parameter change requires scanning to be stopped first
     if (hci_stack->le_scan_type != 0xffu) {
+        uint8_t * packet = hci_cmd_buffer_reserve();
+        if (packet == NULL) return true;
         if (hci_stack->le_scanning_active){
             hci_stack->le_scanning_active = 0;
-            hci_send_cmd(&hci_le_set_scan_enable, 0, 0);
+            hci_send_cmd_buffer(hci_cmd_create_le_set_scan_enable(packet, 0, 0));
         } else {
             int scan_type = (int) hci_stack->le_scan_type;
             hci_stack->le_scan_type = 0xff;
-            hci_send_cmd(&hci_le_set_scan_parameters, scan_type, hci_stack->le_scan_interval, hci_stack->le_scan_window, hci_stack->le_own_addr_type, 0);
+            hci_send_cmd_buffer(hci_cmd_create_le_set_scan_parameters(packet, scan_type, hci_stack->le_scan_interval, hci_stack->le_scan_window, hci_stack->le_own_addr_type, 0));
         }
         return true;
     }
     // finally, we can enable/disable le scan
     if ((hci_stack->le_scanning_enabled != hci_stack->le_scanning_active)){
+        uint8_t * packet = hci_cmd_buffer_reserve();
+        if (packet == NULL) return true;
         hci_stack->le_scanning_active = hci_stack->le_scanning_enabled;
-        hci_send_cmd(&hci_le_set_scan_enable, hci_stack->le_scanning_enabled, 0);
+        hci_send_cmd_buffer(hci_cmd_create_le_set_scan_enable(packet, hci_stack->le_scanning_enabled, 0));
         return true;
     }
 #endif
@@ -3630,8 +3669,10 @@ static bool hci_run_general_gap_le(void){
         return true;
     }
     if (hci_stack->le_advertisements_todo & LE_ADVERTISEMENT_TASKS_SET_PARAMS){
+        uint8_t * packet = hci_cmd_buffer_reserve();
+        if (packet == NULL) return true;
         hci_stack->le_advertisements_todo &= ~LE_ADVERTISEMENT_TASKS_SET_PARAMS;
-        hci_send_cmd(&hci_le_set_advertising_parameters,
+        hci_send_cmd_buffer(hci_cmd_create_le_set_advertising_parameters(packet,
                      hci_stack->le_advertisements_interval_min,
                      hci_stack->le_advertisements_interval_max,
                      hci_stack->le_advertisements_type,
@@ -3639,27 +3680,31 @@ static bool hci_run_general_gap_le(void){
                      hci_stack->le_advertisements_direct_address_type,
                      hci_stack->le_advertisements_direct_address,
                      hci_stack->le_advertisements_channel_map,
-                     hci_stack->le_advertisements_filter_policy);
+                     hci_stack->le_advertisements_filter_policy));
         return true;
     }
     if (hci_stack->le_advertisements_todo & LE_ADVERTISEMENT_TASKS_SET_ADV_DATA){
+        uint8_t * packet = hci_cmd_buffer_reserve();
+        if (packet == NULL) return true;
         hci_stack->le_advertisements_todo &= ~LE_ADVERTISEMENT_TASKS_SET_ADV_DATA;
         uint8_t adv_data_clean[31];
         memset(adv_data_clean, 0, sizeof(adv_data_clean));
         (void)memcpy(adv_data_clean, hci_stack->le_advertisements_data,
                      hci_stack->le_advertisements_data_len);
         btstack_replace_bd_addr_placeholder(adv_data_clean, hci_stack->le_advertisements_data_len, hci_stack->local_bd_addr);
-        hci_send_cmd(&hci_le_set_advertising_data, hci_stack->le_advertisements_data_len, adv_data_clean);
+        hci_send_cmd_buffer(hci_cmd_create_le_set_advertising_data(packet, hci_stack->le_advertisements_data_len, adv_data_clean));
         return true;
     }
     if (hci_stack->le_advertisements_todo & LE_ADVERTISEMENT_TASKS_SET_SCAN_DATA){
+        uint8_t * packet = hci_cmd_buffer_reserve();
+        if (packet == NULL) return true;
         hci_stack->le_advertisements_todo &= ~LE_ADVERTISEMENT_TASKS_SET_SCAN_DATA;
         uint8_t scan_data_clean[31];
         memset(scan_data_clean, 0, sizeof(scan_data_clean));
         (void)memcpy(scan_data_clean, hci_stack->le_scan_response_data,
                      hci_stack->le_scan_response_data_len);
         btstack_replace_bd_addr_placeholder(scan_data_clean, hci_stack->le_scan_response_data_len, hci_stack->local_bd_addr);
-        hci_send_cmd(&hci_le_set_scan_response_data, hci_stack->le_scan_response_data_len, scan_data_clean);
+        hci_send_cmd_buffer(hci_cmd_create_le_set_scan_response_data(packet, hci_stack->le_scan_response_data_len, scan_data_clean));
         return true;
     }
     if (hci_stack->le_advertisements_todo & LE_ADVERTISEMENT_TASKS_ENABLE){
@@ -3717,9 +3762,11 @@ static bool hci_run_general_gap_le(void){
     // start connecting
     if ( (hci_stack->le_connecting_state == LE_CONNECTING_IDLE) &&
          !btstack_linked_list_empty(&hci_stack->le_whitelist)){
+        uint8_t * packet = hci_cmd_buffer_reserve();
+        if (packet == NULL) return true;
         bd_addr_t null_addr;
         memset(null_addr, 0, 6);
-        hci_send_cmd(&hci_le_create_connection,
+        hci_send_cmd_buffer(hci_cmd_create_le_create_connection(packet,
                      hci_stack->le_connection_scan_interval,    // scan interval: 60 ms
                      hci_stack->le_connection_scan_window,    // scan interval: 30 ms
                      1,         // use whitelist
@@ -3732,7 +3779,7 @@ static bool hci_run_general_gap_le(void){
                      hci_stack->le_supervision_timeout,        // conn latency
                      hci_stack->le_minimum_ce_length,          // min ce length
                      hci_stack->le_maximum_ce_length           // max ce length
-        );
+        ));
         return true;
     }
 #endif
@@ -3741,6 +3788,7 @@ static bool hci_run_general_gap_le(void){
 #endif
 
 static bool hci_run_general_pending_commmands(void){
+    uint8_t * packet;
     btstack_linked_item_t * it;
     for (it = (btstack_linked_item_t *) hci_stack->connections; it != NULL; it = it->next){
         hci_connection_t * connection = (hci_connection_t *) it;
@@ -3757,12 +3805,14 @@ static bool hci_run_general_pending_commmands(void){
                     default:
 #ifdef ENABLE_BLE
 #ifdef ENABLE_LE_CENTRAL
+                        packet = hci_cmd_buffer_reserve();
+                        if (packet == NULL) return true;
                         // track outgoing connection
                         hci_stack->outgoing_addr_type = connection->address_type;
                         (void)memcpy(hci_stack->outgoing_addr,
                                      connection->address, 6);
                         log_info("sending hci_le_create_connection");
-                        hci_send_cmd(&hci_le_create_connection,
+                        hci_send_cmd_buffer(hci_cmd_create_le_create_connection(packet,
                                      hci_stack->le_connection_scan_interval,    // conn scan interval
                                      hci_stack->le_connection_scan_window,      // conn scan windows
                                      0,         // don't use whitelist
@@ -3775,7 +3825,7 @@ static bool hci_run_general_pending_commmands(void){
                                      hci_stack->le_supervision_timeout,        // conn latency
                                      hci_stack->le_minimum_ce_length,          // min ce length
                                      hci_stack->le_maximum_ce_length          // max ce length
-                        );
+                        ));
                         connection->state = SENT_CREATE_CONNECTION;
 #endif
 #endif
@@ -3803,8 +3853,10 @@ static bool hci_run_general_pending_commmands(void){
 #endif
 #endif
             case SEND_DISCONNECT:
+                packet = hci_cmd_buffer_reserve();
+                if (packet == NULL) return true;
                 connection->state = SENT_DISCONNECT;
-                hci_send_cmd(&hci_disconnect, connection->con_handle, ERROR_CODE_REMOTE_USER_TERMINATED_CONNECTION);
+                hci_send_cmd_buffer(hci_cmd_create_disconnect(packet, connection->con_handle, ERROR_CODE_REMOTE_USER_TERMINATED_CONNECTION));
                 return true;
 
             default:
@@ -3841,8 +3893,10 @@ static bool hci_run_general_pending_commmands(void){
             bool sc_downgrade = have_link_key && (gap_secure_connection_for_link_key_type(link_key_type) == 1) && !sc_enabled_remote;
             if (sc_downgrade){
                 log_info("Link key based on SC, but remote does not support SC -> disconnect");
+                packet = hci_cmd_buffer_reserve();
+                if (packet == NULL) return true;
                 connection->state = SENT_DISCONNECT;
-                hci_send_cmd(&hci_disconnect, connection->con_handle, ERROR_CODE_AUTHENTICATION_FAILURE);
+                hci_send_cmd_buffer(hci_cmd_create_disconnect(packet, connection->con_handle, ERROR_CODE_AUTHENTICATION_FAILURE));
                 return true;
             }
 
@@ -3913,10 +3967,12 @@ static bool hci_run_general_pending_commmands(void){
         }
 
         if (connection->bonding_flags & BONDING_DISCONNECT_DEDICATED_DONE){
+            packet = hci_cmd_buffer_reserve();
+            if (packet == NULL) return true;
             connection->bonding_flags &= ~BONDING_DISCONNECT_DEDICATED_DONE;
             connection->bonding_flags |= BONDING_EMIT_COMPLETE_ON_DISCONNECT;
             connection->state = SENT_DISCONNECT;
-            hci_send_cmd(&hci_disconnect, connection->con_handle, ERROR_CODE_REMOTE_USER_TERMINATED_CONNECTION);
+            hci_send_cmd_buffer(hci_cmd_create_disconnect(packet, connection->con_handle, ERROR_CODE_REMOTE_USER_TERMINATED_CONNECTION));
             return true;
         }
 
@@ -3940,12 +3996,15 @@ static bool hci_run_general_pending_commmands(void){
 #endif
 
         if (connection->bonding_flags & BONDING_DISCONNECT_SECURITY_BLOCK){
-            connection->bonding_flags &= ~BONDING_DISCONNECT_SECURITY_BLOCK;
             if (connection->state != SENT_DISCONNECT){
+                packet = hci_cmd_buffer_reserve();
+                if (packet == NULL) return true;
+                connection->bonding_flags &= ~BONDING_DISCONNECT_SECURITY_BLOCK;
                 connection->state = SENT_DISCONNECT;
-                hci_send_cmd(&hci_disconnect, connection->con_handle, ERROR_CODE_AUTHENTICATION_FAILURE);
+                hci_send_cmd_buffer(hci_cmd_create_disconnect(packet, connection->con_handle, ERROR_CODE_AUTHENTICATION_FAILURE));
                 return true;
             }
+            connection->bonding_flags &= ~BONDING_DISCONNECT_SECURITY_BLOCK;
         }
 
 #ifdef ENABLE_CLASSIC
@@ -3969,10 +4028,12 @@ static bool hci_run_general_pending_commmands(void){
         switch (connection->le_con_parameter_update_state){
             // response to L2CAP CON PARAMETER UPDATE REQUEST
             case CON_PARAMETER_UPDATE_CHANGE_HCI_CON_PARAMETERS:
+                packet = hci_cmd_buffer_reserve();
+                if (packet == NULL) return true;
                 connection->le_con_parameter_update_state = CON_PARAMETER_UPDATE_NONE;
-                hci_send_cmd(&hci_le_connection_update, connection->con_handle, connection->le_conn_interval_min,
+                hci_send_cmd_buffer(hci_cmd_create_le_connection_update(packet, connection->con_handle, connection->le_conn_interval_min,
                              connection->le_conn_interval_max, connection->le_conn_latency, connection->le_supervision_timeout,
-                             0x0000, 0xffff);
+                             0x0000, 0xffff));
                 return true;
             case CON_PARAMETER_UPDATE_REPLY:
                 connection->le_con_parameter_update_state = CON_PARAMETER_UPDATE_NONE;
@@ -4068,10 +4129,14 @@ static void hci_run(void){
                     connection =  (hci_connection_t *) hci_stack->connections;
                     if (connection){
                         hci_con_handle_t con_handle = (uint16_t) connection->con_handle;
-                        if (!hci_can_send_command_packet_now()) return;
 
                         // check state
                         if (connection->state == SENT_DISCONNECT) return;
+
+                        // build disconnect command first, packet handlers called below cannot send commands while reserved
+                        uint8_t * packet = hci_cmd_buffer_reserve();
+                        if (packet == NULL) return;
+                        uint16_t size = hci_cmd_create_disconnect(packet, con_handle, ERROR_CODE_REMOTE_USER_TERMINATED_CONNECTION);
                         connection->state = SENT_DISCONNECT;
 
                         log_info("HCI_STATE_HALTING, connection %p, handle %u", connection, con_handle);
@@ -4083,7 +4148,7 @@ static void hci_run(void){
                         hci_shutdown_connection(connection);
 
                         // finally, send the disconnect command
-                        hci_send_cmd(&hci_disconnect, con_handle, ERROR_CODE_REMOTE_USER_TERMINATED_CONNECTION);
+                        hci_send_cmd_buffer(size);
                         return;
                     }
 
@@ -4136,10 +4201,11 @@ static void hci_run(void){
                     if (connection){
                         
                         // send disconnect
-                        if (!hci_can_send_command_packet_now()) return;
+                        uint8_t * packet = hci_cmd_buffer_reserve();
+                        if (packet == NULL) return;
 
                         log_info("HCI_STATE_FALLING_ASLEEP, connection %p, handle %u", connection, (uint16_t)connection->con_handle);
-                        hci_send_cmd(&hci_disconnect, connection->con_handle, ERROR_CODE_REMOTE_USER_TERMINATED_CONNECTION);
+                        hci_send_cmd_buffer(hci_cmd_create_disconnect(packet, connection->con_handle, ERROR_CODE_REMOTE_USER_TERMINATED_CONNECTION));
 
                         // send disconnected event right away - causes higher layer connections to get closed, too.
                         hci_shutdown_connection(connection);
@@ -4369,20 +4435,28 @@ void gap_secure_connections_enable(bool enable){
 
 #endif
 
-// va_list part of hci_send_cmd
-int hci_send_cmd_va_arg(const hci_cmd_t *cmd, va_list argptr){
-    if (!hci_can_send_command_packet_now()){ 
-        log_error("hci_send_cmd called but cannot send packet now");
-        return 0;
+// reserve packet buffer for command created by hci_cmd_builder.h
+// @returns packet buffer or NULL if command cannot be sent now
+static uint8_t * hci_cmd_buffer_reserve(void){
+    if (!hci_can_send_command_packet_now()) return NULL;
+    hci_reserve_packet_buffer();
+    return hci_stack->hci_packet_buffer;
+}
+
+// send command created in reserved packet buffer
+static int hci_send_cmd_buffer(uint16_t size){
+    uint8_t * packet = hci_stack->hci_packet_buffer;
+
+    // command credit might have been used up since the buffer was reserved
+    if ((hci_stack->num_cmd_packets == 0u) || !hci_transport_can_send_prepared_packet_now(HCI_COMMAND_DATA_PACKET)){
+        log_error("hci_send_cmd_buffer called but cannot send command now");
+        hci_release_packet_buffer();
+        return -1;  // packet not sent to controller
     }
 
     // for HCI INITIALIZATION
-    // log_info("hci_send_cmd: opcode %04x", cmd->opcode);
-    hci_stack->last_cmd_opcode = cmd->opcode;
+    hci_stack->last_cmd_opcode = little_endian_read_16(packet, 0);
 
-    hci_reserve_packet_buffer();
-    uint8_t * packet = hci_stack->hci_packet_buffer;
-    uint16_t size = hci_cmd_create_from_template(packet, cmd, argptr);
     int err = hci_send_cmd_packet(packet, size);
 
     // release packet buffer on error or for synchronous transport implementations
@@ -4394,6 +4468,18 @@ int hci_send_cmd_va_arg(const hci_cmd_t *cmd, va_list argptr){
     return err;
 }
 
+// va_list part of hci_send_cmd
+int hci_send_cmd_va_arg(const hci_cmd_t *cmd, va_list argptr){
+    uint8_t * packet = hci_cmd_buffer_reserve();
+    if (packet == NULL){
+        log_error("hci_send_cmd called but cannot send packet now");
+        return 0;
+    }
+
+    uint16_t size = hci_cmd_create_from_template(packet, cmd, argptr);
+    return hci_send_cmd_buffer(size);
+}
+
 /**
  * pre: numcmds >= 0 - it's allowed to send a command to the controller
  */
@@ -5700,6 +5786,7 @@ void hci_free_connections_fuzz(void){
     while (btstack_linked_list_iterator_has_next(&it)){
         hci_connection_t * con = (hci_connection_t*) btstack_linked_list_iterator_next(&it);
         btstack_linked_list_iterator_remove(&it);
+        hci_acl_recombination_reset(con);
         btstack_memory_hci_connection_free(con);
     }
 }
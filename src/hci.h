@@ -149,6 +149,12 @@ extern "C" {
 #endif
 #endif
 
+// max number of outstanding HCI Commands, Controller may allow more via Num_HCI_Command_Packets
+// limited to 1 by default to reduce complexity. btstack_crypto uses it to pipeline HCI LE Encrypt
+#ifndef HCI_NUM_CMD_PACKETS_MAX
+#define HCI_NUM_CMD_PACKETS_MAX 1
+#endif
+
 // 
 #define IS_COMMAND(packet, command) ( little_endian_read_16(packet,0) == command.opcode )
 
@@ -475,6 +481,12 @@ typedef struct {
 } l2cap_state_t;
 #endif
 
+// ACL packet recombination buffer, allocated from pool with ENABLE_ACL_RECOMBINATION_BUFFER_POOL
+typedef struct {
+    // PRE_BUFFER + ACL Header + ACL payload
+    uint8_t buffer[HCI_INCOMING_PRE_BUFFER_SIZE + 4 + HCI_ACL_BUFFER_SIZE];
+} hci_acl_recombination_buffer_t;
+
 //
 typedef struct {
     // linked list - assert: first field
@@ -542,8 +554,13 @@ typedef struct {
     // timeout in system ticks (HAVE_EMBEDDED_TICK) or milliseconds (HAVE_EMBEDDED_TIME_MS)
     uint32_t timestamp;
 
+#ifdef ENABLE_ACL_RECOMBINATION_BUFFER_POOL
+    // ACL packet recombination - only allocated while receiving a fragmented packet
+    hci_acl_recombination_buffer_t * acl_recombination_buffer;
+#else
     // ACL packet recombination - PRE_BUFFER + ACL Header + ACL payload
     uint8_t  acl_recombination_buffer[HCI_INCOMING_PRE_BUFFER_SIZE + 4 + HCI_ACL_BUFFER_SIZE];
+#endif
     uint16_t acl_recombination_pos;
     uint16_t acl_recombination_length;
     
@@ -0,0 +1,262 @@
+/*
+ * Copyright (C) 2020 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHIAS
+ * RINGWALD OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+
+/*
+ *  hci_cmd_builder.h
+ *
+ *  @brief Create HCI Commands without interpreting the format string of hci_cmd_t
+ *  @note  Don't edit - generated by tool/btstack_hci_cmd_generator.py
+ *
+ */
+
+#ifndef HCI_CMD_BUILDER_H
+#define HCI_CMD_BUILDER_H
+
+#if defined __cplusplus
+extern "C" {
+#endif
+
+#include "btstack_util.h"
+#include "hci_cmd.h"
+#include <stdint.h>
+#include <string.h>
+
+/* API_START */
+
+/**
+ * @brief Create hci_disconnect command, same result as hci_cmd_create_from_template with &hci_disconnect
+ * @param hci_cmd_buffer
+ * @param handle
+ * @param reason
+ * @return size of command
+ * @note: btstack_type H1
+ */
+static inline uint16_t hci_cmd_create_disconnect(uint8_t * hci_cmd_buffer, hci_con_handle_t handle, uint8_t reason){
+    little_endian_store_16(hci_cmd_buffer, 0, HCI_OPCODE_HCI_DISCONNECT);
+    hci_cmd_buffer[2] = 3;
+    little_endian_store_16(hci_cmd_buffer, 3, handle);
+    hci_cmd_buffer[5] = reason;
+    return 6;
+}
+
+/**
+ * @brief Create hci_host_number_of_completed_packets command, same result as hci_cmd_create_from_template with &hci_host_number_of_completed_packets
+ * @param hci_cmd_buffer
+ * @param number_of_handles
+ * @param connection_handle
+ * @param host_num_of_completed_packets
+ * @return size of command
+ * @note: btstack_type 1H2
+ */
+static inline uint16_t hci_cmd_create_host_number_of_completed_packets(uint8_t * hci_cmd_buffer, uint8_t number_of_handles, hci_con_handle_t connection_handle, uint16_t host_num_of_completed_packets){
+    little_endian_store_16(hci_cmd_buffer, 0, HCI_OPCODE_HCI_HOST_NUMBER_OF_COMPLETED_PACKETS);
+    hci_cmd_buffer[2] = 5;
+    hci_cmd_buffer[3] = number_of_handles;
+    little_endian_store_16(hci_cmd_buffer, 4, connection_handle);
+    little_endian_store_16(hci_cmd_buffer, 6, host_num_of_completed_packets);
+    return 8;
+}
+
+/**
+ * @brief Create hci_le_set_advertising_parameters command, same result as hci_cmd_create_from_template with &hci_le_set_advertising_parameters
+ * @param hci_cmd_buffer
+ * @param advertising_interval_min
+ * @param advertising_interval_max
+ * @param advertising_type
+ * @param own_address_type
+ * @param direct_address_type
+ * @param direct_address
+ * @param advertising_channel_map
+ * @param advertising_filter_policy
+ * @return size of command
+ * @note: btstack_type 22111B11
+ */
+static inline uint16_t hci_cmd_create_le_set_advertising_parameters(uint8_t * hci_cmd_buffer, uint16_t advertising_interval_min, uint16_t advertising_interval_max, uint8_t advertising_type, uint8_t own_address_type, uint8_t direct_address_type, const bd_addr_t direct_address, uint8_t advertising_channel_map, uint8_t advertising_filter_policy){
+    little_endian_store_16(hci_cmd_buffer, 0, HCI_OPCODE_HCI_LE_SET_ADVERTISING_PARAMETERS);
+    hci_cmd_buffer[2] = 15;
+    little_endian_store_16(hci_cmd_buffer, 3, advertising_interval_min);
+    little_endian_store_16(hci_cmd_buffer, 5, advertising_interval_max);
+    hci_cmd_buffer[7] = advertising_type;
+    hci_cmd_buffer[8] = own_address_type;
+    hci_cmd_buffer[9] = direct_address_type;
+    reverse_bd_addr(direct_address, &hci_cmd_buffer[10]);
+    hci_cmd_buffer[16] = advertising_channel_map;
+    hci_cmd_buffer[17] = advertising_filter_policy;
+    return 18;
+}
+
+/**
+ * @brief Create hci_le_set_advertising_data command, same result as hci_cmd_create_from_template with &hci_le_set_advertising_data
+ * @param hci_cmd_buffer
+ * @param advertising_data_length
+ * @param advertising_data
+ * @return size of command
+ * @note: btstack_type 1A
+ */
+static inline uint16_t hci_cmd_create_le_set_advertising_data(uint8_t * hci_cmd_buffer, uint8_t advertising_data_length, const uint8_t * advertising_data){
+    little_endian_store_16(hci_cmd_buffer, 0, HCI_OPCODE_HCI_LE_SET_ADVERTISING_DATA);
+    hci_cmd_buffer[2] = 32;
+    hci_cmd_buffer[3] = advertising_data_length;
+    (void)memcpy(&hci_cmd_buffer[4], advertising_data, 31);
+    return 35;
+}
+
+/**
+ * @brief Create hci_le_set_scan_response_data command, same result as hci_cmd_create_from_template with &hci_le_set_scan_response_data
+ * @param hci_cmd_buffer
+ * @param scan_response_data_length
+ * @param scan_response_data
+ * @return size of command
+ * @note: btstack_type 1A
+ */
+static inline uint16_t hci_cmd_create_le_set_scan_response_data(uint8_t * hci_cmd_buffer, uint8_t scan_response_data_length, const uint8_t * scan_response_data){
+    little_endian_store_16(hci_cmd_buffer, 0, HCI_OPCODE_HCI_LE_SET_SCAN_RESPONSE_DATA);
+    hci_cmd_buffer[2] = 32;
+    hci_cmd_buffer[3] = scan_response_data_length;
+    (void)memcpy(&hci_cmd_buffer[4], scan_response_data, 31);
+    return 35;
+}
+
+/**
+ * @brief Create hci_le_set_scan_parameters command, same result as hci_cmd_create_from_template with &hci_le_set_scan_parameters
+ * @param hci_cmd_buffer
+ * @param le_scan_type
+ * @param le_scan_interval
+ * @param le_scan_window
+ * @param own_address_type
+ * @param scanning_filter_policy
+ * @return size of command
+ * @note: btstack_type 12211
+ */
+static inline uint16_t hci_cmd_create_le_set_scan_parameters(uint8_t * hci_cmd_buffer, uint8_t le_scan_type, uint16_t le_scan_interval, uint16_t le_scan_window, uint8_t own_address_type, uint8_t scanning_filter_policy){
+    little_endian_store_16(hci_cmd_buffer, 0, HCI_OPCODE_HCI_LE_SET_SCAN_PARAMETERS);
+    hci_cmd_buffer[2] = 7;
+    hci_cmd_buffer[3] = le_scan_type;
+    little_endian_store_16(hci_cmd_buffer, 4, le_scan_interval);
+    little_endian_store_16(hci_cmd_buffer, 6, le_scan_window);
+    hci_cmd_buffer[8] = own_address_type;
+    hci_cmd_buffer[9] = scanning_filter_policy;
+    return 10;
+}
+
+/**
+ * @brief Create hci_le_set_scan_enable command, same result as hci_cmd_create_from_template with &hci_le_set_scan_enable
+ * @param hci_cmd_buffer
+ * @param le_scan_enable
+ * @param filter_duplices
+ * @return size of command
+ * @note: btstack_type 11
+ */
+static inline uint16_t hci_cmd_create_le_set_scan_enable(uint8_t * hci_cmd_buffer, uint8_t le_scan_enable, uint8_t filter_duplices){
+    little_endian_store_16(hci_cmd_buffer, 0, HCI_OPCODE_HCI_LE_SET_SCAN_ENABLE);
+    hci_cmd_buffer[2] = 2;
+    hci_cmd_buffer[3] = le_scan_enable;
+    hci_cmd_buffer[4] = filter_duplices;
+    return 5;
+}
+
+/**
+ * @brief Create hci_le_create_connection command, same result as hci_cmd_create_from_template with &hci_le_create_connection
+ * @param hci_cmd_buffer
+ * @param le_scan_interval
+ * @param le_scan_window
+ * @param initiator_filter_policy
+ * @param peer_address_type
+ * @param peer_address
+ * @param own_address_type
+ * @param conn_interval_min
+ * @param conn_interval_max
+ * @param conn_latency
+ * @param supervision_timeout
+ * @param minimum_ce_length
+ * @param maximum_ce_length
+ * @return size of command
+ * @note: btstack_type 2211B1222222
+ */
+static inline uint16_t hci_cmd_create_le_create_connection(uint8_t * hci_cmd_buffer, uint16_t le_scan_interval, uint16_t le_scan_window, uint8_t initiator_filter_policy, uint8_t peer_address_type, const bd_addr_t peer_address, uint8_t own_address_type, uint16_t conn_interval_min, uint16_t conn_interval_max, uint16_t conn_latency, uint16_t supervision_timeout, uint16_t minimum_ce_length, uint16_t maximum_ce_length){
+    little_endian_store_16(hci_cmd_buffer, 0, HCI_OPCODE_HCI_LE_CREATE_CONNECTION);
+    hci_cmd_buffer[2] = 25;
+    little_endian_store_16(hci_cmd_buffer, 3, le_scan_interval);
+    little_endian_store_16(hci_cmd_buffer, 5, le_scan_window);
+    hci_cmd_buffer[7] = initiator_filter_policy;
+    hci_cmd_buffer[8] = peer_address_type;
+    reverse_bd_addr(peer_address, &hci_cmd_buffer[9]);
+    hci_cmd_buffer[15] = own_address_type;
+    little_endian_store_16(hci_cmd_buffer, 16, conn_interval_min);
+    little_endian_store_16(hci_cmd_buffer, 18, conn_interval_max);
+    little_endian_store_16(hci_cmd_buffer, 20, conn_latency);
+    little_endian_store_16(hci_cmd_buffer, 22, supervision_timeout);
+    little_endian_store_16(hci_cmd_buffer, 24, minimum_ce_length);
+    little_endian_store_16(hci_cmd_buffer, 26, maximum_ce_length);
+    return 28;
+}
+
+/**
+ * @brief Create hci_le_connection_update command, same result as hci_cmd_create_from_template with &hci_le_connection_update
+ * @param hci_cmd_buffer
+ * @param conn_handle
+ * @param conn_interval_min
+ * @param conn_interval_max
+ * @param conn_latency
+ * @param supervision_timeout
+ * @param minimum_ce_length
+ * @param maximum_ce_length
+ * @return size of command
+ * @note: btstack_type H222222
+ */
+static inline uint16_t hci_cmd_create_le_connection_update(uint8_t * hci_cmd_buffer, hci_con_handle_t conn_handle, uint16_t conn_interval_min, uint16_t conn_interval_max, uint16_t conn_latency, uint16_t supervision_timeout, uint16_t minimum_ce_length, uint16_t maximum_ce_length){
+    little_endian_store_16(hci_cmd_buffer, 0, HCI_OPCODE_HCI_LE_CONNECTION_UPDATE);
+    hci_cmd_buffer[2] = 14;
+    little_endian_store_16(hci_cmd_buffer, 3, conn_handle);
+    little_endian_store_16(hci_cmd_buffer, 5, conn_interval_min);
+    little_endian_store_16(hci_cmd_buffer, 7, conn_interval_max);
+    little_endian_store_16(hci_cmd_buffer, 9, conn_latency);
+    little_endian_store_16(hci_cmd_buffer, 11, supervision_timeout);
+    little_endian_store_16(hci_cmd_buffer, 13, minimum_ce_length);
+    little_endian_store_16(hci_cmd_buffer, 15, maximum_ce_length);
+    return 17;
+}
+
+
+/* API_END */
+
+#if defined __cplusplus
+}
+#endif
+
+#endif // HCI_CMD_BUILDER_H
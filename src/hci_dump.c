@@ -46,6 +46,7 @@
  *  - Apple's PacketLogger
  *  - stdout hexdump
  *
+ *  With ENABLE_HCI_DUMP_POSIX_ASYNC, binary formats are written by a writer thread, see hci_dump_posix_async.c
  */
 
 #include "btstack_config.h"
@@ -66,6 +67,9 @@
 #include <time.h>
 #include <sys/time.h>     // for timestamps
 #include <sys/stat.h>     // for mode flags
+#ifdef ENABLE_HCI_DUMP_POSIX_ASYNC
+#include "hci_dump_posix_async.h"
+#endif
 #endif
 
 #ifdef ENABLE_SEGGER_RTT
@@ -112,9 +116,13 @@ static int dump_file = -1;
 static int dump_format;
 #ifdef HAVE_POSIX_FILE_IO
 static char time_string[40];
+#ifdef ENABLE_HCI_DUMP_POSIX_ASYNC
+static uint32_t dropped_packets_reported;
+#else
 static int  max_nr_packets = -1;
 static int  nr_packets = 0;
 #endif
+#endif
 
 #if defined(HAVE_POSIX_FILE_IO) || defined (ENABLE_SEGGER_RTT)
 static char log_message_buffer[256];
@@ -132,11 +140,16 @@ void hci_dump_open(const char *filename, hci_dump_format_t format){
         dump_file = fileno(stdout);
     } else {
 
+#ifdef ENABLE_HCI_DUMP_POSIX_ASYNC
+        dropped_packets_reported = 0;
+        dump_file = hci_dump_posix_async_open(filename);
+#else
         int oflags = O_WRONLY | O_CREAT | O_TRUNC;
 #ifdef _WIN32
         oflags |= O_BINARY;
 #endif
         dump_file = open(filename, oflags, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH );
+#endif
         if (dump_file < 0){
             printf("hci_dump_open: failed to open file %s\n", filename);
         }
@@ -162,7 +175,12 @@ void hci_dump_open(const char *filename, hci_dump_format_t format){
 
 #ifdef HAVE_POSIX_FILE_IO
 void hci_dump_set_max_packets(int packets){
+#ifdef ENABLE_HCI_DUMP_POSIX_ASYNC
+    // file is rotated by size instead, see hci_dump_posix_async_set_max_file_size
+    UNUSED(packets);
+#else
     max_nr_packets = packets;
+#endif
 }
 #endif
 
@@ -202,6 +220,19 @@ static void hci_dump_bluez_setup_header(uint8_t * buffer, uint32_t tv_sec, uint3
     buffer[12] = packet_type;
 }
 
+static uint16_t hci_dump_setup_header(uint8_t * buffer, uint32_t tv_sec, uint32_t tv_us, uint8_t packet_type, uint8_t in, uint16_t len){
+    switch (dump_format){
+        case HCI_DUMP_BLUEZ:
+            hci_dump_bluez_setup_header(buffer, tv_sec, tv_us, packet_type, in, len);
+            return HCIDUMP_HDR_SIZE;
+        case HCI_DUMP_PACKETLOGGER:
+            hci_dump_packetlogger_setup_header(buffer, tv_sec, tv_us, packet_type, in, len);
+            return PKTLOG_HDR_SIZE;
+        default:
+            return 0;
+    }
+}
+
 static void printf_packet(uint8_t packet_type, uint8_t in, uint8_t * packet, uint16_t len){
     switch (packet_type){
         case HCI_COMMAND_DATA_PACKET:
@@ -271,7 +302,7 @@ void hci_dump_packet(uint8_t packet_type, uint8_t in, uint8_t *packet, uint16_t
 
     if (dump_file < 0) return; // not activated yet
 
-#ifdef HAVE_POSIX_FILE_IO
+#if defined(HAVE_POSIX_FILE_IO) && !defined(ENABLE_HCI_DUMP_POSIX_ASYNC)
     // don't grow bigger than max_nr_packets
     if (dump_format != HCI_DUMP_STDOUT && max_nr_packets > 0){
         if (nr_packets >= max_nr_packets){
@@ -320,21 +351,28 @@ void hci_dump_packet(uint8_t packet_type, uint8_t in, uint8_t *packet, uint16_t
 #endif
 #endif
 
-    uint16_t header_len = 0;
-    switch (dump_format){
-        case HCI_DUMP_BLUEZ:
-            hci_dump_bluez_setup_header(header.header_bluez, tv_sec, tv_us, packet_type, in, len);
-            header_len = HCIDUMP_HDR_SIZE;
-            break;
-        case HCI_DUMP_PACKETLOGGER:
-            hci_dump_packetlogger_setup_header(header.header_packetlogger, tv_sec, tv_us, packet_type, in, len);
-            header_len = PKTLOG_HDR_SIZE;
-            break;
-        default:
-            return;
+    uint16_t header_len;
+
+#ifdef ENABLE_HCI_DUMP_POSIX_ASYNC
+    // report dropped packets as log message
+    uint32_t dropped_packets = hci_dump_posix_async_get_dropped_packets();
+    if (dropped_packets != dropped_packets_reported){
+        char dropped_message[50];
+        int dropped_message_len = snprintf(dropped_message, sizeof(dropped_message), "HCI dump buffer full - %u packet(s) dropped",
+                                           (unsigned int) (dropped_packets - dropped_packets_reported));
+        header_len = hci_dump_setup_header((uint8_t *) &header, tv_sec, tv_us, LOG_MESSAGE_PACKET, 0, dropped_message_len);
+        if (hci_dump_posix_async_write((const uint8_t *) &header, header_len, (const uint8_t *) dropped_message, dropped_message_len)){
+            dropped_packets_reported = dropped_packets;
+        }
     }
+#endif
 
-#ifdef HAVE_POSIX_FILE_IO
+    header_len = hci_dump_setup_header((uint8_t *) &header, tv_sec, tv_us, packet_type, in, len);
+    if (header_len == 0u) return;
+
+#ifdef ENABLE_HCI_DUMP_POSIX_ASYNC
+    hci_dump_posix_async_write((const uint8_t *) &header, header_len, packet, len);
+#elif defined(HAVE_POSIX_FILE_IO)
     // avoid -Wunused-result
     int res = 0;
     res = write (dump_file, &header, header_len);
@@ -403,7 +441,15 @@ void hci_dump_log_P(int log_level, PGM_P format, ...){
 
 void hci_dump_close(void){
 #ifdef HAVE_POSIX_FILE_IO
+#ifdef ENABLE_HCI_DUMP_POSIX_ASYNC
+    if (dump_format == HCI_DUMP_STDOUT){
+        close(dump_file);
+    } else {
+        hci_dump_posix_async_close();
+    }
+#else
     close(dump_file);
+#endif
 #endif
     dump_file = -1;
 }
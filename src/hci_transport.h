@@ -115,7 +115,8 @@ typedef struct {
 
 typedef enum {
     HCI_TRANSPORT_CONFIG_UART,
-    HCI_TRANSPORT_CONFIG_USB
+    HCI_TRANSPORT_CONFIG_USB,
+    HCI_TRANSPORT_CONFIG_VIRTUAL
 } hci_transport_config_type_t;
 
 typedef struct {
@@ -130,6 +131,18 @@ typedef struct {
     const char *device_name;
 } hci_transport_config_uart_t;
 
+typedef struct {
+    hci_transport_config_type_t type; // == HCI_TRANSPORT_CONFIG_VIRTUAL
+    int        link_fd;                   // socket connected to peer, e.g. from socketpair(AF_UNIX, SOCK_SEQPACKET)
+    uint8_t    bd_addr[6];                // public address of emulated Controller
+    uint16_t   acl_data_packet_length;    // = 0: 1021
+    uint8_t    acl_packets_total_num;     // = 0: 8
+    uint16_t   le_acl_data_packet_length; // = 0: 251
+    uint8_t    le_acl_packets_total_num;  // = 0: 8
+    uint32_t   acl_air_bit_rate;          // bit/s to calculate air time of Classic ACL packets, = 0: no delay
+    uint32_t   le_acl_air_bit_rate;       // bit/s to calculate air time of LE ACL packets, = 0: no delay
+} hci_transport_config_virtual_t;
+
 
 // inline various hci_transport_X.h files
 
@@ -172,6 +185,12 @@ const hci_transport_t * hci_transport_usb_instance(void);
  */
 void hci_transport_usb_set_path(int len, uint8_t * port_numbers);
 
+/**
+ * @brief Setup virtual HCI transport with emulated Controller, configured by hci_transport_config_virtual_t
+ * @note Two instances are connected through their link_fd, e.g. in two processes after fork()
+ */
+const hci_transport_t * hci_transport_virtual_instance(void);
+
 /* API_END */
     
 #if defined __cplusplus
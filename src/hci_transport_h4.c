@@ -46,6 +46,7 @@
  */
 
 #include <inttypes.h>
+#include <string.h>
 
 #include "btstack_config.h"
 
@@ -55,6 +56,11 @@
 #include "bluetooth_company_id.h"
 #include "btstack_uart_block.h"
 
+// read buffer for UART drivers that provide all available bytes via receive_bytes
+#ifndef HCI_H4_RX_BUFFER_SIZE
+#define HCI_H4_RX_BUFFER_SIZE 256
+#endif
+
 #define ENABLE_LOG_EHCILL
 
 #ifdef ENABLE_EHCILL
@@ -147,6 +153,10 @@ static uint16_t read_pos;
 static uint8_t hci_packet_with_pre_buffer[HCI_INCOMING_PRE_BUFFER_SIZE + HCI_INCOMING_PACKET_BUFFER_SIZE + 1]; // packet type + max(acl header + acl payload, event header + event data)
 static uint8_t * hci_packet = &hci_packet_with_pre_buffer[HCI_INCOMING_PRE_BUFFER_SIZE];
 
+// streaming mode: UART driver reports all available bytes, packets are extracted by the same state machine
+static int     hci_transport_h4_streaming;
+static uint8_t hci_transport_h4_rx_buffer[HCI_H4_RX_BUFFER_SIZE];
+
 // Baudrate change bugs in TI CC256x and CYW20704
 #ifdef ENABLE_CC256X_BAUDRATE_CHANGE_FLOWCONTROL_BUG_WORKAROUND
 #define ENABLE_BAUDRATE_CHANGE_FLOWCONTROL_BUG_WORKAROUND
@@ -183,6 +193,10 @@ static void hci_transport_h4_reset_statemachine(void){
 }
 
 static void hci_transport_h4_trigger_next_read(void){
+    if (hci_transport_h4_streaming){
+        btstack_uart->receive_bytes(hci_transport_h4_rx_buffer, sizeof(hci_transport_h4_rx_buffer));
+        return;
+    }
     // log_info("hci_transport_h4_trigger_next_read: %u bytes", bytes_to_read);
     btstack_uart->receive_block(&hci_packet[read_pos], bytes_to_read);  
 }
@@ -222,7 +236,8 @@ static void hci_transport_h4_packet_complete(void){
     packet_handler(hci_packet[0], &hci_packet[1], packet_len);
 }
 
-static void hci_transport_h4_block_read(void){
+// update state machine after bytes_to_read bytes have been stored at hci_packet[read_pos]
+static void hci_transport_h4_process_read(void){
 
     read_pos += bytes_to_read;
 
@@ -312,6 +327,34 @@ static void hci_transport_h4_block_read(void){
     if (h4_state == H4_W4_PAYLOAD && bytes_to_read == 0u) {
         hci_transport_h4_packet_complete();
     }
+}
+
+static void hci_transport_h4_block_read(void){
+    hci_transport_h4_process_read();
+
+    if (h4_state != H4_OFF) {
+        hci_transport_h4_trigger_next_read();
+    }
+}
+
+static void hci_transport_h4_bytes_received(uint16_t num_bytes){
+    // extract all complete packets, a partial packet stays in hci_packet until the next read
+    uint16_t pos = 0;
+    while (pos < num_bytes){
+        // stop if closed by upper stack
+        if (h4_state == H4_OFF) return;
+
+        uint16_t bytes_available = num_bytes - pos;
+        if (bytes_available < bytes_to_read){
+            (void)memcpy(&hci_packet[read_pos], &hci_transport_h4_rx_buffer[pos], bytes_available);
+            read_pos      += bytes_available;
+            bytes_to_read -= bytes_available;
+            break;
+        }
+        (void)memcpy(&hci_packet[read_pos], &hci_transport_h4_rx_buffer[pos], bytes_to_read);
+        pos += bytes_to_read;
+        hci_transport_h4_process_read();
+    }
 
     if (h4_state != H4_OFF) {
         hci_transport_h4_trigger_next_read();
@@ -417,6 +460,12 @@ static void hci_transport_h4_init(const void * transport_config){
     btstack_uart->init(&uart_config);
     btstack_uart->set_block_received(&hci_transport_h4_block_read);
     btstack_uart->set_block_sent(&hci_transport_h4_block_sent);
+
+    // use large reads if supported by UART driver, e.g. POSIX. DMA-driven UARTs keep reading exact blocks
+    hci_transport_h4_streaming = (btstack_uart->set_bytes_received != NULL) && (btstack_uart->receive_bytes != NULL);
+    if (hci_transport_h4_streaming){
+        btstack_uart->set_bytes_received(&hci_transport_h4_bytes_received);
+    }
 }
 
 static int hci_transport_h4_open(void){
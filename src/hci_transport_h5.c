@@ -68,14 +68,22 @@ typedef enum {
     HCI_TRANSPORT_LINK_SEND_SLEEP                 = 1 <<  5,
     HCI_TRANSPORT_LINK_SEND_WOKEN                 = 1 <<  6,
     HCI_TRANSPORT_LINK_SEND_WAKEUP                = 1 <<  7,
-    HCI_TRANSPORT_LINK_SEND_QUEUED_PACKET         = 1 <<  8,
-    HCI_TRANSPORT_LINK_SEND_ACK_PACKET            = 1 <<  9,
-    HCI_TRANSPORT_LINK_ENTER_SLEEP                = 1 << 10,
+    HCI_TRANSPORT_LINK_SEND_ACK_PACKET            = 1 <<  8,
+    HCI_TRANSPORT_LINK_ENTER_SLEEP                = 1 <<  9,
 
 } hci_transport_link_actions_t;
 
-// Configuration Field. No packet buffers -> sliding window = 1, no OOF flow control, support data integrity check
-#define LINK_CONFIG_SLIDING_WINDOW_SIZE 1
+// Max number of unacknowledged reliable packets. For a sliding window > 1, outgoing packets are copied into
+// a retransmit buffer pool with one HCI_OUTGOING_PACKET_BUFFER_SIZE buffer per window slot
+#ifndef HCI_H5_SLIDING_WINDOW_SIZE
+#define HCI_H5_SLIDING_WINDOW_SIZE 1
+#endif
+#if (HCI_H5_SLIDING_WINDOW_SIZE < 1) || (HCI_H5_SLIDING_WINDOW_SIZE > 7)
+#error "HCI_H5_SLIDING_WINDOW_SIZE must be in range 1..7"
+#endif
+
+// Configuration Field. Sliding window = HCI_H5_SLIDING_WINDOW_SIZE, no OOF flow control, support data integrity check
+#define LINK_CONFIG_SLIDING_WINDOW_SIZE HCI_H5_SLIDING_WINDOW_SIZE
 #define LINK_CONFIG_OOF_FLOW_CONTROL 0
 #define LINK_CONFIG_DATA_INTEGRITY_CHECK 1
 #define LINK_CONFIG_VERSION_NR 0
@@ -91,8 +99,11 @@ typedef enum {
 #define LINK_ACKNOWLEDGEMENT_TYPE 0x00
 #define LINK_CONTROL_PACKET_TYPE 0x0f
 
-// max size of write requests
-#define LINK_SLIP_TX_CHUNK_LEN 64
+// outgoing frame is SLIP encoded in one pass: 2 x SOF + worst case of all bytes escaped for header, packet, and DIC
+#define LINK_SLIP_TX_BUFFER_SIZE (2 + 2 * (4 + HCI_OUTGOING_PACKET_BUFFER_SIZE + 2))
+
+// max size of read requests if UART driver supports partial reads
+#define LINK_SLIP_RX_BUFFER_SIZE 256
 
 // ---
 static const uint8_t link_control_sync[] =   { 0x01, 0x7e};
@@ -109,10 +120,8 @@ static const uint8_t link_control_sleep[] =  { 0x07, 0x78};
 // incoming pre-bufffer + 4 bytes H5 header + max(acl header + acl payload, event header + event data) + 2 bytes opt CRC
 static uint8_t   hci_packet_with_pre_buffer[HCI_INCOMING_PRE_BUFFER_SIZE + 6 + HCI_INCOMING_PACKET_BUFFER_SIZE];
 
-// outgoing slip encoded buffer. +4 to assert that DIC fits in buffer. +1 to assert that last SOF fits in buffer.
-static uint8_t   slip_outgoing_buffer[LINK_SLIP_TX_CHUNK_LEN+4+1];
-static uint16_t  slip_outgoing_dic;
-static uint16_t  slip_outgoing_dic_present;
+// outgoing slip encoded frame
+static uint8_t   slip_outgoing_buffer[LINK_SLIP_TX_BUFFER_SIZE];
 static int       slip_write_active;
 
 // H5 Link State
@@ -123,15 +132,29 @@ static uint8_t  link_ack_nr;
 static uint16_t link_resend_timeout_ms;
 static uint8_t  link_peer_asleep;
 static uint8_t  link_peer_supports_data_integrity_check;
+static uint8_t  link_window_size;
 
 // auto sleep-mode
 static btstack_timer_source_t inactivity_timer;
 static uint16_t link_inactivity_timeout_ms; // auto-sleep if set
 
-// Outgoing packet
-static uint8_t   hci_packet_type;
-static uint16_t  hci_packet_size;
-static uint8_t * hci_packet;
+// Outgoing packets, queue entry i has sequence number link_seq_nr + i
+typedef struct {
+    uint8_t * packet;
+    uint16_t  size;
+    uint8_t   type;
+} hci_transport_link_queue_entry_t;
+
+static hci_transport_link_queue_entry_t link_queue[LINK_CONFIG_SLIDING_WINDOW_SIZE];
+static uint8_t link_queue_head;     // oldest unacknowledged packet
+static uint8_t link_queue_len;      // number of unacknowledged packets
+static uint8_t link_queue_num_sent; // number of unacknowledged packets sent since last (re)transmission
+static uint8_t link_packet_sent_pending;
+
+#if LINK_CONFIG_SLIDING_WINDOW_SIZE > 1
+// retransmit buffer pool, outgoing packets are copied to allow the upper layer to continue
+static uint8_t link_retransmit_buffers[LINK_CONFIG_SLIDING_WINDOW_SIZE][HCI_OUTGOING_PACKET_BUFFER_SIZE];
+#endif
 
 // hci packet handler
 static  void (*packet_handler)(uint8_t packet_type, uint8_t *packet, uint16_t size);
@@ -147,6 +170,7 @@ static int hci_transport_bcsp_mode;
 // Prototypes
 static void hci_transport_h5_process_frame(uint16_t frame_size);
 static int  hci_transport_link_have_outgoing_packet(void);
+static int  hci_transport_link_have_unsent_packet(void);
 static void hci_transport_link_send_queued_packet(void);
 static void hci_transport_link_set_timer(uint16_t timeout_ms);
 static void hci_transport_link_timeout_handler(btstack_timer_source_t * timer);
@@ -218,59 +242,32 @@ static void hci_transport_inactivity_timer_set(void){
 // -----------------------------
 // SLIP Outgoing
 
-// Fill chunk and write
-static void hci_transport_slip_encode_chunk_and_send(int pos){
-    while (btstack_slip_encoder_has_data() & (pos < LINK_SLIP_TX_CHUNK_LEN)) {
-        slip_outgoing_buffer[pos++] = btstack_slip_encoder_get_byte();
-    }
-
-    if (!btstack_slip_encoder_has_data()){
-        // Payload encoded, append DIC if present.
-        // note: slip_outgoing_buffer is guaranteed to be big enough to add DIC + SOF after LINK_SLIP_TX_CHUNK_LEN
-        if (slip_outgoing_dic_present){
-            uint8_t dic_buffer[2];
-            big_endian_store_16(dic_buffer, 0, slip_outgoing_dic);
-            btstack_slip_encoder_start(dic_buffer, 2);
-            while (btstack_slip_encoder_has_data()){
-                slip_outgoing_buffer[pos++] = btstack_slip_encoder_get_byte();
-            } 
-        }
-        // Start of Frame
-        slip_outgoing_buffer[pos++] = BTSTACK_SLIP_SOF;
-    }
-    slip_write_active = 1;
-    log_debug("slip: send %d bytes", pos);
-    btstack_uart->send_block(slip_outgoing_buffer, pos);
-}
-
-static inline void hci_transport_slip_send_next_chunk(void){
-    hci_transport_slip_encode_chunk_and_send(0);
-}
-
 // format: 0xc0 HEADER PACKET [DIC] 0xc0
 // @param uint8_t header[4]
 static void hci_transport_slip_send_frame(const uint8_t * header, const uint8_t * packet, uint16_t packet_size, uint16_t data_integrity_check){
     
-    int pos = 0;
-    
-    // store data integrity check info
-    slip_outgoing_dic         = data_integrity_check;
-    slip_outgoing_dic_present = header[0] & 0x40u;
+    uint16_t pos = 0;
 
     // Start of Frame
     slip_outgoing_buffer[pos++] = BTSTACK_SLIP_SOF;
 
-    // Header
-    btstack_slip_encoder_start(header, 4);
-    while (btstack_slip_encoder_has_data()){
-        slip_outgoing_buffer[pos++] = btstack_slip_encoder_get_byte();
+    // Header and Packet
+    pos += btstack_slip_encode(&slip_outgoing_buffer[pos], sizeof(slip_outgoing_buffer) - pos, header, 4);
+    pos += btstack_slip_encode(&slip_outgoing_buffer[pos], sizeof(slip_outgoing_buffer) - pos, packet, packet_size);
+
+    // Data Integrity Check
+    if ((header[0] & 0x40u) != 0u){
+        uint8_t dic_buffer[2];
+        big_endian_store_16(dic_buffer, 0, data_integrity_check);
+        pos += btstack_slip_encode(&slip_outgoing_buffer[pos], sizeof(slip_outgoing_buffer) - pos, dic_buffer, 2);
     }
 
-    // Packet
-    btstack_slip_encoder_start(packet, packet_size);
+    // End of Frame
+    slip_outgoing_buffer[pos++] = BTSTACK_SLIP_SOF;
 
-    // Fill rest of chunk from packet and send
-    hci_transport_slip_encode_chunk_and_send(pos);
+    slip_write_active = 1;
+    log_debug("slip: send %d bytes", pos);
+    btstack_uart->send_block(slip_outgoing_buffer, pos);
 }
 
 // SLIP Incoming
@@ -348,19 +345,24 @@ static void hci_transport_link_send_sleep(void){
     hci_transport_link_send_control(link_control_sleep, sizeof(link_control_sleep));
 }
 
+// send next packet from queue that hasn't been sent since last (re)transmission
 static void hci_transport_link_send_queued_packet(void){
 
+    const hci_transport_link_queue_entry_t * entry = &link_queue[(link_queue_head + link_queue_num_sent) % LINK_CONFIG_SLIDING_WINDOW_SIZE];
+    uint8_t seq_nr = (link_seq_nr + link_queue_num_sent) & 0x07u;
+    link_queue_num_sent++;
+
     uint8_t header[4];
-    hci_transport_link_calc_header(header, link_seq_nr, link_ack_nr, link_peer_supports_data_integrity_check, 1, hci_packet_type, hci_packet_size);
+    hci_transport_link_calc_header(header, seq_nr, link_ack_nr, link_peer_supports_data_integrity_check, 1, entry->type, entry->size);
 
     uint16_t data_integrity_check = 0;
     if (link_peer_supports_data_integrity_check){
-        data_integrity_check = crc16_calc_for_slip_frame(header, hci_packet, hci_packet_size);
+        data_integrity_check = crc16_calc_for_slip_frame(header, entry->packet, entry->size);
     }
-    log_debug("hci_transport_link_send_queued_packet: seq %u, ack %u, size %u. Append dic %u, dic = 0x%04x", link_seq_nr, link_ack_nr, hci_packet_size, link_peer_supports_data_integrity_check, data_integrity_check);
-    log_debug_hexdump(hci_packet, hci_packet_size);
+    log_debug("hci_transport_link_send_queued_packet: seq %u, ack %u, size %u. Append dic %u, dic = 0x%04x", seq_nr, link_ack_nr, entry->size, link_peer_supports_data_integrity_check, data_integrity_check);
+    log_debug_hexdump(entry->packet, entry->size);
 
-    hci_transport_slip_send_frame(header, hci_packet, hci_packet_size, data_integrity_check);
+    hci_transport_slip_send_frame(header, entry->packet, entry->size, data_integrity_check);
 
     // reset inactvitiy timer
     hci_transport_inactivity_timer_set();
@@ -414,8 +416,7 @@ static void hci_transport_link_run(void){
         hci_transport_link_send_wakeup();
         return;
     }
-    if (hci_transport_link_actions & HCI_TRANSPORT_LINK_SEND_QUEUED_PACKET){
-        hci_transport_link_actions &= ~HCI_TRANSPORT_LINK_SEND_QUEUED_PACKET;
+    if (hci_transport_link_have_unsent_packet() && !link_peer_asleep){
         // packet already contains ack, no need to send addtitional one
         hci_transport_link_actions &= ~HCI_TRANSPORT_LINK_SEND_ACK_PACKET;
         hci_transport_link_send_queued_packet();
@@ -436,6 +437,7 @@ static void hci_transport_link_run(void){
 }
 
 static void hci_transport_link_set_timer(uint16_t timeout_ms){
+    btstack_run_loop_remove_timer(&link_timer);
     btstack_run_loop_set_timer_handler(&link_timer, &hci_transport_link_timeout_handler);
     btstack_run_loop_set_timer(&link_timer, timeout_ms);
     btstack_run_loop_add_timer(&link_timer);
@@ -462,8 +464,9 @@ static void hci_transport_link_timeout_handler(btstack_timer_source_t * ts){
                 hci_transport_link_set_timer(LINK_WAKEUP_MS);
                 return;
             }
-            // resend packet
-            hci_transport_link_actions |= HCI_TRANSPORT_LINK_SEND_QUEUED_PACKET;
+            // resend all unacknowledged packets
+            log_info("h5 timeout, resend %u packets starting with seq %u", link_queue_len, link_seq_nr);
+            link_queue_num_sent = 0;
             hci_transport_link_set_timer(link_resend_timeout_ms);
             break;
         default:
@@ -477,6 +480,7 @@ static void hci_transport_link_init(void){
     link_state = LINK_UNINITIALIZED;
     link_peer_asleep = 0;
     link_peer_supports_data_integrity_check = 0;
+    link_window_size = 1;
  
     // get started
     hci_transport_link_actions |= HCI_TRANSPORT_LINK_SEND_SYNC;
@@ -489,18 +493,64 @@ static int hci_transport_link_inc_seq_nr(int seq_nr){
 }
 
 static int hci_transport_link_have_outgoing_packet(void){
-    return hci_packet != NULL;
+    return link_queue_len > 0u;
+}
+
+static int hci_transport_link_have_unsent_packet(void){
+    return link_queue_num_sent < link_queue_len;
 }
 
 static void hci_transport_link_clear_queue(void){
     btstack_run_loop_remove_timer(&link_timer);
-    hci_packet = NULL;
+    link_queue_head = 0;
+    link_queue_len = 0;
+    link_queue_num_sent = 0;
+    link_packet_sent_pending = 0;
 }
 
 static void hci_transport_h5_queue_packet(uint8_t packet_type, uint8_t *packet, int size){
-    hci_packet = packet;
-    hci_packet_type = packet_type;
-    hci_packet_size = size;
+    uint8_t index = (link_queue_head + link_queue_len) % LINK_CONFIG_SLIDING_WINDOW_SIZE;
+    hci_transport_link_queue_entry_t * entry = &link_queue[index];
+#if LINK_CONFIG_SLIDING_WINDOW_SIZE > 1
+    (void)memcpy(link_retransmit_buffers[index], packet, size);
+    entry->packet = link_retransmit_buffers[index];
+#else
+    entry->packet = packet;
+#endif
+    entry->type = packet_type;
+    entry->size = size;
+    link_queue_len++;
+    link_packet_sent_pending = 1;
+}
+
+// cumulative ack: peer expects ack_nr next, all packets before are acknowledged
+static void hci_transport_link_process_ack(uint8_t ack_nr){
+    uint8_t num_acked = (ack_nr - link_seq_nr) & 0x07u;
+    if (num_acked == 0u) return;
+    if (num_acked > link_queue_len){
+        log_info("ack nr %u for unsent packet, seq nr %u, %u packets queued", ack_nr, link_seq_nr, link_queue_len);
+        return;
+    }
+    log_debug("%u outgoing packets up to seq %u ack'ed", num_acked, (ack_nr - 1u) & 0x07u);
+    link_seq_nr = ack_nr;
+    link_queue_head = (link_queue_head + num_acked) % LINK_CONFIG_SLIDING_WINDOW_SIZE;
+    link_queue_len -= num_acked;
+    link_queue_num_sent = (link_queue_num_sent > num_acked) ? (link_queue_num_sent - num_acked) : 0u;
+
+    // restart resend timer for remaining packets
+    btstack_run_loop_remove_timer(&link_timer);
+    if (link_queue_len > 0u){
+        hci_transport_link_set_timer(link_resend_timeout_ms);
+    }
+}
+
+// notify upper stack that it can send again, if there's room in the sliding window
+static void hci_transport_link_emit_packet_sent_if_ready(void){
+    if (link_packet_sent_pending == 0u) return;
+    if (link_queue_len >= link_window_size) return;
+    link_packet_sent_pending = 0;
+    uint8_t event[] = { HCI_EVENT_TRANSPORT_PACKET_SENT, 0};
+    packet_handler(HCI_EVENT_PACKET, &event[0], sizeof(event));
 }
 
 static void hci_transport_h5_emit_sleep_state(int sleep_active){
@@ -523,6 +573,8 @@ static void hci_transport_h5_process_frame(uint16_t frame_size){
 
     if (frame_size < 4u) return;
 
+    int out_of_sequence;
+
     uint8_t * slip_header  = &hci_packet_with_pre_buffer[HCI_INCOMING_PRE_BUFFER_SIZE];
     uint8_t * slip_payload = &hci_packet_with_pre_buffer[HCI_INCOMING_PRE_BUFFER_SIZE + 4];
     int       frame_size_without_header = frame_size - 4u;
@@ -609,9 +661,20 @@ static void hci_transport_h5_process_frame(uint16_t frame_size){
                 break;
             }
             if (memcmp(slip_payload, link_control_config_response, link_control_config_response_prefix_len) == 0){
-                uint8_t config = slip_payload[2];
+                uint8_t config = 0;
+                if (link_payload_len > link_control_config_response_prefix_len){
+                    config = slip_payload[2];
+                }
                 link_peer_supports_data_integrity_check = (config & 0x10u) != 0u;
-                log_info("link received config response 0x%02x, data integrity check supported %u", config, link_peer_supports_data_integrity_check);
+                // use smaller sliding window, peer window size 0 is treated as 1
+                link_window_size = config & 0x07u;
+                if (link_window_size > LINK_CONFIG_SLIDING_WINDOW_SIZE){
+                    link_window_size = LINK_CONFIG_SLIDING_WINDOW_SIZE;
+                }
+                if (link_window_size == 0u){
+                    link_window_size = 1;
+                }
+                log_info("link received config response 0x%02x, data integrity check supported %u, sliding window %u", config, link_peer_supports_data_integrity_check, link_window_size);
                 link_state = LINK_ACTIVE;
                 btstack_run_loop_remove_timer(&link_timer);
                 log_info("link activated");
@@ -627,31 +690,26 @@ static void hci_transport_h5_process_frame(uint16_t frame_size){
         case LINK_ACTIVE:
 
             // validate packet sequence nr in reliable packets (check for out of sequence error)
+            out_of_sequence = 0;
             if (reliable_packet){
-                if (seq_nr != link_ack_nr){
+                if (seq_nr == link_ack_nr){
+                    link_ack_nr = hci_transport_link_inc_seq_nr(link_ack_nr);
+                } else {
                     log_info("expected seq nr %u, but received %u", link_ack_nr, seq_nr);
-                    hci_transport_link_actions |= HCI_TRANSPORT_LINK_SEND_ACK_PACKET;
-                    break;
+                    out_of_sequence = 1;
                 }
                 // ack packet right away
-                link_ack_nr = hci_transport_link_inc_seq_nr(link_ack_nr);
                 hci_transport_link_actions |= HCI_TRANSPORT_LINK_SEND_ACK_PACKET;
             }
 
-            // Process ACKs in reliable packet and explicit ack packets
+            // Process cumulative ACKs in reliable packet and explicit ack packets, also for out of sequence packets
             if (reliable_packet || (link_packet_type == LINK_ACKNOWLEDGEMENT_TYPE)){
-                // our packet is good if the remote expects our seq nr + 1
-                int next_seq_nr = hci_transport_link_inc_seq_nr(link_seq_nr);
-                if (hci_transport_link_have_outgoing_packet() && (next_seq_nr == ack_nr)){
-                    log_debug("outoing packet with seq %u ack'ed", link_seq_nr);
-                    link_seq_nr = next_seq_nr;
-                    hci_transport_link_clear_queue();
-
-                    // notify upper stack that it can send again
-                    uint8_t event[] = { HCI_EVENT_TRANSPORT_PACKET_SENT, 0};
-                    packet_handler(HCI_EVENT_PACKET, &event[0], sizeof(event));
-                }
-            } 
+                hci_transport_link_process_ack(ack_nr);
+                hci_transport_link_emit_packet_sent_if_ready();
+            }
+
+            // drop out of sequence packets
+            if (out_of_sequence) break;
 
             switch (link_packet_type){
                 case LINK_CONTROL_PACKET_TYPE:
@@ -690,7 +748,10 @@ static void hci_transport_h5_process_frame(uint16_t frame_size){
                     if (memcmp(slip_payload, link_control_woken, sizeof(link_control_woken)) == 0){
                         log_info("link: received woken message");
                         link_peer_asleep = 0;
-                        // queued packet will be sent in hci_transport_link_run if needed
+                        // queued packets will be sent in hci_transport_link_run, restart resend timer
+                        if (hci_transport_link_have_outgoing_packet()){
+                            hci_transport_link_set_timer(link_resend_timeout_ms);
+                        }
                         break;
                     }
                     break;
@@ -732,25 +793,34 @@ static void hci_transport_link_update_resend_timeout(uint32_t baudrate){
 
 /// H5 Interface
 
-static uint8_t hci_transport_link_read_byte;
+static uint8_t hci_transport_link_read_buffer[LINK_SLIP_RX_BUFFER_SIZE];
 static int hci_transport_h5_active;
 
-static void hci_transport_h5_read_next_byte(void){
-    btstack_uart->receive_block(&hci_transport_link_read_byte, 1);    
+static void hci_transport_h5_read_next_block(void){
+    if (btstack_uart->receive_bytes != NULL){
+        // decode all bytes available
+        btstack_uart->receive_bytes(hci_transport_link_read_buffer, sizeof(hci_transport_link_read_buffer));
+    } else {
+        btstack_uart->receive_block(hci_transport_link_read_buffer, 1);
+    }
 }
 
 // track time receiving SLIP frame
 static uint32_t hci_transport_h5_receive_start;
-static void hci_transport_h5_block_received(void){
+static void hci_transport_h5_bytes_received(uint16_t num_bytes){
     if (hci_transport_h5_active == 0) return;
 
-    // track start time when receiving first byte // a bit hackish
-    if ((hci_transport_h5_receive_start == 0u) && (hci_transport_link_read_byte != BTSTACK_SLIP_SOF)){
-        hci_transport_h5_receive_start = btstack_run_loop_get_time_ms();
-    }
-    btstack_slip_decoder_process(hci_transport_link_read_byte);
-    uint16_t frame_size = btstack_slip_decoder_frame_size();
-    if (frame_size) {
+    uint16_t pos = 0;
+    while (pos < num_bytes){
+        // track start time when receiving first byte // a bit hackish
+        if ((hci_transport_h5_receive_start == 0u) && (hci_transport_link_read_buffer[pos] != BTSTACK_SLIP_SOF)){
+            hci_transport_h5_receive_start = btstack_run_loop_get_time_ms();
+        }
+        // decode into hci packet buffer
+        pos += btstack_slip_decoder_process_block(&hci_transport_link_read_buffer[pos], num_bytes - pos);
+        uint16_t frame_size = btstack_slip_decoder_frame_size();
+        if (frame_size == 0u) continue;
+
         // track time
         uint32_t packet_receive_time = btstack_run_loop_get_time_ms() - hci_transport_h5_receive_start;
         uint32_t nominal_time = (frame_size + 6u) * 10u * 1000u / uart_config.baudrate;
@@ -762,19 +832,20 @@ static void hci_transport_h5_block_received(void){
         // 
         hci_transport_h5_process_frame(frame_size);
         hci_transport_slip_init();
+
+        // stop if closed by upper stack
+        if (hci_transport_h5_active == 0) return;
     }
-    hci_transport_h5_read_next_byte();
+    hci_transport_h5_read_next_block();
+}
+
+static void hci_transport_h5_block_received(void){
+    hci_transport_h5_bytes_received(1);
 }
 
 static void hci_transport_h5_block_sent(void){
     if (hci_transport_h5_active == 0) return;
 
-    // check if more data to send
-    if (btstack_slip_encoder_has_data()){
-        hci_transport_slip_send_next_chunk();
-        return;
-    }
-
     // done
     slip_write_active = 0;
 
@@ -791,6 +862,9 @@ static void hci_transport_h5_block_sent(void){
     }
 
     hci_transport_link_run();
+
+    // packets are buffered in the retransmit pool, upper stack can continue if sliding window isn't full
+    hci_transport_link_emit_packet_sent_if_ready();
 }
 
 static void hci_transport_h5_init(const void * transport_config){
@@ -816,6 +890,9 @@ static void hci_transport_h5_init(const void * transport_config){
     btstack_uart->init(&uart_config);
     btstack_uart->set_block_received(&hci_transport_h5_block_received);
     btstack_uart->set_block_sent(&hci_transport_h5_block_sent);
+    if (btstack_uart->set_bytes_received != NULL){
+        btstack_uart->set_bytes_received(&hci_transport_h5_bytes_received);
+    }
 }
 
 static int hci_transport_h5_open(void){
@@ -846,6 +923,9 @@ static int hci_transport_h5_open(void){
     // setup resend timeout
     hci_transport_link_update_resend_timeout(uart_config.baudrate);
 
+    // drop outgoing frame if closed during transmission
+    slip_write_active = 0;
+
     // init slip parser state machine
     hci_transport_slip_init();
 
@@ -854,13 +934,16 @@ static int hci_transport_h5_open(void){
 
     // start receiving
     hci_transport_h5_active = 1;
-    hci_transport_h5_read_next_byte();
+    hci_transport_h5_read_next_block();
 
     return 0;
 }
 
 static int hci_transport_h5_close(void){
     hci_transport_h5_active = 0;
+    // stop resend timer and drop unacknowledged packets
+    hci_transport_link_clear_queue();
+    btstack_run_loop_remove_timer(&inactivity_timer);
     return btstack_uart->close();
 }
 
@@ -869,7 +952,8 @@ static void hci_transport_h5_register_packet_handler(void (*handler)(uint8_t pac
 }
 
 static int hci_transport_h5_can_send_packet_now(uint8_t packet_type){
-    int res = !hci_transport_link_have_outgoing_packet() && (link_state == LINK_ACTIVE);
+    UNUSED(packet_type);
+    int res = (link_state == LINK_ACTIVE) && (link_packet_sent_pending == 0u) && (link_queue_len < link_window_size);
     // log_info("can_send_packet_now: %u", res);
     return res;
 }
@@ -881,6 +965,7 @@ static int hci_transport_h5_send_packet(uint8_t packet_type, uint8_t *packet, in
     }
 
     // store request
+    int start_resend_timer = !hci_transport_link_have_outgoing_packet();
     hci_transport_h5_queue_packet(packet_type, packet, size);
 
     // send wakeup first
@@ -892,8 +977,7 @@ static int hci_transport_h5_send_packet(uint8_t packet_type, uint8_t *packet, in
         }
         hci_transport_link_actions |= HCI_TRANSPORT_LINK_SEND_WAKEUP;
         hci_transport_link_set_timer(LINK_WAKEUP_MS);
-    } else {
-        hci_transport_link_actions |= HCI_TRANSPORT_LINK_SEND_QUEUED_PACKET;
+    } else if (start_resend_timer) {
         hci_transport_link_set_timer(link_resend_timeout_ms);
     }
     hci_transport_link_run();
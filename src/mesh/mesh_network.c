@@ -63,7 +63,12 @@
 #endif
 
 // configuration
+#ifndef MESH_NETWORK_CACHE_SIZE
 #define MESH_NETWORK_CACHE_SIZE 2
+#endif
+
+// open addressing hash set with load factor <= 0.5
+#define MESH_NETWORK_CACHE_TABLE_SIZE (2 * MESH_NETWORK_CACHE_SIZE)
 
 // debug config
 // #define LOG_NETWORK
@@ -136,8 +141,11 @@ static mesh_network_pdu_t * adv_bearer_network_pdu;
 
 
 // mesh network cache - we use 32-bit 'hashes'
+// - FIFO of cached hashes in order of arrival, oldest one is evicted when full
+// - hash set with linear probing for lookup, 0 marks free slot as SRC is always a unicast address
 static uint32_t mesh_network_cache[MESH_NETWORK_CACHE_SIZE];
 static int      mesh_network_cache_index;
+static uint32_t mesh_network_cache_table[MESH_NETWORK_CACHE_TABLE_SIZE];
 
 // prototypes
 
@@ -156,21 +164,73 @@ static uint32_t mesh_network_cache_hash(mesh_network_pdu_t * network_pdu){
     return (src << 16) | (ivi << 15) | (seq & 0x7fff);
 }
 
+static uint32_t mesh_network_cache_table_slot(uint32_t hash){
+    // SRC is in upper and SEQ in lower bits, mix both
+    return (hash * 0x9E3779B1u) % MESH_NETWORK_CACHE_TABLE_SIZE;
+}
+
+static uint32_t mesh_network_cache_table_next(uint32_t slot){
+    slot++;
+    if (slot >= MESH_NETWORK_CACHE_TABLE_SIZE){
+        slot = 0;
+    }
+    return slot;
+}
+
+static void mesh_network_cache_table_remove(uint32_t hash){
+    uint32_t slot = mesh_network_cache_table_slot(hash);
+    while (mesh_network_cache_table[slot] != hash){
+        if (mesh_network_cache_table[slot] == 0u) return;
+        slot = mesh_network_cache_table_next(slot);
+    }
+    // backward shift deletion: move following entries of the probe sequence into the free slot
+    uint32_t free_slot = slot;
+    while (true){
+        slot = mesh_network_cache_table_next(slot);
+        uint32_t entry = mesh_network_cache_table[slot];
+        if (entry == 0u) break;
+        uint32_t home = mesh_network_cache_table_slot(entry);
+        // entry stays if its home slot is cyclically in (free_slot, slot]
+        bool stays;
+        if (free_slot <= slot){
+            stays = (free_slot < home) && (home <= slot);
+        } else {
+            stays = (free_slot < home) || (home <= slot);
+        }
+        if (stays) continue;
+        mesh_network_cache_table[free_slot] = entry;
+        free_slot = slot;
+    }
+    mesh_network_cache_table[free_slot] = 0;
+}
+
 static int mesh_network_cache_find(uint32_t hash){
-    int i;
-    for (i = 0; i < MESH_NETWORK_CACHE_SIZE; i++) {
-        if (mesh_network_cache[i] == hash) {
+    uint32_t slot = mesh_network_cache_table_slot(hash);
+    while (mesh_network_cache_table[slot] != 0u){
+        if (mesh_network_cache_table[slot] == hash) {
             return 1;
         }
+        slot = mesh_network_cache_table_next(slot);
     }
     return 0;
 }
 
+// only called if hash is not in cache
 static void mesh_network_cache_add(uint32_t hash){
+    // evict oldest entry
+    uint32_t oldest = mesh_network_cache[mesh_network_cache_index];
+    if (oldest != 0u){
+        mesh_network_cache_table_remove(oldest);
+    }
     mesh_network_cache[mesh_network_cache_index++] = hash;
     if (mesh_network_cache_index >= MESH_NETWORK_CACHE_SIZE){
         mesh_network_cache_index = 0;
     }
+    uint32_t slot = mesh_network_cache_table_slot(hash);
+    while (mesh_network_cache_table[slot] != 0u){
+        slot = mesh_network_cache_table_next(slot);
+    }
+    mesh_network_cache_table[slot] = hash;
 }
 
 // common helper
@@ -0,0 +1,513 @@
+/*
+ * Copyright (C) 2020 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHIAS
+ * RINGWALD OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+#define BTSTACK_FILE__ "att_db_benchmark.c"
+
+/*
+ *  att_db_benchmark.c
+ *
+ *  Replay a full GATT discovery and random ATT requests against a large generated GATT database,
+ *  without ATT DB index, with index built at runtime and with index generated by compile_gatt.py.
+ *  Responses of all runs must be identical.
+ */
+
+#define _POSIX_C_SOURCE 200809
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ble/att_db.h"
+#include "bluetooth.h"
+#include "bluetooth_gatt.h"
+#include "btstack_util.h"
+
+#include "large_profile.h"
+
+#define ATT_MTU            23
+#define ATT_MTU_MAX        247
+#define MAX_SERVICES       256
+#define MAX_CHARACTERISTICS 2048
+#define NUM_DISCOVERIES    20
+#define NUM_RANDOM_REQUESTS 20000
+#define TRANSCRIPT_SIZE    (4 * 1024 * 1024)
+
+typedef struct {
+    uint16_t start_handle;
+    uint16_t end_handle;
+    uint16_t uuid_len;
+    uint8_t  uuid[16];
+} service_t;
+
+typedef struct {
+    uint16_t value_handle;
+    uint16_t uuid_len;
+    uint8_t  uuid[16];
+} characteristic_t;
+
+static att_connection_t att_connection;
+static uint8_t  response_buffer[ATT_MTU_MAX];
+
+static service_t services[MAX_SERVICES];
+static int num_services;
+static characteristic_t characteristics[MAX_CHARACTERISTICS];
+static int num_characteristics;
+
+static uint32_t num_requests;
+static uint8_t * transcript;
+static uint32_t  transcript_len;
+
+static uint32_t random_state;
+
+static uint64_t get_time_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t) ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+static uint32_t random_next(void){
+    // xorshift32
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 17;
+    random_state ^= random_state << 5;
+    return random_state;
+}
+
+static uint16_t att_read_callback(hci_con_handle_t con_handle, uint16_t attribute_handle, uint16_t offset, uint8_t * buffer, uint16_t buffer_size){
+    UNUSED(con_handle);
+    // value len depends on handle
+    uint8_t value[32];
+    uint16_t value_len = 2u + (attribute_handle % 20u);
+    uint16_t i;
+    for (i = 0; i < value_len; i++){
+        value[i] = (uint8_t) (attribute_handle + i);
+    }
+    if (offset > value_len) return 0;
+    return att_read_callback_handle_blob(value, value_len, offset, buffer, buffer_size);
+}
+
+static uint16_t att_request(uint8_t * request, uint16_t request_len){
+    uint16_t response_len = att_handle_request(&att_connection, request, request_len, response_buffer);
+    num_requests++;
+    if (transcript != NULL){
+        if ((transcript_len + 2u + response_len) > TRANSCRIPT_SIZE){
+            printf("Transcript buffer too small\n");
+            exit(1);
+        }
+        little_endian_store_16(transcript, transcript_len, response_len);
+        (void)memcpy(&transcript[transcript_len + 2u], response_buffer, response_len);
+        transcript_len += 2u + response_len;
+    }
+    return response_len;
+}
+
+static void discover_services(uint16_t group_type){
+    uint16_t start_handle = 1;
+    while (true){
+        uint8_t request[7];
+        request[0] = ATT_READ_BY_GROUP_TYPE_REQUEST;
+        little_endian_store_16(request, 1, start_handle);
+        little_endian_store_16(request, 3, 0xffff);
+        little_endian_store_16(request, 5, group_type);
+        uint16_t response_len = att_request(request, sizeof(request));
+        if ((response_len < 2u) || (response_buffer[0] != ATT_READ_BY_GROUP_TYPE_RESPONSE)) break;
+        uint16_t pair_len = response_buffer[1];
+        uint16_t end_handle = 0;
+        uint16_t offset;
+        for (offset = 2; (offset + pair_len) <= response_len; offset += pair_len){
+            end_handle = little_endian_read_16(response_buffer, offset + 2u);
+            if (num_services < MAX_SERVICES){
+                service_t * service = &services[num_services++];
+                service->start_handle = little_endian_read_16(response_buffer, offset);
+                service->end_handle   = end_handle;
+                service->uuid_len     = pair_len - 4u;
+                (void)memcpy(service->uuid, &response_buffer[offset + 4u], btstack_min(service->uuid_len, 16));
+            }
+        }
+        if ((end_handle == 0u) || (end_handle == 0xffffu)) break;
+        start_handle = end_handle + 1u;
+    }
+}
+
+static void discover_characteristics(const service_t * service){
+    uint16_t start_handle = service->start_handle;
+    while (start_handle <= service->end_handle){
+        uint8_t request[7];
+        request[0] = ATT_READ_BY_TYPE_REQUEST;
+        little_endian_store_16(request, 1, start_handle);
+        little_endian_store_16(request, 3, service->end_handle);
+        little_endian_store_16(request, 5, GATT_CHARACTERISTICS_UUID);
+        uint16_t response_len = att_request(request, sizeof(request));
+        if ((response_len < 2u) || (response_buffer[0] != ATT_READ_BY_TYPE_RESPONSE)) break;
+        uint16_t pair_len = response_buffer[1];
+        uint16_t last_handle = 0;
+        uint16_t offset;
+        for (offset = 2; (offset + pair_len) <= response_len; offset += pair_len){
+            last_handle = little_endian_read_16(response_buffer, offset);
+            if (num_characteristics < MAX_CHARACTERISTICS){
+                characteristic_t * characteristic = &characteristics[num_characteristics++];
+                characteristic->value_handle = little_endian_read_16(response_buffer, offset + 3u);
+                characteristic->uuid_len = pair_len - 7u;
+                (void)memcpy(characteristic->uuid, &response_buffer[offset + 7u], btstack_min(characteristic->uuid_len, 16));
+            }
+        }
+        if ((last_handle == 0u) || (last_handle == 0xffffu)) break;
+        start_handle = last_handle + 1u;
+    }
+}
+
+static void discover_descriptors(const service_t * service){
+    uint16_t start_handle = service->start_handle;
+    while (start_handle <= service->end_handle){
+        uint8_t request[5];
+        request[0] = ATT_FIND_INFORMATION_REQUEST;
+        little_endian_store_16(request, 1, start_handle);
+        little_endian_store_16(request, 3, service->end_handle);
+        uint16_t response_len = att_request(request, sizeof(request));
+        if ((response_len < 2u) || (response_buffer[0] != ATT_FIND_INFORMATION_REPLY)) break;
+        uint16_t pair_len = (response_buffer[1] == 1u) ? 4u : 18u;
+        uint16_t last_handle = little_endian_read_16(response_buffer, response_len - pair_len);
+        if (last_handle == 0xffffu) break;
+        start_handle = last_handle + 1u;
+    }
+}
+
+static void discover_service_by_uuid(const service_t * service){
+    uint16_t start_handle = 1;
+    while (true){
+        uint8_t request[7 + 16];
+        request[0] = ATT_FIND_BY_TYPE_VALUE_REQUEST;
+        little_endian_store_16(request, 1, start_handle);
+        little_endian_store_16(request, 3, 0xffff);
+        little_endian_store_16(request, 5, GATT_PRIMARY_SERVICE_UUID);
+        (void)memcpy(&request[7], service->uuid, service->uuid_len);
+        uint16_t response_len = att_request(request, 7u + service->uuid_len);
+        if ((response_len < 5u) || (response_buffer[0] != ATT_FIND_BY_TYPE_VALUE_RESPONSE)) break;
+        uint16_t end_handle = little_endian_read_16(response_buffer, response_len - 2u);
+        if ((end_handle == 0u) || (end_handle == 0xffffu)) break;
+        start_handle = end_handle + 1u;
+    }
+}
+
+static void read_characteristics_by_uuid(const characteristic_t * characteristic){
+    uint16_t start_handle = 1;
+    while (true){
+        uint8_t request[5 + 16];
+        request[0] = ATT_READ_BY_TYPE_REQUEST;
+        little_endian_store_16(request, 1, start_handle);
+        little_endian_store_16(request, 3, 0xffff);
+        (void)memcpy(&request[5], characteristic->uuid, characteristic->uuid_len);
+        uint16_t response_len = att_request(request, 5u + characteristic->uuid_len);
+        if ((response_len < 4u) || (response_buffer[0] != ATT_READ_BY_TYPE_RESPONSE)) break;
+        uint16_t pair_len = response_buffer[1];
+        uint16_t last_handle = little_endian_read_16(response_buffer, 2u + (((response_len - 2u) / pair_len) - 1u) * pair_len);
+        if (last_handle == 0xffffu) break;
+        start_handle = last_handle + 1u;
+    }
+}
+
+static void read_value(uint16_t value_handle){
+    uint8_t request[3];
+    request[0] = ATT_READ_REQUEST;
+    little_endian_store_16(request, 1, value_handle);
+    (void) att_request(request, sizeof(request));
+}
+
+// full discovery as done by gatt_client, followed by reads of all characteristic values
+static void gatt_discovery(void){
+    num_services = 0;
+    num_characteristics = 0;
+    discover_services(GATT_PRIMARY_SERVICE_UUID);
+    discover_services(GATT_SECONDARY_SERVICE_UUID);
+    int i;
+    for (i = 0; i < num_services; i++){
+        discover_characteristics(&services[i]);
+        discover_descriptors(&services[i]);
+        discover_service_by_uuid(&services[i]);
+    }
+    for (i = 0; i < num_characteristics; i++){
+        read_value(characteristics[i].value_handle);
+    }
+    // read characteristics by UUID over complete database, one UUID16 and one UUID128
+    for (i = 0; i < num_characteristics; i++){
+        if (characteristics[i].uuid_len == 2u){
+            read_characteristics_by_uuid(&characteristics[i]);
+            break;
+        }
+    }
+    for (i = 0; i < num_characteristics; i++){
+        if (characteristics[i].uuid_len == 16u){
+            read_characteristics_by_uuid(&characteristics[i]);
+            break;
+        }
+    }
+}
+
+static uint16_t random_handle(uint16_t max_handle){
+    // mostly valid handles, some out of range
+    switch (random_next() % 8u){
+        case 0:
+            return 0;
+        case 1:
+            return 0xffff;
+        default:
+            return (uint16_t) (random_next() % (max_handle + 2u));
+    }
+}
+
+static uint16_t random_uuid(uint8_t * uuid){
+    uint16_t uuid16 = 0;
+    if ((random_next() % 2u) == 0u){
+        uint16_t uuid_len = num_characteristics ? characteristics[random_next() % num_characteristics].uuid_len : 2u;
+        if (num_characteristics){
+            (void)memcpy(uuid, characteristics[random_next() % num_characteristics].uuid, 16);
+        }
+        if ((uuid_len == 16u) || ((random_next() % 4u) == 0u)){
+            // UUID128, possibly a Bluetooth Base UUID
+            return 16;
+        }
+        uuid16 = little_endian_read_16(uuid, 0);
+    } else {
+        static const uint16_t uuids[] = {
+            GATT_PRIMARY_SERVICE_UUID, GATT_SECONDARY_SERVICE_UUID, GATT_CHARACTERISTICS_UUID,
+            GATT_CLIENT_CHARACTERISTICS_CONFIGURATION, GATT_CHARACTERISTIC_USER_DESCRIPTION, 0xA000, 0xA002, 0xC000, 0x1234
+        };
+        uuid16 = uuids[random_next() % (sizeof(uuids) / sizeof(uint16_t))];
+    }
+    little_endian_store_16(uuid, 0, uuid16);
+    return 2;
+}
+
+// group requests with end handle within each service, from start of service and from start of database
+static void group_end_requests(void){
+    int i;
+    for (i = 0; i < num_services; i++){
+        uint16_t start_handles[] = { 1, services[i].start_handle };
+        uint16_t end_handle;
+        for (end_handle = services[i].start_handle; end_handle <= services[i].end_handle; end_handle++){
+            int j;
+            for (j = 0; j < 2; j++){
+                uint8_t request[7 + 16];
+                request[0] = ATT_READ_BY_GROUP_TYPE_REQUEST;
+                little_endian_store_16(request, 1, start_handles[j]);
+                little_endian_store_16(request, 3, end_handle);
+                little_endian_store_16(request, 5, GATT_PRIMARY_SERVICE_UUID);
+                (void) att_request(request, 7);
+                request[0] = ATT_FIND_BY_TYPE_VALUE_REQUEST;
+                (void)memcpy(&request[7], services[i].uuid, services[i].uuid_len);
+                (void) att_request(request, 7u + services[i].uuid_len);
+            }
+        }
+    }
+}
+
+// random requests to cover end handles within groups and mixed UUID formats
+static void random_requests(uint16_t max_handle){
+    random_state = 0x12345678;
+    int i;
+    for (i = 0; i < NUM_RANDOM_REQUESTS; i++){
+        uint8_t request[32];
+        uint16_t request_len;
+        att_connection.mtu = ((random_next() % 2u) == 0u) ? ATT_MTU : (uint16_t) (ATT_MTU + (random_next() % (ATT_MTU_MAX - ATT_MTU + 1)));
+        little_endian_store_16(request, 1, random_handle(max_handle));
+        little_endian_store_16(request, 3, random_handle(max_handle));
+        switch (random_next() % 5u){
+            case 0:
+                request[0] = ATT_FIND_INFORMATION_REQUEST;
+                request_len = 5;
+                break;
+            case 1:
+                request[0] = ATT_FIND_BY_TYPE_VALUE_REQUEST;
+                little_endian_store_16(request, 5, ((random_next() % 4u) == 0u) ? GATT_SECONDARY_SERVICE_UUID : GATT_PRIMARY_SERVICE_UUID);
+                request_len = 7u + random_uuid(&request[7]);
+                break;
+            case 2:
+                request[0] = ATT_READ_BY_TYPE_REQUEST;
+                request_len = 5u + random_uuid(&request[5]);
+                break;
+            case 3:
+                request[0] = ATT_READ_BY_GROUP_TYPE_REQUEST;
+                request_len = 5u + random_uuid(&request[5]);
+                if ((random_next() % 2u) == 0u){
+                    request_len = 7;
+                    little_endian_store_16(request, 5, GATT_PRIMARY_SERVICE_UUID);
+                }
+                break;
+            default:
+                request[0] = ATT_READ_REQUEST;
+                request_len = 3;
+                break;
+        }
+        (void) att_request(request, request_len);
+    }
+    att_connection.mtu = ATT_MTU;
+}
+
+static void record(uint8_t * transcript_buffer, uint32_t * transcript_buffer_len){
+    transcript = transcript_buffer;
+    transcript_len = 0;
+    gatt_discovery();
+    group_end_requests();
+    random_requests(services[num_services - 1].end_handle);
+    *transcript_buffer_len = transcript_len;
+    transcript = NULL;
+}
+
+static void run(const char * name, uint8_t * transcript_buffer, uint32_t * transcript_buffer_len){
+    att_set_db(profile_data);
+
+    // benchmark
+    num_requests = 0;
+    transcript = NULL;
+    uint64_t start_ns = get_time_ns();
+    int i;
+    for (i = 0; i < NUM_DISCOVERIES; i++){
+        gatt_discovery();
+    }
+    uint64_t duration_ns = get_time_ns() - start_ns;
+    printf("%-8s: %3u services, %4u characteristics, %5u requests per discovery, %8.1f us per discovery, %6.0f ns per request\n",
+           name, num_services, num_characteristics, num_requests / NUM_DISCOVERIES,
+           (double) duration_ns / NUM_DISCOVERIES / 1000.0, (double) duration_ns / num_requests);
+
+    record(transcript_buffer, transcript_buffer_len);
+}
+
+// modified precompiled index must be rejected, responses have to match linear search
+static int check_invalid_index(const char * name, const uint16_t * index, uint32_t index_len, const uint8_t * transcript_expected, uint32_t transcript_expected_len){
+    uint8_t * transcript_buffer = malloc(TRANSCRIPT_SIZE);
+    uint32_t transcript_buffer_len;
+    att_set_db_index(index, index_len);
+    att_set_db(profile_data);
+    record(transcript_buffer, &transcript_buffer_len);
+    int result = 0;
+    if ((transcript_buffer_len != transcript_expected_len) || (memcmp(transcript_buffer, transcript_expected, transcript_expected_len) != 0)){
+        printf("Responses differ with invalid index: %s!\n", name);
+        result = 1;
+    }
+    free(transcript_buffer);
+    return result;
+}
+
+static int invalid_indices(const uint8_t * transcript_expected, uint32_t transcript_expected_len){
+    uint32_t index_len = sizeof(profile_data_index) / sizeof(uint16_t);
+    uint16_t num_attributes = (uint16_t) ((index_len - 1u) / 2u);
+    uint16_t * index = malloc(sizeof(profile_data_index));
+    int result = 0;
+
+    // offset outside of ATT DB
+    memcpy(index, profile_data_index, sizeof(profile_data_index));
+    index[num_attributes / 2u] = 0xfff0u;
+    result |= check_invalid_index("offset out of range", index, index_len, transcript_expected, transcript_expected_len);
+
+    // offset not at start of attribute
+    memcpy(index, profile_data_index, sizeof(profile_data_index));
+    index[num_attributes / 2u] += 2u;
+    result |= check_invalid_index("offset inside attribute", index, index_len, transcript_expected, transcript_expected_len);
+
+    // index for different ATT DB with same number of attributes
+    memcpy(index, profile_data_index, sizeof(profile_data_index));
+    index[num_attributes] += 4u;
+    result |= check_invalid_index("stale index", index, index_len, transcript_expected, transcript_expected_len);
+
+    // position in uuid list out of range
+    memcpy(index, profile_data_index, sizeof(profile_data_index));
+    index[num_attributes + 1u] = num_attributes;
+    result |= check_invalid_index("uuid list out of range", index, index_len, transcript_expected, transcript_expected_len);
+
+    // uuid list not sorted
+    memcpy(index, profile_data_index, sizeof(profile_data_index));
+    uint16_t tmp = index[num_attributes + 1u];
+    index[num_attributes + 1u] = index[index_len - 1u];
+    index[index_len - 1u] = tmp;
+    result |= check_invalid_index("uuid list not sorted", index, index_len, transcript_expected, transcript_expected_len);
+
+    // index without uuid list
+    result |= check_invalid_index("truncated index", profile_data_index, num_attributes, transcript_expected, transcript_expected_len);
+
+    free(index);
+    if (result == 0){
+        printf("Invalid precompiled indices rejected\n");
+    }
+    return result;
+}
+
+int main(void){
+    att_connection.mtu = ATT_MTU;
+    att_connection.max_mtu = ATT_MTU_MAX;
+    att_set_read_callback(&att_read_callback);
+
+    uint32_t index_buffer_len = att_db_index_get_buffer_len(profile_data);
+    uint16_t * index_buffer = malloc(index_buffer_len * sizeof(uint16_t));
+    uint8_t * transcript_linear  = malloc(TRANSCRIPT_SIZE);
+    uint8_t * transcript_indexed = malloc(TRANSCRIPT_SIZE);
+    uint8_t * transcript_precompiled = malloc(TRANSCRIPT_SIZE);
+    uint32_t transcript_linear_len;
+    uint32_t transcript_indexed_len;
+    uint32_t transcript_precompiled_len;
+
+    printf("ATT DB: %u bytes, index: %u bytes\n", (unsigned int) sizeof(profile_data), (unsigned int) (index_buffer_len * sizeof(uint16_t)));
+
+    att_set_db_index_buffer(NULL, 0);
+    run("linear", transcript_linear, &transcript_linear_len);
+
+    att_set_db_index_buffer(index_buffer, index_buffer_len);
+    run("indexed", transcript_indexed, &transcript_indexed_len);
+
+    att_set_db_index(profile_data_index, sizeof(profile_data_index) / sizeof(uint16_t));
+    run("compiled", transcript_precompiled, &transcript_precompiled_len);
+
+    int result = 0;
+    if ((index_buffer_len != (sizeof(profile_data_index) / sizeof(uint16_t))) || (memcmp(index_buffer, profile_data_index, sizeof(profile_data_index)) != 0)){
+        printf("Runtime and compiled index differ!\n");
+        result = 1;
+    }
+    if ((transcript_linear_len != transcript_indexed_len) || (memcmp(transcript_linear, transcript_indexed, transcript_linear_len) != 0)
+     || (transcript_linear_len != transcript_precompiled_len) || (memcmp(transcript_linear, transcript_precompiled, transcript_linear_len) != 0)){
+        printf("Responses differ!\n");
+        result = 1;
+    } else {
+        printf("Responses identical (%u bytes)\n", transcript_linear_len);
+    }
+    result |= invalid_indices(transcript_linear, transcript_linear_len);
+
+    free(index_buffer);
+    free(transcript_linear);
+    free(transcript_indexed);
+    free(transcript_precompiled);
+    return result;
+}
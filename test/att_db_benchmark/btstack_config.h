@@ -0,0 +1,21 @@
+//
+// btstack_config.h for ATT DB benchmark
+//
+
+#ifndef __BTSTACK_CONFIG
+#define __BTSTACK_CONFIG
+
+// Port related features
+#define HAVE_POSIX_FILE_IO
+#define HAVE_POSIX_TIME
+
+// BTstack features that can be enabled
+#define ENABLE_BLE
+#define ENABLE_LOG_ERROR
+#define ENABLE_ATT_DB_INDEX
+#define ENABLE_ATT_DELAYED_RESPONSE
+
+// BTstack configuration. buffers, sizes, ...
+#define HCI_ACL_PAYLOAD_SIZE 1024
+
+#endif
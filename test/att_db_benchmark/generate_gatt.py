@@ -0,0 +1,55 @@
+#!/usr/bin/env python3
+#
+# Generate large GATT database for ATT DB benchmark
+#
+# usage: generate_gatt.py output.gatt [num_services] [num_characteristics]
+#
+import sys
+
+def uuid128(prefix, value):
+    return '%08X-0000-1000-8000-%012X' % (value, prefix)
+
+def main():
+    if len(sys.argv) < 2:
+        print('usage: %s output.gatt [num_services] [num_characteristics]' % sys.argv[0])
+        sys.exit(1)
+    num_services        = int(sys.argv[2]) if len(sys.argv) > 2 else 40
+    num_characteristics = int(sys.argv[3]) if len(sys.argv) > 3 else 10
+
+    lines = []
+    lines.append('PRIMARY_SERVICE, GAP_SERVICE')
+    lines.append('CHARACTERISTIC, GAP_DEVICE_NAME, READ, "ATT DB Benchmark"')
+    lines.append('PRIMARY_SERVICE, GATT_SERVICE')
+    lines.append('CHARACTERISTIC, GATT_DATABASE_HASH, READ,')
+
+    for service in range(num_services):
+        # mix of UUID16, UUID128 based on Bluetooth Base UUID and vendor UUID128 services
+        kind = service % 4
+        if kind == 0:
+            lines.append('PRIMARY_SERVICE, %04X' % (0xA000 + service))
+        elif kind == 1:
+            lines.append('PRIMARY_SERVICE, %s' % uuid128(0x00805F9B34FB, 0xA000 + service))
+        elif kind == 2:
+            lines.append('SECONDARY_SERVICE, %04X' % (0xA000 + service))
+        else:
+            lines.append('PRIMARY_SERVICE, %s' % uuid128(0x4242DEADBEEF, 0xB000 + service))
+        for characteristic in range(num_characteristics):
+            if characteristic % 2 == 0:
+                uuid = '%04X' % (0xC000 + characteristic)
+            else:
+                uuid = uuid128(0x4242DEADBEEF, 0xC000 + characteristic)
+            if characteristic % 3 == 0:
+                lines.append('CHARACTERISTIC, %s, READ | NOTIFY | DYNAMIC,' % uuid)
+            elif characteristic % 3 == 1:
+                lines.append('CHARACTERISTIC, %s, READ, "service %u characteristic %u"' % (uuid, service, characteristic))
+            else:
+                lines.append('CHARACTERISTIC, %s, READ | WRITE | DYNAMIC,' % uuid)
+                lines.append('CHARACTERISTIC_USER_DESCRIPTION, READ,')
+        lines.append('')
+
+    with open(sys.argv[1], 'w') as f:
+        f.write('\n'.join(lines))
+        f.write('\n')
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,216 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#include "bluetooth.h"
+#include "btstack_audio_jitter_buffer.h"
+#include "btstack_util.h"
+
+#define FRAME_SIZE          8
+#define MAX_FRAMES          100
+#define TARGET_FRAMES       40
+
+// simulation
+#define TRACE_FILE          "a2dp_arrival_trace.txt"
+#define MAX_TRACE_PACKETS   4000
+#define TRACE_REPETITIONS   3
+#define SAMPLE_RATE         44100
+#define SAMPLES_PER_FRAME   128
+#define SETTLE_TIME_US      60000000.0
+
+uint32_t btstack_min(uint32_t a, uint32_t b){
+    return a < b ? a : b;
+}
+
+static uint8_t storage[MAX_FRAMES * FRAME_SIZE];
+static btstack_audio_jitter_buffer_t jitter_buffer;
+static btstack_resample_t resample;
+
+static uint32_t trace_arrival_us[MAX_TRACE_PACKETS];
+static uint8_t  trace_num_frames[MAX_TRACE_PACKETS];
+static int      trace_num_packets;
+
+static uint32_t next_sequence_number;
+static uint32_t expected_sequence_number;
+
+static void write_frames(uint16_t num_frames){
+    uint8_t frames[MAX_FRAMES * FRAME_SIZE];
+    uint16_t i;
+    for (i=0;i<num_frames;i++){
+        uint32_t words[2] = { next_sequence_number, ~next_sequence_number };
+        memcpy(&frames[i * FRAME_SIZE], words, FRAME_SIZE);
+        next_sequence_number++;
+    }
+    btstack_audio_jitter_buffer_write(&jitter_buffer, frames, num_frames);
+}
+
+static bool read_frame(void){
+    uint8_t frame[FRAME_SIZE];
+    if (!btstack_audio_jitter_buffer_read(&jitter_buffer, frame)) return false;
+    uint32_t words[2];
+    memcpy(words, frame, FRAME_SIZE);
+    CHECK_EQUAL(expected_sequence_number, words[0]);
+    CHECK_EQUAL(~expected_sequence_number, words[1]);
+    expected_sequence_number++;
+    return true;
+}
+
+static void load_trace(void){
+    if (trace_num_packets > 0) return;
+    FILE * file = fopen(TRACE_FILE, "r");
+    CHECK_TRUE(file != NULL);
+    char line[80];
+    while (fgets(line, sizeof(line), file) != NULL){
+        if (line[0] == '#') continue;
+        unsigned int arrival_us;
+        unsigned int num_frames;
+        if (sscanf(line, "%u %u", &arrival_us, &num_frames) != 2) continue;
+        CHECK_TRUE(trace_num_packets < MAX_TRACE_PACKETS);
+        trace_arrival_us[trace_num_packets] = arrival_us;
+        trace_num_frames[trace_num_packets] = (uint8_t) num_frames;
+        trace_num_packets++;
+    }
+    fclose(file);
+    CHECK_TRUE(trace_num_packets > 0);
+}
+
+typedef struct {
+    uint32_t num_underruns;
+    uint16_t min_frames;
+    uint16_t max_frames;
+    double   average_factor;
+} simulation_result_t;
+
+// replay synthetic packet arrival trace (exponential jitter and stalls, see header of trace file) against playback with sink clock deviating by sink_ppm from source clock
+static void simulate(int sink_ppm, simulation_result_t * result){
+    load_trace();
+    double trace_duration_us = (double) trace_arrival_us[trace_num_packets - 1] + 10000.0;
+    double callback_interval_us = (SAMPLES_PER_FRAME * 1000000.0) / (SAMPLE_RATE * (1.0 + sink_ppm / 1000000.0));
+    double next_callback_us = 0;
+    uint64_t consumed_samples = 0;  // Q16
+    double factor_sum = 0;
+    int    factor_count = 0;
+    result->min_frames = MAX_FRAMES;
+    result->max_frames = 0;
+
+    int repetition;
+    for (repetition = 0; repetition < TRACE_REPETITIONS; repetition++){
+        int packet = 0;
+        while (packet < trace_num_packets){
+            double arrival_us = (repetition * trace_duration_us) + trace_arrival_us[packet];
+            if (arrival_us <= next_callback_us){
+                write_frames(trace_num_frames[packet]);
+                packet++;
+                continue;
+            }
+            // playback callback requests SAMPLES_PER_FRAME samples at sink clock
+            if (btstack_audio_jitter_buffer_is_started(&jitter_buffer)){
+                consumed_samples += (uint64_t) SAMPLES_PER_FRAME * resample.src_step;
+                while (consumed_samples >= ((uint64_t) SAMPLES_PER_FRAME << 16)){
+                    consumed_samples -= (uint64_t) SAMPLES_PER_FRAME << 16;
+                    read_frame();
+                }
+                if (next_callback_us > SETTLE_TIME_US){
+                    uint16_t frames = btstack_audio_jitter_buffer_frames_available(&jitter_buffer);
+                    if (frames < result->min_frames) result->min_frames = frames;
+                    if (frames > result->max_frames) result->max_frames = frames;
+                    factor_sum += resample.src_step;
+                    factor_count++;
+                }
+            }
+            next_callback_us += callback_interval_us;
+        }
+    }
+    result->num_underruns  = btstack_audio_jitter_buffer_get_num_underruns(&jitter_buffer);
+    result->average_factor = factor_sum / factor_count;
+}
+
+TEST_GROUP(AudioJitterBuffer){
+    void setup(void){
+        next_sequence_number = 0;
+        expected_sequence_number = 0;
+        btstack_audio_jitter_buffer_init(&jitter_buffer, storage, sizeof(storage), TARGET_FRAMES);
+        btstack_audio_jitter_buffer_set_frame_size(&jitter_buffer, FRAME_SIZE);
+        btstack_resample_init(&resample, 2);
+        btstack_audio_jitter_buffer_set_resample(&jitter_buffer, &resample);
+    }
+};
+
+TEST(AudioJitterBuffer, NoFrameSize){
+    btstack_audio_jitter_buffer_init(&jitter_buffer, storage, sizeof(storage), TARGET_FRAMES);
+    uint8_t frame[FRAME_SIZE];
+    CHECK_EQUAL(ERROR_CODE_COMMAND_DISALLOWED, btstack_audio_jitter_buffer_write(&jitter_buffer, frame, 1));
+    CHECK_EQUAL(0, btstack_audio_jitter_buffer_frames_available(&jitter_buffer));
+}
+
+TEST(AudioJitterBuffer, StartAtTarget){
+    int i;
+    for (i=0;i<TARGET_FRAMES-1;i++){
+        write_frames(1);
+        CHECK_FALSE(btstack_audio_jitter_buffer_is_started(&jitter_buffer));
+        CHECK_FALSE(read_frame());
+    }
+    write_frames(1);
+    CHECK_TRUE(btstack_audio_jitter_buffer_is_started(&jitter_buffer));
+    for (i=0;i<TARGET_FRAMES;i++){
+        CHECK_TRUE(read_frame());
+    }
+    CHECK_EQUAL(0, btstack_audio_jitter_buffer_get_num_underruns(&jitter_buffer));
+}
+
+TEST(AudioJitterBuffer, Underrun){
+    write_frames(TARGET_FRAMES);
+    while (read_frame());
+    CHECK_EQUAL(1, btstack_audio_jitter_buffer_get_num_underruns(&jitter_buffer));
+    CHECK_FALSE(btstack_audio_jitter_buffer_is_started(&jitter_buffer));
+    // buffer below target falls behind, resampling compensates by stretching
+    CHECK_TRUE(btstack_audio_jitter_buffer_get_resampling_factor(&jitter_buffer) < 0x10000);
+    CHECK_EQUAL(btstack_audio_jitter_buffer_get_resampling_factor(&jitter_buffer), resample.src_step);
+    write_frames(TARGET_FRAMES - 1);
+    CHECK_FALSE(read_frame());
+    write_frames(1);
+    CHECK_TRUE(read_frame());
+}
+
+TEST(AudioJitterBuffer, Overflow){
+    write_frames(MAX_FRAMES - 5);
+    CHECK_EQUAL(ERROR_CODE_MEMORY_CAPACITY_EXCEEDED, btstack_audio_jitter_buffer_write(&jitter_buffer, storage, 10));
+    CHECK_EQUAL(MAX_FRAMES, btstack_audio_jitter_buffer_frames_available(&jitter_buffer));
+    CHECK_EQUAL(5, btstack_audio_jitter_buffer_get_num_frames_dropped(&jitter_buffer));
+}
+
+TEST(AudioJitterBuffer, FrameSizeChange){
+    write_frames(TARGET_FRAMES);
+    btstack_audio_jitter_buffer_set_frame_size(&jitter_buffer, FRAME_SIZE);
+    CHECK_EQUAL(TARGET_FRAMES, btstack_audio_jitter_buffer_frames_available(&jitter_buffer));
+    btstack_audio_jitter_buffer_set_frame_size(&jitter_buffer, FRAME_SIZE / 2);
+    CHECK_EQUAL(0, btstack_audio_jitter_buffer_frames_available(&jitter_buffer));
+    CHECK_FALSE(btstack_audio_jitter_buffer_is_started(&jitter_buffer));
+}
+
+TEST(AudioJitterBuffer, Simulation){
+    static const int sink_ppm[] = { -2000, -300, 0, 300, 2000 };
+    unsigned int i;
+    for (i=0;i<sizeof(sink_ppm)/sizeof(int);i++){
+        setup();
+        simulation_result_t result;
+        simulate(sink_ppm[i], &result);
+        double expected_factor = 65536.0 / (1.0 + sink_ppm[i] / 1000000.0);
+        printf("sink %+5d ppm: underruns %u, frames %2u - %2u, factor 0x%05x, expected 0x%05x\n", sink_ppm[i],
+               result.num_underruns, result.min_frames, result.max_frames,
+               (unsigned int) (result.average_factor + 0.5), (unsigned int) (expected_factor + 0.5));
+        CHECK_EQUAL(0, result.num_underruns);
+        // stalls in trace take up to 70 ms, i.e. 24 frames
+        CHECK_TRUE(result.min_frames >= 10);
+        CHECK_TRUE(result.max_frames <= TARGET_FRAMES + 10);
+        // estimated clock ratio within 60 ppm
+        DOUBLES_EQUAL(expected_factor, result.average_factor, 4.0);
+    }
+}
+
+int main (int argc, const char * argv[]){
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
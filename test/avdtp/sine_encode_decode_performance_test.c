@@ -35,109 +35,269 @@
  *
  */
 
+#define BTSTACK_FILE__ "sine_encode_decode_performance_test.c"
+
+/*
+ * sine_encode_decode_performance_test.c
+ *
+ * Measures SBC encoder and decoder throughput in frames per second for the common
+ * A2DP configurations, best of NUM_ROUNDS runs. Encoded frames and decoded PCM are
+ * summed into a checksum, which has to be identical for all analysis and synthesis
+ * filter implementations, e.g. with and without SBC_SIMD_OPT. Finally, it verifies that
+ * two encoder instances used in alternation as well as batch encoding produce the same
+ * output as a single encoder instance encoding one frame at a time.
+ */
+
 #include <stdio.h>
 #include <math.h>
 #include <stdlib.h>
 #include <string.h>
-#include <portaudio.h>
+#include <time.h>
 
 #include "btstack_sbc.h"
-#include "avdtp.h"
-#include "avdtp_source.h"
-#include "btstack_stdin.h"
-
-#define NUM_CHANNELS        2
-#define SAMPLE_RATE         44100
-#define BYTES_PER_AUDIO_SAMPLE   (2*NUM_CHANNELS)
-#define LATENCY             300 // ms
+#include "btstack_util.h"
 
 #ifndef M_PI
 #define M_PI  3.14159265
 #endif
-#define TABLE_SIZE_441HZ   100
 
-typedef struct {
-    int16_t source[TABLE_SIZE_441HZ];
-    int left_phase;
-    int right_phase;
-} paTestData;
+#define NUM_CHANNELS        2
+#define NUM_FRAMES          20000
+#define NUM_PCM_FRAMES      1000
+#define NUM_ROUNDS          5
+#define MAX_SBC_FRAME_LEN   512
+#define NUM_CHECK_FRAMES    200
+#define NUM_BATCH_FRAMES    8
 
-static uint8_t pcm_frame[2*8*16*2];
+typedef struct {
+    const char * name;
+    int subbands;
+    int blocks;
+    int channel_mode;
+    int bitpool;
+} test_config_t;
 
-static paTestData sin_data;
+// same values as SBC_MONO, SBC_DUAL, SBC_STEREO, SBC_JOINT_STEREO in sbc_encoder.h
+static const test_config_t test_configs[] = {
+    { "8 subbands, joint stereo", 8, 16, 3, 53 },
+    { "8 subbands, stereo",       8, 16, 2, 53 },
+    { "4 subbands, joint stereo", 4, 16, 3, 31 },
+    { "8 subbands, mono",         8, 16, 0, 31 },
+};
 
-static btstack_sbc_mode_t mode = SBC_MODE_STANDARD;
 static btstack_sbc_encoder_state_t sbc_encoder_state;
+static btstack_sbc_encoder_state_t sbc_encoder_state_2;
 static btstack_sbc_decoder_state_t sbc_decoder_state;
 
+static int16_t  pcm_input[NUM_PCM_FRAMES][16*8*NUM_CHANNELS];
+static uint8_t  sbc_frames[NUM_FRAMES][MAX_SBC_FRAME_LEN];
+static uint16_t sbc_frame_len[NUM_FRAMES];
+static int16_t  pcm_batch[NUM_BATCH_FRAMES * 16 * 8 * NUM_CHANNELS];
+static uint8_t  sbc_batch[NUM_BATCH_FRAMES * MAX_SBC_FRAME_LEN];
+
+static uint32_t signal_phase;
+static uint32_t noise_state;
+static uint32_t checksum;
+static int      decoded_frames;
+
+static double now_seconds(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec * 1e-9;
+}
+
+// 441 Hz / 1 kHz tones plus some noise, so that all subbands carry energy
+static void fill_pcm_frame(int16_t * pcm, int num_samples, int num_channels){
+    int i;
+    for (i=0; i<num_samples; i++){
+        noise_state = noise_state * 1664525u + 1013904223u;
+        int16_t noise = (int16_t) (noise_state >> 16) >> 4;
+        double t = (double) signal_phase++ / 44100.0;
+        pcm[i*num_channels] = (int16_t) (sin(2.0 * M_PI * 441.0 * t) * 16000.0) + noise;
+        if (num_channels == 2){
+            pcm[i*num_channels+1] = (int16_t) (sin(2.0 * M_PI * 1000.0 * t) * 12000.0) - noise;
+        }
+    }
+}
+
+static void checksum_update(const uint8_t * data, int len){
+    int i;
+    for (i=0; i<len; i++){
+        checksum = (checksum * 31u) + data[i];
+    }
+}
+
 static void handle_pcm_data(int16_t * data, int num_samples, int num_channels, int sample_rate, void * context){
     UNUSED(sample_rate);
     UNUSED(context);
-    UNUSED(data);
-    UNUSED(num_samples);
-    UNUSED(num_channels);
+    checksum_update((const uint8_t *) data, num_samples * num_channels * 2);
+    decoded_frames++;
 }
 
-static void fill_sine_frame(void *userData, int num_samples_to_write){
-    paTestData *data = (paTestData*)userData;
-    int count = 0;
-    int offset = 0;
-    while (count < num_samples_to_write){
-        uint8_t write_data[BYTES_PER_AUDIO_SAMPLE];
-        *(int16_t*)&write_data[0] = data->source[data->left_phase];
-        *(int16_t*)&write_data[2] = data->source[data->right_phase];
-        
-        memcpy(pcm_frame+offset, write_data, BYTES_PER_AUDIO_SAMPLE);
-        offset += BYTES_PER_AUDIO_SAMPLE;
-        count++;
-
-        data->left_phase += 1;
-        if (data->left_phase >= TABLE_SIZE_441HZ){
-            data->left_phase -= TABLE_SIZE_441HZ;
+static double encode_frames(const test_config_t * config){
+    int i;
+    btstack_sbc_encoder_init(&sbc_encoder_state, SBC_MODE_STANDARD, config->blocks, config->subbands,
+                             0, 44100, config->bitpool, config->channel_mode);
+    double start = now_seconds();
+    for (i=0; i<NUM_FRAMES; i++){
+        btstack_sbc_encoder_process_data_ctx(&sbc_encoder_state, pcm_input[i % NUM_PCM_FRAMES]);
+        uint16_t len = btstack_sbc_encoder_sbc_buffer_length_ctx(&sbc_encoder_state);
+        memcpy(sbc_frames[i], btstack_sbc_encoder_sbc_buffer_ctx(&sbc_encoder_state), len);
+        sbc_frame_len[i] = len;
+    }
+    return now_seconds() - start;
+}
+
+static double decode_frames(void){
+    int i;
+    btstack_sbc_decoder_init(&sbc_decoder_state, SBC_MODE_STANDARD, handle_pcm_data, NULL);
+    checksum = 0;
+    decoded_frames = 0;
+    double start = now_seconds();
+    for (i=0; i<NUM_FRAMES; i++){
+        btstack_sbc_decoder_process_data(&sbc_decoder_state, 0, sbc_frames[i], sbc_frame_len[i]);
+    }
+    return now_seconds() - start;
+}
+
+static void run_test(const test_config_t * config){
+    int num_channels = (config->channel_mode == 0) ? 1 : 2;
+    int num_samples  = config->blocks * config->subbands;
+    double encoding_time = 0;
+    double decoding_time = 0;
+    int i;
+
+    // pre-generate PCM to keep the signal generator out of the measurement
+    signal_phase = 0;
+    noise_state  = 0x12345678;
+    for (i=0; i<NUM_PCM_FRAMES; i++){
+        fill_pcm_frame(pcm_input[i], num_samples, num_channels);
+    }
+
+    for (i=0; i<NUM_ROUNDS; i++){
+        double duration = encode_frames(config);
+        if ((i == 0) || (duration < encoding_time)){
+            encoding_time = duration;
+        }
+    }
+    checksum = 0;
+    for (i=0; i<NUM_FRAMES; i++){
+        checksum_update(sbc_frames[i], sbc_frame_len[i]);
+    }
+    uint32_t encoder_checksum = checksum;
+
+    for (i=0; i<NUM_ROUNDS; i++){
+        double duration = decode_frames();
+        if ((i == 0) || (duration < decoding_time)){
+            decoding_time = duration;
         }
-        data->right_phase += 1; 
-        if (data->right_phase >= TABLE_SIZE_441HZ){
-            data->right_phase -= TABLE_SIZE_441HZ;
-        } 
     }
+
+    printf("%-26s encode %8.0f fps, decode %8.0f fps, checksums %08x %08x\n", config->name,
+           NUM_FRAMES / encoding_time, decoded_frames / decoding_time, encoder_checksum, checksum);
+}
+
+static void encoder_init(btstack_sbc_encoder_state_t * state, const test_config_t * config){
+    btstack_sbc_encoder_init(state, SBC_MODE_STANDARD, config->blocks, config->subbands,
+                             0, 44100, config->bitpool, config->channel_mode);
+}
+
+static void encoder_checksum_update(btstack_sbc_encoder_state_t * state, int16_t * pcm, uint32_t * encoder_checksum){
+    btstack_sbc_encoder_process_data_ctx(state, pcm);
+    checksum = *encoder_checksum;
+    checksum_update(btstack_sbc_encoder_sbc_buffer_ctx(state), btstack_sbc_encoder_sbc_buffer_length_ctx(state));
+    *encoder_checksum = checksum;
+}
+
+static int verify_encoder_instances(const test_config_t * config_1, const test_config_t * config_2){
+    uint32_t expected_1 = 0;
+    uint32_t expected_2 = 0;
+    uint32_t actual_1 = 0;
+    uint32_t actual_2 = 0;
+    int i;
+
+    signal_phase = 0;
+    noise_state  = 0x12345678;
+    for (i=0; i<NUM_CHECK_FRAMES; i++){
+        fill_pcm_frame(pcm_input[i], 16 * 8, NUM_CHANNELS);
+    }
+
+    // one instance at a time
+    encoder_init(&sbc_encoder_state, config_1);
+    for (i=0; i<NUM_CHECK_FRAMES; i++){
+        encoder_checksum_update(&sbc_encoder_state, pcm_input[i], &expected_1);
+    }
+    encoder_init(&sbc_encoder_state, config_2);
+    for (i=0; i<NUM_CHECK_FRAMES; i++){
+        encoder_checksum_update(&sbc_encoder_state, pcm_input[i], &expected_2);
+    }
+
+    // both instances in alternation
+    encoder_init(&sbc_encoder_state,   config_1);
+    encoder_init(&sbc_encoder_state_2, config_2);
+    for (i=0; i<NUM_CHECK_FRAMES; i++){
+        encoder_checksum_update(&sbc_encoder_state,   pcm_input[i], &actual_1);
+        encoder_checksum_update(&sbc_encoder_state_2, pcm_input[i], &actual_2);
+    }
+
+    int ok = (expected_1 == actual_1) && (expected_2 == actual_2);
+    printf("%s + %s, two encoder instances: %s\n", config_1->name, config_2->name, ok ? "OK" : "FAILED");
+    return ok;
 }
 
-int btstack_main(int argc, const char * argv[]);
-int btstack_main(int argc, const char * argv[]){
-    (void) argc;
-    (void) argv;
-    btstack_sbc_encoder_init(&sbc_encoder_state, SBC_MODE_STANDARD, 16, 8, 2, 44100, 53);
-                    
-    /* initialise sinusoidal wavetable */
+static int verify_batch_encoding(const test_config_t * config){
+    uint32_t expected = 0;
+    uint32_t actual = 0;
+    int num_samples = config->blocks * config->subbands;
+    int num_channels = (config->channel_mode == 0) ? 1 : 2;
+    int frame_len;
+    int ok = 1;
     int i;
-    for (i=0; i<TABLE_SIZE_441HZ; i++){ 
-        sin_data.source[i] = sin(((double)i/(double)TABLE_SIZE_441HZ) * M_PI * 2.)*32767;
-    }
-    sin_data.left_phase = sin_data.right_phase = 0;
-    
-    btstack_sbc_decoder_init(&sbc_decoder_state, mode, handle_pcm_data, NULL);
-    int num_frames = 10000;
-    uint32_t timestamp_start;
-    uint32_t encoding_time = 0;
-    uint32_t decoding_time = 0;
-    
-    timestamp_start = btstack_run_loop_get_time_ms();
-    for (i=0; i<num_frames; i++){
-        fill_sine_frame(&sin_data, 128);
-        btstack_sbc_encoder_process_data((int16_t *) pcm_frame);
-    }
-    encoding_time = btstack_run_loop_get_time_ms() - timestamp_start;
-
-    timestamp_start = btstack_run_loop_get_time_ms();
-    for (i=0; i<num_frames; i++){
-        fill_sine_frame(&sin_data, 128);
-        btstack_sbc_encoder_process_data((int16_t *) pcm_frame);
-        btstack_sbc_decoder_process_data(&sbc_decoder_state, 0, btstack_sbc_encoder_sbc_buffer(), btstack_sbc_encoder_sbc_buffer_length());
-    }
-    decoding_time =  btstack_run_loop_get_time_ms() - timestamp_start - encoding_time;
-
-    printf("%d frames encoded in %dms\n", num_frames, encoding_time);
-    printf("%d frames decoded in %dms\n", num_frames, decoding_time);
-    
-    exit(0);
+
+    signal_phase = 0;
+    noise_state  = 0x12345678;
+    for (i=0; i<NUM_CHECK_FRAMES; i++){
+        fill_pcm_frame(pcm_input[i], num_samples, num_channels);
+    }
+
+    encoder_init(&sbc_encoder_state, config);
+    frame_len = btstack_sbc_encoder_sbc_buffer_length_ctx(&sbc_encoder_state);
+    for (i=0; i<NUM_CHECK_FRAMES; i++){
+        encoder_checksum_update(&sbc_encoder_state, pcm_input[i], &expected);
+        ok &= btstack_sbc_encoder_sbc_buffer_length_ctx(&sbc_encoder_state) == frame_len;
+    }
+
+    // pcm_input rows are larger than one frame, gather PCM for batch into contiguous buffer
+    int pcm_frame_len = num_samples * num_channels;
+    encoder_init(&sbc_encoder_state, config);
+    for (i=0; i<NUM_CHECK_FRAMES; i+=NUM_BATCH_FRAMES){
+        int j;
+        for (j=0; j<NUM_BATCH_FRAMES; j++){
+            memcpy(&pcm_batch[j * pcm_frame_len], pcm_input[i+j], pcm_frame_len * 2);
+        }
+        uint16_t len = btstack_sbc_encoder_process_data_batch_ctx(&sbc_encoder_state, pcm_batch, NUM_BATCH_FRAMES, sbc_batch);
+        ok &= len == (NUM_BATCH_FRAMES * frame_len);
+        checksum = actual;
+        for (j=0; j<NUM_BATCH_FRAMES; j++){
+            checksum_update(&sbc_batch[j * frame_len], frame_len);
+        }
+        actual = checksum;
+    }
+
+    ok &= (expected == actual);
+    printf("%s, batch encoding: %s\n", config->name, ok ? "OK" : "FAILED");
+    return ok;
+}
+
+int main(void){
+    unsigned int i;
+    for (i=0; i<sizeof(test_configs) / sizeof(test_config_t); i++){
+        run_test(&test_configs[i]);
+    }
+    if (!verify_encoder_instances(&test_configs[0], &test_configs[2])) return 1;
+    if (!verify_encoder_instances(&test_configs[1], &test_configs[3])) return 1;
+    for (i=0; i<sizeof(test_configs) / sizeof(test_config_t); i++){
+        if (!verify_batch_encoding(&test_configs[i])) return 1;
+    }
+    return 0;
 }
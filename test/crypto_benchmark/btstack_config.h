@@ -0,0 +1,24 @@
+//
+// btstack_config.h for crypto benchmark
+//
+
+#ifndef __BTSTACK_CONFIG
+#define __BTSTACK_CONFIG
+
+// Port related features
+#define HAVE_MALLOC
+#define HAVE_POSIX_TIME
+
+// BTstack features that can be enabled
+#define ENABLE_BLE
+#define ENABLE_LOG_ERROR
+
+// AES128 via HCI LE Encrypt for comparison
+#ifndef CRYPTO_BENCHMARK_HCI
+#define ENABLE_SOFTWARE_AES128
+#endif
+
+// BTstack configuration. buffers, sizes, ...
+#define HCI_ACL_PAYLOAD_SIZE 1024
+
+#endif
@@ -0,0 +1,359 @@
+/*
+ * Copyright (C) 2020 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHIAS
+ * RINGWALD OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+#define BTSTACK_FILE__ "crypto_benchmark.c"
+
+/*
+ *  crypto_benchmark.c
+ *
+ *  Measure throughput of btstack_crypto_ccm_decrypt_block and btstack_crypto_aes128_cmac_message,
+ *  number of HCI LE Encrypt commands per operation, and Controller round trips for overlapping
+ *  operations with up to HCI_NUM_CMD_PACKETS_MAX commands in flight.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "btstack_crypto.h"
+#include "btstack_util.h"
+#include "hci.h"
+#include "rijndael.h"
+
+#define NUM_ITERATIONS_CCM   200000
+#define NUM_ITERATIONS_CMAC  100000
+#define NUM_ITERATIONS_AES   2000000
+#define NUM_ITERATIONS_MIXED 50000
+
+// Mesh Message #24, Lower Transport Segment 0
+static const char * ccm_key_string        = "0953fa93e7caac9638f58820220a398e";
+static const char * ccm_nonce_string      = "000307080d1234000012345677";
+static const char * ccm_plaintext_string  = "9736e6a03401de1547118463123e5f6a17b9";
+static const char * ccm_ciphertext_string = "94e998b4081f5a7308ce3edbb3b06cdecd02";
+static const char * ccm_net_mic_string    = "8e307f1c";
+
+// RFC 4493, Example 3
+static const char * cmac_key_string       = "2b7e151628aed2a6abf7158809cf4f3c";
+static const char * cmac_message_string   = "6bc1bee22e409f96e93d7e117393172aae2d8a571e03ac9c9eb76fac45af8e5130c81c46a35ce411";
+static const char * cmac_string           = "dfa66747de9ae63030ca32611497c827";
+
+static btstack_packet_callback_registration_t * hci_event_callback_registration;
+static uint8_t  hci_events_pending[HCI_NUM_CMD_PACKETS_MAX][22];
+static int      hci_events_pending_pos;
+static int      hci_events_pending_count;
+static uint32_t hci_le_encrypt_count;
+static uint32_t hci_round_trip_count;
+static int      operations_pending;
+
+static uint64_t get_time_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t) ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+static int parse_hex(uint8_t * buffer, const char * hex_string){
+    int len = 0;
+    while (*hex_string){
+        int high_nibble = nibble_for_char(*hex_string++);
+        int low_nibble  = nibble_for_char(*hex_string++);
+        *buffer++ = (uint8_t) ((high_nibble << 4) | low_nibble);
+        len++;
+    }
+    return len;
+}
+
+// HCI mock: LE Encrypt is answered by an emulated Controller after the command was sent
+void hci_add_event_handler(btstack_packet_callback_registration_t * callback_handler){
+    hci_event_callback_registration = callback_handler;
+}
+
+HCI_STATE hci_get_state(void){
+    return HCI_STATE_WORKING;
+}
+
+int hci_can_send_command_packet_now(void){
+    return hci_events_pending_count < HCI_NUM_CMD_PACKETS_MAX;
+}
+
+void hci_halting_defer(void){
+}
+
+int hci_send_cmd(const hci_cmd_t * cmd, ...){
+    if (cmd->opcode != hci_le_encrypt.opcode) {
+        printf("Unexpected HCI Command 0x%04x\n", cmd->opcode);
+        exit(EXIT_FAILURE);
+    }
+    va_list argptr;
+    va_start(argptr, cmd);
+    const uint8_t * key_flipped       = va_arg(argptr, const uint8_t *);
+    const uint8_t * plaintext_flipped = va_arg(argptr, const uint8_t *);
+    va_end(argptr);
+    uint8_t key[16];
+    uint8_t plaintext[16];
+    uint8_t ciphertext[16];
+    reverse_128(key_flipped, key);
+    reverse_128(plaintext_flipped, plaintext);
+    uint32_t rk[RKLENGTH(KEYBITS)];
+    int nrounds = rijndaelSetupEncrypt(rk, key, KEYBITS);
+    rijndaelEncrypt(rk, nrounds, plaintext, ciphertext);
+    static const uint8_t command_complete[] = { HCI_EVENT_COMMAND_COMPLETE, 0x14, 0x01, 0x17, 0x20, 0x00 };
+    uint8_t * event = hci_events_pending[(hci_events_pending_pos + hci_events_pending_count) % HCI_NUM_CMD_PACKETS_MAX];
+    memcpy(event, command_complete, sizeof(command_complete));
+    reverse_128(ciphertext, &event[6]);
+    hci_events_pending_count++;
+    hci_le_encrypt_count++;
+    return 0;
+}
+
+static void operation_complete(void * arg){
+    UNUSED(arg);
+    operations_pending--;
+}
+
+// deliver HCI Events for all commands sent in the previous round until all operations are complete
+static void wait_for_operations(void){
+    while (operations_pending > 0){
+        int num_events = hci_events_pending_count;
+        if (num_events == 0){
+            printf("Operation stalled\n");
+            exit(EXIT_FAILURE);
+        }
+        hci_round_trip_count++;
+        while (num_events > 0){
+            uint8_t event[22];
+            memcpy(event, hci_events_pending[hci_events_pending_pos], sizeof(event));
+            hci_events_pending_pos = (hci_events_pending_pos + 1) % HCI_NUM_CMD_PACKETS_MAX;
+            hci_events_pending_count--;
+            num_events--;
+            (*hci_event_callback_registration->callback)(HCI_EVENT_PACKET, 0, event, sizeof(event));
+        }
+    }
+}
+
+static void ccm_decrypt(btstack_crypto_ccm_t * request, const uint8_t * key, const uint8_t * nonce, uint16_t len,
+                        const uint8_t * ciphertext, uint8_t * plaintext, uint8_t * net_mic){
+    btstack_crypto_ccm_init(request, key, nonce, len, 0, 4);
+    operations_pending++;
+    btstack_crypto_ccm_decrypt_block(request, len, ciphertext, plaintext, &operation_complete, NULL);
+    wait_for_operations();
+    btstack_crypto_ccm_get_authentication_value(request, net_mic);
+}
+
+static void cmac_message(btstack_crypto_aes128_cmac_t * request, const uint8_t * key, uint16_t len, const uint8_t * message, uint8_t * hash){
+    operations_pending++;
+    btstack_crypto_aes128_cmac_message(request, key, len, message, hash, &operation_complete, NULL);
+    wait_for_operations();
+}
+
+static void verify(const char * name, const uint8_t * expected, const uint8_t * actual, int len){
+    if (memcmp(expected, actual, len) == 0) return;
+    printf("%s: result mismatch\n", name);
+    exit(EXIT_FAILURE);
+}
+
+static void benchmark_ccm_decrypt(void){
+    uint8_t key[16];
+    uint8_t nonce[13];
+    uint8_t plaintext_expected[18];
+    uint8_t ciphertext[256];
+    uint8_t plaintext[256];
+    uint8_t net_mic_expected[4];
+    uint8_t net_mic[4];
+    memset(ciphertext, 0x55, sizeof(ciphertext));
+    parse_hex(key, ccm_key_string);
+    parse_hex(nonce, ccm_nonce_string);
+    parse_hex(plaintext_expected, ccm_plaintext_string);
+    parse_hex(ciphertext, ccm_ciphertext_string);
+    parse_hex(net_mic_expected, ccm_net_mic_string);
+
+    btstack_crypto_ccm_t request;
+    ccm_decrypt(&request, key, nonce, 18, ciphertext, plaintext, net_mic);
+    verify("CCM", plaintext_expected, plaintext, sizeof(plaintext_expected));
+    verify("CCM NetMIC", net_mic_expected, net_mic, sizeof(net_mic_expected));
+
+    static const uint16_t lengths[] = { 18, 29, 256 };
+    unsigned int i;
+    for (i = 0; i < sizeof(lengths) / sizeof(uint16_t); i++){
+        uint16_t len = lengths[i];
+        uint32_t count_before = hci_le_encrypt_count;
+        uint64_t start_ns = get_time_ns();
+        int iteration;
+        for (iteration = 0; iteration < NUM_ITERATIONS_CCM; iteration++){
+            ccm_decrypt(&request, key, nonce, len, ciphertext, plaintext, net_mic);
+        }
+        uint64_t duration_ns = get_time_ns() - start_ns;
+        printf("- ccm_decrypt_block %3u bytes: %7.1f ns per operation, %6.1f MB/s, %2u HCI LE Encrypt per operation\n",
+               len, (double) duration_ns / NUM_ITERATIONS_CCM, (double) len * NUM_ITERATIONS_CCM * 1e3 / duration_ns,
+               (hci_le_encrypt_count - count_before) / NUM_ITERATIONS_CCM);
+    }
+}
+
+static void benchmark_cmac_message(void){
+    uint8_t key[16];
+    uint8_t message[1024];
+    uint8_t cmac_expected[16];
+    uint8_t cmac[16];
+    memset(message, 0x55, sizeof(message));
+    parse_hex(key, cmac_key_string);
+    int message_len = parse_hex(message, cmac_message_string);
+    parse_hex(cmac_expected, cmac_string);
+
+    btstack_crypto_aes128_cmac_t request;
+    cmac_message(&request, key, message_len, message, cmac);
+    verify("CMAC", cmac_expected, cmac, sizeof(cmac_expected));
+
+    static const uint16_t lengths[] = { 16, 40, 1024 };
+    unsigned int i;
+    for (i = 0; i < sizeof(lengths) / sizeof(uint16_t); i++){
+        uint16_t len = lengths[i];
+        uint32_t count_before = hci_le_encrypt_count;
+        uint64_t start_ns = get_time_ns();
+        int iteration;
+        for (iteration = 0; iteration < NUM_ITERATIONS_CMAC; iteration++){
+            cmac_message(&request, key, len, message, cmac);
+        }
+        uint64_t duration_ns = get_time_ns() - start_ns;
+        printf("- aes128_cmac_message %4u bytes: %8.1f ns per operation, %6.1f MB/s, %2u HCI LE Encrypt per operation\n",
+               len, (double) duration_ns / NUM_ITERATIONS_CMAC, (double) len * NUM_ITERATIONS_CMAC * 1e3 / duration_ns,
+               (hci_le_encrypt_count - count_before) / NUM_ITERATIONS_CMAC);
+    }
+}
+
+// SM and Mesh issue independent AES128, CCM and CMAC operations at the same time
+static void benchmark_mixed(void){
+    uint8_t ccm_key[16];
+    uint8_t nonce[13];
+    uint8_t ciphertext[18];
+    uint8_t plaintext_expected[18];
+    uint8_t cmac_key[16];
+    uint8_t message[40];
+    uint8_t cmac_expected[16];
+    parse_hex(ccm_key, ccm_key_string);
+    parse_hex(nonce, ccm_nonce_string);
+    parse_hex(ciphertext, ccm_ciphertext_string);
+    parse_hex(plaintext_expected, ccm_plaintext_string);
+    parse_hex(cmac_key, cmac_key_string);
+    parse_hex(message, cmac_message_string);
+    parse_hex(cmac_expected, cmac_string);
+
+    uint8_t aes128_expected[16];
+    uint32_t rk[RKLENGTH(KEYBITS)];
+    int nrounds = rijndaelSetupEncrypt(rk, ccm_key, KEYBITS);
+    rijndaelEncrypt(rk, nrounds, cmac_key, aes128_expected);
+
+    btstack_crypto_aes128_t      aes128_requests[2];
+    btstack_crypto_ccm_t         ccm_requests[2];
+    btstack_crypto_aes128_cmac_t cmac_request;
+    uint8_t aes128_results[2][16];
+    uint8_t ccm_plaintexts[2][18];
+    uint8_t cmac[16];
+
+    uint32_t count_before = hci_le_encrypt_count;
+    uint32_t round_trips_before = hci_round_trip_count;
+    uint64_t start_ns = get_time_ns();
+    int iteration;
+    for (iteration = 0; iteration < NUM_ITERATIONS_MIXED; iteration++){
+        operations_pending += 5;
+        int i;
+        for (i = 0; i < 2; i++){
+            btstack_crypto_aes128_encrypt(&aes128_requests[i], ccm_key, cmac_key, aes128_results[i], &operation_complete, NULL);
+            btstack_crypto_ccm_init(&ccm_requests[i], ccm_key, nonce, sizeof(ciphertext), 0, 4);
+            btstack_crypto_ccm_decrypt_block(&ccm_requests[i], sizeof(ciphertext), ciphertext, ccm_plaintexts[i], &operation_complete, NULL);
+        }
+        btstack_crypto_aes128_cmac_message(&cmac_request, cmac_key, sizeof(message), message, cmac, &operation_complete, NULL);
+        wait_for_operations();
+    }
+    uint64_t duration_ns = get_time_ns() - start_ns;
+
+    int i;
+    for (i = 0; i < 2; i++){
+        verify("AES128", aes128_expected, aes128_results[i], sizeof(aes128_expected));
+        verify("CCM", plaintext_expected, ccm_plaintexts[i], sizeof(plaintext_expected));
+    }
+    verify("CMAC", cmac_expected, cmac, sizeof(cmac_expected));
+
+    printf("- 2 x AES128 + 2 x CCM 18 bytes + CMAC 40 bytes: %7.1f ns, %2u HCI LE Encrypt, %2u Controller round trips\n",
+           (double) duration_ns / NUM_ITERATIONS_MIXED, (hci_le_encrypt_count - count_before) / NUM_ITERATIONS_MIXED,
+           (hci_round_trip_count - round_trips_before) / NUM_ITERATIONS_MIXED);
+}
+
+#ifdef ENABLE_SOFTWARE_AES128
+static void benchmark_aes128_block(void){
+    uint8_t key[16];
+    uint8_t block[16];
+    parse_hex(key, cmac_key_string);
+    memset(block, 0, sizeof(block));
+
+    // reference: key expansion for every block
+    uint64_t start_ns = get_time_ns();
+    int iteration;
+    for (iteration = 0; iteration < NUM_ITERATIONS_AES; iteration++){
+        uint32_t rk[RKLENGTH(KEYBITS)];
+        int nrounds = rijndaelSetupEncrypt(rk, key, KEYBITS);
+        rijndaelEncrypt(rk, nrounds, block, block);
+    }
+    uint64_t duration_ns = get_time_ns() - start_ns;
+    printf("- rijndael with key setup: %5.1f ns per block\n", (double) duration_ns / NUM_ITERATIONS_AES);
+
+    start_ns = get_time_ns();
+    for (iteration = 0; iteration < NUM_ITERATIONS_AES; iteration++){
+        btstack_aes128_calc(key, block, block);
+    }
+    duration_ns = get_time_ns() - start_ns;
+    printf("- btstack_aes128_calc:     %5.1f ns per block\n", (double) duration_ns / NUM_ITERATIONS_AES);
+}
+#endif
+
+int main(void){
+#ifdef ENABLE_SOFTWARE_AES128
+#if defined(__x86_64__) && defined(__AES__)
+    printf("AES128: software, AES-NI\n");
+#else
+    printf("AES128: software, T-tables\n");
+#endif
+    benchmark_aes128_block();
+#else
+    printf("AES128: HCI LE Encrypt (emulated Controller, %u commands in flight)\n", HCI_NUM_CMD_PACKETS_MAX);
+#endif
+    btstack_crypto_init();
+    benchmark_ccm_decrypt();
+    benchmark_cmac_message();
+    benchmark_mixed();
+    return 0;
+}
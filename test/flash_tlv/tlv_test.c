@@ -13,6 +13,10 @@
 #include "btstack_config.h"
 #include "btstack_debug.h"
 
+#ifdef ENABLE_TLV_FLASH_BANK_WRITE_BUFFER
+#include "btstack_run_loop_posix.h"
+#endif
+
 #ifdef ENABLE_TLV_FLASH_EXPLICIT_DELETE_FIELD
 // Provide additional bytes for 3 x delete fields (in both banks)
 #define HAL_FLASH_BANK_MEMORY_STORAGE_SIZE (256 + 24)
@@ -244,6 +248,88 @@ TEST(BSTACK_TLV, TestWriteResetRead){
     CHECK_EQUAL(buffer, data);
 }
 
+#ifdef ENABLE_TLV_FLASH_BANK_INDEX
+TEST(BSTACK_TLV, TestIndexOverflow){
+	btstack_tlv_impl = btstack_tlv_flash_bank_init_instance(&btstack_tlv_context, hal_flash_bank_impl, &hal_flash_bank_context);
+	// more tags than index entries
+	uint32_t tags[] = { 'aaaa', 'bbbb', 'cccc' };
+	uint8_t  data;
+	int i;
+	for (data=0;data<2;data++){
+		for (i=0;i<3;i++){
+			uint8_t buffer = data + i;
+			btstack_tlv_impl->store_tag(&btstack_tlv_context, tags[i], &buffer, 1);
+		}
+	}
+	btstack_tlv_impl->delete_tag(&btstack_tlv_context, tags[1]);
+	btstack_tlv_impl = btstack_tlv_flash_bank_init_instance(&btstack_tlv_context, hal_flash_bank_impl, &hal_flash_bank_context);
+	uint8_t buffer;
+	CHECK_EQUAL(btstack_tlv_impl->get_tag(&btstack_tlv_context, tags[0], &buffer, 1), 1);
+	CHECK_EQUAL(buffer, 1);
+	CHECK_EQUAL(btstack_tlv_impl->get_tag(&btstack_tlv_context, tags[1], &buffer, 1), 0);
+	CHECK_EQUAL(btstack_tlv_impl->get_tag(&btstack_tlv_context, tags[2], &buffer, 1), 1);
+	CHECK_EQUAL(buffer, 3);
+}
+#endif
+
+#ifdef ENABLE_TLV_FLASH_BANK_WRITE_BUFFER
+TEST(BSTACK_TLV, TestWriteBufferFlush){
+	btstack_tlv_impl = btstack_tlv_flash_bank_init_instance(&btstack_tlv_context, hal_flash_bank_impl, &hal_flash_bank_context);
+	btstack_tlv_flash_bank_set_write_delay(&btstack_tlv_context, 1000);
+	uint32_t tag = 'abcd';
+	uint8_t  data;
+	for (data=0;data<10;data++){
+		btstack_tlv_impl->store_tag(&btstack_tlv_context, tag, &data, 1);
+	}
+	uint8_t buffer;
+	CHECK_EQUAL(btstack_tlv_impl->get_tag(&btstack_tlv_context, tag, &buffer, 1), 1);
+	CHECK_EQUAL(buffer, 9);
+
+	// not in flash yet
+	btstack_tlv_flash_bank_t btstack_tlv_context_2;
+	const btstack_tlv_t * btstack_tlv_impl_2 = btstack_tlv_flash_bank_init_instance(&btstack_tlv_context_2, hal_flash_bank_impl, &hal_flash_bank_context);
+	CHECK_EQUAL(btstack_tlv_impl_2->get_tag(&btstack_tlv_context_2, tag, NULL, 0), 0);
+
+	btstack_tlv_flash_bank_flush(&btstack_tlv_context);
+	btstack_tlv_impl_2 = btstack_tlv_flash_bank_init_instance(&btstack_tlv_context_2, hal_flash_bank_impl, &hal_flash_bank_context);
+	CHECK_EQUAL(btstack_tlv_impl_2->get_tag(&btstack_tlv_context_2, tag, &buffer, 1), 1);
+	CHECK_EQUAL(buffer, 9);
+}
+
+TEST(BSTACK_TLV, TestWriteBufferLargeValue){
+	btstack_tlv_impl = btstack_tlv_flash_bank_init_instance(&btstack_tlv_context, hal_flash_bank_impl, &hal_flash_bank_context);
+	btstack_tlv_flash_bank_set_write_delay(&btstack_tlv_context, 1000);
+	uint32_t tag = 'abcd';
+	uint8_t  data[TLV_FLASH_BANK_WRITE_BUFFER_VALUE_SIZE + 1];
+	memset(data, 1, sizeof(data));
+	btstack_tlv_impl->store_tag(&btstack_tlv_context, tag, data, 1);
+	// written directly, replaces buffered value
+	memset(data, 2, sizeof(data));
+	btstack_tlv_impl->store_tag(&btstack_tlv_context, tag, data, sizeof(data));
+	btstack_tlv_flash_bank_set_write_delay(&btstack_tlv_context, 0);
+
+	btstack_tlv_impl = btstack_tlv_flash_bank_init_instance(&btstack_tlv_context, hal_flash_bank_impl, &hal_flash_bank_context);
+	uint8_t buffer[sizeof(data)];
+	CHECK_EQUAL(btstack_tlv_impl->get_tag(&btstack_tlv_context, tag, buffer, sizeof(buffer)), sizeof(data));
+	CHECK_EQUAL_ARRAY(data, buffer, sizeof(data));
+}
+
+TEST(BSTACK_TLV, TestWriteBufferDelete){
+	btstack_tlv_impl = btstack_tlv_flash_bank_init_instance(&btstack_tlv_context, hal_flash_bank_impl, &hal_flash_bank_context);
+	uint32_t tag = 'abcd';
+	uint8_t  data = 7;
+	btstack_tlv_impl->store_tag(&btstack_tlv_context, tag, &data, 1);
+	btstack_tlv_flash_bank_set_write_delay(&btstack_tlv_context, 1000);
+	data++;
+	btstack_tlv_impl->store_tag(&btstack_tlv_context, tag, &data, 1);
+	btstack_tlv_impl->delete_tag(&btstack_tlv_context, tag);
+	CHECK_EQUAL(btstack_tlv_impl->get_tag(&btstack_tlv_context, tag, NULL, 0), 0);
+	btstack_tlv_flash_bank_flush(&btstack_tlv_context);
+	btstack_tlv_impl = btstack_tlv_flash_bank_init_instance(&btstack_tlv_context, hal_flash_bank_impl, &hal_flash_bank_context);
+	CHECK_EQUAL(btstack_tlv_impl->get_tag(&btstack_tlv_context, tag, NULL, 0), 0);
+}
+#endif
+
 //
 TEST_GROUP(LINK_KEY_DB){
 	const hal_flash_bank_t * hal_flash_bank_impl;
@@ -328,5 +414,8 @@ TEST(LINK_KEY_DB, KeyReplacement){
 
 int main (int argc, const char * argv[]){
 	hci_dump_open("tlv_test.pklg", HCI_DUMP_PACKETLOGGER);
+#ifdef ENABLE_TLV_FLASH_BANK_WRITE_BUFFER
+	btstack_run_loop_init(btstack_run_loop_posix_get_instance());
+#endif
     return CommandLineTestRunner::RunAllTests(argc, argv);
 }
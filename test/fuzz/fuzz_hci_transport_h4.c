@@ -1,6 +1,7 @@
 #include <stdint.h>
 #include <stddef.h>
 #include <stdio.h>
+#include <string.h>
 
 #include <btstack_util.h>
 #include "hci_transport.h"
@@ -17,6 +18,11 @@ static uint8_t * read_request_buffer;
 static uint32_t  read_request_len;
 
 static void (*block_received)(void);
+static void (*bytes_received)(uint16_t num_bytes);
+
+// summary of received packets to compare block and streaming mode
+static uint32_t packets_received;
+static uint32_t packets_hash;
 
 static int btstack_uart_fuzz_init(const btstack_uart_config_t * config){
     return 0;
@@ -52,6 +58,15 @@ static void btstack_uart_fuzz_receive_block(uint8_t *buffer, uint16_t len){
     read_request_len = len;
 }
 
+static void btstack_uart_fuzz_set_bytes_received( void (*bytes_handler)(uint16_t num_bytes)){
+    bytes_received = bytes_handler;
+}
+
+static void btstack_uart_fuzz_receive_bytes(uint8_t *buffer, uint16_t len){
+    read_request_buffer = buffer;
+    read_request_len = len;
+}
+
 static int btstack_uart_fuzz_set_baudrate(uint32_t baudrate){
     return 0;
 }
@@ -77,6 +92,26 @@ btstack_uart_block_t uart_driver = {
         /* int (*get_supported_sleep_modes); */                           &btstack_uart_fuzz_get_supported_sleep_modes,
         /* void (*set_sleep)(btstack_uart_sleep_mode_t sleep_mode); */    &btstack_uart_fuzz_set_sleep,
         /* void (*set_wakeup_handler)(void (*handler)(void)); */          &btstack_uart_fuzz_set_wakeup_handler,
+        /* void (*set_bytes_received)(void (*handler)(uint16_t)); */      NULL,
+        /* void (*receive_bytes)(uint8_t *buffer, uint16_t len); */       NULL,
+};
+
+btstack_uart_block_t uart_driver_streaming = {
+        /* int  (*init)(hci_transport_config_uart_t * config); */         &btstack_uart_fuzz_init,
+        /* int  (*open)(void); */                                         &btstack_uart_fuzz_open,
+        /* int  (*close)(void); */                                        &btstack_uart_fuzz_close,
+        /* void (*set_block_received)(void (*handler)(void)); */          &btstack_uart_fuzz_set_block_received,
+        /* void (*set_block_sent)(void (*handler)(void)); */              &btstack_uart_fuzz_set_block_sent,
+        /* int  (*set_baudrate)(uint32_t baudrate); */                    &btstack_uart_fuzz_set_baudrate,
+        /* int  (*set_parity)(int parity); */                             &btstack_uart_fuzz_set_parity,
+        /* int  (*set_flowcontrol)(int flowcontrol); */                   NULL,
+        /* void (*receive_block)(uint8_t *buffer, uint16_t len); */       &btstack_uart_fuzz_receive_block,
+        /* void (*send_block)(const uint8_t *buffer, uint16_t length); */ &btstack_uart_fuzz_send_block,
+        /* int (*get_supported_sleep_modes); */                           &btstack_uart_fuzz_get_supported_sleep_modes,
+        /* void (*set_sleep)(btstack_uart_sleep_mode_t sleep_mode); */    &btstack_uart_fuzz_set_sleep,
+        /* void (*set_wakeup_handler)(void (*handler)(void)); */          &btstack_uart_fuzz_set_wakeup_handler,
+        /* void (*set_bytes_received)(void (*handler)(uint16_t)); */      &btstack_uart_fuzz_set_bytes_received,
+        /* void (*receive_bytes)(uint8_t *buffer, uint16_t len); */       &btstack_uart_fuzz_receive_bytes,
 };
 
 static void packet_handler(uint8_t packet_type, uint8_t *packet, uint16_t size){
@@ -97,9 +132,15 @@ static void packet_handler(uint8_t packet_type, uint8_t *packet, uint16_t size){
             __builtin_trap();
             break;
     }
+    packets_received++;
+    packets_hash = (packets_hash * 31u) + packet_type;
+    uint16_t i;
+    for (i = 0; i < size; i++){
+        packets_hash = (packets_hash * 31u) + packet[i];
+    }
 }
 
-int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+static void fuzz_block_mode(const uint8_t *data, size_t size){
     const hci_transport_t * transport = hci_transport_h4_instance(&uart_driver);
     read_request_len = 0;
     transport->init(&config);
@@ -108,11 +149,49 @@ int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
     while (size > 0){
         if (read_request_len == 0) __builtin_trap();
 
-        uint16_t bytes_to_feed = btstack_min(read_request_len, size);
+        // UART driver only reports complete blocks
+        if (size < read_request_len) break;
+
+        uint16_t bytes_to_feed = read_request_len;
         memcpy(read_request_buffer, data, bytes_to_feed);
         size -= bytes_to_feed;
         data += bytes_to_feed;
         (*block_received)();
     }
+}
+
+static void fuzz_streaming_mode(const uint8_t *data, size_t size){
+    const hci_transport_t * transport = hci_transport_h4_instance(&uart_driver_streaming);
+    read_request_len = 0;
+    transport->init(&config);
+    transport->register_packet_handler(&packet_handler);
+    transport->open();
+    // vary number of bytes per read to split packets at different positions
+    uint32_t seed = (uint32_t) size;
+    while (size > 0){
+        if (read_request_len == 0) __builtin_trap();
+
+        seed = (seed * 1103515245u) + 12345u;
+        uint16_t bytes_to_feed = btstack_min(1u + ((seed >> 16) % read_request_len), size);
+        memcpy(read_request_buffer, data, bytes_to_feed);
+        size -= bytes_to_feed;
+        data += bytes_to_feed;
+        (*bytes_received)(bytes_to_feed);
+    }
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    packets_received = 0;
+    packets_hash = 0;
+    fuzz_block_mode(data, size);
+    uint32_t block_mode_packets_received = packets_received;
+    uint32_t block_mode_packets_hash = packets_hash;
+
+    // streaming parser has to deliver the same packets
+    packets_received = 0;
+    packets_hash = 0;
+    fuzz_streaming_mode(data, size);
+    if (packets_received != block_mode_packets_received) __builtin_trap();
+    if (packets_hash != block_mode_packets_hash) __builtin_trap();
     return 0;
 }
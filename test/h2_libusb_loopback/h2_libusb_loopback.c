@@ -0,0 +1,279 @@
+/*
+ * Copyright (C) 2020 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHIAS
+ * RINGWALD OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+#define BTSTACK_FILE__ "h2_libusb_loopback.c"
+
+/*
+ *  h2_libusb_loopback.c
+ *
+ *  Loopback harness for the H2 libusb transport. libusb is replaced by the USB emulation in sim_libusb.c with a
+ *  virtual clock. An emulated Controller with CONTROLLER_ACL_BUFFERS ACL buffers answers HCI Commands and reports
+ *  Number Of Completed Packets. The host follows HCI flow control like hci.c and streams HCI Commands and ACL
+ *  packets to measure the effect of HCI_USB_ACL_OUT_BUFFER_COUNT and HCI_NUM_CMD_PACKETS_MAX.
+ *  Exits with an error if packets are lost, reordered, or Controller buffers overflow.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sim_libusb.h"
+
+#include "btstack_debug.h"
+#include "btstack_run_loop.h"
+#include "btstack_util.h"
+#include "hci.h"
+#include "hci_transport.h"
+
+// default used by hci_transport_h2_libusb.c
+#ifndef HCI_USB_ACL_OUT_BUFFER_COUNT
+#define HCI_USB_ACL_OUT_BUFFER_COUNT 1
+#endif
+
+#define NUM_COMMANDS            200
+#define NUM_PACKETS             1000
+#define ACL_PAYLOAD_SIZE        1021
+#define ACL_PACKET_SIZE         (HCI_ACL_HEADER_SIZE + ACL_PAYLOAD_SIZE)
+
+#define CONTROLLER_ACL_BUFFERS  8
+#define CONTROLLER_CMD_PACKETS  4
+#define CONTROLLER_CMD_US       100
+#define CONTROLLER_ACL_US       500
+
+#define MAX_SIM_TIME_US         (600ULL * 1000000ULL)
+
+typedef struct {
+    uint32_t completion_latency_us;
+} sim_scenario_t;
+
+static const sim_scenario_t scenarios[] = {
+    {    0 },
+    {  250 },
+    { 1000 },
+    { 2000 },
+};
+
+// Controller emulation
+static uint64_t    controller_cmd_busy_until_us;
+static uint64_t    controller_acl_busy_until_us;
+static uint32_t    controller_acl_buffers_used;
+static uint32_t    controller_cmd_pending;
+static uint32_t    controller_expected_packet;
+static uint32_t    controller_num_errors;
+
+// host
+static const hci_transport_t * transport;
+static uint8_t  host_packet[HCI_ACL_BUFFER_SIZE];
+static int      host_packet_buffer_reserved;
+static uint32_t host_num_cmd_packets;
+static uint32_t host_acl_free_buffers;
+static uint32_t host_num_commands_sent;
+static uint32_t host_num_commands_completed;
+static uint32_t host_num_packets_sent;
+static uint64_t host_commands_done_us;
+
+// -----------------------------
+// Controller
+
+void controller_receive_command(const uint8_t * packet, uint16_t len){
+    if (len < 3) {
+        controller_num_errors++;
+        return;
+    }
+    uint64_t now_us = sim_get_time_us();
+    controller_cmd_pending++;
+    controller_cmd_busy_until_us = sim_max(controller_cmd_busy_until_us, now_us) + CONTROLLER_CMD_US;
+    // Command Complete with Num_HCI_Command_Packets and status
+    uint8_t event[6];
+    event[0] = HCI_EVENT_COMMAND_COMPLETE;
+    event[1] = 4;
+    event[2] = 0;   // Num_HCI_Command_Packets, set when event is sent
+    event[3] = packet[0];
+    event[4] = packet[1];
+    event[5] = ERROR_CODE_SUCCESS;
+    sim_controller_send_packet(HCI_EVENT_PACKET, controller_cmd_busy_until_us, event, sizeof(event), 0);
+}
+
+void controller_receive_acl_packet(const uint8_t * packet, uint16_t len){
+    if ((len != ACL_PACKET_SIZE) || (little_endian_read_32(packet, HCI_ACL_HEADER_SIZE) != controller_expected_packet)){
+        printf("controller: unexpected ACL packet, expected %u\n", controller_expected_packet);
+        controller_num_errors++;
+    }
+    controller_expected_packet++;
+    controller_acl_buffers_used++;
+    if (controller_acl_buffers_used > CONTROLLER_ACL_BUFFERS){
+        printf("controller: ACL buffer overflow\n");
+        controller_num_errors++;
+    }
+    // send packet over the air and report Number Of Completed Packets
+    controller_acl_busy_until_us = sim_max(controller_acl_busy_until_us, sim_get_time_us()) + CONTROLLER_ACL_US;
+    uint8_t event[7];
+    event[0] = HCI_EVENT_NUMBER_OF_COMPLETED_PACKETS;
+    event[1] = 5;
+    event[2] = 1;
+    little_endian_store_16(event, 3, little_endian_read_16(packet, 0) & 0x0fffu);
+    little_endian_store_16(event, 5, 1);
+    sim_controller_send_packet(HCI_EVENT_PACKET, controller_acl_busy_until_us, event, sizeof(event), 1);
+}
+
+void controller_packet_delivered(sim_packet_t * packet){
+    if (packet->releases_acl_buffer){
+        controller_acl_buffers_used--;
+    }
+    if (packet->data[0] == HCI_EVENT_COMMAND_COMPLETE){
+        // host may have sent more commands than allowed as earlier events with Num_HCI_Command_Packets were in flight
+        controller_cmd_pending--;
+        packet->data[2] = (controller_cmd_pending < CONTROLLER_CMD_PACKETS) ? (CONTROLLER_CMD_PACKETS - controller_cmd_pending) : 0;
+    }
+}
+
+// -----------------------------
+// Host: HCI flow control for Commands and ACL packets as in hci.c
+
+static void host_run(void){
+    while (!host_packet_buffer_reserved){
+        if (host_num_commands_sent < NUM_COMMANDS){
+            if (host_num_cmd_packets == 0) return;
+            if (!transport->can_send_packet_now(HCI_COMMAND_DATA_PACKET)) return;
+            host_num_cmd_packets--;
+            host_num_commands_sent++;
+            host_packet_buffer_reserved = 1;
+            little_endian_store_16(host_packet, 0, HCI_OPCODE_HCI_LE_RAND);
+            host_packet[2] = 0;
+            transport->send_packet(HCI_COMMAND_DATA_PACKET, host_packet, 3);
+            continue;
+        }
+        if (host_num_commands_completed < NUM_COMMANDS) return;
+        if (host_num_packets_sent < NUM_PACKETS){
+            if (host_acl_free_buffers == 0) return;
+            if (!transport->can_send_packet_now(HCI_ACL_DATA_PACKET)) return;
+            host_acl_free_buffers--;
+            little_endian_store_16(host_packet, 0, 0x0001);
+            little_endian_store_16(host_packet, 2, ACL_PAYLOAD_SIZE);
+            memset(&host_packet[HCI_ACL_HEADER_SIZE], 0x55, ACL_PAYLOAD_SIZE);
+            little_endian_store_32(host_packet, HCI_ACL_HEADER_SIZE, host_num_packets_sent);
+            host_num_packets_sent++;
+            host_packet_buffer_reserved = 1;
+            transport->send_packet(HCI_ACL_DATA_PACKET, host_packet, ACL_PACKET_SIZE);
+            continue;
+        }
+        return;
+    }
+}
+
+static void host_packet_handler(uint8_t packet_type, uint8_t * packet, uint16_t size){
+    UNUSED(size);
+    if (packet_type != HCI_EVENT_PACKET) return;
+    switch (packet[0]){
+        case HCI_EVENT_TRANSPORT_PACKET_SENT:
+            host_packet_buffer_reserved = 0;
+            break;
+        case HCI_EVENT_COMMAND_COMPLETE:
+            host_num_cmd_packets = btstack_min(packet[2], HCI_NUM_CMD_PACKETS_MAX);
+            host_num_commands_completed++;
+            if (host_num_commands_completed == NUM_COMMANDS){
+                host_commands_done_us = sim_get_time_us();
+            }
+            break;
+        case HCI_EVENT_NUMBER_OF_COMPLETED_PACKETS:
+            host_acl_free_buffers += little_endian_read_16(packet, 5);
+            break;
+        default:
+            break;
+    }
+    host_run();
+}
+
+// -----------------------------
+// Simulation
+
+static int sim_run_scenario(const sim_scenario_t * scenario){
+    // reset simulation
+    sim_reset(scenario->completion_latency_us);
+    controller_cmd_busy_until_us = 0;
+    controller_acl_busy_until_us = 0;
+    controller_acl_buffers_used = 0;
+    controller_cmd_pending = 0;
+    controller_expected_packet = 0;
+    controller_num_errors = 0;
+    host_packet_buffer_reserved = 0;
+    host_num_cmd_packets = 1;
+    host_acl_free_buffers = CONTROLLER_ACL_BUFFERS;
+    host_num_commands_sent = 0;
+    host_num_commands_completed = 0;
+    host_num_packets_sent = 0;
+    host_commands_done_us = 0;
+
+    if (transport->open() != 0){
+        printf("failed to open transport\n");
+        return 1;
+    }
+    host_run();
+
+    while ((controller_expected_packet < NUM_PACKETS) || (host_acl_free_buffers < CONTROLLER_ACL_BUFFERS)){
+        if (!sim_step(MAX_SIM_TIME_US)){
+            printf("simulation stalled after %u commands, %u packets\n", host_num_commands_completed, controller_expected_packet);
+            return 1;
+        }
+    }
+
+    transport->close();
+
+    double commands_s = (double) host_commands_done_us / 1000000.0;
+    double acl_s = (double) (sim_get_time_us() - host_commands_done_us) / 1000000.0;
+    printf("- completion latency %4u us: %6.0f commands/s, %6.1f kB/s, max %u ACL transfers in flight\n",
+           scenario->completion_latency_us, NUM_COMMANDS / commands_s,
+           (double) (NUM_PACKETS * ACL_PAYLOAD_SIZE) / acl_s / 1000.0, sim_get_acl_out_in_flight_max());
+    return (controller_num_errors + sim_get_num_errors()) > 0;
+}
+
+int main(void){
+    printf("H2 libusb loopback, HCI_USB_ACL_OUT_BUFFER_COUNT %u, HCI_NUM_CMD_PACKETS_MAX %u, %u ACL buffers, %u commands, %u ACL packets with %u bytes payload\n",
+           HCI_USB_ACL_OUT_BUFFER_COUNT, HCI_NUM_CMD_PACKETS_MAX, CONTROLLER_ACL_BUFFERS, NUM_COMMANDS, NUM_PACKETS, ACL_PAYLOAD_SIZE);
+
+    btstack_run_loop_init(sim_run_loop_get_instance());
+
+    transport = hci_transport_usb_instance();
+    transport->register_packet_handler(&host_packet_handler);
+
+    int errors = 0;
+    unsigned int i;
+    for (i = 0; i < sizeof(scenarios) / sizeof(sim_scenario_t); i++){
+        errors += sim_run_scenario(&scenarios[i]);
+    }
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,489 @@
+/*
+ * Copyright (C) 2020 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHIAS
+ * RINGWALD OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+#define BTSTACK_FILE__ "h2_libusb_stack.c"
+
+/*
+ *  h2_libusb_stack.c
+ *
+ *  Runs hci.c and l2cap.c over the H2 libusb transport on the USB emulation in sim_libusb.c. The emulated
+ *  Controller answers the HCI initialization, accepts an LE connection with small LE ACL buffers and acts as
+ *  a peer that accepts an LE Data Channel and returns credits. The host streams SDUs which are segmented by
+ *  l2cap.c and fragmented by hci.c, so HCI_EVENT_TRANSPORT_PACKET_SENT is used for every ACL fragment.
+ *  Exits with an error if the stack stalls, SDUs are corrupted, or Controller buffers overflow.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sim_libusb.h"
+
+#include "bluetooth_company_id.h"
+#include "btstack_debug.h"
+#include "btstack_event.h"
+#include "btstack_memory.h"
+#include "btstack_run_loop.h"
+#include "btstack_util.h"
+#include "hci.h"
+#include "hci_transport.h"
+#include "l2cap.h"
+
+// default used by hci_transport_h2_libusb.c
+#ifndef HCI_USB_ACL_OUT_BUFFER_COUNT
+#define HCI_USB_ACL_OUT_BUFFER_COUNT 1
+#endif
+
+#define NUM_SDUS                200
+#define SDU_SIZE                500
+#define TEST_PSM                0x0080
+
+#define COMPLETION_LATENCY_US   250
+
+#define CONTROLLER_CMD_PACKETS  4
+#define CONTROLLER_CMD_US       100
+#define CONTROLLER_LE_ACL_LEN   27
+#define CONTROLLER_LE_ACL_NUM   8
+#define CONTROLLER_LE_ACL_US    250
+#define CONTROLLER_CON_HANDLE   0x0040
+
+#define PEER_CID                0x0040
+#define PEER_MTU                SDU_SIZE
+#define PEER_MPS                200
+#define PEER_INITIAL_CREDITS    8
+#define PEER_CREDITS_BATCH      4
+
+#define MAX_SIM_TIME_US         (60ULL * 1000000ULL)
+
+static const bd_addr_t controller_bd_addr = { 0x00, 0x1B, 0xDC, 0x08, 0xE2, 0x01 };
+static const bd_addr_t peer_bd_addr       = { 0x00, 0x1B, 0xDC, 0x08, 0xE2, 0x02 };
+
+// Controller emulation
+static uint64_t controller_cmd_busy_until_us;
+static uint64_t controller_acl_busy_until_us;
+static uint32_t controller_acl_buffers_used;
+static uint32_t controller_cmd_pending;
+static uint32_t controller_num_errors;
+
+// peer: L2CAP reassembly and LE Data Channel
+static uint8_t  peer_l2cap_buffer[HCI_ACL_BUFFER_SIZE];
+static uint16_t peer_l2cap_len;
+static uint16_t peer_local_cid;
+static uint8_t  peer_sig_id;
+static uint16_t peer_sdu_len;
+static uint16_t peer_sdu_pos;
+static uint32_t peer_num_sdus;
+static uint16_t peer_credits_pending;
+
+// host
+static btstack_packet_callback_registration_t hci_event_callback_registration;
+static hci_con_handle_t host_con_handle;
+static uint16_t host_cid;
+static uint8_t  host_receive_buffer[100];
+static uint8_t  host_sdu[SDU_SIZE];
+static uint32_t host_num_sdus_sent;
+static uint32_t host_num_packets_sent_events;
+static uint64_t host_channel_opened_us;
+
+static uint8_t test_pattern(uint32_t sdu_nr, uint16_t pos){
+    return (uint8_t) (sdu_nr + pos);
+}
+
+// -----------------------------
+// Controller
+
+static void controller_send_event(uint64_t ready_us, const uint8_t * event, uint16_t len, uint8_t releases_acl_buffer){
+    if (!sim_controller_send_packet(HCI_EVENT_PACKET, ready_us, event, len, releases_acl_buffer)){
+        controller_num_errors++;
+    }
+}
+
+static void controller_send_command_complete(uint16_t opcode, const uint8_t * return_params, uint8_t return_params_len){
+    uint8_t event[5 + 65];
+    event[0] = HCI_EVENT_COMMAND_COMPLETE;
+    event[1] = 3 + return_params_len;
+    event[2] = 0;   // Num_HCI_Command_Packets, set when event is sent
+    little_endian_store_16(event, 3, opcode);
+    memcpy(&event[5], return_params, return_params_len);
+    controller_send_event(controller_cmd_busy_until_us, event, 5 + return_params_len, 0);
+}
+
+static void controller_send_command_status(uint16_t opcode, uint8_t status){
+    uint8_t event[6];
+    event[0] = HCI_EVENT_COMMAND_STATUS;
+    event[1] = 4;
+    event[2] = status;
+    event[3] = 0;   // Num_HCI_Command_Packets, set when event is sent
+    little_endian_store_16(event, 4, opcode);
+    controller_send_event(controller_cmd_busy_until_us, event, sizeof(event), 0);
+}
+
+static void controller_send_le_connection_complete(const uint8_t * params){
+    uint8_t event[21];
+    event[0] = HCI_EVENT_LE_META;
+    event[1] = 19;
+    event[2] = HCI_SUBEVENT_LE_CONNECTION_COMPLETE;
+    event[3] = ERROR_CODE_SUCCESS;
+    little_endian_store_16(event, 4, CONTROLLER_CON_HANDLE);
+    event[6] = HCI_ROLE_MASTER;
+    event[7] = params[5];                       // peer address type
+    memcpy(&event[8], &params[6], 6);           // peer address
+    little_endian_store_16(event, 14, little_endian_read_16(params, 12));   // connection interval max
+    little_endian_store_16(event, 16, little_endian_read_16(params, 16));   // connection latency
+    little_endian_store_16(event, 18, little_endian_read_16(params, 18));   // supervision timeout
+    event[20] = 0;
+    controller_send_event(controller_cmd_busy_until_us + 1000u, event, sizeof(event), 0);
+}
+
+void controller_receive_command(const uint8_t * packet, uint16_t len){
+    if (len < 3) {
+        controller_num_errors++;
+        return;
+    }
+    uint16_t opcode = little_endian_read_16(packet, 0);
+    const uint8_t * params = &packet[3];
+    uint8_t return_params[65];
+
+    controller_cmd_pending++;
+    controller_cmd_busy_until_us = sim_max(controller_cmd_busy_until_us, sim_get_time_us()) + CONTROLLER_CMD_US;
+
+    return_params[0] = ERROR_CODE_SUCCESS;
+    switch (opcode){
+        case HCI_OPCODE_HCI_READ_LOCAL_VERSION_INFORMATION:
+            return_params[1] = 0x09;        // HCI Version 5.0
+            little_endian_store_16(return_params, 2, 0);
+            return_params[4] = 0x09;        // LMP Version 5.0
+            little_endian_store_16(return_params, 5, BLUETOOTH_COMPANY_ID_BLUEKITCHEN_GMBH);
+            little_endian_store_16(return_params, 7, 0);
+            controller_send_command_complete(opcode, return_params, 9);
+            break;
+        case HCI_OPCODE_HCI_READ_LOCAL_SUPPORTED_COMMANDS:
+            memset(&return_params[1], 0, 64);
+            return_params[1 + 14] = 0x80;   // Read Buffer Size
+            return_params[1 + 24] = 0x40;   // Write LE Host Supported
+            controller_send_command_complete(opcode, return_params, 65);
+            break;
+        case HCI_OPCODE_HCI_READ_LOCAL_SUPPORTED_FEATURES:
+            memset(&return_params[1], 0, 8);
+            return_params[1 + 4] = 0x60;    // BR/EDR Not Supported, LE Supported (Controller)
+            controller_send_command_complete(opcode, return_params, 9);
+            break;
+        case HCI_OPCODE_HCI_READ_BD_ADDR:
+            reverse_bd_addr(controller_bd_addr, &return_params[1]);
+            controller_send_command_complete(opcode, return_params, 7);
+            break;
+        case HCI_OPCODE_HCI_READ_BUFFER_SIZE:
+            // no shared buffers, LE Read Buffer Size is used
+            memset(&return_params[1], 0, 7);
+            controller_send_command_complete(opcode, return_params, 8);
+            break;
+        case HCI_OPCODE_HCI_LE_READ_BUFFER_SIZE:
+            little_endian_store_16(return_params, 1, CONTROLLER_LE_ACL_LEN);
+            return_params[3] = CONTROLLER_LE_ACL_NUM;
+            controller_send_command_complete(opcode, return_params, 4);
+            break;
+        case HCI_OPCODE_HCI_LE_READ_WHITE_LIST_SIZE:
+            return_params[1] = 8;
+            controller_send_command_complete(opcode, return_params, 2);
+            break;
+        case HCI_OPCODE_HCI_LE_CREATE_CONNECTION:
+            controller_send_command_status(opcode, ERROR_CODE_SUCCESS);
+            controller_send_le_connection_complete(params);
+            break;
+        default:
+            // other link control commands would need further events
+            if ((opcode >> 10) == OGF_LINK_CONTROL){
+                printf("controller: unsupported command %04x\n", opcode);
+                controller_num_errors++;
+                controller_send_command_status(opcode, ERROR_CODE_UNKNOWN_HCI_COMMAND);
+                break;
+            }
+            controller_send_command_complete(opcode, return_params, 1);
+            break;
+    }
+}
+
+static void peer_send_l2cap(uint16_t cid, const uint8_t * payload, uint16_t len){
+    uint8_t packet[HCI_ACL_HEADER_SIZE + L2CAP_HEADER_SIZE + 16];
+    btstack_assert(len <= 16);
+    little_endian_store_16(packet, 0, CONTROLLER_CON_HANDLE | 0x2000u);
+    little_endian_store_16(packet, 2, L2CAP_HEADER_SIZE + len);
+    little_endian_store_16(packet, 4, len);
+    little_endian_store_16(packet, 6, cid);
+    memcpy(&packet[8], payload, len);
+    if (!sim_controller_send_packet(HCI_ACL_DATA_PACKET, controller_acl_busy_until_us, packet, HCI_ACL_HEADER_SIZE + L2CAP_HEADER_SIZE + len, 0)){
+        controller_num_errors++;
+    }
+}
+
+static void peer_send_credits(void){
+    uint8_t command[8];
+    command[0] = LE_FLOW_CONTROL_CREDIT;
+    command[1] = ++peer_sig_id;
+    little_endian_store_16(command, 2, 4);
+    little_endian_store_16(command, 4, peer_local_cid);
+    little_endian_store_16(command, 6, peer_credits_pending);
+    peer_credits_pending = 0;
+    peer_send_l2cap(L2CAP_CID_SIGNALING_LE, command, sizeof(command));
+}
+
+static void peer_handle_signaling(const uint8_t * command, uint16_t len){
+    if (len < 4) return;
+    if (command[0] != LE_CREDIT_BASED_CONNECTION_REQUEST) return;
+    if ((len < 14) || (little_endian_read_16(command, 4) != TEST_PSM)){
+        printf("peer: unexpected LE Credit Based Connection Request\n");
+        controller_num_errors++;
+        return;
+    }
+    peer_local_cid = little_endian_read_16(command, 6);
+    uint8_t response[14];
+    response[0] = LE_CREDIT_BASED_CONNECTION_RESPONSE;
+    response[1] = command[1];
+    little_endian_store_16(response, 2, 10);
+    little_endian_store_16(response, 4, PEER_CID);
+    little_endian_store_16(response, 6, PEER_MTU);
+    little_endian_store_16(response, 8, PEER_MPS);
+    little_endian_store_16(response, 10, PEER_INITIAL_CREDITS);
+    little_endian_store_16(response, 12, 0);
+    peer_send_l2cap(L2CAP_CID_SIGNALING_LE, response, sizeof(response));
+}
+
+static void peer_handle_pdu(const uint8_t * pdu, uint16_t len){
+    uint16_t pos = 0;
+    if (peer_sdu_pos == 0){
+        peer_sdu_len = little_endian_read_16(pdu, 0);
+        pos = 2;
+    }
+    if ((len > PEER_MPS) || (peer_sdu_len != SDU_SIZE) || ((peer_sdu_pos + len - pos) > peer_sdu_len)){
+        printf("peer: invalid PDU, len %u, SDU len %u\n", len, peer_sdu_len);
+        controller_num_errors++;
+        return;
+    }
+    for (; pos < len; pos++){
+        if (pdu[pos] != test_pattern(peer_num_sdus, peer_sdu_pos)){
+            printf("peer: SDU %u corrupted at %u\n", peer_num_sdus, peer_sdu_pos);
+            controller_num_errors++;
+            return;
+        }
+        peer_sdu_pos++;
+    }
+    if (peer_sdu_pos == peer_sdu_len){
+        peer_num_sdus++;
+        peer_sdu_pos = 0;
+    }
+    // return credits in batches
+    peer_credits_pending++;
+    if (peer_credits_pending == PEER_CREDITS_BATCH){
+        peer_send_credits();
+    }
+}
+
+static void peer_handle_l2cap(const uint8_t * packet, uint16_t len){
+    uint16_t cid = little_endian_read_16(packet, 2);
+    const uint8_t * payload = &packet[L2CAP_HEADER_SIZE];
+    uint16_t payload_len = len - L2CAP_HEADER_SIZE;
+    switch (cid){
+        case L2CAP_CID_SIGNALING_LE:
+            peer_handle_signaling(payload, payload_len);
+            break;
+        case PEER_CID:
+            peer_handle_pdu(payload, payload_len);
+            break;
+        default:
+            break;
+    }
+}
+
+void controller_receive_acl_packet(const uint8_t * packet, uint16_t len){
+    uint16_t handle_and_flags = little_endian_read_16(packet, 0);
+    uint16_t acl_len = little_endian_read_16(packet, 2);
+    if (((handle_and_flags & 0x0fffu) != CONTROLLER_CON_HANDLE) || (acl_len > CONTROLLER_LE_ACL_LEN) || ((HCI_ACL_HEADER_SIZE + acl_len) != len)){
+        printf("controller: invalid ACL packet, len %u\n", len);
+        controller_num_errors++;
+        return;
+    }
+    controller_acl_buffers_used++;
+    if (controller_acl_buffers_used > CONTROLLER_LE_ACL_NUM){
+        printf("controller: ACL buffer overflow\n");
+        controller_num_errors++;
+    }
+
+    // L2CAP reassembly
+    if ((handle_and_flags & 0x3000u) != 0x1000u){
+        peer_l2cap_len = 0;
+    }
+    if ((peer_l2cap_len + acl_len) > sizeof(peer_l2cap_buffer)){
+        printf("controller: L2CAP PDU too large\n");
+        controller_num_errors++;
+        peer_l2cap_len = 0;
+    } else {
+        memcpy(&peer_l2cap_buffer[peer_l2cap_len], &packet[HCI_ACL_HEADER_SIZE], acl_len);
+        peer_l2cap_len += acl_len;
+        if ((peer_l2cap_len >= L2CAP_HEADER_SIZE) && (peer_l2cap_len == (L2CAP_HEADER_SIZE + little_endian_read_16(peer_l2cap_buffer, 0)))){
+            peer_handle_l2cap(peer_l2cap_buffer, peer_l2cap_len);
+            peer_l2cap_len = 0;
+        }
+    }
+
+    // send packet over the air and report Number Of Completed Packets
+    controller_acl_busy_until_us = sim_max(controller_acl_busy_until_us, sim_get_time_us()) + CONTROLLER_LE_ACL_US;
+    uint8_t event[7];
+    event[0] = HCI_EVENT_NUMBER_OF_COMPLETED_PACKETS;
+    event[1] = 5;
+    event[2] = 1;
+    little_endian_store_16(event, 3, CONTROLLER_CON_HANDLE);
+    little_endian_store_16(event, 5, 1);
+    controller_send_event(controller_acl_busy_until_us, event, sizeof(event), 1);
+}
+
+void controller_packet_delivered(sim_packet_t * packet){
+    if (packet->releases_acl_buffer){
+        controller_acl_buffers_used--;
+    }
+    if (packet->packet_type != HCI_EVENT_PACKET) return;
+    uint8_t * num_hci_command_packets;
+    switch (packet->data[0]){
+        case HCI_EVENT_COMMAND_COMPLETE:
+            num_hci_command_packets = &packet->data[2];
+            break;
+        case HCI_EVENT_COMMAND_STATUS:
+            num_hci_command_packets = &packet->data[3];
+            break;
+        default:
+            return;
+    }
+    controller_cmd_pending--;
+    *num_hci_command_packets = (controller_cmd_pending < CONTROLLER_CMD_PACKETS) ? (CONTROLLER_CMD_PACKETS - controller_cmd_pending) : 0;
+}
+
+// -----------------------------
+// Host: LE Data Channel over hci.c and l2cap.c
+
+static void host_send_sdu(void){
+    uint16_t pos;
+    for (pos = 0; pos < SDU_SIZE; pos++){
+        host_sdu[pos] = test_pattern(host_num_sdus_sent, pos);
+    }
+    uint8_t status = l2cap_le_send_data(host_cid, host_sdu, SDU_SIZE);
+    if (status != ERROR_CODE_SUCCESS){
+        printf("host: l2cap_le_send_data failed, status 0x%02x\n", status);
+        controller_num_errors++;
+        return;
+    }
+    host_num_sdus_sent++;
+}
+
+static void host_l2cap_packet_handler(uint8_t packet_type, uint16_t channel, uint8_t * packet, uint16_t size){
+    UNUSED(channel);
+    UNUSED(size);
+    if (packet_type != HCI_EVENT_PACKET) return;
+    switch (hci_event_packet_get_type(packet)){
+        case L2CAP_EVENT_LE_CHANNEL_OPENED:
+            if (l2cap_event_le_channel_opened_get_status(packet) != ERROR_CODE_SUCCESS){
+                printf("host: LE Data Channel failed, status 0x%02x\n", l2cap_event_le_channel_opened_get_status(packet));
+                controller_num_errors++;
+                break;
+            }
+            host_channel_opened_us = sim_get_time_us();
+            l2cap_le_request_can_send_now_event(host_cid);
+            break;
+        case L2CAP_EVENT_LE_PACKET_SENT:
+            host_num_packets_sent_events++;
+            break;
+        case L2CAP_EVENT_LE_CAN_SEND_NOW:
+            host_send_sdu();
+            if (host_num_sdus_sent < NUM_SDUS){
+                l2cap_le_request_can_send_now_event(host_cid);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+static void host_hci_packet_handler(uint8_t packet_type, uint16_t channel, uint8_t * packet, uint16_t size){
+    UNUSED(channel);
+    UNUSED(size);
+    if (packet_type != HCI_EVENT_PACKET) return;
+    bd_addr_t addr;
+    switch (hci_event_packet_get_type(packet)){
+        case BTSTACK_EVENT_STATE:
+            if (btstack_event_state_get_state(packet) != HCI_STATE_WORKING) break;
+            memcpy(addr, peer_bd_addr, 6);
+            gap_connect(addr, BD_ADDR_TYPE_LE_PUBLIC);
+            break;
+        case HCI_EVENT_LE_META:
+            if (hci_event_le_meta_get_subevent_code(packet) != HCI_SUBEVENT_LE_CONNECTION_COMPLETE) break;
+            host_con_handle = hci_subevent_le_connection_complete_get_connection_handle(packet);
+            l2cap_le_create_channel(&host_l2cap_packet_handler, host_con_handle, TEST_PSM, host_receive_buffer,
+                                    sizeof(host_receive_buffer), L2CAP_LE_AUTOMATIC_CREDITS, LEVEL_0, &host_cid);
+            break;
+        default:
+            break;
+    }
+}
+
+int main(void){
+    printf("H2 libusb stack, HCI_USB_ACL_OUT_BUFFER_COUNT %u, HCI_NUM_CMD_PACKETS_MAX %u, %u LE ACL buffers of %u bytes, %u SDUs with %u bytes\n",
+           HCI_USB_ACL_OUT_BUFFER_COUNT, HCI_NUM_CMD_PACKETS_MAX, CONTROLLER_LE_ACL_NUM, CONTROLLER_LE_ACL_LEN, NUM_SDUS, SDU_SIZE);
+
+    sim_reset(COMPLETION_LATENCY_US);
+
+    btstack_memory_init();
+    btstack_run_loop_init(sim_run_loop_get_instance());
+
+    hci_init(hci_transport_usb_instance(), NULL);
+    l2cap_init();
+
+    hci_event_callback_registration.callback = &host_hci_packet_handler;
+    hci_add_event_handler(&hci_event_callback_registration);
+
+    hci_power_control(HCI_POWER_ON);
+
+    while ((peer_num_sdus < NUM_SDUS) || (host_num_packets_sent_events < NUM_SDUS)){
+        if ((controller_num_errors + sim_get_num_errors()) > 0) break;
+        if (!sim_step(MAX_SIM_TIME_US)){
+            printf("simulation stalled after %u SDUs sent, %u received\n", host_num_sdus_sent, peer_num_sdus);
+            return 1;
+        }
+    }
+
+    double duration_s = (double) (sim_get_time_us() - host_channel_opened_us) / 1000000.0;
+    printf("- %u SDUs received, %6.1f kB/s, max %u ACL transfers in flight\n", peer_num_sdus,
+           (double) (peer_num_sdus * SDU_SIZE) / duration_s / 1000.0, sim_get_acl_out_in_flight_max());
+    return (controller_num_errors + sim_get_num_errors()) > 0;
+}
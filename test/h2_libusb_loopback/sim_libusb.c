@@ -0,0 +1,578 @@
+/*
+ * Copyright (C) 2020 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHIAS
+ * RINGWALD OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+#define BTSTACK_FILE__ "sim_libusb.c"
+
+/*
+ *  sim_libusb.c
+ *
+ *  USB emulation for the H2 libusb harnesses, see sim_libusb.h
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libusb.h"
+#include "sim_libusb.h"
+
+#include "btstack_debug.h"
+#include "btstack_run_loop_base.h"
+#include "btstack_util.h"
+
+// Full Speed: 19 bulk packets of 64 bytes per 1 ms frame
+#define USB_BYTES_PER_MS        1216
+#define USB_FRAME_US            1000
+
+#define MAX_TRANSFERS           32
+#define MAX_PACKETS             64
+
+#define EVENT_IN_ADDR           0x81
+#define ACL_IN_ADDR             0x82
+#define ACL_OUT_ADDR            0x02
+
+typedef enum {
+    SIM_TRANSFER_IDLE = 0,
+    SIM_TRANSFER_W4_DATA,       // IN transfer waiting for Controller data
+    SIM_TRANSFER_ON_BUS,        // OUT transfer, data not received by Controller yet
+    SIM_TRANSFER_W4_CALLBACK,   // completed, callback pending
+} sim_transfer_state_t;
+
+typedef struct {
+    sim_transfer_state_t state;
+    uint64_t bus_done_us;
+    uint64_t completion_us;
+    uint32_t seq_nr;
+    struct libusb_transfer * transfer;
+} sim_transfer_t;
+
+// simulation state
+static uint64_t now_us;
+static uint32_t completion_latency_us;
+static uint32_t sim_num_errors;
+
+// USB emulation
+static sim_transfer_t sim_transfers[MAX_TRANSFERS];
+static uint32_t       sim_transfer_seq_nr;
+static uint64_t       sim_control_pipe_free_us;
+static uint64_t       sim_bulk_pipe_free_us;
+static uint32_t       sim_acl_out_in_flight;
+static uint32_t       sim_acl_out_in_flight_max;
+static struct libusb_device        { int dummy; } sim_device;
+static struct libusb_device_handle { int dummy; } sim_device_handle;
+static libusb_device * sim_device_list[] = { &sim_device, NULL };
+
+static const struct libusb_endpoint_descriptor sim_endpoints[] = {
+    { 7, 5, EVENT_IN_ADDR, LIBUSB_TRANSFER_TYPE_INTERRUPT, 16, 1 },
+    { 7, 5, ACL_IN_ADDR,   LIBUSB_TRANSFER_TYPE_BULK,      64, 1 },
+    { 7, 5, ACL_OUT_ADDR,  LIBUSB_TRANSFER_TYPE_BULK,      64, 1 },
+};
+static const struct libusb_interface_descriptor sim_interface_descriptor = {
+    9, 4, 0, 0, 3, sim_endpoints
+};
+static const struct libusb_interface sim_interface = { &sim_interface_descriptor, 1 };
+static struct libusb_config_descriptor sim_config_descriptor = { 9, 2, 0, 1, &sim_interface };
+
+// packets from Controller to host
+static sim_packet_t controller_packets[MAX_PACKETS];
+static uint16_t     controller_packets_head;
+static uint16_t     controller_packets_len;
+
+uint64_t sim_min(uint64_t a, uint64_t b){
+    return a < b ? a : b;
+}
+
+uint64_t sim_max(uint64_t a, uint64_t b){
+    return a > b ? a : b;
+}
+
+static uint64_t sim_byte_time_us(uint32_t num_bytes){
+    return ((uint64_t) num_bytes * 1000u) / USB_BYTES_PER_MS;
+}
+
+// -----------------------------
+// Run loop with virtual clock
+
+static void sim_run_loop_init(void){
+    btstack_run_loop_base_init();
+}
+
+static uint32_t sim_run_loop_get_time_ms(void){
+    return (uint32_t) (now_us / 1000u);
+}
+
+static void sim_run_loop_set_timer(btstack_timer_source_t * ts, uint32_t timeout_in_ms){
+    ts->timeout = sim_run_loop_get_time_ms() + timeout_in_ms;
+}
+
+static const btstack_run_loop_t sim_run_loop = {
+    &sim_run_loop_init,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    &sim_run_loop_set_timer,
+    &btstack_run_loop_base_add_timer,
+    &btstack_run_loop_base_remove_timer,
+    NULL,
+    NULL,
+    &sim_run_loop_get_time_ms,
+};
+
+const btstack_run_loop_t * sim_run_loop_get_instance(void){
+    return &sim_run_loop;
+}
+
+// -----------------------------
+// Controller to host queue
+
+int sim_controller_send_packet(uint8_t packet_type, uint64_t ready_us, const uint8_t * data, uint16_t len, uint8_t releases_acl_buffer){
+    if ((controller_packets_len == MAX_PACKETS) || (len > HCI_ACL_BUFFER_SIZE)){
+        printf("controller: packet queue full\n");
+        sim_num_errors++;
+        return 0;
+    }
+    sim_packet_t * packet = &controller_packets[(controller_packets_head + controller_packets_len) % MAX_PACKETS];
+    packet->ready_us = ready_us;
+    packet->packet_type = packet_type;
+    packet->len = len;
+    memcpy(packet->data, data, len);
+    packet->releases_acl_buffer = releases_acl_buffer;
+    controller_packets_len++;
+    return 1;
+}
+
+uint16_t sim_controller_num_queued_packets(void){
+    return controller_packets_len;
+}
+
+static sim_packet_t * sim_controller_get_ready_packet(void){
+    if (controller_packets_len == 0) return NULL;
+    sim_packet_t * packet = &controller_packets[controller_packets_head];
+    if (packet->ready_us > now_us) return NULL;
+    return packet;
+}
+
+static uint8_t sim_in_endpoint_for_packet(const sim_packet_t * packet){
+    return (packet->packet_type == HCI_EVENT_PACKET) ? EVENT_IN_ADDR : ACL_IN_ADDR;
+}
+
+// -----------------------------
+// libusb emulation
+
+static sim_transfer_t * sim_transfer_for_libusb_transfer(const struct libusb_transfer * transfer){
+    int i;
+    for (i = 0; i < MAX_TRANSFERS; i++){
+        if (sim_transfers[i].transfer == transfer) return &sim_transfers[i];
+    }
+    return NULL;
+}
+
+int libusb_init(libusb_context ** ctx){
+    UNUSED(ctx);
+    return 0;
+}
+
+void libusb_exit(libusb_context * ctx){
+    UNUSED(ctx);
+}
+
+void libusb_set_debug(libusb_context * ctx, int level){
+    UNUSED(ctx);
+    UNUSED(level);
+}
+
+const char * libusb_error_name(int errcode){
+    UNUSED(errcode);
+    return "LIBUSB_ERROR";
+}
+
+ssize_t libusb_get_device_list(libusb_context * ctx, libusb_device *** list){
+    UNUSED(ctx);
+    *list = sim_device_list;
+    return 1;
+}
+
+void libusb_free_device_list(libusb_device ** list, int unref_devices){
+    UNUSED(list);
+    UNUSED(unref_devices);
+}
+
+int libusb_get_device_descriptor(libusb_device * dev, struct libusb_device_descriptor * desc){
+    UNUSED(dev);
+    memset(desc, 0, sizeof(struct libusb_device_descriptor));
+    desc->bDeviceClass = 0xE0;
+    desc->bDeviceSubClass = 0x01;
+    desc->bDeviceProtocol = 0x01;
+    return 0;
+}
+
+int libusb_get_active_config_descriptor(libusb_device * dev, struct libusb_config_descriptor ** config){
+    UNUSED(dev);
+    *config = &sim_config_descriptor;
+    return 0;
+}
+
+void libusb_free_config_descriptor(struct libusb_config_descriptor * config){
+    UNUSED(config);
+}
+
+uint8_t libusb_get_bus_number(libusb_device * dev){
+    UNUSED(dev);
+    return 1;
+}
+
+uint8_t libusb_get_device_address(libusb_device * dev){
+    UNUSED(dev);
+    return 1;
+}
+
+int libusb_get_port_numbers(libusb_device * dev, uint8_t * port_numbers, int port_numbers_len){
+    UNUSED(dev);
+    if (port_numbers_len < 1) return 0;
+    port_numbers[0] = 1;
+    return 1;
+}
+
+int libusb_open(libusb_device * dev, libusb_device_handle ** dev_handle){
+    UNUSED(dev);
+    *dev_handle = &sim_device_handle;
+    return 0;
+}
+
+libusb_device_handle * libusb_open_device_with_vid_pid(libusb_context * ctx, uint16_t vendor_id, uint16_t product_id){
+    UNUSED(ctx);
+    UNUSED(vendor_id);
+    UNUSED(product_id);
+    return &sim_device_handle;
+}
+
+void libusb_close(libusb_device_handle * dev_handle){
+    UNUSED(dev_handle);
+}
+
+libusb_device * libusb_get_device(libusb_device_handle * dev_handle){
+    UNUSED(dev_handle);
+    return &sim_device;
+}
+
+int libusb_reset_device(libusb_device_handle * dev_handle){
+    UNUSED(dev_handle);
+    return 0;
+}
+
+int libusb_kernel_driver_active(libusb_device_handle * dev_handle, int interface_number){
+    UNUSED(dev_handle);
+    UNUSED(interface_number);
+    return 0;
+}
+
+int libusb_detach_kernel_driver(libusb_device_handle * dev_handle, int interface_number){
+    UNUSED(dev_handle);
+    UNUSED(interface_number);
+    return 0;
+}
+
+int libusb_attach_kernel_driver(libusb_device_handle * dev_handle, int interface_number){
+    UNUSED(dev_handle);
+    UNUSED(interface_number);
+    return 0;
+}
+
+int libusb_set_configuration(libusb_device_handle * dev_handle, int configuration){
+    UNUSED(dev_handle);
+    UNUSED(configuration);
+    return 0;
+}
+
+int libusb_claim_interface(libusb_device_handle * dev_handle, int interface_number){
+    UNUSED(dev_handle);
+    UNUSED(interface_number);
+    return 0;
+}
+
+int libusb_release_interface(libusb_device_handle * dev_handle, int interface_number){
+    UNUSED(dev_handle);
+    UNUSED(interface_number);
+    return 0;
+}
+
+int libusb_set_interface_alt_setting(libusb_device_handle * dev_handle, int interface_number, int alternate_setting){
+    UNUSED(dev_handle);
+    UNUSED(interface_number);
+    UNUSED(alternate_setting);
+    return 0;
+}
+
+int libusb_clear_halt(libusb_device_handle * dev_handle, unsigned char endpoint){
+    UNUSED(dev_handle);
+    UNUSED(endpoint);
+    return 0;
+}
+
+struct libusb_transfer * libusb_alloc_transfer(int iso_packets){
+    int i;
+    for (i = 0; i < MAX_TRANSFERS; i++){
+        if (sim_transfers[i].transfer != NULL) continue;
+        struct libusb_transfer * transfer = calloc(1, sizeof(struct libusb_transfer) + iso_packets * sizeof(struct libusb_iso_packet_descriptor));
+        sim_transfers[i].transfer = transfer;
+        sim_transfers[i].state = SIM_TRANSFER_IDLE;
+        return transfer;
+    }
+    return NULL;
+}
+
+void libusb_free_transfer(struct libusb_transfer * transfer){
+    sim_transfer_t * sim_transfer = sim_transfer_for_libusb_transfer(transfer);
+    if (sim_transfer == NULL) return;
+    if (sim_transfer->state != SIM_TRANSFER_IDLE){
+        printf("libusb: transfer %p freed while in flight\n", (void *) transfer);
+        sim_num_errors++;
+    }
+    sim_transfer->transfer = NULL;
+    free(transfer);
+}
+
+int libusb_submit_transfer(struct libusb_transfer * transfer){
+    sim_transfer_t * sim_transfer = sim_transfer_for_libusb_transfer(transfer);
+    if (sim_transfer == NULL) return LIBUSB_ERROR_INVALID_PARAM;
+    if (sim_transfer->state != SIM_TRANSFER_IDLE) return LIBUSB_ERROR_BUSY;
+    sim_transfer->seq_nr = sim_transfer_seq_nr++;
+    transfer->actual_length = 0;
+    if (transfer->endpoint & 0x80){
+        sim_transfer->state = SIM_TRANSFER_W4_DATA;
+        return 0;
+    }
+    // OUT transfers share bus bandwidth, setup stage is ignored
+    uint64_t * pipe_free_us = (transfer->endpoint == 0) ? &sim_control_pipe_free_us : &sim_bulk_pipe_free_us;
+    *pipe_free_us = sim_max(*pipe_free_us, now_us) + sim_byte_time_us(transfer->length);
+    sim_transfer->bus_done_us = *pipe_free_us;
+    sim_transfer->completion_us = sim_transfer->bus_done_us + completion_latency_us;
+    sim_transfer->state = SIM_TRANSFER_ON_BUS;
+    if (transfer->endpoint == ACL_OUT_ADDR){
+        sim_acl_out_in_flight++;
+        sim_acl_out_in_flight_max = btstack_max(sim_acl_out_in_flight_max, sim_acl_out_in_flight);
+    }
+    return 0;
+}
+
+int libusb_cancel_transfer(struct libusb_transfer * transfer){
+    sim_transfer_t * sim_transfer = sim_transfer_for_libusb_transfer(transfer);
+    if (sim_transfer == NULL) return LIBUSB_ERROR_NOT_FOUND;
+    switch (sim_transfer->state){
+        case SIM_TRANSFER_W4_DATA:
+        case SIM_TRANSFER_ON_BUS:
+            if (transfer->endpoint == ACL_OUT_ADDR){
+                sim_acl_out_in_flight--;
+            }
+            transfer->status = LIBUSB_TRANSFER_CANCELLED;
+            sim_transfer->completion_us = now_us;
+            sim_transfer->state = SIM_TRANSFER_W4_CALLBACK;
+            return 0;
+        default:
+            return LIBUSB_ERROR_NOT_FOUND;
+    }
+}
+
+// get completed transfer with earliest completion time
+static sim_transfer_t * sim_get_completed_transfer(void){
+    sim_transfer_t * next = NULL;
+    int i;
+    for (i = 0; i < MAX_TRANSFERS; i++){
+        sim_transfer_t * sim_transfer = &sim_transfers[i];
+        if (sim_transfer->transfer == NULL) continue;
+        if (sim_transfer->state != SIM_TRANSFER_W4_CALLBACK) continue;
+        if (sim_transfer->completion_us > now_us) continue;
+        if ((next == NULL) || (sim_transfer->completion_us < next->completion_us) ||
+            ((sim_transfer->completion_us == next->completion_us) && (sim_transfer->seq_nr < next->seq_nr))){
+            next = sim_transfer;
+        }
+    }
+    return next;
+}
+
+int libusb_handle_events_timeout(libusb_context * ctx, struct timeval * tv){
+    UNUSED(ctx);
+    UNUSED(tv);
+    sim_transfer_t * sim_transfer;
+    while ((sim_transfer = sim_get_completed_transfer()) != NULL){
+        sim_transfer->state = SIM_TRANSFER_IDLE;
+        struct libusb_transfer * transfer = sim_transfer->transfer;
+        (*transfer->callback)(transfer);
+    }
+    return 0;
+}
+
+int libusb_pollfds_handle_timeouts(libusb_context * ctx){
+    UNUSED(ctx);
+    return 0;
+}
+
+const struct libusb_pollfd ** libusb_get_pollfds(libusb_context * ctx){
+    UNUSED(ctx);
+    return calloc(1, sizeof(struct libusb_pollfd *));
+}
+
+// oldest IN transfer waiting for data from given endpoint
+static sim_transfer_t * sim_get_in_transfer(uint8_t endpoint){
+    sim_transfer_t * in_transfer = NULL;
+    int i;
+    for (i = 0; i < MAX_TRANSFERS; i++){
+        sim_transfer_t * sim_transfer = &sim_transfers[i];
+        if (sim_transfer->transfer == NULL) continue;
+        if (sim_transfer->state != SIM_TRANSFER_W4_DATA) continue;
+        if (sim_transfer->transfer->endpoint != endpoint) continue;
+        if ((in_transfer == NULL) || (sim_transfer->seq_nr < in_transfer->seq_nr)){
+            in_transfer = sim_transfer;
+        }
+    }
+    return in_transfer;
+}
+
+// -----------------------------
+// USB bus: OUT data reaches Controller, Controller packets complete interrupt and bulk IN transfers
+
+static void sim_process_bus(void){
+    int i;
+    // OUT transfers, in order of arrival
+    while (true){
+        sim_transfer_t * next = NULL;
+        for (i = 0; i < MAX_TRANSFERS; i++){
+            sim_transfer_t * sim_transfer = &sim_transfers[i];
+            if (sim_transfer->transfer == NULL) continue;
+            if (sim_transfer->state != SIM_TRANSFER_ON_BUS) continue;
+            if (sim_transfer->bus_done_us > now_us) continue;
+            if ((next == NULL) || (sim_transfer->seq_nr < next->seq_nr)){
+                next = sim_transfer;
+            }
+        }
+        if (next == NULL) break;
+        struct libusb_transfer * transfer = next->transfer;
+        if (transfer->endpoint == 0){
+            controller_receive_command(&transfer->buffer[LIBUSB_CONTROL_SETUP_SIZE], transfer->length - LIBUSB_CONTROL_SETUP_SIZE);
+        } else {
+            controller_receive_acl_packet(transfer->buffer, transfer->length);
+            sim_acl_out_in_flight--;
+        }
+        transfer->status = LIBUSB_TRANSFER_COMPLETED;
+        transfer->actual_length = transfer->length;
+        next->state = SIM_TRANSFER_W4_CALLBACK;
+    }
+
+    // Controller packets in order, events are polled by host every frame
+    sim_packet_t * packet;
+    while ((packet = sim_controller_get_ready_packet()) != NULL){
+        sim_transfer_t * in_transfer = sim_get_in_transfer(sim_in_endpoint_for_packet(packet));
+        if (in_transfer == NULL) break;
+        controller_packet_delivered(packet);
+        controller_packets_head = (controller_packets_head + 1) % MAX_PACKETS;
+        controller_packets_len--;
+        struct libusb_transfer * transfer = in_transfer->transfer;
+        memcpy(transfer->buffer, packet->data, packet->len);
+        transfer->status = LIBUSB_TRANSFER_COMPLETED;
+        transfer->actual_length = packet->len;
+        if (packet->packet_type == HCI_EVENT_PACKET){
+            uint64_t next_frame_us = ((now_us / USB_FRAME_US) + 1u) * USB_FRAME_US;
+            in_transfer->completion_us = next_frame_us + completion_latency_us;
+        } else {
+            sim_bulk_pipe_free_us = sim_max(sim_bulk_pipe_free_us, now_us) + sim_byte_time_us(packet->len);
+            in_transfer->completion_us = sim_bulk_pipe_free_us + completion_latency_us;
+        }
+        in_transfer->state = SIM_TRANSFER_W4_CALLBACK;
+    }
+}
+
+static uint64_t sim_next_event_us(void){
+    uint64_t next_us = UINT64_MAX;
+    int i;
+    for (i = 0; i < MAX_TRANSFERS; i++){
+        sim_transfer_t * sim_transfer = &sim_transfers[i];
+        if (sim_transfer->transfer == NULL) continue;
+        if (sim_transfer->state == SIM_TRANSFER_ON_BUS){
+            next_us = sim_min(next_us, sim_transfer->bus_done_us);
+        }
+    }
+    // Controller packets are delivered when host has (re)submitted an IN transfer
+    if (controller_packets_len > 0){
+        const sim_packet_t * packet = &controller_packets[controller_packets_head];
+        if (sim_get_in_transfer(sim_in_endpoint_for_packet(packet)) != NULL){
+            next_us = sim_min(next_us, packet->ready_us);
+        }
+    }
+    // completed transfers are reported via transport timer
+    int32_t timeout_ms = btstack_run_loop_base_get_time_until_timeout(sim_run_loop_get_time_ms());
+    if (timeout_ms >= 0){
+        next_us = sim_min(next_us, (uint64_t) (sim_run_loop_get_time_ms() + timeout_ms) * 1000u);
+    }
+    return next_us;
+}
+
+// -----------------------------
+// Simulation
+
+void sim_reset(uint32_t latency_us){
+    now_us = 0;
+    completion_latency_us = latency_us;
+    sim_num_errors = 0;
+    sim_control_pipe_free_us = 0;
+    sim_bulk_pipe_free_us = 0;
+    sim_acl_out_in_flight = 0;
+    sim_acl_out_in_flight_max = 0;
+    controller_packets_head = 0;
+    controller_packets_len = 0;
+}
+
+uint64_t sim_get_time_us(void){
+    return now_us;
+}
+
+int sim_step(uint64_t max_time_us){
+    uint64_t next_us = sim_next_event_us();
+    if ((next_us == UINT64_MAX) || (next_us > max_time_us)) return 0;
+    now_us = sim_max(now_us, next_us);
+    sim_process_bus();
+    btstack_run_loop_base_process_timers(sim_run_loop_get_time_ms());
+    return 1;
+}
+
+uint32_t sim_get_acl_out_in_flight_max(void){
+    return sim_acl_out_in_flight_max;
+}
+
+uint32_t sim_get_num_errors(void){
+    return sim_num_errors;
+}
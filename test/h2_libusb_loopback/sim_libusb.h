@@ -0,0 +1,48 @@
+//
+// USB emulation for the H2 libusb harnesses
+// - implements the libusb API declared in libusb.h with a virtual clock
+// - models bulk/control bandwidth of a Full Speed device, 1 ms interrupt polling and a configurable completion latency
+// - HCI Commands and ACL packets are passed to the emulated Controller of the harness,
+//   packets queued by the Controller complete interrupt and bulk IN transfers
+//
+
+#ifndef SIM_LIBUSB_H
+#define SIM_LIBUSB_H
+
+#include <stdint.h>
+
+#include "btstack_run_loop.h"
+#include "hci.h"
+
+typedef struct {
+    uint64_t ready_us;
+    uint8_t  packet_type;
+    uint16_t len;
+    uint8_t  data[HCI_ACL_BUFFER_SIZE];
+    uint8_t  releases_acl_buffer;
+} sim_packet_t;
+
+// implemented by the harness
+void controller_receive_command(const uint8_t * packet, uint16_t len);
+void controller_receive_acl_packet(const uint8_t * packet, uint16_t len);
+void controller_packet_delivered(sim_packet_t * packet);
+
+const btstack_run_loop_t * sim_run_loop_get_instance(void);
+
+void     sim_reset(uint32_t completion_latency_us);
+uint64_t sim_get_time_us(void);
+
+// advance virtual time to next event, returns 0 if there is none before max_time_us
+int      sim_step(uint64_t max_time_us);
+
+// queue HCI Event or ACL packet from Controller to host, returns 0 if queue is full
+int      sim_controller_send_packet(uint8_t packet_type, uint64_t ready_us, const uint8_t * data, uint16_t len, uint8_t releases_acl_buffer);
+uint16_t sim_controller_num_queued_packets(void);
+
+uint32_t sim_get_acl_out_in_flight_max(void);
+uint32_t sim_get_num_errors(void);
+
+uint64_t sim_min(uint64_t a, uint64_t b);
+uint64_t sim_max(uint64_t a, uint64_t b);
+
+#endif
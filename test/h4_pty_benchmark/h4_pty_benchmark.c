@@ -0,0 +1,242 @@
+/*
+ * Copyright (C) 2020 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHIAS
+ * RINGWALD OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+#define BTSTACK_FILE__ "h4_pty_benchmark.c"
+
+/*
+ *  h4_pty_benchmark.c
+ *
+ *  HCI packets per second and per UART read over a pty pair. The host stack uses hci_transport_h4 with the POSIX
+ *  UART driver on the pty slave, an emulated Controller in a child process streams small LE ACL packets interleaved
+ *  with Number Of Completed Packets events on the pty master.
+ *  Build with H4_PTY_BENCHMARK_BLOCKWISE to disable partial reads, which makes H4 read packet type, header and
+ *  payload with separate reads.
+ */
+
+#define _GNU_SOURCE
+
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "btstack_debug.h"
+#include "btstack_run_loop.h"
+#include "btstack_run_loop_posix.h"
+#include "btstack_uart_block.h"
+#include "btstack_util.h"
+#include "hci.h"
+#include "hci_transport.h"
+
+#define NUM_PACKETS         200000
+#define ACL_PAYLOAD_SIZE    27
+#define ACL_PACKET_SIZE     (HCI_ACL_HEADER_SIZE + ACL_PAYLOAD_SIZE)
+#define EVENT_PACKET_SIZE   7
+#define ACL_PER_EVENT       4
+#define PACKETS_PER_WRITE   64
+#define TIMEOUT_S           60
+
+// host
+static const hci_transport_t * transport;
+static btstack_uart_block_t uart_driver;
+static uint32_t host_num_packets_received;
+static uint32_t host_num_reads;
+static uint64_t host_start_ns;
+static pid_t    controller_pid;
+
+static uint64_t get_time_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t) ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+// -----------------------------
+// Controller emulation, runs in child process
+
+static void controller_write(int fd, const uint8_t * data, uint32_t len){
+    while (len > 0){
+        ssize_t bytes_written = write(fd, data, len);
+        if (bytes_written <= 0) exit(1);
+        data += bytes_written;
+        len  -= bytes_written;
+    }
+}
+
+static void controller_run(int fd){
+    static uint8_t packets[PACKETS_PER_WRITE * (1 + ACL_PACKET_SIZE)];
+    uint8_t event_packet[1 + EVENT_PACKET_SIZE] = { HCI_EVENT_PACKET, HCI_EVENT_NUMBER_OF_COMPLETED_PACKETS, 5, 1, 0x01, 0x00, ACL_PER_EVENT, 0x00 };
+    uint8_t acl_packet[1 + ACL_PACKET_SIZE];
+    memset(acl_packet, 0x55, sizeof(acl_packet));
+    acl_packet[0] = HCI_ACL_DATA_PACKET;
+    little_endian_store_16(acl_packet, 1, 0x0001);
+    little_endian_store_16(acl_packet, 3, ACL_PAYLOAD_SIZE);
+
+    uint32_t i;
+    uint32_t len = 0;
+    for (i = 0; i < NUM_PACKETS; i++){
+        if ((i % (ACL_PER_EVENT + 1)) == ACL_PER_EVENT){
+            memcpy(&packets[len], event_packet, sizeof(event_packet));
+            len += sizeof(event_packet);
+        } else {
+            little_endian_store_32(acl_packet, 1 + HCI_ACL_HEADER_SIZE, i);
+            memcpy(&packets[len], acl_packet, sizeof(acl_packet));
+            len += sizeof(acl_packet);
+        }
+        if (((i + 1) % PACKETS_PER_WRITE) == 0){
+            controller_write(fd, packets, len);
+            len = 0;
+        }
+    }
+    controller_write(fd, packets, len);
+
+    // wait for host to terminate us
+    while (true){
+        pause();
+    }
+}
+
+// -----------------------------
+// Host
+
+static void host_finish(int status){
+    kill(controller_pid, SIGTERM);
+    waitpid(controller_pid, NULL, 0);
+    exit(status);
+}
+
+// count reads requested from POSIX UART driver, each results in at least one read() syscall
+static void host_receive_block(uint8_t * buffer, uint16_t len){
+    host_num_reads++;
+    btstack_uart_block_posix_instance()->receive_block(buffer, len);
+}
+
+#ifndef H4_PTY_BENCHMARK_BLOCKWISE
+static void host_receive_bytes(uint8_t * buffer, uint16_t len){
+    host_num_reads++;
+    btstack_uart_block_posix_instance()->receive_bytes(buffer, len);
+}
+#endif
+
+static void host_packet_handler(uint8_t packet_type, uint8_t * packet, uint16_t size){
+    if (host_num_packets_received == 0){
+        host_start_ns = get_time_ns();
+        host_num_reads = 0;
+    }
+    switch (packet_type){
+        case HCI_EVENT_PACKET:
+            if (packet[0] != HCI_EVENT_NUMBER_OF_COMPLETED_PACKETS) return;
+            break;
+        case HCI_ACL_DATA_PACKET:
+            if ((size != ACL_PACKET_SIZE) || (little_endian_read_32(packet, HCI_ACL_HEADER_SIZE) != host_num_packets_received)){
+                printf("host: unexpected ACL packet\n");
+                host_finish(1);
+            }
+            break;
+        default:
+            return;
+    }
+    host_num_packets_received++;
+    if (host_num_packets_received < NUM_PACKETS) return;
+
+    double duration_s = (double) (get_time_ns() - host_start_ns) / 1000000000.0;
+    printf("- %8.0f packets/s, %u reads, %5.2f packets per read\n", NUM_PACKETS / duration_s,
+           host_num_reads, (double) NUM_PACKETS / host_num_reads);
+    host_finish(0);
+}
+
+int main(void){
+    // create pty pair
+    int master_fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if ((master_fd < 0) || (grantpt(master_fd) != 0) || (unlockpt(master_fd) != 0)){
+        printf("failed to create pty pair\n");
+        return 1;
+    }
+    const char * slave_name = ptsname(master_fd);
+    // keep slave open, reads on master fail while no slave is open
+    int slave_fd = open(slave_name, O_RDWR | O_NOCTTY);
+    if (slave_fd < 0){
+        printf("failed to open %s\n", slave_name);
+        return 1;
+    }
+
+    uart_driver = *btstack_uart_block_posix_instance();
+    uart_driver.receive_block = &host_receive_block;
+#ifdef H4_PTY_BENCHMARK_BLOCKWISE
+    printf("H4 over pty, block-wise reads, %u packets with %u bytes ACL payload\n", NUM_PACKETS, ACL_PAYLOAD_SIZE);
+    // H4 reads packet type, header and payload separately if UART driver does not support partial reads
+    uart_driver.set_bytes_received = NULL;
+    uart_driver.receive_bytes = NULL;
+#else
+    printf("H4 over pty, partial reads, %u packets with %u bytes ACL payload\n", NUM_PACKETS, ACL_PAYLOAD_SIZE);
+    uart_driver.receive_bytes = &host_receive_bytes;
+#endif
+
+    btstack_run_loop_init(btstack_run_loop_posix_get_instance());
+
+    static hci_transport_config_uart_t config = {
+        HCI_TRANSPORT_CONFIG_UART,
+        921600,
+        0,
+        0,
+        NULL
+    };
+    config.device_name = slave_name;
+    transport = hci_transport_h4_instance(&uart_driver);
+    transport->init(&config);
+    transport->register_packet_handler(&host_packet_handler);
+    if (transport->open() != 0){
+        printf("failed to open H4 transport\n");
+        return 1;
+    }
+
+    // start Controller after UART has been configured
+    controller_pid = fork();
+    if (controller_pid == 0){
+        close(slave_fd);
+        controller_run(master_fd);
+        return 0;
+    }
+    close(master_fd);
+
+    alarm(TIMEOUT_S);
+    btstack_run_loop_execute();
+    return 0;
+}
@@ -0,0 +1,17 @@
+//
+// btstack_config.h for H5 loopback harness
+//
+
+#ifndef __BTSTACK_CONFIG
+#define __BTSTACK_CONFIG
+
+// Port related features
+#define HAVE_ASSERT
+
+// BTstack features that can be enabled
+#define ENABLE_LOG_ERROR
+
+// BTstack configuration. buffers, sizes, ...
+#define HCI_ACL_PAYLOAD_SIZE 1021
+
+#endif
@@ -0,0 +1,571 @@
+/*
+ * Copyright (C) 2020 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHIAS
+ * RINGWALD OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+#define BTSTACK_FILE__ "h5_loopback.c"
+
+/*
+ *  h5_loopback.c
+ *
+ *  Loopback harness for the H5 (Three-Wire UART) transport. The controller side of the link is emulated and
+ *  UART transmission time, one-way latency and frame loss are simulated with a virtual clock. ACL packets are
+ *  streamed from host to controller to measure the throughput for the sliding window selected by
+ *  HCI_H5_SLIDING_WINDOW_SIZE. Exits with an error if packets are lost, duplicated or reordered.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "btstack_debug.h"
+#include "btstack_run_loop.h"
+#include "btstack_run_loop_base.h"
+#include "btstack_slip.h"
+#include "btstack_uart_block.h"
+#include "btstack_util.h"
+#include "hci.h"
+#include "hci_transport.h"
+
+// default used by hci_transport_h5.c
+#ifndef HCI_H5_SLIDING_WINDOW_SIZE
+#define HCI_H5_SLIDING_WINDOW_SIZE 1
+#endif
+
+#define BAUDRATE            921600
+#define NUM_PACKETS         500
+#define ACL_PAYLOAD_SIZE    1021
+#define CONTROLLER_WINDOW   7
+#define MAX_SIM_TIME_US     (600ULL * 1000000ULL)
+
+#define MAX_FRAME_SIZE      (4 + HCI_ACL_HEADER_SIZE + ACL_PAYLOAD_SIZE + 2)
+#define MAX_CHUNK_SIZE      (2 + 2 * MAX_FRAME_SIZE)
+#define MAX_CHUNKS          64
+
+// H5 packet types
+#define LINK_ACKNOWLEDGEMENT_TYPE 0x00
+#define LINK_CONTROL_PACKET_TYPE  0x0f
+
+// a block of bytes in flight on one direction of the UART
+typedef struct {
+    uint64_t arrival_us;
+    uint16_t len;
+    uint16_t pos;
+    uint8_t  data[MAX_CHUNK_SIZE];
+} sim_chunk_t;
+
+typedef struct {
+    sim_chunk_t chunks[MAX_CHUNKS];
+    uint16_t    head;
+    uint16_t    len;
+    uint64_t    wire_free_us;
+} sim_wire_t;
+
+typedef struct {
+    uint32_t latency_ms;
+    uint32_t drop_rate_permille;
+} sim_scenario_t;
+
+static const sim_scenario_t scenarios[] = {
+    {  0,  0 },
+    {  2,  0 },
+    { 10,  0 },
+    {  0, 10 },
+    {  2, 10 },
+    { 10, 10 },
+    {  2, 50 },
+};
+
+// simulation state
+static uint64_t now_us;
+static uint32_t sim_random_state;
+static const sim_scenario_t * scenario;
+
+// UART
+static sim_wire_t host_to_controller;
+static sim_wire_t controller_to_host;
+static void (*uart_block_received)(void);
+static void (*uart_block_sent)(void);
+static void (*uart_bytes_received)(uint16_t num_bytes);
+static uint8_t * uart_receive_buffer;
+static uint16_t  uart_receive_len;
+static uint16_t  uart_receive_pos;
+static int       uart_receive_partial;
+static int       uart_block_sent_pending;
+static uint64_t  uart_block_sent_us;
+
+// controller emulation
+static uint8_t  controller_frame[MAX_FRAME_SIZE];
+static uint16_t controller_frame_len;
+static int      controller_frame_escape;
+static uint8_t  controller_expected_seq_nr;
+static uint32_t controller_expected_packet;
+static uint32_t controller_num_retransmissions;
+static uint32_t controller_num_dropped;
+static uint32_t controller_num_errors;
+
+// host
+static const hci_transport_t * transport;
+static uint8_t  host_acl_packet[HCI_ACL_HEADER_SIZE + ACL_PAYLOAD_SIZE];
+static uint32_t host_num_packets_sent;
+
+// -----------------------------
+// Virtual clock and run loop
+
+static uint32_t sim_random(void){
+    sim_random_state = sim_random_state * 1103515245u + 12345u;
+    return (sim_random_state >> 16) & 0x7fffu;
+}
+
+static uint64_t sim_min(uint64_t a, uint64_t b){
+    return (a < b) ? a : b;
+}
+
+static uint64_t sim_max(uint64_t a, uint64_t b){
+    return (a > b) ? a : b;
+}
+
+static int sim_drop_frame(void){
+    return (sim_random() % 1000u) < scenario->drop_rate_permille;
+}
+
+static uint64_t sim_byte_time_us(uint16_t num_bytes){
+    // 8N1 -> 10 bit per byte
+    return ((uint64_t) num_bytes * 10u * 1000000u) / BAUDRATE;
+}
+
+static void sim_run_loop_init(void){
+    btstack_run_loop_base_init();
+}
+
+static uint32_t sim_run_loop_get_time_ms(void){
+    return (uint32_t) (now_us / 1000u);
+}
+
+static void sim_run_loop_set_timer(btstack_timer_source_t * ts, uint32_t timeout_in_ms){
+    ts->timeout = sim_run_loop_get_time_ms() + timeout_in_ms;
+}
+
+static const btstack_run_loop_t sim_run_loop = {
+    &sim_run_loop_init,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    &sim_run_loop_set_timer,
+    &btstack_run_loop_base_add_timer,
+    &btstack_run_loop_base_remove_timer,
+    NULL,
+    NULL,
+    &sim_run_loop_get_time_ms,
+};
+
+// -----------------------------
+// UART wires with transmission time and latency
+
+static void sim_wire_init(sim_wire_t * wire){
+    memset(wire, 0, sizeof(sim_wire_t));
+}
+
+// returns time when the last byte has been transmitted
+static uint64_t sim_wire_send(sim_wire_t * wire, const uint8_t * data, uint16_t len){
+    btstack_assert(len <= MAX_CHUNK_SIZE);
+    btstack_assert(wire->len < MAX_CHUNKS);
+    uint64_t start_us = sim_max(now_us, wire->wire_free_us);
+    uint64_t end_us   = start_us + sim_byte_time_us(len);
+    wire->wire_free_us = end_us;
+    sim_chunk_t * chunk = &wire->chunks[(wire->head + wire->len) % MAX_CHUNKS];
+    chunk->arrival_us = end_us + (scenario->latency_ms * 1000u);
+    chunk->len = len;
+    chunk->pos = 0;
+    memcpy(chunk->data, data, len);
+    wire->len++;
+    return end_us;
+}
+
+static sim_chunk_t * sim_wire_get_arrived_chunk(sim_wire_t * wire){
+    if (wire->len == 0) return NULL;
+    sim_chunk_t * chunk = &wire->chunks[wire->head];
+    if (chunk->arrival_us > now_us) return NULL;
+    return chunk;
+}
+
+static void sim_wire_consume_chunk(sim_wire_t * wire){
+    wire->head = (wire->head + 1) % MAX_CHUNKS;
+    wire->len--;
+}
+
+// -----------------------------
+// UART driver
+
+static int uart_init(const btstack_uart_config_t * config){
+    UNUSED(config);
+    return 0;
+}
+
+static int uart_open(void){
+    return 0;
+}
+
+static int uart_close(void){
+    return 0;
+}
+
+static void uart_set_block_received(void (*handler)(void)){
+    uart_block_received = handler;
+}
+
+static void uart_set_block_sent(void (*handler)(void)){
+    uart_block_sent = handler;
+}
+
+static int uart_set_baudrate(uint32_t baudrate){
+    UNUSED(baudrate);
+    return 0;
+}
+
+static int uart_set_parity(int parity){
+    UNUSED(parity);
+    return 0;
+}
+
+static void uart_receive_block(uint8_t * buffer, uint16_t len){
+    uart_receive_buffer = buffer;
+    uart_receive_len = len;
+    uart_receive_pos = 0;
+    uart_receive_partial = 0;
+}
+
+static void uart_set_bytes_received(void (*handler)(uint16_t num_bytes)){
+    uart_bytes_received = handler;
+}
+
+static void uart_receive_bytes(uint8_t * buffer, uint16_t len){
+    uart_receive_block(buffer, len);
+    uart_receive_partial = 1;
+}
+
+static void uart_send_block(const uint8_t * data, uint16_t len){
+    btstack_assert(uart_block_sent_pending == 0);
+    uart_block_sent_us = sim_wire_send(&host_to_controller, data, len);
+    uart_block_sent_pending = 1;
+}
+
+static const btstack_uart_block_t uart_driver = {
+    /* int  (*init)(...); */                    &uart_init,
+    /* int  (*open)(void); */                   &uart_open,
+    /* int  (*close)(void); */                  &uart_close,
+    /* void (*set_block_received)(...); */      &uart_set_block_received,
+    /* void (*set_block_sent)(...); */          &uart_set_block_sent,
+    /* int  (*set_baudrate)(...); */            &uart_set_baudrate,
+    /* int  (*set_parity)(...); */              &uart_set_parity,
+    /* int  (*set_flowcontrol)(...); */         NULL,
+    /* void (*receive_block)(...); */           &uart_receive_block,
+    /* void (*send_block)(...); */              &uart_send_block,
+    /* int  (*get_supported_sleep_modes); */    NULL,
+    /* void (*set_sleep)(...); */               NULL,
+    /* void (*set_wakeup_handler)(...); */      NULL,
+    /* void (*set_bytes_received)(...); */      &uart_set_bytes_received,
+    /* void (*receive_bytes)(...); */           &uart_receive_bytes,
+};
+
+// -----------------------------
+// Controller emulation
+
+static void controller_send_frame(uint8_t ack_nr, uint8_t packet_type, const uint8_t * payload, uint16_t payload_len){
+    uint8_t header[4];
+    header[0] = ack_nr << 3;
+    header[1] = packet_type | ((payload_len & 0x0fu) << 4);
+    header[2] = payload_len >> 4;
+    header[3] = 0xffu - (header[0] + header[1] + header[2]);
+
+    // corrupt header checksum to simulate bit errors, host will discard frame
+    if (sim_drop_frame()){
+        header[3] ^= 0x55u;
+    }
+
+    uint8_t frame[MAX_CHUNK_SIZE];
+    uint16_t pos = 0;
+    frame[pos++] = BTSTACK_SLIP_SOF;
+    pos += btstack_slip_encode(&frame[pos], sizeof(frame) - pos, header, 4);
+    pos += btstack_slip_encode(&frame[pos], sizeof(frame) - pos, payload, payload_len);
+    frame[pos++] = BTSTACK_SLIP_SOF;
+    (void) sim_wire_send(&controller_to_host, frame, pos);
+}
+
+static void controller_send_ack(void){
+    controller_send_frame(controller_expected_seq_nr, LINK_ACKNOWLEDGEMENT_TYPE, NULL, 0);
+}
+
+static void controller_process_control(const uint8_t * payload, uint16_t len){
+    static const uint8_t link_control_sync[]            = { 0x01, 0x7e};
+    static const uint8_t link_control_sync_response[]   = { 0x02, 0x7d};
+    static const uint8_t link_control_config[]          = { 0x03, 0xfc};
+    static const uint8_t link_control_config_response[] = { 0x04, 0x7b, CONTROLLER_WINDOW};
+    if (len < 2) return;
+    if (memcmp(payload, link_control_sync, 2) == 0){
+        controller_send_frame(0, LINK_CONTROL_PACKET_TYPE, link_control_sync_response, sizeof(link_control_sync_response));
+        return;
+    }
+    if (memcmp(payload, link_control_config, 2) == 0){
+        controller_expected_seq_nr = 0;
+        controller_send_frame(0, LINK_CONTROL_PACKET_TYPE, link_control_config_response, sizeof(link_control_config_response));
+        return;
+    }
+}
+
+static void controller_process_acl_packet(const uint8_t * packet, uint16_t len){
+    if ((len != sizeof(host_acl_packet)) || (little_endian_read_32(packet, HCI_ACL_HEADER_SIZE) != controller_expected_packet)){
+        printf("controller: expected packet %u, got %u with len %u\n", controller_expected_packet,
+               little_endian_read_32(packet, HCI_ACL_HEADER_SIZE), len);
+        controller_num_errors++;
+        return;
+    }
+    controller_expected_packet++;
+}
+
+static void controller_process_frame(const uint8_t * frame, uint16_t len){
+    if (len < 4) return;
+
+    // simulate bit errors
+    if (sim_drop_frame()){
+        controller_num_dropped++;
+        return;
+    }
+
+    uint8_t  header_checksum = frame[0] + frame[1] + frame[2] + frame[3];
+    uint8_t  seq_nr = frame[0] & 0x07u;
+    uint8_t  reliable_packet = (frame[0] & 0x80u) != 0u;
+    uint8_t  packet_type = frame[1] & 0x0fu;
+    uint16_t payload_len = (frame[1] >> 4) | (frame[2] << 4);
+    if ((header_checksum != 0xffu) || (payload_len != (len - 4))){
+        printf("controller: invalid frame\n");
+        controller_num_errors++;
+        return;
+    }
+
+    if (packet_type == LINK_CONTROL_PACKET_TYPE){
+        controller_process_control(&frame[4], payload_len);
+        return;
+    }
+    if (reliable_packet == 0u) return;
+
+    // accept in-sequence packets only, send cumulative ack for all
+    if (seq_nr == controller_expected_seq_nr){
+        controller_expected_seq_nr = (controller_expected_seq_nr + 1u) & 0x07u;
+        if (packet_type == HCI_ACL_DATA_PACKET){
+            controller_process_acl_packet(&frame[4], payload_len);
+        }
+    } else {
+        controller_num_retransmissions++;
+    }
+    controller_send_ack();
+}
+
+static void controller_receive_bytes(const uint8_t * data, uint16_t len){
+    uint16_t i;
+    for (i = 0; i < len; i++){
+        uint8_t byte = data[i];
+        if (byte == BTSTACK_SLIP_SOF){
+            if (controller_frame_len > 0){
+                controller_process_frame(controller_frame, controller_frame_len);
+            }
+            controller_frame_len = 0;
+            controller_frame_escape = 0;
+            continue;
+        }
+        if (controller_frame_escape){
+            controller_frame_escape = 0;
+            switch (byte){
+                case 0xdc:
+                    byte = 0xc0;
+                    break;
+                case 0xdd:
+                    byte = 0xdb;
+                    break;
+                default:
+                    break;
+            }
+        } else if (byte == 0xdb){
+            controller_frame_escape = 1;
+            continue;
+        }
+        if (controller_frame_len < sizeof(controller_frame)){
+            controller_frame[controller_frame_len++] = byte;
+        }
+    }
+}
+
+// -----------------------------
+// Host: stream ACL packets
+
+static void host_send_next_packet(void){
+    if (host_num_packets_sent >= NUM_PACKETS) return;
+    if (!transport->can_send_packet_now(HCI_ACL_DATA_PACKET)) return;
+    little_endian_store_16(host_acl_packet, 0, 0x0001);
+    little_endian_store_16(host_acl_packet, 2, ACL_PAYLOAD_SIZE);
+    little_endian_store_32(host_acl_packet, HCI_ACL_HEADER_SIZE, host_num_packets_sent);
+    host_num_packets_sent++;
+    transport->send_packet(HCI_ACL_DATA_PACKET, host_acl_packet, sizeof(host_acl_packet));
+}
+
+static void host_packet_handler(uint8_t packet_type, uint8_t * packet, uint16_t size){
+    UNUSED(size);
+    if (packet_type != HCI_EVENT_PACKET) return;
+    if (packet[0] != HCI_EVENT_TRANSPORT_PACKET_SENT) return;
+    host_send_next_packet();
+}
+
+// -----------------------------
+// Simulation
+
+static uint64_t sim_next_event_us(void){
+    uint64_t next_us = UINT64_MAX;
+    if (uart_block_sent_pending){
+        next_us = uart_block_sent_us;
+    }
+    if (host_to_controller.len > 0){
+        next_us = sim_min(next_us, host_to_controller.chunks[host_to_controller.head].arrival_us);
+    }
+    if ((uart_receive_buffer != NULL) && (controller_to_host.len > 0)){
+        next_us = sim_min(next_us, controller_to_host.chunks[controller_to_host.head].arrival_us);
+    }
+    int32_t timeout_ms = btstack_run_loop_base_get_time_until_timeout(sim_run_loop_get_time_ms());
+    if (timeout_ms >= 0){
+        next_us = sim_min(next_us, (uint64_t) (sim_run_loop_get_time_ms() + timeout_ms) * 1000u);
+    }
+    return next_us;
+}
+
+static void sim_process_events(void){
+    // host: block sent
+    if (uart_block_sent_pending && (uart_block_sent_us <= now_us)){
+        uart_block_sent_pending = 0;
+        (*uart_block_sent)();
+    }
+
+    // controller: bytes received
+    sim_chunk_t * chunk;
+    while ((chunk = sim_wire_get_arrived_chunk(&host_to_controller)) != NULL){
+        controller_receive_bytes(chunk->data, chunk->len);
+        sim_wire_consume_chunk(&host_to_controller);
+    }
+
+    // host: bytes received
+    while ((uart_receive_buffer != NULL) && ((chunk = sim_wire_get_arrived_chunk(&controller_to_host)) != NULL)){
+        uint16_t bytes_to_copy = btstack_min(uart_receive_len - uart_receive_pos, chunk->len - chunk->pos);
+        memcpy(&uart_receive_buffer[uart_receive_pos], &chunk->data[chunk->pos], bytes_to_copy);
+        uart_receive_pos += bytes_to_copy;
+        chunk->pos += bytes_to_copy;
+        if (chunk->pos == chunk->len){
+            sim_wire_consume_chunk(&controller_to_host);
+        }
+        if (uart_receive_partial){
+            uart_receive_buffer = NULL;
+            (*uart_bytes_received)(uart_receive_pos);
+        } else if (uart_receive_pos == uart_receive_len){
+            uart_receive_buffer = NULL;
+            (*uart_block_received)();
+        }
+    }
+
+    // timers
+    btstack_run_loop_base_process_timers(sim_run_loop_get_time_ms());
+}
+
+static int sim_run_scenario(void){
+    // reset simulation
+    now_us = 0;
+    sim_random_state = 0x1234;
+    sim_wire_init(&host_to_controller);
+    sim_wire_init(&controller_to_host);
+    uart_receive_buffer = NULL;
+    uart_block_sent_pending = 0;
+    controller_frame_len = 0;
+    controller_frame_escape = 0;
+    controller_expected_seq_nr = 0;
+    controller_expected_packet = 0;
+    controller_num_retransmissions = 0;
+    controller_num_dropped = 0;
+    controller_num_errors = 0;
+    host_num_packets_sent = 0;
+    memset(host_acl_packet, 0x55, sizeof(host_acl_packet));
+
+    transport->open();
+
+    while (controller_expected_packet < NUM_PACKETS){
+        uint64_t next_us = sim_next_event_us();
+        if ((next_us == UINT64_MAX) || (next_us > MAX_SIM_TIME_US)){
+            printf("simulation stalled after %u packets\n", controller_expected_packet);
+            return 1;
+        }
+        now_us = sim_max(now_us, next_us);
+        sim_process_events();
+    }
+
+    transport->close();
+
+    double duration_s = (double) now_us / 1000000.0;
+    printf("- latency %2u ms, frame loss %4.1f %%: %6.1f kB/s, %4u frames lost, %4u retransmitted frames\n",
+           scenario->latency_ms, (double) scenario->drop_rate_permille / 10.0,
+           (double) (NUM_PACKETS * ACL_PAYLOAD_SIZE) / duration_s / 1000.0,
+           controller_num_dropped, controller_num_retransmissions);
+    return controller_num_errors > 0;
+}
+
+int main(void){
+    printf("H5 loopback, HCI_H5_SLIDING_WINDOW_SIZE %u, %u baud, %u ACL packets with %u bytes payload\n",
+           HCI_H5_SLIDING_WINDOW_SIZE, BAUDRATE, NUM_PACKETS, ACL_PAYLOAD_SIZE);
+
+    btstack_run_loop_init(&sim_run_loop);
+
+    static const hci_transport_config_uart_t config = {
+        HCI_TRANSPORT_CONFIG_UART,
+        BAUDRATE,
+        0,
+        1,
+        NULL
+    };
+    transport = hci_transport_h5_instance(&uart_driver);
+    transport->init(&config);
+    transport->register_packet_handler(&host_packet_handler);
+
+    int errors = 0;
+    unsigned int i;
+    for (i = 0; i < sizeof(scenarios) / sizeof(sim_scenario_t); i++){
+        scenario = &scenarios[i];
+        errors += sim_run_scenario();
+    }
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,28 @@
+//
+// btstack_config.h for ACL recombination test
+//
+#ifndef __BTSTACK_CONFIG
+#define __BTSTACK_CONFIG
+
+// Port related features
+#define HAVE_MALLOC
+#define HAVE_ASSERT
+#define HAVE_POSIX_TIME
+
+// BTstack features that can be enabled
+#define ENABLE_BLE
+#define ENABLE_CLASSIC
+#define ENABLE_LE_PERIPHERAL
+#define ENABLE_LE_CENTRAL
+#define ENABLE_LOG_ERROR
+#define ENABLE_LOG_INFO
+#define ENABLE_ACL_RECOMBINATION_BUFFER_POOL
+
+// BTstack configuration. buffers, sizes, ...
+#define HCI_ACL_PAYLOAD_SIZE 1024
+#define HCI_INCOMING_PRE_BUFFER_SIZE 6
+#define MAX_NR_HCI_ACL_RECOMBINATION_BUFFERS 1
+#define NVM_NUM_LINK_KEYS 2
+#define NVM_NUM_DEVICE_DB_ENTRIES 4
+
+#endif
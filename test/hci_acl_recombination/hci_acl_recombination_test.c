@@ -0,0 +1,209 @@
+// *****************************************************************************
+//
+// test ACL recombination with buffers from shared pool
+//
+// *****************************************************************************
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#include "btstack_memory.h"
+#include "btstack_run_loop_posix.h"
+#include "btstack_util.h"
+#include "hci.h"
+#include "hci_dump.h"
+
+#define CLASSIC_HANDLE 0x0003
+#define LE_HANDLE      0x0005
+#define L2CAP_CID      0x0040
+
+static void (*packet_handler)(uint8_t packet_type, uint8_t *packet, uint16_t size);
+
+static int     acl_packets_received;
+static uint8_t acl_packet[4 + HCI_ACL_PAYLOAD_SIZE];
+static uint16_t acl_packet_size;
+
+static int hci_transport_test_can_send_now(uint8_t packet_type){
+    (void) packet_type;
+    return 1;
+}
+
+static int hci_transport_test_send_packet(uint8_t packet_type, uint8_t * packet, int size){
+    (void) packet_type;
+    (void) packet;
+    (void) size;
+    return 0;
+}
+
+static void hci_transport_test_init(const void * transport_config){
+    (void) transport_config;
+}
+
+static int hci_transport_test_open(void){
+    return 0;
+}
+
+static int hci_transport_test_close(void){
+    return 0;
+}
+
+static void hci_transport_test_register_packet_handler(void (*handler)(uint8_t packet_type, uint8_t *packet, uint16_t size)){
+    packet_handler = handler;
+}
+
+static const hci_transport_t hci_transport_test = {
+        /* const char * name; */                                        "TEST",
+        /* void   (*init) (const void *transport_config); */            &hci_transport_test_init,
+        /* int    (*open)(void); */                                     &hci_transport_test_open,
+        /* int    (*close)(void); */                                    &hci_transport_test_close,
+        /* void   (*register_packet_handler)(void (*handler)(...); */   &hci_transport_test_register_packet_handler,
+        /* int    (*can_send_packet_now)(uint8_t packet_type); */       &hci_transport_test_can_send_now,
+        /* int    (*send_packet)(...); */                               &hci_transport_test_send_packet,
+        /* int    (*set_baudrate)(uint32_t baudrate); */                NULL,
+        /* void   (*reset_link)(void); */                               NULL,
+        /* void   (*set_sco_config)(uint16_t voice_setting, int num_connections); */ NULL,
+};
+
+static void acl_packet_handler(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size){
+    (void) channel;
+    if (packet_type != HCI_ACL_DATA_PACKET) return;
+    acl_packets_received++;
+    memcpy(acl_packet, packet, size);
+    acl_packet_size = size;
+}
+
+// send ACL fragment to HCI, first fragment starts with L2CAP header for l2cap_length bytes of payload
+static void send_first_fragment(hci_con_handle_t con_handle, uint16_t l2cap_length, const uint8_t * payload, uint16_t payload_len){
+    uint8_t packet[4 + 4 + HCI_ACL_PAYLOAD_SIZE];
+    little_endian_store_16(packet, 0, con_handle | (0x02 << 12));
+    little_endian_store_16(packet, 2, 4 + payload_len);
+    little_endian_store_16(packet, 4, l2cap_length);
+    little_endian_store_16(packet, 6, L2CAP_CID);
+    memcpy(&packet[8], payload, payload_len);
+    packet_handler(HCI_ACL_DATA_PACKET, packet, 8 + payload_len);
+}
+
+static void send_continuation_fragment(hci_con_handle_t con_handle, const uint8_t * payload, uint16_t payload_len){
+    uint8_t packet[4 + HCI_ACL_PAYLOAD_SIZE];
+    little_endian_store_16(packet, 0, con_handle | (0x01 << 12));
+    little_endian_store_16(packet, 2, payload_len);
+    memcpy(&packet[4], payload, payload_len);
+    packet_handler(HCI_ACL_DATA_PACKET, packet, 4 + payload_len);
+}
+
+static void send_disconnection_complete(hci_con_handle_t con_handle){
+    uint8_t event[6];
+    event[0] = HCI_EVENT_DISCONNECTION_COMPLETE;
+    event[1] = 4;
+    event[2] = ERROR_CODE_SUCCESS;
+    little_endian_store_16(event, 3, con_handle);
+    event[5] = ERROR_CODE_REMOTE_USER_TERMINATED_CONNECTION;
+    packet_handler(HCI_EVENT_PACKET, event, sizeof(event));
+}
+
+// pool has a single buffer, check if it is available without keeping it
+static bool recombination_buffer_available(void){
+    hci_acl_recombination_buffer_t * buffer = btstack_memory_hci_acl_recombination_buffer_get();
+    if (buffer == NULL) return false;
+    btstack_memory_hci_acl_recombination_buffer_free(buffer);
+    return true;
+}
+
+static void check_l2cap_packet(hci_con_handle_t con_handle, const uint8_t * payload, uint16_t payload_len){
+    CHECK_EQUAL(8 + payload_len, acl_packet_size);
+    CHECK_EQUAL(con_handle, little_endian_read_16(acl_packet, 0) & 0x0fff);
+    CHECK_EQUAL(4 + payload_len, little_endian_read_16(acl_packet, 2));
+    CHECK_EQUAL(payload_len, little_endian_read_16(acl_packet, 4));
+    CHECK_EQUAL(L2CAP_CID, little_endian_read_16(acl_packet, 6));
+    MEMCMP_EQUAL(payload, &acl_packet[8], payload_len);
+}
+
+static uint8_t payload[600];
+
+TEST_GROUP(ACLRecombination){
+    void setup(void){
+        static int first = 1;
+        if (first){
+            first = 0;
+            btstack_memory_init();
+            btstack_run_loop_init(btstack_run_loop_posix_get_instance());
+        }
+        int i;
+        for (i = 0; i < (int) sizeof(payload); i++){
+            payload[i] = (uint8_t) i;
+        }
+        acl_packets_received = 0;
+        acl_packet_size = 0;
+        hci_init(&hci_transport_test, NULL);
+        hci_register_acl_packet_handler(&acl_packet_handler);
+        hci_simulate_working_fuzz();
+        hci_setup_test_connections_fuzz();
+    }
+    void teardown(void){
+        hci_free_connections_fuzz();
+    }
+};
+
+TEST(ACLRecombination, SingleFragmentWithoutBuffer){
+    send_first_fragment(LE_HANDLE, 20, payload, 20);
+    CHECK_EQUAL(1, acl_packets_received);
+    check_l2cap_packet(LE_HANDLE, payload, 20);
+    CHECK(recombination_buffer_available());
+}
+
+TEST(ACLRecombination, BufferOnlyWhileReceiving){
+    CHECK(recombination_buffer_available());
+    send_first_fragment(CLASSIC_HANDLE, 600, payload, 200);
+    CHECK_EQUAL(0, acl_packets_received);
+    CHECK(!recombination_buffer_available());
+    send_continuation_fragment(CLASSIC_HANDLE, &payload[200], 200);
+    CHECK_EQUAL(0, acl_packets_received);
+    send_continuation_fragment(CLASSIC_HANDLE, &payload[400], 200);
+    CHECK_EQUAL(1, acl_packets_received);
+    check_l2cap_packet(CLASSIC_HANDLE, payload, 600);
+    CHECK(recombination_buffer_available());
+}
+
+TEST(ACLRecombination, PoolExhausted){
+    // first connection gets the only buffer, packet on second connection is dropped
+    send_first_fragment(CLASSIC_HANDLE, 300, payload, 100);
+    send_first_fragment(LE_HANDLE, 50, payload, 20);
+    send_continuation_fragment(LE_HANDLE, &payload[20], 30);
+    CHECK_EQUAL(0, acl_packets_received);
+    send_continuation_fragment(CLASSIC_HANDLE, &payload[100], 200);
+    CHECK_EQUAL(1, acl_packets_received);
+    check_l2cap_packet(CLASSIC_HANDLE, payload, 300);
+
+    // buffer returned, second connection can receive fragmented packets now
+    send_first_fragment(LE_HANDLE, 50, payload, 20);
+    send_continuation_fragment(LE_HANDLE, &payload[20], 30);
+    CHECK_EQUAL(2, acl_packets_received);
+    check_l2cap_packet(LE_HANDLE, payload, 50);
+    CHECK(recombination_buffer_available());
+}
+
+TEST(ACLRecombination, OversizedContinuationReleasesBuffer){
+    send_first_fragment(CLASSIC_HANDLE, 2000, payload, 600);
+    CHECK(!recombination_buffer_available());
+    send_continuation_fragment(CLASSIC_HANDLE, payload, 600);
+    CHECK_EQUAL(0, acl_packets_received);
+    CHECK(recombination_buffer_available());
+}
+
+TEST(ACLRecombination, DisconnectReleasesBuffer){
+    send_first_fragment(LE_HANDLE, 300, payload, 100);
+    CHECK(!recombination_buffer_available());
+    send_disconnection_complete(LE_HANDLE);
+    CHECK(hci_connection_for_handle(LE_HANDLE) == NULL);
+    CHECK(recombination_buffer_available());
+}
+
+int main (int argc, const char * argv[]){
+    // hci_dump_open("hci_dump.pklg", HCI_DUMP_PACKETLOGGER);
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
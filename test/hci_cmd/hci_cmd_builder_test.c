@@ -0,0 +1,180 @@
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "btstack_util.h"
+#include "hci_cmd.h"
+#include "hci_cmd_builder.h"
+
+#define NUM_RANDOM_ITERATIONS 100
+
+// hci_host_number_of_completed_packets is not compiled in hci_cmd.c, as hci.c creates it for multiple handles
+static const hci_cmd_t host_number_of_completed_packets = {
+    HCI_OPCODE_HCI_HOST_NUMBER_OF_COMPLETED_PACKETS, "1H2"
+};
+
+static uint8_t template_buffer[300];
+static uint8_t builder_buffer[300];
+static uint16_t template_size;
+
+static void create_from_template(const hci_cmd_t * cmd, ...){
+    va_list argptr;
+    va_start(argptr, cmd);
+    template_size = hci_cmd_create_from_template(template_buffer, cmd, argptr);
+    va_end(argptr);
+}
+
+static void CHECK_EQUAL_COMMANDS(uint16_t builder_size){
+    CHECK_EQUAL(template_size, builder_size);
+    int i;
+    for (i=0; i<template_size; i++){
+        if (template_buffer[i] != builder_buffer[i]) {
+            printf("offset %u wrong\n", i);
+            printf("expected: "); printf_hexdump(template_buffer, template_size);
+            printf("actual:   "); printf_hexdump(builder_buffer, template_size);
+        }
+        BYTES_EQUAL(template_buffer[i], builder_buffer[i]);
+    }
+}
+
+static uint8_t random_8(void){
+    return (uint8_t) rand();
+}
+
+static uint16_t random_16(void){
+    return (uint16_t) rand();
+}
+
+static void random_bytes(uint8_t * buffer, uint16_t size){
+    uint16_t i;
+    for (i=0; i<size; i++){
+        buffer[i] = random_8();
+    }
+}
+
+TEST_GROUP(HCICmdBuilder){
+    bd_addr_t address;
+    uint8_t data[31];
+    void setup(void){
+        srand(0);
+        // different fill pattern to detect unwritten bytes
+        memset(template_buffer, 0x55, sizeof(template_buffer));
+        memset(builder_buffer,  0xaa, sizeof(builder_buffer));
+    }
+};
+
+TEST(HCICmdBuilder, Disconnect){
+    int i;
+    for (i=0;i<NUM_RANDOM_ITERATIONS;i++){
+        hci_con_handle_t handle = random_16();
+        uint8_t reason = random_8();
+        create_from_template(&hci_disconnect, handle, reason);
+        CHECK_EQUAL_COMMANDS(hci_cmd_create_disconnect(builder_buffer, handle, reason));
+    }
+}
+
+TEST(HCICmdBuilder, HostNumberOfCompletedPackets){
+    int i;
+    for (i=0;i<NUM_RANDOM_ITERATIONS;i++){
+        hci_con_handle_t handle = random_16();
+        uint16_t num_packets = random_16();
+        create_from_template(&host_number_of_completed_packets, 1, handle, num_packets);
+        CHECK_EQUAL_COMMANDS(hci_cmd_create_host_number_of_completed_packets(builder_buffer, 1, handle, num_packets));
+    }
+}
+
+TEST(HCICmdBuilder, LEConnectionUpdate){
+    int i;
+    for (i=0;i<NUM_RANDOM_ITERATIONS;i++){
+        hci_con_handle_t handle = random_16();
+        uint16_t params[6];
+        int j;
+        for (j=0;j<6;j++){
+            params[j] = random_16();
+        }
+        create_from_template(&hci_le_connection_update, handle, params[0], params[1], params[2], params[3], params[4], params[5]);
+        CHECK_EQUAL_COMMANDS(hci_cmd_create_le_connection_update(builder_buffer, handle, params[0], params[1], params[2], params[3], params[4], params[5]));
+    }
+}
+
+TEST(HCICmdBuilder, LECreateConnection){
+    int i;
+    for (i=0;i<NUM_RANDOM_ITERATIONS;i++){
+        uint16_t params[8];
+        int j;
+        for (j=0;j<8;j++){
+            params[j] = random_16();
+        }
+        uint8_t filter_policy = random_8();
+        uint8_t peer_address_type = random_8();
+        uint8_t own_address_type = random_8();
+        random_bytes(address, 6);
+        create_from_template(&hci_le_create_connection, params[0], params[1], filter_policy, peer_address_type, address, own_address_type,
+                             params[2], params[3], params[4], params[5], params[6], params[7]);
+        CHECK_EQUAL_COMMANDS(hci_cmd_create_le_create_connection(builder_buffer, params[0], params[1], filter_policy, peer_address_type, address, own_address_type,
+                             params[2], params[3], params[4], params[5], params[6], params[7]));
+    }
+}
+
+TEST(HCICmdBuilder, LESetAdvertisingParameters){
+    int i;
+    for (i=0;i<NUM_RANDOM_ITERATIONS;i++){
+        uint16_t interval_min = random_16();
+        uint16_t interval_max = random_16();
+        uint8_t  params[5];
+        random_bytes(params, sizeof(params));
+        random_bytes(address, 6);
+        create_from_template(&hci_le_set_advertising_parameters, interval_min, interval_max, params[0], params[1], params[2], address, params[3], params[4]);
+        CHECK_EQUAL_COMMANDS(hci_cmd_create_le_set_advertising_parameters(builder_buffer, interval_min, interval_max, params[0], params[1], params[2], address, params[3], params[4]));
+    }
+}
+
+TEST(HCICmdBuilder, LESetAdvertisingData){
+    int i;
+    for (i=0;i<NUM_RANDOM_ITERATIONS;i++){
+        uint8_t len = random_8() % 32;
+        random_bytes(data, sizeof(data));
+        create_from_template(&hci_le_set_advertising_data, len, data);
+        CHECK_EQUAL_COMMANDS(hci_cmd_create_le_set_advertising_data(builder_buffer, len, data));
+    }
+}
+
+TEST(HCICmdBuilder, LESetScanResponseData){
+    int i;
+    for (i=0;i<NUM_RANDOM_ITERATIONS;i++){
+        uint8_t len = random_8() % 32;
+        random_bytes(data, sizeof(data));
+        create_from_template(&hci_le_set_scan_response_data, len, data);
+        CHECK_EQUAL_COMMANDS(hci_cmd_create_le_set_scan_response_data(builder_buffer, len, data));
+    }
+}
+
+TEST(HCICmdBuilder, LESetScanParameters){
+    int i;
+    for (i=0;i<NUM_RANDOM_ITERATIONS;i++){
+        uint8_t  scan_type = random_8();
+        uint16_t interval = random_16();
+        uint16_t window = random_16();
+        uint8_t  own_address_type = random_8();
+        uint8_t  filter_policy = random_8();
+        create_from_template(&hci_le_set_scan_parameters, scan_type, interval, window, own_address_type, filter_policy);
+        CHECK_EQUAL_COMMANDS(hci_cmd_create_le_set_scan_parameters(builder_buffer, scan_type, interval, window, own_address_type, filter_policy));
+    }
+}
+
+TEST(HCICmdBuilder, LESetScanEnable){
+    int i;
+    for (i=0;i<NUM_RANDOM_ITERATIONS;i++){
+        uint8_t enable = random_8();
+        uint8_t filter_duplicates = random_8();
+        create_from_template(&hci_le_set_scan_enable, enable, filter_duplicates);
+        CHECK_EQUAL_COMMANDS(hci_cmd_create_le_set_scan_enable(builder_buffer, enable, filter_duplicates));
+    }
+}
+
+int main (int argc, const char * argv[]){
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
@@ -0,0 +1,133 @@
+/*
+ * Copyright (C) 2020 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHIAS
+ * RINGWALD OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+#define BTSTACK_FILE__ "hci_cmd_benchmark.c"
+
+/*
+ *  hci_cmd_benchmark.c
+ *
+ *  Compare time to create HCI Commands with hci_cmd_create_from_template and with hci_cmd_builder.h
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "btstack_util.h"
+#include "hci_cmd.h"
+#include "hci_cmd_builder.h"
+
+#define NUM_ITERATIONS 1000000
+
+static uint8_t  hci_cmd_buffer[300];
+static uint32_t checksum;
+
+static uint64_t get_time_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t) ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+static uint16_t create_from_template(const hci_cmd_t * cmd, ...){
+    va_list argptr;
+    va_start(argptr, cmd);
+    uint16_t size = hci_cmd_create_from_template(hci_cmd_buffer, cmd, argptr);
+    va_end(argptr);
+    return size;
+}
+
+static void report(const char * name, uint64_t template_ns, uint64_t builder_ns){
+    printf("%-32s template %6.1f ns, builder %6.1f ns, speedup %4.1fx\n", name,
+           (double) template_ns / NUM_ITERATIONS, (double) builder_ns / NUM_ITERATIONS, (double) template_ns / (double) builder_ns);
+}
+
+#define BENCHMARK(name, template_call, builder_call)        \
+    do {                                                    \
+        uint32_t i;                                         \
+        uint64_t start_ns = get_time_ns();                  \
+        for (i = 0; i < NUM_ITERATIONS; i++){               \
+            checksum += template_call;                      \
+            checksum += hci_cmd_buffer[i & 0x0f];           \
+        }                                                   \
+        uint64_t template_ns = get_time_ns() - start_ns;    \
+        start_ns = get_time_ns();                           \
+        for (i = 0; i < NUM_ITERATIONS; i++){               \
+            checksum += builder_call;                       \
+            checksum += hci_cmd_buffer[i & 0x0f];           \
+        }                                                   \
+        uint64_t builder_ns = get_time_ns() - start_ns;     \
+        report(name, template_ns, builder_ns);              \
+    } while (0)
+
+int main(void){
+    bd_addr_t address = { 0x11, 0x22, 0x33, 0x44, 0x55, 0x66 };
+    uint8_t   data[31];
+    memset(data, 0x42, sizeof(data));
+
+    BENCHMARK("hci_disconnect",
+              create_from_template(&hci_disconnect, (uint16_t) i, 0x13),
+              hci_cmd_create_disconnect(hci_cmd_buffer, (uint16_t) i, 0x13));
+
+    BENCHMARK("hci_le_connection_update",
+              create_from_template(&hci_le_connection_update, (uint16_t) i, 24, 40, 0, 72, 0, 0xffff),
+              hci_cmd_create_le_connection_update(hci_cmd_buffer, (uint16_t) i, 24, 40, 0, 72, 0, 0xffff));
+
+    BENCHMARK("hci_le_create_connection",
+              create_from_template(&hci_le_create_connection, 0x60, 0x30, 0, 0, address, 0, (uint16_t) i, 40, 0, 72, 2, 0x30),
+              hci_cmd_create_le_create_connection(hci_cmd_buffer, 0x60, 0x30, 0, 0, address, 0, (uint16_t) i, 40, 0, 72, 2, 0x30));
+
+    BENCHMARK("hci_le_set_advertising_data",
+              create_from_template(&hci_le_set_advertising_data, (uint8_t) (i & 0x1f), data),
+              hci_cmd_create_le_set_advertising_data(hci_cmd_buffer, (uint8_t) (i & 0x1f), data));
+
+    BENCHMARK("hci_le_set_advertising_parameters",
+              create_from_template(&hci_le_set_advertising_parameters, (uint16_t) i, 0x0800, 0, 0, 0, address, 0x07, 0),
+              hci_cmd_create_le_set_advertising_parameters(hci_cmd_buffer, (uint16_t) i, 0x0800, 0, 0, 0, address, 0x07, 0));
+
+    BENCHMARK("hci_le_set_scan_parameters",
+              create_from_template(&hci_le_set_scan_parameters, 1, (uint16_t) i, 0x30, 0, 0),
+              hci_cmd_create_le_set_scan_parameters(hci_cmd_buffer, 1, (uint16_t) i, 0x30, 0, 0));
+
+    BENCHMARK("hci_le_set_scan_enable",
+              create_from_template(&hci_le_set_scan_enable, (uint8_t) (i & 1), 0),
+              hci_cmd_create_le_set_scan_enable(hci_cmd_buffer, (uint8_t) (i & 1), 0));
+
+    // print checksum to avoid optimizing away results
+    printf("checksum %08x\n", checksum);
+    return 0;
+}
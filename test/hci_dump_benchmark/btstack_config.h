@@ -0,0 +1,21 @@
+//
+// btstack_config.h for HCI dump benchmark
+//
+
+#ifndef __BTSTACK_CONFIG
+#define __BTSTACK_CONFIG
+
+// Port related features
+#define HAVE_MALLOC
+#define HAVE_POSIX_FILE_IO
+#define HAVE_POSIX_TIME
+
+// BTstack features that can be enabled
+#define ENABLE_LOG_ERROR
+
+// ENABLE_HCI_DUMP_POSIX_ASYNC is set by Makefile
+
+// BTstack configuration. buffers, sizes, ...
+#define HCI_ACL_PAYLOAD_SIZE 1024
+
+#endif
@@ -0,0 +1,160 @@
+/*
+ * Copyright (C) 2020 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHIAS
+ * RINGWALD OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+#define BTSTACK_FILE__ "hci_dump_benchmark.c"
+
+/*
+ *  hci_dump_benchmark.c
+ *
+ *  Measure how long the run loop thread is blocked by hci_dump_packet with logging off and with
+ *  PacketLogger logging to a file. Emulates streaming: every millisecond, a burst of ACL packets and
+ *  a Number Of Completed Packets event is logged. Built with and without ENABLE_HCI_DUMP_POSIX_ASYNC.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#include "bluetooth.h"
+#include "btstack_util.h"
+#include "hci_dump.h"
+#ifdef ENABLE_HCI_DUMP_POSIX_ASYNC
+#include "hci_dump_posix_async.h"
+#endif
+
+#define NUM_BURSTS          2000
+#define PACKETS_PER_BURST   5
+#define ACL_PACKET_SIZE     1021
+#define BURST_INTERVAL_NS   1000000L
+#define MAX_FILE_SIZE       (4 * 1024 * 1024)
+
+#ifdef ENABLE_HCI_DUMP_POSIX_ASYNC
+#define PKLG_PATH "hci_dump_benchmark_async.pklg"
+#else
+#define PKLG_PATH "hci_dump_benchmark.pklg"
+#endif
+
+static uint8_t  acl_packet[ACL_PACKET_SIZE];
+static uint8_t  event_packet[] = { 0x13, 0x05, 0x01, 0x01, 0x00, PACKETS_PER_BURST, 0x00 };
+static uint64_t burst_duration_ns[NUM_BURSTS];
+
+static uint64_t get_time_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t) ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+static int compare_uint64(const void * a, const void * b){
+    uint64_t value_a = *(const uint64_t *) a;
+    uint64_t value_b = *(const uint64_t *) b;
+    if (value_a < value_b) return -1;
+    if (value_a > value_b) return 1;
+    return 0;
+}
+
+static void run_bursts(const char * name){
+    struct timespec interval = { 0, BURST_INTERVAL_NS };
+    int i;
+    for (i = 0; i < NUM_BURSTS; i++){
+        uint64_t start_ns = get_time_ns();
+        int j;
+        for (j = 0; j < PACKETS_PER_BURST; j++){
+            hci_dump_packet(HCI_ACL_DATA_PACKET, 0, acl_packet, sizeof(acl_packet));
+        }
+        hci_dump_packet(HCI_EVENT_PACKET, 1, event_packet, sizeof(event_packet));
+        burst_duration_ns[i] = get_time_ns() - start_ns;
+        nanosleep(&interval, NULL);
+    }
+
+    uint64_t sum_ns = 0;
+    for (i = 0; i < NUM_BURSTS; i++){
+        sum_ns += burst_duration_ns[i];
+    }
+    qsort(burst_duration_ns, NUM_BURSTS, sizeof(uint64_t), &compare_uint64);
+    printf("- %-8s mean %8.2f us, p99 %8.2f us, max %8.2f us per burst of %u packets\n", name,
+           (double) sum_ns / NUM_BURSTS / 1000.0,
+           (double) burst_duration_ns[(NUM_BURSTS * 99) / 100] / 1000.0,
+           (double) burst_duration_ns[NUM_BURSTS - 1] / 1000.0,
+           PACKETS_PER_BURST + 1);
+}
+
+static long get_file_size(const char * path){
+    struct stat st;
+    if (stat(path, &st) != 0) return 0;
+    return (long) st.st_size;
+}
+
+int main(void){
+#ifdef ENABLE_HCI_DUMP_POSIX_ASYNC
+    printf("hci_dump with asynchronous writer thread, max file size %u kB\n", MAX_FILE_SIZE / 1024);
+#else
+    printf("hci_dump with synchronous writes\n");
+#endif
+    memset(acl_packet, 0x55, sizeof(acl_packet));
+    little_endian_store_16(acl_packet, 0, 0x0001);
+    little_endian_store_16(acl_packet, 2, ACL_PACKET_SIZE - 4);
+
+    run_bursts("off:");
+
+    remove(PKLG_PATH);
+    remove(PKLG_PATH ".1");
+#ifdef ENABLE_HCI_DUMP_POSIX_ASYNC
+    hci_dump_posix_async_set_max_file_size(MAX_FILE_SIZE);
+#endif
+    // file name is copied, rotated file must not depend on caller's buffer
+    char path[sizeof(PKLG_PATH)];
+    btstack_strcpy(path, sizeof(path), PKLG_PATH);
+    hci_dump_open(path, HCI_DUMP_PACKETLOGGER);
+    memset(path, 0, sizeof(path));
+    run_bursts("on:");
+#ifdef ENABLE_HCI_DUMP_POSIX_ASYNC
+    uint32_t dropped_packets = hci_dump_posix_async_get_dropped_packets();
+#endif
+    hci_dump_close();
+
+    printf("- file size: %ld bytes", get_file_size(PKLG_PATH));
+#ifdef ENABLE_HCI_DUMP_POSIX_ASYNC
+    printf(", rotated file size: %ld bytes", get_file_size(PKLG_PATH ".1"));
+#endif
+#ifdef ENABLE_HCI_DUMP_POSIX_ASYNC
+    printf(", %u packets dropped", dropped_packets);
+#endif
+    printf("\n");
+    return 0;
+}
@@ -4,6 +4,7 @@
 #include <string.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <math.h>
 
 #include "CppUTest/TestHarness.h"
 #include "CppUTest/CommandLineTestRunner.h"
@@ -367,6 +368,66 @@ TEST(CVSD_PLC, TestSineWave){
     process_wav_file_with_plc("results/sine_test_with_bad_frames.wav", "results/sine_test_with_bad_frames_after_plc.wav");
 }
 
+// normalized cross correlation between template at end of history and y[n], in double precision
+static double pattern_correlation(int16_t * y, int n){
+    double num = 0;
+    double x2  = 0;
+    double y2  = 0;
+    int m;
+    for (m=0;m<CVSD_M;m++){
+        double x_m = y[CVSD_LHIST-CVSD_M+m];
+        double y_m = y[n+m];
+        num += x_m * y_m;
+        x2  += x_m * x_m;
+        y2  += y_m * y_m;
+    }
+    if ((x2 == 0) || (y2 == 0)) return 0;
+    return num / sqrt(x2 * y2);
+}
+
+static int pattern_match_reference(int16_t * y){
+    int bestmatch = 0;
+    int n;
+    for (n=1;n<CVSD_N;n++){
+        if (pattern_correlation(y, n) > pattern_correlation(y, bestmatch)){
+            bestmatch = n;
+        }
+    }
+    return bestmatch;
+}
+
+static void check_pattern_match(int16_t * y){
+    int bestmatch = btstack_cvsd_plc_pattern_match(y);
+    int bestmatch_reference = pattern_match_reference(y);
+    if (bestmatch == bestmatch_reference) return;
+    // only accept different match if correlation is practically the same
+    DOUBLES_EQUAL(pattern_correlation(y, bestmatch_reference), pattern_correlation(y, bestmatch), 1e-5);
+}
+
+TEST(CVSD_PLC, PatternMatch){
+    int16_t history[CVSD_LHIST];
+    int i;
+    int round;
+    srand(1);
+    for (round=0;round<100;round++){
+        // sine with random frequency plus noise
+        double frequency = 100.0 + (rand() % 3000);
+        int noise = rand() % 8000;
+        for (i=0;i<CVSD_LHIST;i++){
+            history[i] = (int16_t) (20000.0 * sin(2.0 * M_PI * frequency * i / 8000.0)) + (noise ? ((rand() % noise) - (noise / 2)) : 0);
+        }
+        check_pattern_match(history);
+    }
+    // full scale square wave
+    for (i=0;i<CVSD_LHIST;i++){
+        history[i] = ((i / 13) & 1) ? 32767 : -32768;
+    }
+    check_pattern_match(history);
+    // silence
+    memset(history, 0, sizeof(history));
+    CHECK_EQUAL(0, btstack_cvsd_plc_pattern_match(history));
+}
+
 int main (int argc, const char * argv[]){
     return CommandLineTestRunner::RunAllTests(argc, argv);
 }
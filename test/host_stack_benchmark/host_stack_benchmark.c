@@ -0,0 +1,652 @@
+/*
+ * Copyright (C) 2020 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHIAS
+ * RINGWALD OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+#define BTSTACK_FILE__ "host_stack_benchmark.c"
+
+/*
+ *  host_stack_benchmark.c
+ *
+ *  Measure throughput and one-way latency of L2CAP, RFCOMM, GATT Notifications and LE Data Channels
+ *  without Bluetooth hardware. Two processes with a complete host stack each are connected via
+ *  the virtual HCI transport: A initiates all connections, B accepts them. For each protocol, the
+ *  sender first transfers BENCHMARK_THROUGHPUT_BYTES as fast as possible and then sends small
+ *  packets with a timestamp every BENCHMARK_LATENCY_INTERVAL_MS. The receiver reports the results.
+ *
+ *  The scenarios are run without air time, to show host stack overhead, and with air time based on
+ *  typical Classic EDR and LE 2M PHY application throughput.
+ */
+
+#include "btstack_config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bluetooth_data_types.h"
+#include "btstack_debug.h"
+#include "btstack_event.h"
+#include "btstack_memory.h"
+#include "btstack_run_loop.h"
+#include "btstack_run_loop_posix.h"
+#include "btstack_util.h"
+#include "ble/att_server.h"
+#include "ble/gatt_client.h"
+#include "ble/le_device_db.h"
+#include "ble/sm.h"
+#include "classic/btstack_link_key_db_memory.h"
+#include "classic/rfcomm.h"
+#include "gap.h"
+#include "hci.h"
+#include "hci_transport.h"
+#include "l2cap.h"
+
+#include "host_stack_benchmark.h"
+
+#define BENCHMARK_L2CAP_PSM              0x1001
+#define BENCHMARK_RFCOMM_CHANNEL         1
+#define BENCHMARK_LE_DATA_CHANNEL_PSM    0x0025
+#define BENCHMARK_LE_DATA_CHANNEL_MTU    1000
+
+#define BENCHMARK_THROUGHPUT_BYTES       (256 * 1024)
+#define BENCHMARK_LATENCY_PACKETS        50
+#define BENCHMARK_LATENCY_PACKET_SIZE    20
+#define BENCHMARK_LATENCY_INTERVAL_MS    10
+#define BENCHMARK_LATENCY_START_MS       100
+#define BENCHMARK_WATCHDOG_MS            60000
+
+#define BENCHMARK_NOTIFICATION_VALUE_HANDLE   ATT_CHARACTERISTIC_0000FF11_0000_1000_8000_00805F9B34FB_01_VALUE_HANDLE
+#define BENCHMARK_NOTIFICATION_CCC_HANDLE     ATT_CHARACTERISTIC_0000FF11_0000_1000_8000_00805F9B34FB_01_CLIENT_CONFIGURATION_HANDLE
+
+// benchmark packet: type, send timestamp in us, filler
+#define BENCHMARK_HEADER_SIZE           9
+
+typedef enum {
+    BENCHMARK_PACKET_THROUGHPUT = 0,
+    BENCHMARK_PACKET_LATENCY,
+    BENCHMARK_PACKET_DONE,
+} benchmark_packet_t;
+
+typedef enum {
+    PROTOCOL_L2CAP = 0,
+    PROTOCOL_RFCOMM,
+    PROTOCOL_GATT,
+    PROTOCOL_LE_DATA_CHANNEL,
+} benchmark_protocol_t;
+
+typedef enum {
+    SENDER_IDLE,
+    SENDER_THROUGHPUT,
+    SENDER_W4_LATENCY_TIMER,
+    SENDER_LATENCY,
+    SENDER_DONE,
+} sender_state_t;
+
+typedef struct {
+    const char * name;
+    uint32_t     acl_air_bit_rate;
+    uint32_t     le_acl_air_bit_rate;
+} benchmark_scenario_t;
+
+static const benchmark_scenario_t benchmark_scenarios[] = {
+    { "host-bound, no air time", 0, 0 },
+    { "air time: Classic 2.1 Mbps, LE 1.4 Mbps", 2100000, 1400000 },
+};
+
+static const char * protocol_names[] = { "L2CAP", "RFCOMM", "GATT", "LE CoC" };
+
+static bd_addr_t device_a_addr = { 0x00, 0x1B, 0xDC, 0x00, 0x00, 0x0A };
+static bd_addr_t device_b_addr = { 0x00, 0x1B, 0xDC, 0x00, 0x00, 0x0B };
+
+// fixed keys, no pairing information is stored
+static sm_key_t benchmark_er = { 0x45, 0x52, 0x20, 0x4B, 0x65, 0x79, 0x20, 0x42, 0x65, 0x6E, 0x63, 0x68, 0x6D, 0x61, 0x72, 0x6B };
+static sm_key_t benchmark_ir = { 0x49, 0x52, 0x20, 0x4B, 0x65, 0x79, 0x20, 0x42, 0x65, 0x6E, 0x63, 0x68, 0x6D, 0x61, 0x72, 0x6B };
+
+static int      is_device_a;
+static bd_addr_t peer_addr;
+static int      ready_fd;
+
+static btstack_packet_callback_registration_t hci_event_callback_registration;
+static btstack_timer_source_t watchdog_timer;
+static gatt_client_notification_t notification_listener;
+
+static hci_con_handle_t classic_con_handle;
+static hci_con_handle_t le_con_handle;
+static uint16_t l2cap_cid;
+static uint16_t rfcomm_cid;
+static uint16_t le_data_channel_cid;
+static uint8_t  le_data_channel_buffer[BENCHMARK_LE_DATA_CHANNEL_MTU];
+
+// sender
+static benchmark_protocol_t   sender_protocol;
+static sender_state_t         sender_state;
+static uint16_t               sender_payload_size;
+static uint32_t               sender_bytes;
+static uint16_t               sender_latency_packets;
+static btstack_timer_source_t sender_timer;
+static uint8_t                sender_buffer[HCI_ACL_PAYLOAD_SIZE];
+
+// receiver
+static uint32_t receiver_bytes;
+static uint64_t receiver_first_send_us;
+static uint64_t receiver_last_receive_us;
+static uint16_t receiver_latency_packets;
+static uint64_t receiver_latency_us[BENCHMARK_LATENCY_PACKETS];
+
+static uint64_t get_time_us(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t) ts.tv_sec * 1000000u) + ((uint64_t) ts.tv_nsec / 1000u);
+}
+
+static int compare_uint64(const void * a, const void * b){
+    uint64_t value_a = *(const uint64_t *) a;
+    uint64_t value_b = *(const uint64_t *) b;
+    if (value_a < value_b) return -1;
+    if (value_a > value_b) return 1;
+    return 0;
+}
+
+// sender
+
+static void sender_request_can_send_now(void){
+    switch (sender_protocol){
+        case PROTOCOL_L2CAP:
+            l2cap_request_can_send_now_event(l2cap_cid);
+            break;
+        case PROTOCOL_RFCOMM:
+            rfcomm_request_can_send_now_event(rfcomm_cid);
+            break;
+        case PROTOCOL_GATT:
+            att_server_request_can_send_now_event(le_con_handle);
+            break;
+        case PROTOCOL_LE_DATA_CHANNEL:
+            l2cap_le_request_can_send_now_event(le_data_channel_cid);
+            break;
+        default:
+            btstack_assert(false);
+            break;
+    }
+}
+
+static void sender_send(benchmark_packet_t type, uint16_t size){
+    sender_buffer[0] = (uint8_t) type;
+    uint64_t now_us = get_time_us();
+    little_endian_store_32(sender_buffer, 1, (uint32_t) now_us);
+    little_endian_store_32(sender_buffer, 5, (uint32_t) (now_us >> 32));
+    switch (sender_protocol){
+        case PROTOCOL_L2CAP:
+            l2cap_send(l2cap_cid, sender_buffer, size);
+            break;
+        case PROTOCOL_RFCOMM:
+            rfcomm_send(rfcomm_cid, sender_buffer, size);
+            break;
+        case PROTOCOL_GATT:
+            att_server_notify(le_con_handle, BENCHMARK_NOTIFICATION_VALUE_HANDLE, sender_buffer, size);
+            break;
+        case PROTOCOL_LE_DATA_CHANNEL:
+            l2cap_le_send_data(le_data_channel_cid, sender_buffer, size);
+            break;
+        default:
+            btstack_assert(false);
+            break;
+    }
+}
+
+static void sender_timer_handler(btstack_timer_source_t * ts){
+    UNUSED(ts);
+    sender_state = SENDER_LATENCY;
+    sender_request_can_send_now();
+}
+
+static void sender_start_latency_timer(uint32_t timeout_ms){
+    sender_state = SENDER_W4_LATENCY_TIMER;
+    btstack_run_loop_set_timer_handler(&sender_timer, &sender_timer_handler);
+    btstack_run_loop_set_timer(&sender_timer, timeout_ms);
+    btstack_run_loop_add_timer(&sender_timer);
+}
+
+static void sender_start(benchmark_protocol_t protocol, uint16_t payload_size){
+    sender_protocol = protocol;
+    sender_payload_size = btstack_min(payload_size, sizeof(sender_buffer));
+    sender_bytes = 0;
+    sender_latency_packets = 0;
+    memset(sender_buffer, 0x55, sizeof(sender_buffer));
+    sender_state = SENDER_THROUGHPUT;
+    sender_request_can_send_now();
+}
+
+static void sender_can_send_now(void){
+    switch (sender_state){
+        case SENDER_THROUGHPUT:
+            sender_send(BENCHMARK_PACKET_THROUGHPUT, sender_payload_size);
+            sender_bytes += sender_payload_size;
+            if (sender_bytes < BENCHMARK_THROUGHPUT_BYTES){
+                sender_request_can_send_now();
+            } else {
+                // let Controller transmit queued packets first
+                sender_start_latency_timer(BENCHMARK_LATENCY_START_MS);
+            }
+            break;
+        case SENDER_LATENCY:
+            sender_send(BENCHMARK_PACKET_LATENCY, BENCHMARK_LATENCY_PACKET_SIZE);
+            sender_latency_packets++;
+            if (sender_latency_packets < BENCHMARK_LATENCY_PACKETS){
+                sender_start_latency_timer(BENCHMARK_LATENCY_INTERVAL_MS);
+            } else {
+                sender_state = SENDER_DONE;
+                sender_request_can_send_now();
+            }
+            break;
+        case SENDER_DONE:
+            sender_send(BENCHMARK_PACKET_DONE, BENCHMARK_HEADER_SIZE);
+            sender_state = SENDER_IDLE;
+            break;
+        default:
+            break;
+    }
+}
+
+// receiver
+
+static void receiver_report(benchmark_protocol_t protocol){
+    uint64_t duration_us = receiver_last_receive_us - receiver_first_send_us;
+    uint64_t sum_us = 0;
+    uint16_t i;
+    for (i=0;i<receiver_latency_packets;i++){
+        sum_us += receiver_latency_us[i];
+    }
+    qsort(receiver_latency_us, receiver_latency_packets, sizeof(uint64_t), &compare_uint64);
+    printf("- %-7s throughput %8.1f kB/s, latency mean %7.1f us, median %7.1f us, max %7.1f us\n",
+           protocol_names[protocol],
+           (duration_us > 0) ? ((double) receiver_bytes * 1000000.0 / 1024.0 / (double) duration_us) : 0.0,
+           (receiver_latency_packets > 0) ? ((double) sum_us / receiver_latency_packets) : 0.0,
+           (receiver_latency_packets > 0) ? (double) receiver_latency_us[receiver_latency_packets / 2] : 0.0,
+           (receiver_latency_packets > 0) ? (double) receiver_latency_us[receiver_latency_packets - 1] : 0.0);
+    fflush(stdout);
+    receiver_bytes = 0;
+    receiver_latency_packets = 0;
+}
+
+// returns true if all data was received
+static bool receiver_handle_data(benchmark_protocol_t protocol, const uint8_t * packet, uint16_t size){
+    if (size < BENCHMARK_HEADER_SIZE){
+        printf("Unexpected packet size %u\n", size);
+        exit(EXIT_FAILURE);
+    }
+    uint64_t now_us = get_time_us();
+    uint64_t send_us = ((uint64_t) little_endian_read_32(packet, 5) << 32) | little_endian_read_32(packet, 1);
+    switch ((benchmark_packet_t) packet[0]){
+        case BENCHMARK_PACKET_THROUGHPUT:
+            if (receiver_bytes == 0){
+                receiver_first_send_us = send_us;
+            }
+            receiver_bytes += size;
+            receiver_last_receive_us = now_us;
+            break;
+        case BENCHMARK_PACKET_LATENCY:
+            if (receiver_latency_packets < BENCHMARK_LATENCY_PACKETS){
+                receiver_latency_us[receiver_latency_packets++] = now_us - send_us;
+            }
+            break;
+        case BENCHMARK_PACKET_DONE:
+            receiver_report(protocol);
+            return true;
+        default:
+            break;
+    }
+    return false;
+}
+
+// device A: initiator
+
+static void device_a_packet_handler(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size){
+    UNUSED(channel);
+    // value has to stay valid until the write is sent
+    static uint8_t ccc_value[2];
+    uint16_t local_cid;
+    uint8_t status;
+
+    switch (packet_type){
+        case L2CAP_DATA_PACKET:
+            // LE Data Channel only
+            if (receiver_handle_data(PROTOCOL_LE_DATA_CHANNEL, packet, size)){
+                l2cap_le_disconnect(le_data_channel_cid);
+            }
+            return;
+        case HCI_EVENT_PACKET:
+            break;
+        default:
+            return;
+    }
+
+    switch (hci_event_packet_get_type(packet)) {
+        case BTSTACK_EVENT_STATE:
+            if (btstack_event_state_get_state(packet) != HCI_STATE_WORKING) break;
+            l2cap_create_channel(&device_a_packet_handler, peer_addr, BENCHMARK_L2CAP_PSM, l2cap_max_mtu(), NULL);
+            break;
+
+        case L2CAP_EVENT_CHANNEL_OPENED:
+            status = l2cap_event_channel_opened_get_status(packet);
+            if (status != ERROR_CODE_SUCCESS){
+                printf("L2CAP connection failed, status 0x%02x\n", status);
+                exit(EXIT_FAILURE);
+            }
+            classic_con_handle = l2cap_event_channel_opened_get_handle(packet);
+            l2cap_cid = l2cap_event_channel_opened_get_local_cid(packet);
+            sender_start(PROTOCOL_L2CAP, l2cap_event_channel_opened_get_remote_mtu(packet));
+            break;
+        case L2CAP_EVENT_CAN_SEND_NOW:
+            sender_can_send_now();
+            break;
+        case L2CAP_EVENT_CHANNEL_CLOSED:
+        case L2CAP_EVENT_LE_CHANNEL_CLOSED:
+            // closed LE Data Channels are also reported by L2CAP_EVENT_CHANNEL_CLOSED, local cid at same offset
+            local_cid = l2cap_event_channel_closed_get_local_cid(packet);
+            if (local_cid == l2cap_cid){
+                l2cap_cid = 0;
+                rfcomm_create_channel(&device_a_packet_handler, peer_addr, BENCHMARK_RFCOMM_CHANNEL, NULL);
+            } else if (local_cid == le_data_channel_cid){
+                le_data_channel_cid = 0;
+                gap_disconnect(le_con_handle);
+            }
+            break;
+
+        case RFCOMM_EVENT_CHANNEL_OPENED:
+            status = rfcomm_event_channel_opened_get_status(packet);
+            if (status != ERROR_CODE_SUCCESS){
+                printf("RFCOMM connection failed, status 0x%02x\n", status);
+                exit(EXIT_FAILURE);
+            }
+            rfcomm_cid = rfcomm_event_channel_opened_get_rfcomm_cid(packet);
+            sender_start(PROTOCOL_RFCOMM, rfcomm_event_channel_opened_get_max_frame_size(packet));
+            break;
+        case RFCOMM_EVENT_CAN_SEND_NOW:
+            sender_can_send_now();
+            break;
+        case RFCOMM_EVENT_CHANNEL_CLOSED:
+            gap_disconnect(classic_con_handle);
+            break;
+
+        case HCI_EVENT_DISCONNECTION_COMPLETE:
+            if (hci_event_disconnection_complete_get_connection_handle(packet) == classic_con_handle){
+                classic_con_handle = HCI_CON_HANDLE_INVALID;
+                gap_connect(peer_addr, BD_ADDR_TYPE_LE_PUBLIC);
+            } else if (hci_event_disconnection_complete_get_connection_handle(packet) == le_con_handle){
+                exit(EXIT_SUCCESS);
+            }
+            break;
+
+        case HCI_EVENT_LE_META:
+            if (hci_event_le_meta_get_subevent_code(packet) != HCI_SUBEVENT_LE_CONNECTION_COMPLETE) break;
+            status = hci_subevent_le_connection_complete_get_status(packet);
+            if (status != ERROR_CODE_SUCCESS){
+                printf("LE connection failed, status 0x%02x\n", status);
+                exit(EXIT_FAILURE);
+            }
+            le_con_handle = hci_subevent_le_connection_complete_get_connection_handle(packet);
+            // enable notifications, MTU is exchanged first
+            gatt_client_listen_for_characteristic_value_updates(&notification_listener, &device_a_packet_handler, le_con_handle, NULL);
+            little_endian_store_16(ccc_value, 0, GATT_CLIENT_CHARACTERISTICS_CONFIGURATION_NOTIFICATION);
+            gatt_client_write_value_of_characteristic(&device_a_packet_handler, le_con_handle, BENCHMARK_NOTIFICATION_CCC_HANDLE, sizeof(ccc_value), ccc_value);
+            break;
+
+        case GATT_EVENT_NOTIFICATION:
+            if (receiver_handle_data(PROTOCOL_GATT, gatt_event_notification_get_value(packet), gatt_event_notification_get_value_length(packet))){
+                l2cap_le_create_channel(&device_a_packet_handler, le_con_handle, BENCHMARK_LE_DATA_CHANNEL_PSM, le_data_channel_buffer,
+                                        sizeof(le_data_channel_buffer), L2CAP_LE_AUTOMATIC_CREDITS, LEVEL_0, &le_data_channel_cid);
+            }
+            break;
+
+        case L2CAP_EVENT_LE_CHANNEL_OPENED:
+            status = l2cap_event_le_channel_opened_get_status(packet);
+            if (status != ERROR_CODE_SUCCESS){
+                printf("LE Data Channel connection failed, status 0x%02x\n", status);
+                exit(EXIT_FAILURE);
+            }
+            sender_start(PROTOCOL_LE_DATA_CHANNEL, l2cap_event_le_channel_opened_get_remote_mtu(packet));
+            break;
+        case L2CAP_EVENT_LE_CAN_SEND_NOW:
+            sender_can_send_now();
+            break;
+
+        default:
+            break;
+    }
+}
+
+// device B: acceptor
+
+static const uint8_t adv_data[] = { 0x02, BLUETOOTH_DATA_TYPE_FLAGS, 0x06 };
+
+static int device_b_att_write_callback(hci_con_handle_t con_handle, uint16_t attribute_handle, uint16_t transaction_mode,
+                                       uint16_t offset, uint8_t *buffer, uint16_t buffer_size){
+    UNUSED(transaction_mode);
+    UNUSED(offset);
+    if (attribute_handle != BENCHMARK_NOTIFICATION_CCC_HANDLE) return 0;
+    if (buffer_size < 2) return 0;
+    if (little_endian_read_16(buffer, 0) != GATT_CLIENT_CHARACTERISTICS_CONFIGURATION_NOTIFICATION) return 0;
+    le_con_handle = con_handle;
+    sender_start(PROTOCOL_GATT, att_server_get_mtu(con_handle) - 3);
+    return 0;
+}
+
+static void device_b_packet_handler(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size){
+    UNUSED(channel);
+    bd_addr_t null_addr;
+    uint8_t ready = 1;
+
+    switch (packet_type){
+        case L2CAP_DATA_PACKET:
+            if (channel == l2cap_cid){
+                if (receiver_handle_data(PROTOCOL_L2CAP, packet, size)){
+                    l2cap_disconnect(l2cap_cid, 0);
+                }
+            } else if (channel == le_data_channel_cid){
+                if (receiver_handle_data(PROTOCOL_LE_DATA_CHANNEL, packet, size)){
+                    l2cap_le_disconnect(le_data_channel_cid);
+                }
+            }
+            return;
+        case RFCOMM_DATA_PACKET:
+            if (receiver_handle_data(PROTOCOL_RFCOMM, packet, size)){
+                rfcomm_disconnect(rfcomm_cid);
+            }
+            return;
+        case HCI_EVENT_PACKET:
+            break;
+        default:
+            return;
+    }
+
+    switch (hci_event_packet_get_type(packet)) {
+        case BTSTACK_EVENT_STATE:
+            if (btstack_event_state_get_state(packet) != HCI_STATE_WORKING) break;
+            memset(null_addr, 0, sizeof(null_addr));
+            gap_advertisements_set_params(0x0030, 0x0030, 0, 0, null_addr, 0x07, 0x00);
+            gap_advertisements_set_data(sizeof(adv_data), (uint8_t *) adv_data);
+            gap_advertisements_enable(1);
+            // let device A connect
+            if (write(ready_fd, &ready, 1) != 1){
+                exit(EXIT_FAILURE);
+            }
+            break;
+
+        case L2CAP_EVENT_INCOMING_CONNECTION:
+            l2cap_cid = l2cap_event_incoming_connection_get_local_cid(packet);
+            l2cap_accept_connection(l2cap_cid);
+            break;
+        case L2CAP_EVENT_CHANNEL_CLOSED:
+            // local cid can be reused for LE Data Channel
+            if (l2cap_event_channel_closed_get_local_cid(packet) == l2cap_cid){
+                l2cap_cid = 0;
+            }
+            break;
+        case RFCOMM_EVENT_INCOMING_CONNECTION:
+            rfcomm_cid = rfcomm_event_incoming_connection_get_rfcomm_cid(packet);
+            rfcomm_accept_connection(rfcomm_cid);
+            break;
+        case L2CAP_EVENT_LE_INCOMING_CONNECTION:
+            le_data_channel_cid = l2cap_event_le_incoming_connection_get_local_cid(packet);
+            l2cap_le_accept_connection(le_data_channel_cid, le_data_channel_buffer, sizeof(le_data_channel_buffer), L2CAP_LE_AUTOMATIC_CREDITS);
+            break;
+
+        case ATT_EVENT_CAN_SEND_NOW:
+            sender_can_send_now();
+            break;
+
+        case HCI_EVENT_DISCONNECTION_COMPLETE:
+            if (hci_event_disconnection_complete_get_connection_handle(packet) == le_con_handle){
+                exit(EXIT_SUCCESS);
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+static void watchdog_timer_handler(btstack_timer_source_t * ts){
+    UNUSED(ts);
+    printf("Device %c: benchmark did not complete\n", is_device_a ? 'A' : 'B');
+    exit(EXIT_FAILURE);
+}
+
+static void run_device(const benchmark_scenario_t * scenario, int link_fd){
+    static hci_transport_config_virtual_t config;
+    config.type = HCI_TRANSPORT_CONFIG_VIRTUAL;
+    config.link_fd = link_fd;
+    config.acl_air_bit_rate = scenario->acl_air_bit_rate;
+    config.le_acl_air_bit_rate = scenario->le_acl_air_bit_rate;
+    bd_addr_copy(config.bd_addr, is_device_a ? device_a_addr : device_b_addr);
+    bd_addr_copy(peer_addr, is_device_a ? device_b_addr : device_a_addr);
+    classic_con_handle = HCI_CON_HANDLE_INVALID;
+    le_con_handle = HCI_CON_HANDLE_INVALID;
+
+    btstack_memory_init();
+    btstack_run_loop_init(btstack_run_loop_posix_get_instance());
+    hci_init(hci_transport_virtual_instance(), &config);
+    hci_set_link_key_db(btstack_link_key_db_memory_instance());
+
+    btstack_packet_handler_t packet_handler = is_device_a ? &device_a_packet_handler : &device_b_packet_handler;
+    hci_event_callback_registration.callback = packet_handler;
+    hci_add_event_handler(&hci_event_callback_registration);
+
+    l2cap_init();
+    rfcomm_init();
+    le_device_db_init();
+    sm_init();
+    sm_set_er(benchmark_er);
+    sm_set_ir(benchmark_ir);
+    gatt_client_init();
+    att_server_init(profile_data, NULL, is_device_a ? NULL : &device_b_att_write_callback);
+    att_server_register_packet_handler(packet_handler);
+
+    if (!is_device_a){
+        l2cap_register_service(packet_handler, BENCHMARK_L2CAP_PSM, l2cap_max_mtu(), gap_get_security_level());
+        rfcomm_register_service(packet_handler, BENCHMARK_RFCOMM_CHANNEL, 0xffff);
+        l2cap_le_register_service(packet_handler, BENCHMARK_LE_DATA_CHANNEL_PSM, LEVEL_0);
+    }
+
+    btstack_run_loop_set_timer_handler(&watchdog_timer, &watchdog_timer_handler);
+    btstack_run_loop_set_timer(&watchdog_timer, BENCHMARK_WATCHDOG_MS);
+    btstack_run_loop_add_timer(&watchdog_timer);
+
+    hci_power_control(HCI_POWER_ON);
+    btstack_run_loop_execute();
+}
+
+static int run_scenario(const benchmark_scenario_t * scenario){
+    int link_fds[2];
+    int ready_fds[2];
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, link_fds) != 0) return -1;
+    if (pipe(ready_fds) != 0) return -1;
+
+    printf("%s\n", scenario->name);
+    fflush(stdout);
+
+    pid_t device_b = fork();
+    if (device_b == 0){
+        close(link_fds[0]);
+        close(ready_fds[0]);
+        is_device_a = 0;
+        ready_fd = ready_fds[1];
+        run_device(scenario, link_fds[1]);
+        exit(EXIT_FAILURE);
+    }
+
+    pid_t device_a = fork();
+    if (device_a == 0){
+        close(link_fds[1]);
+        close(ready_fds[1]);
+        is_device_a = 1;
+        // wait until device B is up
+        uint8_t ready;
+        if (read(ready_fds[0], &ready, 1) != 1){
+            exit(EXIT_FAILURE);
+        }
+        run_device(scenario, link_fds[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    close(link_fds[0]);
+    close(link_fds[1]);
+    close(ready_fds[0]);
+    close(ready_fds[1]);
+
+    int result = 0;
+    int status;
+    if ((waitpid(device_a, &status, 0) < 0) || !WIFEXITED(status) || (WEXITSTATUS(status) != EXIT_SUCCESS)) result = -1;
+    if ((waitpid(device_b, &status, 0) < 0) || !WIFEXITED(status) || (WEXITSTATUS(status) != EXIT_SUCCESS)) result = -1;
+    return result;
+}
+
+int main(void){
+    printf("Host stack benchmark: %u kB throughput and %u packets latency per protocol, latency is one-way\n",
+           BENCHMARK_THROUGHPUT_BYTES / 1024, BENCHMARK_LATENCY_PACKETS);
+    unsigned int i;
+    for (i = 0; i < (sizeof(benchmark_scenarios) / sizeof(benchmark_scenarios[0])); i++){
+        if (run_scenario(&benchmark_scenarios[i]) != 0){
+            printf("Benchmark failed\n");
+            return EXIT_FAILURE;
+        }
+    }
+    return EXIT_SUCCESS;
+}
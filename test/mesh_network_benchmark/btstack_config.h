@@ -0,0 +1,31 @@
+//
+// btstack_config.h for mesh network benchmark
+//
+
+#ifndef __BTSTACK_CONFIG
+#define __BTSTACK_CONFIG
+
+// Port related features
+#define HAVE_MALLOC
+#define HAVE_POSIX_TIME
+
+// BTstack features that can be enabled
+#define ENABLE_BLE
+#define ENABLE_LOG_ERROR
+#define ENABLE_SOFTWARE_AES128
+
+// Mesh Config
+#define ENABLE_MESH
+#define ENABLE_MESH_ADV_BEARER
+#define ENABLE_MESH_RELAY
+
+// BTstack configuration. buffers, sizes, ...
+#define HCI_ACL_PAYLOAD_SIZE 52
+
+#define MAX_NR_MESH_TRANSPORT_KEYS    16
+#define MAX_NR_MESH_SUBNETS            2
+#define MAX_NR_MESH_NETWORK_KEYS      (MAX_NR_MESH_SUBNETS+1)
+
+// MESH_NETWORK_CACHE_SIZE is set by Makefile
+
+#endif
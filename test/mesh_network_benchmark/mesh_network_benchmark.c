@@ -0,0 +1,243 @@
+/*
+ * Copyright (C) 2020 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHIAS
+ * RINGWALD OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+#define BTSTACK_FILE__ "mesh_network_benchmark.c"
+
+/*
+ *  mesh_network_benchmark.c
+ *
+ *  Measure receive path of mesh_network for new and duplicate Network PDUs
+ *  with a network cache of MESH_NETWORK_CACHE_SIZE entries.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "btstack_crypto.h"
+#include "btstack_memory.h"
+#include "btstack_util.h"
+#include "hci.h"
+#include "mesh/adv_bearer.h"
+#include "mesh/mesh_foundation.h"
+#include "mesh/mesh_keys.h"
+#include "mesh/mesh_network.h"
+#include "mesh/mesh_node.h"
+
+#define NUM_SOURCES     64
+#define NUM_MEASURED    20000
+
+// warm up with MESH_NETWORK_CACHE_SIZE PDUs, measure with NUM_MEASURED new PDUs
+#define NUM_PDUS (MESH_NETWORK_CACHE_SIZE + NUM_MEASURED)
+
+static btstack_packet_handler_t adv_packet_handler;
+
+static uint8_t  pdus[NUM_PDUS][29];
+static uint8_t  pdu_lens[NUM_PDUS];
+static int      pdu_sent;
+static uint32_t pdus_received;
+
+static uint64_t get_time_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t) ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+static int parse_hex(uint8_t * buffer, const char * hex_string){
+    int len = 0;
+    while (*hex_string){
+        int high_nibble = nibble_for_char(*hex_string++);
+        int low_nibble  = nibble_for_char(*hex_string++);
+        *buffer++ = (uint8_t) ((high_nibble << 4) | low_nibble);
+        len++;
+    }
+    return len;
+}
+
+// HCI mock: not used with software AES128
+void hci_add_event_handler(btstack_packet_callback_registration_t * callback_handler){
+    UNUSED(callback_handler);
+}
+
+HCI_STATE hci_get_state(void){
+    return HCI_STATE_WORKING;
+}
+
+int hci_can_send_command_packet_now(void){
+    return 1;
+}
+
+void hci_halting_defer(void){
+}
+
+int hci_send_cmd(const hci_cmd_t * cmd, ...){
+    printf("Unexpected HCI Command 0x%04x\n", cmd->opcode);
+    exit(EXIT_FAILURE);
+}
+
+// ADV Bearer mock: Network PDUs are sent immediately and stored for the receive benchmark
+void adv_bearer_register_for_network_pdu(btstack_packet_handler_t packet_handler){
+    adv_packet_handler = packet_handler;
+}
+
+static void adv_bearer_emit_event(uint8_t subevent){
+    uint8_t event[3];
+    event[0] = HCI_EVENT_MESH_META;
+    event[1] = 1;
+    event[2] = subevent;
+    (*adv_packet_handler)(HCI_EVENT_PACKET, 0, &event[0], sizeof(event));
+}
+
+void adv_bearer_request_can_send_now_for_network_pdu(void){
+    adv_bearer_emit_event(MESH_SUBEVENT_CAN_SEND_NOW);
+}
+
+void adv_bearer_send_network_pdu(const uint8_t * network_pdu, uint16_t size, uint8_t count, uint16_t interval){
+    UNUSED(count);
+    UNUSED(interval);
+    memcpy(pdus[pdu_sent], network_pdu, size);
+    pdu_lens[pdu_sent] = (uint8_t) size;
+    pdu_sent++;
+}
+
+static void higher_layer_handler(mesh_network_callback_type_t callback_type, mesh_network_pdu_t * network_pdu){
+    switch (callback_type){
+        case MESH_NETWORK_PDU_RECEIVED:
+            pdus_received++;
+            mesh_network_message_processed_by_higher_layer(network_pdu);
+            break;
+        default:
+            break;
+    }
+}
+
+static void setup_network_key(void){
+    mesh_network_key_t * network_key = btstack_memory_mesh_network_key_get();
+    network_key->nid = 0x68;
+    parse_hex(network_key->encryption_key, "0953fa93e7caac9638f58820220a398e");
+    parse_hex(network_key->privacy_key,    "8b84eedec100067d670971dd2aa700cf");
+    mesh_network_key_add(network_key);
+    mesh_subnet_setup_for_netkey_index(network_key->netkey_index);
+}
+
+// encrypt Network PDUs from NUM_SOURCES nodes to this node via mesh_network_send_pdu
+static void create_network_pdus(void){
+    static const uint8_t transport_pdu_data[] = { 0x66, 0x75, 0x34, 0x22, 0x00, 0x05, 0x55, 0xaa, 0x11, 0x22, 0x33, 0x44};
+    mesh_network_pdu_t * network_pdu = btstack_memory_mesh_network_pdu_get();
+    int i;
+    for (i = 0; i < NUM_PDUS; i++){
+        uint16_t src = (uint16_t) (0x0100 + (i % NUM_SOURCES));
+        uint32_t seq = (uint32_t) (1 + (i / NUM_SOURCES));
+        mesh_network_setup_pdu(network_pdu, 0, 0x68, 0, 0, seq, src, mesh_node_get_primary_element_address(),
+                               transport_pdu_data, sizeof(transport_pdu_data));
+        mesh_network_send_pdu(network_pdu);
+        adv_bearer_emit_event(MESH_SUBEVENT_MESSAGE_SENT);
+        if (pdu_sent != (i + 1)){
+            printf("Network PDU %u not sent\n", i);
+            exit(EXIT_FAILURE);
+        }
+    }
+    btstack_memory_mesh_network_pdu_free(network_pdu);
+}
+
+static void receive(int first, int count){
+    int i;
+    for (i = first; i < first + count; i++){
+        mesh_network_received_message(pdus[i], pdu_lens[i], 0);
+    }
+}
+
+static void benchmark_receive(const char * name, int first, int count, uint32_t expected_received){
+    uint32_t received_before = pdus_received;
+    uint64_t start_ns = get_time_ns();
+    receive(first, count);
+    uint64_t duration_ns = get_time_ns() - start_ns;
+    if ((pdus_received - received_before) != expected_received){
+        printf("%s: %u of %u PDUs forwarded to higher layer\n", name, pdus_received - received_before, expected_received);
+        exit(EXIT_FAILURE);
+    }
+    printf("- %-10s %7.1f ns per Network PDU\n", name, (double) duration_ns / count);
+}
+
+// reference: linear scan as used before for network cache lookup
+static void benchmark_linear_scan(void){
+    static uint32_t cache[MESH_NETWORK_CACHE_SIZE];
+    int i;
+    for (i = 0; i < MESH_NETWORK_CACHE_SIZE; i++){
+        cache[i] = (uint32_t) (0x01000000u + i);
+    }
+    volatile uint32_t hash = 0x00010000u;
+    uint32_t found = 0;
+    uint64_t start_ns = get_time_ns();
+    int iteration;
+    for (iteration = 0; iteration < NUM_MEASURED; iteration++){
+        for (i = 0; i < MESH_NETWORK_CACHE_SIZE; i++){
+            if (cache[i] == hash) {
+                found++;
+                break;
+            }
+        }
+    }
+    uint64_t duration_ns = get_time_ns() - start_ns;
+    printf("- %-10s %7.1f ns per lookup (linear scan reference, %u found)\n", "miss", (double) duration_ns / NUM_MEASURED, found);
+}
+
+int main(void){
+    printf("Mesh Network Cache with %u entries\n", MESH_NETWORK_CACHE_SIZE);
+
+    btstack_memory_init();
+    btstack_crypto_init();
+    mesh_network_init();
+    mesh_network_key_init();
+    mesh_network_set_higher_layer_handler(&higher_layer_handler);
+    mesh_node_primary_element_address_set(0x0001);
+    setup_network_key();
+
+    create_network_pdus();
+
+    // fill cache
+    receive(0, MESH_NETWORK_CACHE_SIZE);
+
+    // new PDUs evict oldest entries, last MESH_NETWORK_CACHE_SIZE PDUs remain in cache
+    benchmark_receive("new:", MESH_NETWORK_CACHE_SIZE, NUM_MEASURED, NUM_MEASURED);
+    int num_duplicates = btstack_min(MESH_NETWORK_CACHE_SIZE, NUM_MEASURED);
+    benchmark_receive("duplicate:", NUM_PDUS - num_duplicates, num_duplicates, 0);
+
+    benchmark_linear_scan();
+    return 0;
+}
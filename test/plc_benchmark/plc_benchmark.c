@@ -0,0 +1,188 @@
+/*
+ * Copyright (C) 2020 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHIAS
+ * RINGWALD OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+#define BTSTACK_FILE__ "plc_benchmark.c"
+
+/*
+ *  plc_benchmark.c
+ *
+ *  Measure processing time of the first bad frame for CVSD and SBC PLC, which includes pattern matching
+ *  over the full history. Compares pattern matching against the previous float implementation with
+ *  per-lag square root approximation and counts how often both pick the same lag.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "btstack_cvsd_plc.h"
+#include "btstack_sbc_plc.h"
+
+#define NUM_ROUNDS      2000
+
+static btstack_cvsd_plc_state_t cvsd_plc_state;
+static btstack_sbc_plc_state_t  sbc_plc_state;
+
+static uint64_t get_time_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t) ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+// previous implementation
+static float sqrt3(const float x){
+    union {
+        int i;
+        float x;
+    } u;
+    u.x = x;
+    u.i = (1<<29) + (u.i >> 1) - (1<<22);
+    u.x =       u.x + (x/u.x);
+    u.x = (0.25f*u.x) + (x/u.x);
+    return u.x;
+}
+
+static float reference_cross_correlation(const int16_t *x, const int16_t *y, int template_length){
+    float num = 0;
+    float x2 = 0;
+    float y2 = 0;
+    int   m;
+    for (m=0;m<template_length;m++){
+        num+=((float)x[m])*y[m];
+        x2+=((float)x[m])*x[m];
+        y2+=((float)y[m])*y[m];
+    }
+    return num/sqrt3(x2*y2);
+}
+
+static int reference_pattern_match(const int16_t *y, int history_length, int window_length, int template_length){
+    float maxCn = -999999.0;
+    int   bestmatch = 0;
+    int   n;
+    for (n=0;n<window_length;n++){
+        float Cn = reference_cross_correlation(&y[history_length-template_length], &y[n], template_length);
+        if (Cn>maxCn){
+            bestmatch=n;
+            maxCn = Cn;
+        }
+    }
+    return bestmatch;
+}
+
+// speech-like test signal: two harmonics with slowly changing pitch plus noise
+static void fill_history(int16_t * history, int num_samples, int sample_rate, int round){
+    double pitch = 120.0 + (round % 50) * 4.0;
+    int i;
+    for (i=0;i<num_samples;i++){
+        double t = (double) i / sample_rate;
+        double value = 9000.0 * sin(2.0 * M_PI * pitch * t) + 5000.0 * sin(2.0 * M_PI * 3.0 * pitch * t + round);
+        history[i] = (int16_t) (value + (rand() % 2000) - 1000);
+    }
+}
+
+static void report(const char * name, uint64_t duration_ns, int num_equal){
+    printf("- %-28s %7.2f us per frame", name, (double) duration_ns / NUM_ROUNDS / 1000.0);
+    if (num_equal >= 0){
+        printf(", same lag as previous implementation in %u of %u frames", num_equal, NUM_ROUNDS);
+    }
+    printf("\n");
+}
+
+static void benchmark_cvsd(void){
+    int16_t out[CVSD_FS];
+    uint64_t reference_ns = 0;
+    uint64_t bad_frame_ns = 0;
+    int num_equal = 0;
+    int round;
+    for (round=0;round<NUM_ROUNDS;round++){
+        btstack_cvsd_plc_init(&cvsd_plc_state);
+        fill_history(cvsd_plc_state.hist, CVSD_LHIST, 8000, round);
+
+        uint64_t start_ns = get_time_ns();
+        int reference_lag = reference_pattern_match(cvsd_plc_state.hist, CVSD_LHIST, CVSD_N, CVSD_M);
+        reference_ns += get_time_ns() - start_ns;
+
+        if (btstack_cvsd_plc_pattern_match(cvsd_plc_state.hist) == reference_lag){
+            num_equal++;
+        }
+
+        start_ns = get_time_ns();
+        btstack_cvsd_plc_bad_frame(&cvsd_plc_state, CVSD_FS, out);
+        bad_frame_ns += get_time_ns() - start_ns;
+    }
+    report("CVSD pattern match, previous:", reference_ns, -1);
+    report("CVSD first bad frame:", bad_frame_ns, num_equal);
+}
+
+static void benchmark_sbc(void){
+    int16_t zir[SBC_FS];
+    int16_t out[SBC_FS];
+    uint64_t reference_ns = 0;
+    uint64_t bad_frame_ns = 0;
+    int num_equal = 0;
+    int round;
+    memset(zir, 0, sizeof(zir));
+    for (round=0;round<NUM_ROUNDS;round++){
+        btstack_sbc_plc_init(&sbc_plc_state);
+        fill_history(sbc_plc_state.hist, SBC_LHIST, 16000, round);
+
+        uint64_t start_ns = get_time_ns();
+        int reference_lag = reference_pattern_match(sbc_plc_state.hist, SBC_LHIST, SBC_N, SBC_M);
+        reference_ns += get_time_ns() - start_ns;
+
+        start_ns = get_time_ns();
+        btstack_sbc_plc_bad_frame(&sbc_plc_state, zir, out);
+        bad_frame_ns += get_time_ns() - start_ns;
+
+        // bestlag points to the samples following the matched template
+        if ((sbc_plc_state.bestlag - SBC_M) == reference_lag){
+            num_equal++;
+        }
+    }
+    report("SBC pattern match, previous:", reference_ns, -1);
+    report("SBC first bad frame:", bad_frame_ns, num_equal);
+}
+
+int main(void){
+    srand(1);
+    printf("Processing time for first bad frame after good history, %u rounds\n", NUM_ROUNDS);
+    benchmark_cvsd();
+    benchmark_sbc();
+    return 0;
+}
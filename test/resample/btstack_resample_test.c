@@ -0,0 +1,167 @@
+#include <math.h>
+#include <string.h>
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+#include "btstack_resample.h"
+
+#define SAMPLE_RATE         44100
+#define NUM_INPUT_FRAMES    8192
+#define MAX_OUTPUT_FRAMES   (NUM_INPUT_FRAMES * 2)
+#define NUM_SKIPPED_FRAMES  32
+#define AMPLITUDE           16000.0
+
+// polyphase filter is centered between taps 7 and 8, with 15 frames history
+#define POLYPHASE_DELAY     (BTSTACK_RESAMPLE_POLYPHASE_TAPS / 2)
+
+static int16_t input_buffer[NUM_INPUT_FRAMES * 2];
+static int16_t output_buffer[MAX_OUTPUT_FRAMES * 2];
+static int16_t output_mono[2][MAX_OUTPUT_FRAMES];
+static int16_t channel_buffer[NUM_INPUT_FRAMES];
+
+static double reference_sample(double frequency, double position){
+    return AMPLITUDE * sin(2.0 * M_PI * frequency * position / SAMPLE_RATE);
+}
+
+static void fill_sine(double frequency, int num_channels){
+    int i;
+    for (i=0;i<NUM_INPUT_FRAMES;i++){
+        int c;
+        for (c=0;c<num_channels;c++){
+            // second channel with different phase
+            input_buffer[i * num_channels + c] = (int16_t) lrint(reference_sample(frequency, i + (c * 3.5)));
+        }
+    }
+}
+
+// process input in blocks of varying size, returns number of output frames
+static uint32_t resample(btstack_resample_t * context, const int16_t * input, int num_channels, int16_t * output){
+    static const uint32_t block_sizes[] = { 128, 7, 256, 1, 31, 512, 15, 16 };
+    uint32_t input_pos = 0;
+    uint32_t output_frames = 0;
+    int block = 0;
+    while (input_pos < NUM_INPUT_FRAMES){
+        uint32_t num_frames = block_sizes[block++ % (sizeof(block_sizes) / sizeof(uint32_t))];
+        if ((input_pos + num_frames) > NUM_INPUT_FRAMES){
+            num_frames = NUM_INPUT_FRAMES - input_pos;
+        }
+        output_frames += btstack_resample_block(context, &input[input_pos * num_channels], num_frames, &output[output_frames * num_channels]);
+        input_pos += num_frames;
+    }
+    return output_frames;
+}
+
+// SNR of resampled sine compared to ideal sine at output positions
+static double resample_snr(btstack_resample_mode_t mode, double frequency, uint32_t factor){
+    btstack_resample_t context;
+    btstack_resample_init(&context, 1);
+    btstack_resample_set_mode(&context, mode);
+    btstack_resample_set_factor(&context, factor);
+    fill_sine(frequency, 1);
+    uint32_t num_output_frames = resample(&context, input_buffer, 1, output_buffer);
+    double delay = (mode == BTSTACK_RESAMPLE_MODE_POLYPHASE) ? POLYPHASE_DELAY : 0;
+    double signal = 0;
+    double noise  = 0;
+    uint32_t i;
+    // skip start-up and end, where the reference would need input beyond the test signal
+    for (i=NUM_SKIPPED_FRAMES;i<(num_output_frames - NUM_SKIPPED_FRAMES);i++){
+        double reference = reference_sample(frequency, ((i * (double) factor) / 65536.0) - delay);
+        double error = output_buffer[i] - reference;
+        signal += reference * reference;
+        noise  += error * error;
+    }
+    return 10.0 * log10(signal / noise);
+}
+
+// stereo uses SIMD if available, mono the generic implementation
+static void check_stereo_matches_mono(btstack_resample_mode_t mode, uint32_t factor){
+    btstack_resample_t context;
+    uint32_t num_frames[2];
+    int c;
+    fill_sine(3000.0, 2);
+    for (c=0;c<2;c++){
+        int i;
+        for (i=0;i<NUM_INPUT_FRAMES;i++){
+            channel_buffer[i] = input_buffer[i * 2 + c];
+        }
+        btstack_resample_init(&context, 1);
+        btstack_resample_set_mode(&context, mode);
+        btstack_resample_set_factor(&context, factor);
+        num_frames[c] = resample(&context, channel_buffer, 1, output_mono[c]);
+    }
+    btstack_resample_init(&context, 2);
+    btstack_resample_set_mode(&context, mode);
+    btstack_resample_set_factor(&context, factor);
+    uint32_t num_stereo_frames = resample(&context, input_buffer, 2, output_buffer);
+    CHECK_EQUAL(num_frames[0], num_stereo_frames);
+    CHECK_EQUAL(num_frames[1], num_stereo_frames);
+    uint32_t i;
+    for (i=0;i<num_stereo_frames;i++){
+        CHECK_EQUAL(output_mono[0][i], output_buffer[i * 2]);
+        CHECK_EQUAL(output_mono[1][i], output_buffer[i * 2 + 1]);
+    }
+}
+
+TEST_GROUP(Resample){
+};
+
+TEST(Resample, LinearIdentity){
+    btstack_resample_t context;
+    btstack_resample_init(&context, 2);
+    fill_sine(1000.0, 2);
+    uint32_t num_output_frames = resample(&context, input_buffer, 2, output_buffer);
+    // last frame is kept for interpolation with next block
+    CHECK_EQUAL(NUM_INPUT_FRAMES - 1, num_output_frames);
+    CHECK_EQUAL(0, memcmp(input_buffer, output_buffer, num_output_frames * 2 * sizeof(int16_t)));
+}
+
+TEST(Resample, PolyphaseDelay){
+    btstack_resample_t context;
+    btstack_resample_init(&context, 1);
+    btstack_resample_set_mode(&context, BTSTACK_RESAMPLE_MODE_POLYPHASE);
+    int16_t impulse[32];
+    int16_t output[32];
+    memset(impulse, 0, sizeof(impulse));
+    impulse[0] = 10000;
+    CHECK_EQUAL(32, btstack_resample_block(&context, impulse, 32, output));
+    CHECK_EQUAL((impulse[0] * 14740 + 8192) >> 14, output[POLYPHASE_DELAY]);
+}
+
+TEST(Resample, LinearStereoMatchesMono){
+    check_stereo_matches_mono(BTSTACK_RESAMPLE_MODE_LINEAR, 0x10000);
+    check_stereo_matches_mono(BTSTACK_RESAMPLE_MODE_LINEAR, 0x10123);
+    check_stereo_matches_mono(BTSTACK_RESAMPLE_MODE_LINEAR, 0x0fe01);
+    check_stereo_matches_mono(BTSTACK_RESAMPLE_MODE_LINEAR, 0x08765);
+}
+
+TEST(Resample, PolyphaseStereoMatchesMono){
+    check_stereo_matches_mono(BTSTACK_RESAMPLE_MODE_POLYPHASE, 0x10000);
+    check_stereo_matches_mono(BTSTACK_RESAMPLE_MODE_POLYPHASE, 0x10123);
+    check_stereo_matches_mono(BTSTACK_RESAMPLE_MODE_POLYPHASE, 0x0fe01);
+    check_stereo_matches_mono(BTSTACK_RESAMPLE_MODE_POLYPHASE, 0x08765);
+}
+
+TEST(Resample, LinearSNR){
+    CHECK_TRUE(resample_snr(BTSTACK_RESAMPLE_MODE_LINEAR, 1000.0, 0x10123) > 45.0);
+    CHECK_TRUE(resample_snr(BTSTACK_RESAMPLE_MODE_LINEAR, 1000.0, 0x0fe01) > 45.0);
+}
+
+TEST(Resample, PolyphaseSNR){
+    static const double frequencies[] = { 100.0, 1000.0, 5000.0, 10000.0 };
+    unsigned int i;
+    for (i=0;i<sizeof(frequencies)/sizeof(double);i++){
+        double snr_linear    = resample_snr(BTSTACK_RESAMPLE_MODE_LINEAR,    frequencies[i], 0x10123);
+        double snr_polyphase = resample_snr(BTSTACK_RESAMPLE_MODE_POLYPHASE, frequencies[i], 0x10123);
+        printf("%6.0f Hz: SNR linear %5.1f dB, polyphase %5.1f dB\n", frequencies[i], snr_linear, snr_polyphase);
+        // limited by Q14 coefficients, linear interpolation is only competitive for very low frequencies
+        CHECK_TRUE(snr_polyphase > 60.0);
+        if (frequencies[i] >= 1000.0){
+            CHECK_TRUE(snr_polyphase > snr_linear);
+        }
+        CHECK_TRUE(resample_snr(BTSTACK_RESAMPLE_MODE_POLYPHASE, frequencies[i], 0x0fe01) > 60.0);
+    }
+}
+
+int main (int argc, const char * argv[]){
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2020 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHIAS
+ * RINGWALD OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+#define BTSTACK_FILE__ "resample_benchmark.c"
+
+/*
+ *  resample_benchmark.c
+ *
+ *  Measure resampling throughput for linear and polyphase mode. Stereo uses SSE2/NEON if available,
+ *  while two mono contexts show the generic implementation for the same amount of audio.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "btstack_resample.h"
+
+#define SAMPLE_RATE     44100
+#define BLOCK_FRAMES    128
+#define NUM_BLOCKS      20000
+// slightly faster than source to emulate drift compensation
+#define RESAMPLE_FACTOR 0x10123
+
+static int16_t input_stereo[BLOCK_FRAMES * 2];
+static int16_t input_mono[BLOCK_FRAMES];
+static int16_t output_buffer[BLOCK_FRAMES * 2 * 2];
+
+static uint64_t get_time_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t) ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+static void run_benchmark(const char * name, btstack_resample_mode_t mode, int num_channels, int num_contexts){
+    btstack_resample_t contexts[2];
+    int c;
+    for (c = 0; c < num_contexts; c++){
+        btstack_resample_init(&contexts[c], num_channels);
+        btstack_resample_set_mode(&contexts[c], mode);
+        btstack_resample_set_factor(&contexts[c], RESAMPLE_FACTOR);
+    }
+    const int16_t * input = (num_channels == 2) ? input_stereo : input_mono;
+    uint64_t num_output_frames = 0;
+    uint64_t start_ns = get_time_ns();
+    int i;
+    for (i = 0; i < NUM_BLOCKS; i++){
+        for (c = 0; c < num_contexts; c++){
+            num_output_frames += btstack_resample_block(&contexts[c], input, BLOCK_FRAMES, output_buffer);
+        }
+    }
+    uint64_t duration_ns = get_time_ns() - start_ns;
+    // report stereo frames, i.e. output of two mono contexts counts as one stereo frame
+    double stereo_frames = (double) num_output_frames * num_channels / 2.0;
+    printf("- %-24s %8.2f ms, %7.1f Mframes/s, %6.1f x realtime\n", name,
+           (double) duration_ns / 1000000.0,
+           stereo_frames * 1000.0 / (double) duration_ns,
+           stereo_frames * 1000000000.0 / SAMPLE_RATE / (double) duration_ns);
+}
+
+int main(void){
+    int i;
+    for (i = 0; i < BLOCK_FRAMES; i++){
+        int16_t sample = (int16_t) (16000.0 * sin(2.0 * M_PI * 1000.0 * i / SAMPLE_RATE));
+        input_mono[i] = sample;
+        input_stereo[i * 2]     = sample;
+        input_stereo[i * 2 + 1] = -sample;
+    }
+    printf("Resampling %u blocks of %u frames, factor 0x%x\n", NUM_BLOCKS, BLOCK_FRAMES, RESAMPLE_FACTOR);
+    run_benchmark("linear, 2 x mono:",    BTSTACK_RESAMPLE_MODE_LINEAR,    1, 2);
+    run_benchmark("linear, stereo:",      BTSTACK_RESAMPLE_MODE_LINEAR,    2, 1);
+    run_benchmark("polyphase, 2 x mono:", BTSTACK_RESAMPLE_MODE_POLYPHASE, 1, 2);
+    run_benchmark("polyphase, stereo:",   BTSTACK_RESAMPLE_MODE_POLYPHASE, 2, 1);
+    return 0;
+}
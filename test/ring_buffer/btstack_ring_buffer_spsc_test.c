@@ -0,0 +1,75 @@
+/*
+ *  btstack_ring_buffer_spsc_test.c
+ *
+ *  Stress test for ENABLE_RING_BUFFER_SPSC: producer thread writes a byte sequence in place
+ *  via reserve/commit, consumer thread verifies it via peek/consume. Built with ThreadSanitizer.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "btstack_ring_buffer.h"
+#include "btstack_util.h"
+
+#define NUM_BYTES   (4 * 1024 * 1024)
+
+static uint8_t               storage[1000];
+static btstack_ring_buffer_t ring_buffer;
+
+uint32_t btstack_min(uint32_t a, uint32_t b){
+    return a < b ? a : b;
+}
+
+static void * producer(void * context){
+    (void) context;
+    btstack_ring_buffer_span_t spans[2];
+    uint32_t bytes_written = 0;
+    uint32_t chunk = 1;
+    while (bytes_written < NUM_BYTES){
+        uint32_t len = btstack_ring_buffer_reserve(&ring_buffer, btstack_min(chunk, NUM_BYTES - bytes_written), spans);
+        uint32_t i;
+        for (i = 0; i < spans[0].len; i++) spans[0].data[i] = (uint8_t) bytes_written++;
+        for (i = 0; i < spans[1].len; i++) spans[1].data[i] = (uint8_t) bytes_written++;
+        btstack_ring_buffer_commit(&ring_buffer, len);
+        chunk = (chunk % 300) + 7;
+    }
+    return NULL;
+}
+
+static void * consumer(void * context){
+    (void) context;
+    btstack_ring_buffer_span_t spans[2];
+    uint32_t bytes_read = 0;
+    uint32_t chunk = 1;
+    while (bytes_read < NUM_BYTES){
+        uint32_t len = btstack_ring_buffer_peek(&ring_buffer, chunk, spans);
+        uint32_t i;
+        for (i = 0; i < spans[0].len; i++){
+            if (spans[0].data[i] != (uint8_t) bytes_read++) return (void *) 1;
+        }
+        for (i = 0; i < spans[1].len; i++){
+            if (spans[1].data[i] != (uint8_t) bytes_read++) return (void *) 1;
+        }
+        btstack_ring_buffer_consume(&ring_buffer, len);
+        chunk = (chunk % 500) + 13;
+    }
+    return NULL;
+}
+
+int main(void){
+    pthread_t producer_thread;
+    pthread_t consumer_thread;
+    void * result;
+    btstack_ring_buffer_init(&ring_buffer, storage, sizeof(storage));
+    pthread_create(&producer_thread, NULL, &producer, NULL);
+    pthread_create(&consumer_thread, NULL, &consumer, NULL);
+    pthread_join(producer_thread, NULL);
+    pthread_join(consumer_thread, &result);
+    if (result != NULL || !btstack_ring_buffer_empty(&ring_buffer)){
+        printf("SPSC: data mismatch\n");
+        return 1;
+    }
+    printf("SPSC: %u bytes transferred\n", NUM_BYTES);
+    return 0;
+}
@@ -3,6 +3,8 @@
 #include "btstack_ring_buffer.h"
 #include "btstack_util.h"
 
+#define ERROR_CODE_MEMORY_CAPACITY_EXCEEDED 0x07
+
 static  uint8_t storage[10];
 
 uint32_t btstack_min(uint32_t a, uint32_t b){
@@ -93,6 +95,105 @@ TEST(RingBuffer, ReadWriteChunks){
     }
 }
 
+TEST(RingBuffer, FullBuffer){
+    uint8_t test_write_data[] = {1,2,3,4,5,6,7,8,9,10};
+    CHECK_EQUAL(0, btstack_ring_buffer_write(&ring_buffer, test_write_data, sizeof(test_write_data)));
+    CHECK_EQUAL(storage_size, btstack_ring_buffer_bytes_available(&ring_buffer));
+    CHECK_EQUAL(0, btstack_ring_buffer_bytes_free(&ring_buffer));
+    CHECK_FALSE(btstack_ring_buffer_empty(&ring_buffer));
+    CHECK_EQUAL(ERROR_CODE_MEMORY_CAPACITY_EXCEEDED, btstack_ring_buffer_write(&ring_buffer, test_write_data, 1));
+}
+
+TEST(RingBuffer, ReserveCommit){
+    btstack_ring_buffer_span_t spans[2];
+    // move indices to middle of storage
+    uint8_t test_data[] = {1,2,3,4,5,6};
+    uint32_t number_of_bytes_read = 0;
+    btstack_ring_buffer_write(&ring_buffer, test_data, 6);
+    btstack_ring_buffer_read(&ring_buffer, test_data, 6, &number_of_bytes_read);
+
+    // reserve wraps around end of storage
+    CHECK_EQUAL(7, btstack_ring_buffer_reserve(&ring_buffer, 7, spans));
+    CHECK_TRUE(spans[0].data == &storage[6]);
+    CHECK_EQUAL(4, spans[0].len);
+    CHECK_TRUE(spans[1].data == &storage[0]);
+    CHECK_EQUAL(3, spans[1].len);
+    uint8_t value = 10;
+    int i, j;
+    for (i=0;i<2;i++){
+        for (j=0;j<(int)spans[i].len;j++){
+            spans[i].data[j] = value++;
+        }
+    }
+    // nothing visible before commit
+    CHECK_EQUAL(0, btstack_ring_buffer_bytes_available(&ring_buffer));
+    btstack_ring_buffer_commit(&ring_buffer, 7);
+    CHECK_EQUAL(7, btstack_ring_buffer_bytes_available(&ring_buffer));
+
+    // reserve is limited by free space
+    CHECK_EQUAL(3, btstack_ring_buffer_reserve(&ring_buffer, 5, spans));
+    CHECK_EQUAL(3, spans[0].len);
+    CHECK_EQUAL(0, spans[1].len);
+
+    uint8_t test_read_data[7];
+    btstack_ring_buffer_read(&ring_buffer, test_read_data, sizeof(test_read_data), &number_of_bytes_read);
+    CHECK_EQUAL(7, number_of_bytes_read);
+    for (i=0;i<7;i++){
+        CHECK_EQUAL(10 + i, test_read_data[i]);
+    }
+}
+
+TEST(RingBuffer, PeekConsume){
+    btstack_ring_buffer_span_t spans[2];
+    uint8_t test_data[] = {1,2,3,4,5,6,7,8};
+    uint32_t number_of_bytes_read = 0;
+    CHECK_EQUAL(0, btstack_ring_buffer_peek(&ring_buffer, 5, spans));
+    CHECK_EQUAL(0, spans[0].len);
+    CHECK_EQUAL(0, spans[1].len);
+
+    btstack_ring_buffer_write(&ring_buffer, test_data, 8);
+    btstack_ring_buffer_read(&ring_buffer, test_data, 7, &number_of_bytes_read);
+    btstack_ring_buffer_write(&ring_buffer, test_data, 5);
+
+    // data wraps around end of storage
+    CHECK_EQUAL(6, btstack_ring_buffer_peek(&ring_buffer, 10, spans));
+    CHECK_TRUE(spans[0].data == &storage[7]);
+    CHECK_EQUAL(3, spans[0].len);
+    CHECK_EQUAL(8, spans[0].data[0]);
+    CHECK_TRUE(spans[1].data == &storage[0]);
+    CHECK_EQUAL(3, spans[1].len);
+    CHECK_EQUAL(3, spans[1].data[0]);
+
+    // peek does not remove data
+    CHECK_EQUAL(6, btstack_ring_buffer_bytes_available(&ring_buffer));
+    btstack_ring_buffer_consume(&ring_buffer, 2);
+    CHECK_EQUAL(4, btstack_ring_buffer_peek(&ring_buffer, 10, spans));
+    CHECK_EQUAL(1, spans[0].len);
+    CHECK_EQUAL(3, spans[1].len);
+    btstack_ring_buffer_consume(&ring_buffer, 4);
+    CHECK_TRUE(btstack_ring_buffer_empty(&ring_buffer));
+}
+
+TEST(RingBuffer, FillAndDrainInPlace){
+    btstack_ring_buffer_span_t spans[2];
+    uint8_t next_write = 0;
+    uint8_t next_read  = 0;
+    int round;
+    for (round=0;round<50;round++){
+        uint32_t len = btstack_ring_buffer_reserve(&ring_buffer, (round % 7) + 1, spans);
+        uint32_t i;
+        for (i=0;i<spans[0].len;i++) spans[0].data[i] = next_write++;
+        for (i=0;i<spans[1].len;i++) spans[1].data[i] = next_write++;
+        btstack_ring_buffer_commit(&ring_buffer, len);
+
+        len = btstack_ring_buffer_peek(&ring_buffer, (round % 5) + 1, spans);
+        for (i=0;i<spans[0].len;i++) CHECK_EQUAL(next_read++, spans[0].data[i]);
+        for (i=0;i<spans[1].len;i++) CHECK_EQUAL(next_read++, spans[1].data[i]);
+        btstack_ring_buffer_consume(&ring_buffer, len);
+        CHECK_EQUAL((uint8_t)(next_write - next_read), btstack_ring_buffer_bytes_available(&ring_buffer));
+    }
+}
+
 int main (int argc, const char * argv[]){
     return CommandLineTestRunner::RunAllTests(argc, argv);
 }
\ No newline at end of file
@@ -0,0 +1,201 @@
+/*
+ * Copyright (C) 2020 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHIAS
+ * RINGWALD OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+/*
+ *  run_loop_benchmark.c
+ *
+ *  Compare wakeup latency and CPU usage of the POSIX select() run loop and the Linux epoll run loop.
+ *  For each configuration, N pipes are registered as data sources. A writer thread wakes up a random
+ *  data source and waits until the run loop has processed it. Each configuration runs in its own process.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <sys/resource.h>
+#include <sys/select.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "btstack_run_loop.h"
+#include "btstack_run_loop_posix.h"
+#include "btstack_run_loop_epoll.h"
+
+#define NUM_WAKEUPS 20000
+#define MAX_SOURCES 1000
+
+static int num_sources;
+static int pipe_fds[MAX_SOURCES][2];
+static btstack_data_source_t data_sources[MAX_SOURCES];
+
+static sem_t wakeup_processed;
+static struct timespec wakeup_sent;
+static int      wakeups_received;
+static uint64_t latency_sum_ns;
+static uint64_t latency_max_ns;
+static struct rusage usage_start;
+
+static uint64_t timespec_diff_ns(const struct timespec * start, const struct timespec * stop){
+    return ((uint64_t)(stop->tv_sec - start->tv_sec) * 1000000000ULL) + stop->tv_nsec - start->tv_nsec;
+}
+
+static uint64_t rusage_cpu_us(const struct rusage * usage){
+    return ((uint64_t) usage->ru_utime.tv_sec + usage->ru_stime.tv_sec) * 1000000ULL + usage->ru_utime.tv_usec + usage->ru_stime.tv_usec;
+}
+
+static void report_and_exit(void){
+    struct rusage usage_end;
+    getrusage(RUSAGE_THREAD, &usage_end);
+    uint64_t cpu_us = rusage_cpu_us(&usage_end) - rusage_cpu_us(&usage_start);
+    printf("%5u sources: latency avg %7.2f us, max %8.2f us, run loop cpu %6.2f us/wakeup\n", num_sources,
+           (double) latency_sum_ns / NUM_WAKEUPS / 1000.0,
+           (double) latency_max_ns / 1000.0,
+           (double) cpu_us / NUM_WAKEUPS);
+    fflush(stdout);
+    _exit(0);
+}
+
+static void data_source_process(btstack_data_source_t * ds, btstack_data_source_callback_type_t callback_type){
+    (void) callback_type;
+    struct timespec now;
+    uint8_t byte;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (read(ds->source.fd, &byte, 1) != 1) return;
+    uint64_t latency_ns = timespec_diff_ns(&wakeup_sent, &now);
+    latency_sum_ns += latency_ns;
+    if (latency_ns > latency_max_ns){
+        latency_max_ns = latency_ns;
+    }
+    wakeups_received++;
+    if (wakeups_received == NUM_WAKEUPS){
+        report_and_exit();
+    }
+    sem_post(&wakeup_processed);
+}
+
+static void * writer_thread(void * context){
+    (void) context;
+    uint8_t byte = 0x55;
+    int i;
+    for (i = 0; i < NUM_WAKEUPS; i++){
+        int index = rand() % num_sources;
+        clock_gettime(CLOCK_MONOTONIC, &wakeup_sent);
+        if (write(pipe_fds[index][1], &byte, 1) != 1) break;
+        sem_wait(&wakeup_processed);
+    }
+    return NULL;
+}
+
+static void run_benchmark(const btstack_run_loop_t * run_loop, int sources, int check_fd_setsize){
+    num_sources = sources;
+    int i;
+    for (i = 0; i < num_sources; i++){
+        if (pipe(pipe_fds[i])){
+            printf("%5u sources: pipe() failed, increase open file limit\n", num_sources);
+            fflush(stdout);
+            _exit(1);
+        }
+        if (check_fd_setsize && (pipe_fds[i][0] >= FD_SETSIZE)){
+            printf("%5u sources: skipped, fd %u exceeds FD_SETSIZE (%u)\n", num_sources, pipe_fds[i][0], FD_SETSIZE);
+            fflush(stdout);
+            _exit(0);
+        }
+    }
+
+    btstack_run_loop_init(run_loop);
+    for (i = 0; i < num_sources; i++){
+        btstack_data_source_t * ds = &data_sources[i];
+        btstack_run_loop_set_data_source_fd(ds, pipe_fds[i][0]);
+        btstack_run_loop_set_data_source_handler(ds, &data_source_process);
+        btstack_run_loop_enable_data_source_callbacks(ds, DATA_SOURCE_CALLBACK_READ);
+        btstack_run_loop_add_data_source(ds);
+    }
+
+    sem_init(&wakeup_processed, 0, 0);
+    getrusage(RUSAGE_THREAD, &usage_start);
+
+    pthread_t thread;
+    pthread_create(&thread, NULL, &writer_thread, NULL);
+
+    // does not return, data_source_process exits after NUM_WAKEUPS
+    btstack_run_loop_execute();
+}
+
+static void run_benchmark_in_child(const btstack_run_loop_t * run_loop, int sources, int check_fd_setsize){
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0){
+        run_benchmark(run_loop, sources, check_fd_setsize);
+    }
+    waitpid(pid, NULL, 0);
+}
+
+int main(int argc, const char * argv[]){
+    (void) argc;
+    (void) argv;
+
+    // two fds per source
+    struct rlimit limit;
+    getrlimit(RLIMIT_NOFILE, &limit);
+    if (limit.rlim_cur < (2 * MAX_SOURCES + 16)){
+        limit.rlim_cur = 2 * MAX_SOURCES + 16;
+        if (limit.rlim_cur > limit.rlim_max){
+            limit.rlim_cur = limit.rlim_max;
+        }
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+
+    static const int source_counts[] = { 10, 100, 1000 };
+    unsigned int i;
+
+    printf("POSIX run loop (select), %u wakeups\n", NUM_WAKEUPS);
+    for (i = 0; i < sizeof(source_counts) / sizeof(int); i++){
+        run_benchmark_in_child(btstack_run_loop_posix_get_instance(), source_counts[i], 1);
+    }
+
+    printf("Linux run loop (epoll), %u wakeups\n", NUM_WAKEUPS);
+    for (i = 0; i < sizeof(source_counts) / sizeof(int); i++){
+        run_benchmark_in_child(btstack_run_loop_epoll_get_instance(), source_counts[i], 0);
+    }
+    return 0;
+}
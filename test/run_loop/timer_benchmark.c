@@ -0,0 +1,193 @@
+/*
+ * Copyright (C) 2020 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHIAS
+ * RINGWALD OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+/*
+ *  timer_benchmark.c
+ *
+ *  Arm, cancel, restart and expire 10k timers through btstack_run_loop_base with a simulated clock.
+ *  Build with -DENABLE_RUN_LOOP_TIMER_WHEEL to measure the timer wheel instead of the sorted list.
+ */
+
+#define _POSIX_C_SOURCE 200809
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "btstack_run_loop_base.h"
+#include "btstack_util.h"
+
+#define NUM_TIMERS      10000
+#define NUM_RESTARTS    100000
+#define MAX_TIMEOUT_MS  30000
+
+static btstack_timer_source_t timers[NUM_TIMERS];
+static uint32_t now_ms;
+static uint32_t last_timeout;
+static int      num_fired;
+static int      num_errors;
+
+static uint64_t get_time_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t) ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+static void timer_handler(btstack_timer_source_t * ts){
+    // timers must not fire early and must fire in order of their timeout
+    if (btstack_time_delta(ts->timeout, now_ms) > 0) {
+        num_errors++;
+    }
+    if ((num_fired > 0) && (btstack_time_delta(ts->timeout, last_timeout) < 0)){
+        num_errors++;
+    }
+    last_timeout = ts->timeout;
+    num_fired++;
+}
+
+static void arm_timer(int index){
+    btstack_timer_source_t * ts = &timers[index];
+    ts->timeout = now_ms + 1 + (rand() % MAX_TIMEOUT_MS);
+    btstack_run_loop_base_add_timer(ts);
+}
+
+// changing the timeout of an active timer must not leave a stale time until next timeout
+static void check_changed_timeout(void){
+    btstack_timer_source_t * first  = &timers[0];
+    btstack_timer_source_t * second = &timers[1];
+    first->timeout  = now_ms + 100;
+    second->timeout = now_ms + 200;
+    btstack_run_loop_base_add_timer(first);
+    btstack_run_loop_base_add_timer(second);
+    if (btstack_run_loop_base_get_time_until_timeout(now_ms) != 100){
+        num_errors++;
+    }
+    first->timeout = now_ms + 300;
+    btstack_run_loop_base_remove_timer(first);
+    if (btstack_run_loop_base_get_time_until_timeout(now_ms) != 200){
+        num_errors++;
+    }
+    btstack_run_loop_base_remove_timer(second);
+    if (btstack_run_loop_base_get_time_until_timeout(now_ms) != -1){
+        num_errors++;
+    }
+}
+
+static void report(const char * name, uint64_t start_ns, int num_ops){
+    uint64_t duration_ns = get_time_ns() - start_ns;
+    printf("%-30s %8.1f ns/op\n", name, (double) duration_ns / num_ops);
+}
+
+int main(int argc, const char * argv[]){
+    (void) argc;
+    (void) argv;
+    int i;
+    uint64_t start_ns;
+
+#ifdef ENABLE_RUN_LOOP_TIMER_WHEEL
+    printf("Timer wheel, %u timers\n", NUM_TIMERS);
+#else
+    printf("Sorted timer list, %u timers\n", NUM_TIMERS);
+#endif
+
+    srand(1234);
+    btstack_run_loop_base_init();
+    now_ms = 100000;
+    btstack_run_loop_base_process_timers(now_ms);
+    for (i = 0; i < NUM_TIMERS; i++){
+        btstack_run_loop_set_timer_handler(&timers[i], &timer_handler);
+    }
+
+    check_changed_timeout();
+
+    // arm
+    start_ns = get_time_ns();
+    for (i = 0; i < NUM_TIMERS; i++){
+        arm_timer(i);
+    }
+    report("arm", start_ns, NUM_TIMERS);
+
+    // cancel in random order
+    start_ns = get_time_ns();
+    for (i = 0; i < NUM_TIMERS; i++){
+        int index = (i * 7919) % NUM_TIMERS;
+        if (btstack_run_loop_base_remove_timer(&timers[index]) == false){
+            num_errors++;
+        }
+    }
+    report("cancel", start_ns, NUM_TIMERS);
+
+    // cancel inactive timers
+    start_ns = get_time_ns();
+    for (i = 0; i < NUM_TIMERS; i++){
+        if (btstack_run_loop_base_remove_timer(&timers[i])){
+            num_errors++;
+        }
+    }
+    report("cancel inactive", start_ns, NUM_TIMERS);
+
+    // restart random timers, e.g. supervision timeouts
+    for (i = 0; i < NUM_TIMERS; i++){
+        arm_timer(i);
+    }
+    start_ns = get_time_ns();
+    for (i = 0; i < NUM_RESTARTS; i++){
+        int index = rand() % NUM_TIMERS;
+        btstack_run_loop_base_remove_timer(&timers[index]);
+        arm_timer(index);
+    }
+    report("restart", start_ns, NUM_RESTARTS);
+
+    // let all timers expire, advance time in 1 ms steps as a run loop would
+    start_ns = get_time_ns();
+    int ticks = 0;
+    while (true){
+        int32_t timeout_ms = btstack_run_loop_base_get_time_until_timeout(now_ms);
+        if (timeout_ms < 0) break;
+        now_ms++;
+        ticks++;
+        btstack_run_loop_base_process_timers(now_ms);
+    }
+    report("expire (per ms tick)", start_ns, ticks);
+
+    if (num_fired != NUM_TIMERS){
+        num_errors++;
+    }
+    printf("%u timers fired, %u errors\n", num_fired, num_errors);
+    return num_errors ? 1 : 0;
+}
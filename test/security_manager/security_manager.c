@@ -23,6 +23,7 @@
 #include "hci.h"
 #include "hci_dump.h"
 #include "l2cap.h"
+#include "ble/le_device_db.h"
 #include "ble/sm.h"
 
 // test data
@@ -116,6 +117,7 @@ void mock_simulate_connected(void);
 uint8_t * mock_packet_buffer(void);
 uint16_t mock_packet_buffer_len(void);
 void mock_clear_packet_buffer(void);
+void aes128_calc_cyphertext(uint8_t key[16], uint8_t plaintext[16], uint8_t cyphertext[16]);
 
 void app_packet_handler (uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size){
     uint16_t aHandle;
@@ -429,6 +431,84 @@ TEST(SecurityManager, MainTest){
     CHECK_ACL_PACKET(test_acl_packet_22);
 }
 
+// RPA for IRK: prand with 0b01 in the two most significant bits || ah(irk, prand)
+static void create_resolvable_private_address(sm_key_t irk, const uint8_t prand[3], bd_addr_t addr){
+    uint8_t r_prime[16];
+    uint8_t hash[16];
+    memset(r_prime, 0, 16);
+    memcpy(&r_prime[13], prand, 3);
+    aes128_calc_cyphertext(irk, r_prime, hash);
+    memcpy(&addr[0], prand, 3);
+    memcpy(&addr[3], &hash[13], 3);
+}
+
+// answer all LE Encrypt commands, @returns number of commands
+static int report_le_encrypt_results(void){
+    int num_commands = 0;
+    while (little_endian_read_16(mock_packet_buffer(), 0) == hci_le_encrypt.opcode){
+        mock_clear_packet_buffer();
+        aes128_report_result();
+        num_commands++;
+    }
+    return num_commands;
+}
+
+static void simulate_connected_with_address(const bd_addr_t addr){
+    uint8_t packet[] = { 0x3e, 0x13, 0x01, 0x00, 0x40, 0x00, 0x01, 0x01, 0, 0, 0, 0, 0, 0, 0x18, 0x00, 0x00, 0x00, 0x48, 0x00, 0x05};
+    reverse_bd_addr(addr, &packet[8]);
+    mock_simulate_hci_event(&packet[0], sizeof(packet));
+}
+
+static void simulate_disconnected(void){
+    uint8_t packet[] = { HCI_EVENT_DISCONNECTION_COMPLETE, 0x04, 0x00, 0x40, 0x00, ERROR_CODE_REMOTE_USER_TERMINATED_CONNECTION };
+    mock_simulate_hci_event(&packet[0], sizeof(packet));
+}
+
+TEST(SecurityManager, CachedResolvablePrivateAddress){
+
+    mock_init();
+    mock_simulate_hci_state_working();
+    report_le_encrypt_results();
+    mock_clear_packet_buffer();
+    simulate_disconnected();
+
+    sm_key_t irk = { 0x01, 0x23, 0x45, 0x67, 0x89, 0xab, 0xcd, 0xef, 0xfe, 0xdc, 0xba, 0x98, 0x76, 0x54, 0x32, 0x10 };
+    bd_addr_t identity_addr = { 0x00, 0x1b, 0xdc, 0x01, 0x02, 0x03 };
+    int le_db_index = le_device_db_add(BD_ADDR_TYPE_LE_PUBLIC, identity_addr, irk);
+    CHECK(le_db_index >= 0);
+
+    const uint8_t prand[] = { 0x55, 0x12, 0x34 };
+    bd_addr_t rpa;
+    create_resolvable_private_address(irk, prand, rpa);
+
+    // first connection: IRK lookup via LE Encrypt
+    simulate_connected_with_address(rpa);
+    CHECK(report_le_encrypt_results() > 0);
+    CHECK_EQUAL(IRK_LOOKUP_SUCCEEDED, sm_identity_resolving_state(0x40));
+    CHECK_EQUAL(le_db_index, sm_le_device_index(0x40));
+    simulate_disconnected();
+
+    // reconnect with same RPA: cached result without LE Encrypt
+    simulate_connected_with_address(rpa);
+    CHECK_EQUAL(0, report_le_encrypt_results());
+    CHECK_EQUAL(IRK_LOOKUP_SUCCEEDED, sm_identity_resolving_state(0x40));
+    CHECK_EQUAL(le_db_index, sm_le_device_index(0x40));
+    simulate_disconnected();
+
+    // replace device, le_device_db_count() does not change: cached result is stale
+    le_device_db_remove(le_db_index);
+    sm_key_t other_irk = { 0x10, 0x32, 0x54, 0x76, 0x98, 0xba, 0xdc, 0xfe, 0xef, 0xcd, 0xab, 0x89, 0x67, 0x45, 0x23, 0x01 };
+    bd_addr_t other_addr = { 0x00, 0x1b, 0xdc, 0x04, 0x05, 0x06 };
+    int other_le_db_index = le_device_db_add(BD_ADDR_TYPE_LE_PUBLIC, other_addr, other_irk);
+    CHECK(other_le_db_index >= 0);
+
+    simulate_connected_with_address(rpa);
+    CHECK(report_le_encrypt_results() > 0);
+    CHECK_EQUAL(IRK_LOOKUP_FAILED, sm_identity_resolving_state(0x40));
+    simulate_disconnected();
+    le_device_db_remove(other_le_db_index);
+}
+
 int main (int argc, const char * argv[]){
     // hci_dump_open("hci_dump.pklg", HCI_DUMP_STDOUT); // HCI_DUMP_PACKETLOGGER
     return CommandLineTestRunner::RunAllTests(argc, argv);
@@ -0,0 +1,152 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#include "btstack_slip.h"
+
+#define MAX_FRAME_SIZE 300
+
+// btstack_slip logs errors
+extern "C" void hci_dump_log(int log_level, const char * format, ...){
+    (void) log_level;
+    (void) format;
+}
+
+static void fill_random(uint8_t * data, uint16_t len){
+    uint16_t i;
+    for (i = 0; i < len; i++){
+        // favor SOF and ESC to get many escapes
+        switch (rand() & 7){
+            case 0:
+                data[i] = BTSTACK_SLIP_SOF;
+                break;
+            case 1:
+                data[i] = 0xdb;
+                break;
+            default:
+                data[i] = (uint8_t) rand();
+                break;
+        }
+    }
+}
+
+static uint16_t encode_bytewise(uint8_t * buffer, const uint8_t * data, uint16_t len){
+    uint16_t pos = 0;
+    btstack_slip_encoder_start(data, len);
+    while (btstack_slip_encoder_has_data()){
+        buffer[pos++] = btstack_slip_encoder_get_byte();
+    }
+    return pos;
+}
+
+TEST_GROUP(SLIP){
+    uint8_t data[MAX_FRAME_SIZE];
+    uint8_t encoded[2 + 2 * MAX_FRAME_SIZE];
+    uint8_t decoded[MAX_FRAME_SIZE];
+
+    void setup(void){
+        srand(1234);
+    }
+};
+
+TEST(SLIP, EncodeEscapes){
+    const uint8_t input[] = { 0x01, BTSTACK_SLIP_SOF, 0x02, 0xdb, 0x03 };
+    const uint8_t expected[] = { 0x01, 0xdb, 0xdc, 0x02, 0xdb, 0xdd, 0x03 };
+    uint16_t len = btstack_slip_encode(encoded, sizeof(encoded), input, sizeof(input));
+    CHECK_EQUAL(sizeof(expected), len);
+    MEMCMP_EQUAL(expected, encoded, sizeof(expected));
+}
+
+TEST(SLIP, EncodeMatchesBytewise){
+    uint8_t reference[sizeof(encoded)];
+    int i;
+    for (i = 0; i < 200; i++){
+        uint16_t len = rand() % MAX_FRAME_SIZE;
+        fill_random(data, len);
+        uint16_t reference_len = encode_bytewise(reference, data, len);
+        CHECK_EQUAL(reference_len, btstack_slip_encode(encoded, sizeof(encoded), data, len));
+        MEMCMP_EQUAL(reference, encoded, reference_len);
+    }
+}
+
+TEST(SLIP, EncodeBufferTooSmall){
+    const uint8_t input[] = { 0x01, 0x02, 0x03, BTSTACK_SLIP_SOF };
+    CHECK_EQUAL(0, btstack_slip_encode(encoded, 3, input, sizeof(input)));
+    CHECK_EQUAL(0, btstack_slip_encode(encoded, 4, input, sizeof(input)));
+    CHECK_EQUAL(5, btstack_slip_encode(encoded, 5, input, sizeof(input)));
+}
+
+TEST(SLIP, DecodeBlock){
+    const uint8_t input[] = { BTSTACK_SLIP_SOF, 0x01, 0xdb, 0xdc, 0x02, 0xdb, 0xdd, BTSTACK_SLIP_SOF, BTSTACK_SLIP_SOF, 0x05 };
+    const uint8_t expected[] = { 0x01, BTSTACK_SLIP_SOF, 0x02, 0xdb };
+    btstack_slip_decoder_init(decoded, sizeof(decoded));
+    // stops after complete frame
+    CHECK_EQUAL(8, btstack_slip_decoder_process_block(input, sizeof(input)));
+    CHECK_EQUAL(sizeof(expected), btstack_slip_decoder_frame_size());
+    MEMCMP_EQUAL(expected, decoded, sizeof(expected));
+    CHECK_EQUAL(0, btstack_slip_decoder_process_block(&input[8], 2));
+}
+
+TEST(SLIP, DecodeFramesInRandomBlocks){
+    // stream of encoded frames, decoded from blocks of random size
+    static uint8_t stream[20 * sizeof(encoded)];
+    uint16_t frame_len[20];
+    uint8_t  frames[20][MAX_FRAME_SIZE];
+    uint32_t stream_len = 0;
+    int i;
+    for (i = 0; i < 20; i++){
+        frame_len[i] = 1 + (rand() % (MAX_FRAME_SIZE - 1));
+        fill_random(frames[i], frame_len[i]);
+        stream[stream_len++] = BTSTACK_SLIP_SOF;
+        stream_len += btstack_slip_encode(&stream[stream_len], sizeof(encoded), frames[i], frame_len[i]);
+        stream[stream_len++] = BTSTACK_SLIP_SOF;
+    }
+
+    btstack_slip_decoder_init(decoded, sizeof(decoded));
+    int num_frames = 0;
+    uint32_t pos = 0;
+    while (pos < stream_len){
+        uint16_t block_len = 1 + (rand() % 64);
+        if (block_len > (stream_len - pos)){
+            block_len = stream_len - pos;
+        }
+        uint16_t block_pos = 0;
+        while (block_pos < block_len){
+            block_pos += btstack_slip_decoder_process_block(&stream[pos + block_pos], block_len - block_pos);
+            uint16_t frame_size = btstack_slip_decoder_frame_size();
+            if (frame_size == 0) continue;
+            CHECK_EQUAL(frame_len[num_frames], frame_size);
+            MEMCMP_EQUAL(frames[num_frames], decoded, frame_size);
+            num_frames++;
+            btstack_slip_decoder_init(decoded, sizeof(decoded));
+        }
+        pos += block_len;
+    }
+    CHECK_EQUAL(20, num_frames);
+}
+
+TEST(SLIP, DecodeFrameTooLong){
+    uint8_t input[2 + MAX_FRAME_SIZE + 2 + 4];
+    uint16_t pos = 0;
+    input[pos++] = BTSTACK_SLIP_SOF;
+    memset(&input[pos], 0x55, MAX_FRAME_SIZE + 1);
+    pos += MAX_FRAME_SIZE + 1;
+    input[pos++] = BTSTACK_SLIP_SOF;
+    // following frame is decoded
+    input[pos++] = 0x01;
+    input[pos++] = 0x02;
+    input[pos++] = BTSTACK_SLIP_SOF;
+
+    btstack_slip_decoder_init(decoded, MAX_FRAME_SIZE);
+    uint16_t consumed = btstack_slip_decoder_process_block(input, pos);
+    CHECK_EQUAL(pos, consumed);
+    CHECK_EQUAL(2, btstack_slip_decoder_frame_size());
+    CHECK_EQUAL(0x01, decoded[0]);
+    CHECK_EQUAL(0x02, decoded[1]);
+}
+
+int main (int argc, const char * argv[]){
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
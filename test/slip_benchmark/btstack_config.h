@@ -0,0 +1,18 @@
+//
+// btstack_config.h for SLIP and H5 over pty benchmarks
+//
+
+#ifndef __BTSTACK_CONFIG
+#define __BTSTACK_CONFIG
+
+// Port related features
+#define HAVE_POSIX_TIME
+
+// BTstack features that can be enabled
+#define ENABLE_LOG_ERROR
+
+// BTstack configuration. buffers, sizes, ...
+#define HCI_ACL_PAYLOAD_SIZE 1021
+#define HCI_H5_SLIDING_WINDOW_SIZE 4
+
+#endif
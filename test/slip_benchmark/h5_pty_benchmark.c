@@ -0,0 +1,326 @@
+/*
+ * Copyright (C) 2020 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHIAS
+ * RINGWALD OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+#define BTSTACK_FILE__ "h5_pty_benchmark.c"
+
+/*
+ *  h5_pty_benchmark.c
+ *
+ *  End-to-end H5 frames per second over a pty pair. The host stack uses hci_transport_h5 with the POSIX UART driver
+ *  on the pty slave, an emulated Controller in a child process acks reliable packets on the pty master.
+ *  - TX: host sends reliable ACL packets, Controller sends one cumulative ack per read
+ *  - RX: Controller sends unreliable ACL packets in large writes, host decodes them
+ *  Build with H5_PTY_BENCHMARK_BYTEWISE to disable partial reads, which makes H5 read and decode single bytes.
+ */
+
+#define _GNU_SOURCE
+
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "btstack_debug.h"
+#include "btstack_run_loop.h"
+#include "btstack_run_loop_posix.h"
+#include "btstack_slip.h"
+#include "btstack_uart_block.h"
+#include "btstack_util.h"
+#include "hci.h"
+#include "hci_transport.h"
+
+#define NUM_PACKETS         20000
+#define ACL_PAYLOAD_SIZE    1021
+#define ACL_PACKET_SIZE     (HCI_ACL_HEADER_SIZE + ACL_PAYLOAD_SIZE)
+#define FRAMES_PER_WRITE    8
+#define TIMEOUT_S           60
+
+#define LINK_ACKNOWLEDGEMENT_TYPE 0x00
+#define LINK_CONTROL_PACKET_TYPE  0x0f
+
+// host
+static const hci_transport_t * transport;
+static uint8_t  host_acl_packet[ACL_PACKET_SIZE];
+static uint32_t host_num_packets_sent;
+static uint32_t host_num_packets_received;
+static uint64_t host_tx_start_ns;
+static uint64_t host_rx_start_ns;
+static pid_t    controller_pid;
+
+// controller
+static int      controller_fd;
+static uint8_t  controller_frame[4 + ACL_PACKET_SIZE + 2];
+static uint8_t  controller_expected_seq_nr;
+static uint32_t controller_num_packets_received;
+
+static uint64_t get_time_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t) ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+// -----------------------------
+// Controller emulation, runs in child process
+
+static uint16_t controller_encode_frame(uint8_t * buffer, uint8_t reliable_ack_nr, uint8_t packet_type, const uint8_t * payload, uint16_t payload_len){
+    uint8_t header[4];
+    header[0] = reliable_ack_nr << 3;
+    header[1] = packet_type | ((payload_len & 0x0fu) << 4);
+    header[2] = payload_len >> 4;
+    header[3] = 0xffu - (header[0] + header[1] + header[2]);
+    uint16_t pos = 0;
+    buffer[pos++] = BTSTACK_SLIP_SOF;
+    pos += btstack_slip_encode(&buffer[pos], 8, header, 4);
+    pos += btstack_slip_encode(&buffer[pos], 2 * payload_len, payload, payload_len);
+    buffer[pos++] = BTSTACK_SLIP_SOF;
+    return pos;
+}
+
+static void controller_write(const uint8_t * data, uint32_t len){
+    while (len > 0){
+        ssize_t bytes_written = write(controller_fd, data, len);
+        if (bytes_written <= 0) exit(1);
+        data += bytes_written;
+        len  -= bytes_written;
+    }
+}
+
+static void controller_send_frame(uint8_t packet_type, const uint8_t * payload, uint16_t payload_len){
+    static uint8_t frame[2 + 2 * (4 + ACL_PACKET_SIZE)];
+    uint16_t len = controller_encode_frame(frame, controller_expected_seq_nr, packet_type, payload, payload_len);
+    controller_write(frame, len);
+}
+
+static void controller_stream_acl_packets(void){
+    static uint8_t frames[FRAMES_PER_WRITE * (2 + 2 * (4 + ACL_PACKET_SIZE))];
+    uint8_t acl_packet[ACL_PACKET_SIZE];
+    memset(acl_packet, 0x55, sizeof(acl_packet));
+    little_endian_store_16(acl_packet, 0, 0x0001);
+    little_endian_store_16(acl_packet, 2, ACL_PAYLOAD_SIZE);
+    uint32_t i;
+    uint32_t len = 0;
+    for (i = 0; i < NUM_PACKETS; i++){
+        little_endian_store_32(acl_packet, HCI_ACL_HEADER_SIZE, i);
+        len += controller_encode_frame(&frames[len], controller_expected_seq_nr, HCI_ACL_DATA_PACKET, acl_packet, sizeof(acl_packet));
+        if (((i + 1) % FRAMES_PER_WRITE) == 0){
+            controller_write(frames, len);
+            len = 0;
+        }
+    }
+    controller_write(frames, len);
+}
+
+// returns true if ack should be sent
+static int controller_process_frame(uint16_t len){
+    static const uint8_t link_control_sync[]            = { 0x01, 0x7e};
+    static const uint8_t link_control_sync_response[]   = { 0x02, 0x7d};
+    static const uint8_t link_control_config[]          = { 0x03, 0xfc};
+    static const uint8_t link_control_config_response[] = { 0x04, 0x7b, 0x07};
+
+    if (len < 6) return 0;
+    uint8_t seq_nr = controller_frame[0] & 0x07u;
+    uint8_t reliable_packet = (controller_frame[0] & 0x80u) != 0u;
+    uint8_t packet_type = controller_frame[1] & 0x0fu;
+    const uint8_t * payload = &controller_frame[4];
+
+    if (packet_type == LINK_CONTROL_PACKET_TYPE){
+        if (memcmp(payload, link_control_sync, 2) == 0){
+            controller_send_frame(LINK_CONTROL_PACKET_TYPE, link_control_sync_response, sizeof(link_control_sync_response));
+        }
+        if (memcmp(payload, link_control_config, 2) == 0){
+            controller_expected_seq_nr = 0;
+            controller_send_frame(LINK_CONTROL_PACKET_TYPE, link_control_config_response, sizeof(link_control_config_response));
+        }
+        return 0;
+    }
+    if (reliable_packet == 0u) return 0;
+    if (seq_nr == controller_expected_seq_nr){
+        controller_expected_seq_nr = (controller_expected_seq_nr + 1u) & 0x07u;
+        controller_num_packets_received++;
+    }
+    return 1;
+}
+
+static void controller_run(int fd){
+    static uint8_t read_buffer[4096];
+    controller_fd = fd;
+    btstack_slip_decoder_init(controller_frame, sizeof(controller_frame));
+    while (true){
+        ssize_t bytes_read = read(controller_fd, read_buffer, sizeof(read_buffer));
+        if (bytes_read <= 0) exit(0);
+        int send_ack = 0;
+        uint16_t pos = 0;
+        while (pos < bytes_read){
+            pos += btstack_slip_decoder_process_block(&read_buffer[pos], bytes_read - pos);
+            uint16_t frame_size = btstack_slip_decoder_frame_size();
+            if (frame_size == 0) continue;
+            send_ack |= controller_process_frame(frame_size);
+            btstack_slip_decoder_init(controller_frame, sizeof(controller_frame));
+        }
+        // cumulative ack for all packets in this read
+        if (send_ack){
+            controller_send_frame(LINK_ACKNOWLEDGEMENT_TYPE, NULL, 0);
+        }
+        if (controller_num_packets_received == NUM_PACKETS){
+            controller_num_packets_received++;
+            controller_stream_acl_packets();
+        }
+    }
+}
+
+// -----------------------------
+// Host
+
+static void host_report(const char * name, uint64_t start_ns, uint64_t end_ns){
+    double duration_s = (double) (end_ns - start_ns) / 1000000000.0;
+    printf("- %s %8.0f frames/s, %6.1f MB/s\n", name, NUM_PACKETS / duration_s,
+           (double) NUM_PACKETS * ACL_PAYLOAD_SIZE / duration_s / 1000000.0);
+}
+
+static void host_send_next_packet(void){
+    if (host_num_packets_sent >= NUM_PACKETS) return;
+    if (!transport->can_send_packet_now(HCI_ACL_DATA_PACKET)) return;
+    little_endian_store_16(host_acl_packet, 0, 0x0001);
+    little_endian_store_16(host_acl_packet, 2, ACL_PAYLOAD_SIZE);
+    little_endian_store_32(host_acl_packet, HCI_ACL_HEADER_SIZE, host_num_packets_sent);
+    host_num_packets_sent++;
+    transport->send_packet(HCI_ACL_DATA_PACKET, host_acl_packet, sizeof(host_acl_packet));
+}
+
+static void host_finish(int status){
+    kill(controller_pid, SIGTERM);
+    waitpid(controller_pid, NULL, 0);
+    exit(status);
+}
+
+static void host_packet_handler(uint8_t packet_type, uint8_t * packet, uint16_t size){
+    switch (packet_type){
+        case HCI_EVENT_PACKET:
+            if (packet[0] != HCI_EVENT_TRANSPORT_PACKET_SENT) break;
+            if (host_tx_start_ns == 0){
+                host_tx_start_ns = get_time_ns();
+            }
+            host_send_next_packet();
+            break;
+        case HCI_ACL_DATA_PACKET:
+            // Controller starts sending after it received all packets
+            if (host_num_packets_received == 0){
+                host_rx_start_ns = get_time_ns();
+                host_report("TX", host_tx_start_ns, host_rx_start_ns);
+            }
+            if ((size != ACL_PACKET_SIZE) || (little_endian_read_32(packet, HCI_ACL_HEADER_SIZE) != host_num_packets_received)){
+                printf("host: unexpected ACL packet\n");
+                host_finish(1);
+            }
+            host_num_packets_received++;
+            if (host_num_packets_received == NUM_PACKETS){
+                host_report("RX", host_rx_start_ns, get_time_ns());
+                host_finish(0);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+int main(void){
+    // create pty pair
+    int master_fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if ((master_fd < 0) || (grantpt(master_fd) != 0) || (unlockpt(master_fd) != 0)){
+        printf("failed to create pty pair\n");
+        return 1;
+    }
+    const char * slave_name = ptsname(master_fd);
+    // keep slave open, reads on master fail while no slave is open
+    int slave_fd = open(slave_name, O_RDWR | O_NOCTTY);
+    if (slave_fd < 0){
+        printf("failed to open %s\n", slave_name);
+        return 1;
+    }
+
+    controller_pid = fork();
+    if (controller_pid == 0){
+        close(slave_fd);
+        controller_run(master_fd);
+        return 0;
+    }
+    close(master_fd);
+
+#ifdef H5_PTY_BENCHMARK_BYTEWISE
+    printf("H5 over pty, byte-wise reads, HCI_H5_SLIDING_WINDOW_SIZE %u, %u ACL packets with %u bytes payload\n",
+           HCI_H5_SLIDING_WINDOW_SIZE, NUM_PACKETS, ACL_PAYLOAD_SIZE);
+    // H5 falls back to single byte reads if UART driver does not support partial reads
+    static btstack_uart_block_t uart_driver;
+    uart_driver = *btstack_uart_block_posix_instance();
+    uart_driver.set_bytes_received = NULL;
+    uart_driver.receive_bytes = NULL;
+#else
+    printf("H5 over pty, HCI_H5_SLIDING_WINDOW_SIZE %u, %u ACL packets with %u bytes payload\n",
+           HCI_H5_SLIDING_WINDOW_SIZE, NUM_PACKETS, ACL_PAYLOAD_SIZE);
+    const btstack_uart_block_t * uart_driver_instance = btstack_uart_block_posix_instance();
+#endif
+
+    btstack_run_loop_init(btstack_run_loop_posix_get_instance());
+
+    static hci_transport_config_uart_t config = {
+        HCI_TRANSPORT_CONFIG_UART,
+        921600,
+        0,
+        0,
+        NULL
+    };
+    config.device_name = slave_name;
+#ifdef H5_PTY_BENCHMARK_BYTEWISE
+    transport = hci_transport_h5_instance(&uart_driver);
+#else
+    transport = hci_transport_h5_instance(uart_driver_instance);
+#endif
+    transport->init(&config);
+    transport->register_packet_handler(&host_packet_handler);
+    if (transport->open() != 0){
+        printf("failed to open H5 transport\n");
+        host_finish(1);
+    }
+    memset(host_acl_packet, 0x55, sizeof(host_acl_packet));
+
+    alarm(TIMEOUT_S);
+    btstack_run_loop_execute();
+    return 0;
+}
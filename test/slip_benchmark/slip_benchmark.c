@@ -0,0 +1,192 @@
+/*
+ * Copyright (C) 2020 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHIAS
+ * RINGWALD OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+#define BTSTACK_FILE__ "slip_benchmark.c"
+
+/*
+ *  slip_benchmark.c
+ *
+ *  Compare byte-wise SLIP encoder/decoder with btstack_slip_encode and btstack_slip_decoder_process_block
+ *  for H5 frames carrying 1021 byte ACL packets with random payload.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "btstack_slip.h"
+
+#define NUM_FRAMES      512
+#define FRAME_SIZE      (4 + 4 + 1021 + 2)
+#define NUM_ROUNDS      20
+#define READ_SIZE       256
+
+static uint8_t  frames[NUM_FRAMES][FRAME_SIZE];
+static uint8_t  stream[NUM_FRAMES * (2 + 2 * FRAME_SIZE)];
+static uint8_t  stream_reference[NUM_FRAMES * (2 + 2 * FRAME_SIZE)];
+static uint32_t stream_len;
+static uint8_t  decoded[FRAME_SIZE];
+static int      num_errors;
+
+static uint64_t get_time_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t) ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+static void report(const char * name, uint64_t start_ns, uint32_t num_bytes){
+    uint64_t duration_ns = get_time_ns() - start_ns;
+    printf("%-20s %8.1f MB/s\n", name, (double) num_bytes * 1000.0 / duration_ns);
+}
+
+static uint32_t encode_bytewise(void){
+    uint32_t pos = 0;
+    int i;
+    for (i = 0; i < NUM_FRAMES; i++){
+        stream_reference[pos++] = BTSTACK_SLIP_SOF;
+        btstack_slip_encoder_start(frames[i], FRAME_SIZE);
+        while (btstack_slip_encoder_has_data()){
+            stream_reference[pos++] = btstack_slip_encoder_get_byte();
+        }
+        stream_reference[pos++] = BTSTACK_SLIP_SOF;
+    }
+    return pos;
+}
+
+static uint32_t encode_block(void){
+    uint32_t pos = 0;
+    int i;
+    for (i = 0; i < NUM_FRAMES; i++){
+        stream[pos++] = BTSTACK_SLIP_SOF;
+        pos += btstack_slip_encode(&stream[pos], 2 * FRAME_SIZE, frames[i], FRAME_SIZE);
+        stream[pos++] = BTSTACK_SLIP_SOF;
+    }
+    return pos;
+}
+
+static void check_frame(int frame_nr, uint16_t frame_size){
+    if ((frame_nr >= NUM_FRAMES) || (frame_size != FRAME_SIZE) || (memcmp(frames[frame_nr], decoded, FRAME_SIZE) != 0)){
+        num_errors++;
+    }
+}
+
+static int decode_bytewise(void){
+    int num_frames = 0;
+    uint32_t i;
+    btstack_slip_decoder_init(decoded, sizeof(decoded));
+    for (i = 0; i < stream_len; i++){
+        btstack_slip_decoder_process(stream[i]);
+        uint16_t frame_size = btstack_slip_decoder_frame_size();
+        if (frame_size == 0) continue;
+        check_frame(num_frames++, frame_size);
+        btstack_slip_decoder_init(decoded, sizeof(decoded));
+    }
+    return num_frames;
+}
+
+// decode in blocks of READ_SIZE, as returned by UART read
+static int decode_block(void){
+    int num_frames = 0;
+    uint32_t pos = 0;
+    btstack_slip_decoder_init(decoded, sizeof(decoded));
+    while (pos < stream_len){
+        uint16_t block_len = READ_SIZE;
+        if (block_len > (stream_len - pos)){
+            block_len = (uint16_t) (stream_len - pos);
+        }
+        uint16_t block_pos = 0;
+        while (block_pos < block_len){
+            block_pos += btstack_slip_decoder_process_block(&stream[pos + block_pos], block_len - block_pos);
+            uint16_t frame_size = btstack_slip_decoder_frame_size();
+            if (frame_size == 0) continue;
+            check_frame(num_frames++, frame_size);
+            btstack_slip_decoder_init(decoded, sizeof(decoded));
+        }
+        pos += block_len;
+    }
+    return num_frames;
+}
+
+int main(void){
+    int i;
+    uint64_t start_ns;
+
+    srand(1234);
+    for (i = 0; i < NUM_FRAMES; i++){
+        int j;
+        for (j = 0; j < FRAME_SIZE; j++){
+            frames[i][j] = (uint8_t) rand();
+        }
+    }
+
+    uint32_t num_bytes = NUM_ROUNDS * NUM_FRAMES * FRAME_SIZE;
+    printf("SLIP codec, %u frames with %u bytes\n", NUM_FRAMES, FRAME_SIZE);
+
+    start_ns = get_time_ns();
+    for (i = 0; i < NUM_ROUNDS; i++){
+        stream_len = encode_bytewise();
+    }
+    report("encode byte-wise", start_ns, num_bytes);
+
+    start_ns = get_time_ns();
+    for (i = 0; i < NUM_ROUNDS; i++){
+        stream_len = encode_block();
+    }
+    report("encode block", start_ns, num_bytes);
+
+    if (memcmp(stream, stream_reference, stream_len) != 0){
+        num_errors++;
+    }
+
+    start_ns = get_time_ns();
+    for (i = 0; i < NUM_ROUNDS; i++){
+        if (decode_bytewise() != NUM_FRAMES) num_errors++;
+    }
+    report("decode byte-wise", start_ns, num_bytes);
+
+    start_ns = get_time_ns();
+    for (i = 0; i < NUM_ROUNDS; i++){
+        if (decode_block() != NUM_FRAMES) num_errors++;
+    }
+    report("decode block", start_ns, num_bytes);
+
+    if (num_errors){
+        printf("%u errors\n", num_errors);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,31 @@
+//
+// btstack_config.h for SM address resolution benchmark
+//
+
+#ifndef __BTSTACK_CONFIG
+#define __BTSTACK_CONFIG
+
+// Port related features
+#define HAVE_MALLOC
+#define HAVE_POSIX_TIME
+
+// BTstack features that can be enabled
+#define ENABLE_BLE
+#define ENABLE_LE_PERIPHERAL
+#define ENABLE_LE_CENTRAL
+#define ENABLE_LOG_ERROR
+
+// AES128 via HCI LE Encrypt for comparison
+#ifndef SM_BENCHMARK_HCI
+#define ENABLE_SOFTWARE_AES128
+#endif
+
+#ifndef SM_BENCHMARK_NO_CACHE
+#define ENABLE_SM_ADDRESS_RESOLUTION_CACHE
+#endif
+
+// BTstack configuration. buffers, sizes, ...
+#define HCI_ACL_PAYLOAD_SIZE 52
+#define MAX_NR_LE_DEVICE_DB_ENTRIES 500
+
+#endif
@@ -0,0 +1,320 @@
+/*
+ * Copyright (C) 2020 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHIAS
+ * RINGWALD OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+#define BTSTACK_FILE__ "sm_address_resolution_benchmark.c"
+
+/*
+ *  sm_address_resolution_benchmark.c
+ *
+ *  Measure time and number of HCI LE Encrypt commands for sm_address_resolution_lookup
+ *  with 10, 100 and 500 bonded devices, for first and repeated lookups of a resolvable
+ *  private address.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ble/le_device_db.h"
+#include "ble/sm.h"
+#include "btstack_event.h"
+#include "btstack_memory.h"
+#include "btstack_run_loop.h"
+#include "btstack_run_loop_posix.h"
+#include "btstack_util.h"
+#include "hci.h"
+#include "l2cap.h"
+#include "rijndael.h"
+
+#define NUM_LOOKUPS 2000
+
+static btstack_linked_list_t hci_event_handlers;
+static btstack_packet_callback_registration_t sm_event_callback_registration;
+
+static uint8_t  hci_event_pending[22];
+static int      hci_event_pending_len;
+static uint32_t hci_le_encrypt_count;
+
+static int      lookup_result;
+static uint16_t lookup_index;
+
+static uint64_t get_time_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t) ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+static void aes128_calc(const uint8_t * key, const uint8_t * plaintext, uint8_t * ciphertext){
+    uint32_t rk[RKLENGTH(KEYBITS)];
+    int nrounds = rijndaelSetupEncrypt(rk, key, KEYBITS);
+    rijndaelEncrypt(rk, nrounds, plaintext, ciphertext);
+}
+
+static void dispatch_hci_event(uint8_t * packet, uint16_t size){
+    btstack_linked_list_iterator_t it;
+    btstack_linked_list_iterator_init(&it, &hci_event_handlers);
+    while (btstack_linked_list_iterator_has_next(&it)){
+        btstack_packet_callback_registration_t * entry = (btstack_packet_callback_registration_t*) btstack_linked_list_iterator_next(&it);
+        (*entry->callback)(HCI_EVENT_PACKET, 0, packet, size);
+    }
+}
+
+// HCI mock: each command is answered by an emulated Controller before the next one can be sent
+void hci_add_event_handler(btstack_packet_callback_registration_t * callback_handler){
+    btstack_linked_list_add_tail(&hci_event_handlers, (btstack_linked_item_t *) callback_handler);
+}
+
+HCI_STATE hci_get_state(void){
+    return HCI_STATE_WORKING;
+}
+
+int hci_can_send_command_packet_now(void){
+    return hci_event_pending_len == 0;
+}
+
+void hci_halting_defer(void){
+}
+
+int hci_send_cmd(const hci_cmd_t * cmd, ...){
+    uint8_t command_complete[] = { HCI_EVENT_COMMAND_COMPLETE, 0x04, 0x01, 0x00, 0x00, 0x00 };
+    little_endian_store_16(command_complete, 3, cmd->opcode);
+    memcpy(hci_event_pending, command_complete, sizeof(command_complete));
+    hci_event_pending_len = sizeof(command_complete);
+    if (cmd->opcode != hci_le_encrypt.opcode) return 0;
+
+    va_list argptr;
+    va_start(argptr, cmd);
+    const uint8_t * key_flipped       = va_arg(argptr, const uint8_t *);
+    const uint8_t * plaintext_flipped = va_arg(argptr, const uint8_t *);
+    va_end(argptr);
+    uint8_t key[16];
+    uint8_t plaintext[16];
+    uint8_t ciphertext[16];
+    reverse_128(key_flipped, key);
+    reverse_128(plaintext_flipped, plaintext);
+    aes128_calc(key, plaintext, ciphertext);
+    hci_event_pending[1] = 0x14;
+    reverse_128(ciphertext, &hci_event_pending[6]);
+    hci_event_pending_len = 22;
+    hci_le_encrypt_count++;
+    return 0;
+}
+
+static void deliver_hci_events(void){
+    while (hci_event_pending_len > 0){
+        uint8_t event[22];
+        uint16_t size = (uint16_t) hci_event_pending_len;
+        memcpy(event, hci_event_pending, size);
+        hci_event_pending_len = 0;
+        dispatch_hci_event(event, size);
+    }
+}
+
+// unused parts of HCI, GAP and L2CAP
+hci_connection_t * hci_connection_for_handle(hci_con_handle_t con_handle){
+    UNUSED(con_handle);
+    return NULL;
+}
+
+void hci_connections_get_iterator(btstack_linked_list_iterator_t * it){
+    static btstack_linked_list_t connections;
+    btstack_linked_list_iterator_init(it, &connections);
+}
+
+void gap_le_get_own_address(uint8_t * addr_type, bd_addr_t addr){
+    *addr_type = BD_ADDR_TYPE_LE_PUBLIC;
+    memset(addr, 0, 6);
+}
+
+void gap_local_bd_addr(bd_addr_t address_buffer){
+    memset(address_buffer, 0, 6);
+}
+
+void hci_le_advertisements_set_params(uint16_t adv_int_min, uint16_t adv_int_max, uint8_t adv_type,
+    uint8_t direct_address_typ, bd_addr_t direct_address, uint8_t channel_map, uint8_t filter_policy){
+    UNUSED(adv_int_min);
+    UNUSED(adv_int_max);
+    UNUSED(adv_type);
+    UNUSED(direct_address_typ);
+    (void) direct_address;
+    UNUSED(channel_map);
+    UNUSED(filter_policy);
+}
+
+void hci_le_set_own_address_type(uint8_t own_address_type){
+    UNUSED(own_address_type);
+}
+
+int l2cap_can_send_fixed_channel_packet_now(hci_con_handle_t con_handle, uint16_t channel_id){
+    UNUSED(con_handle);
+    UNUSED(channel_id);
+    return 0;
+}
+
+void l2cap_request_can_send_fix_channel_now_event(hci_con_handle_t con_handle, uint16_t channel_id){
+    UNUSED(con_handle);
+    UNUSED(channel_id);
+}
+
+int l2cap_send_connectionless(hci_con_handle_t con_handle, uint16_t cid, uint8_t * data, uint16_t len){
+    UNUSED(con_handle);
+    UNUSED(cid);
+    UNUSED(data);
+    UNUSED(len);
+    return 0;
+}
+
+void l2cap_register_fixed_channel(btstack_packet_handler_t packet_handler, uint16_t channel_id){
+    UNUSED(packet_handler);
+    UNUSED(channel_id);
+}
+
+// SM events
+static void sm_packet_handler(uint8_t packet_type, uint16_t channel, uint8_t * packet, uint16_t size){
+    UNUSED(channel);
+    UNUSED(size);
+    if (packet_type != HCI_EVENT_PACKET) return;
+    switch (hci_event_packet_get_type(packet)){
+        case SM_EVENT_IDENTITY_RESOLVING_SUCCEEDED:
+            lookup_result = SM_EVENT_IDENTITY_RESOLVING_SUCCEEDED;
+            lookup_index  = sm_event_identity_resolving_succeeded_get_index(packet);
+            break;
+        case SM_EVENT_IDENTITY_RESOLVING_FAILED:
+            lookup_result = SM_EVENT_IDENTITY_RESOLVING_FAILED;
+            break;
+        default:
+            break;
+    }
+}
+
+// RPA = hash || prand, with hash = ah(IRK, prand)
+static void create_rpa(const sm_key_t irk, uint32_t prand, bd_addr_t rpa){
+    sm_key_t r_prime;
+    sm_key_t hash;
+    memset(r_prime, 0, sizeof(r_prime));
+    big_endian_store_24(r_prime, 13, (prand & 0x3fffffu) | 0x400000u);
+    aes128_calc(irk, r_prime, hash);
+    memcpy(&rpa[0], &r_prime[13], 3);
+    memcpy(&rpa[3], &hash[13], 3);
+}
+
+static void setup_le_device_db(int num_devices){
+    le_device_db_init();
+    int i;
+    for (i = 0; i < num_devices; i++){
+        bd_addr_t addr;
+        sm_key_t irk;
+        memset(irk, 0, sizeof(irk));
+        big_endian_store_32(irk, 12, (uint32_t) i + 1u);
+        memset(addr, 0, sizeof(addr));
+        big_endian_store_32(addr, 2, (uint32_t) i + 1u);
+        le_device_db_add(BD_ADDR_TYPE_LE_PUBLIC, addr, irk);
+    }
+}
+
+static void lookup(bd_addr_t rpa, int expected_result, int expected_index){
+    lookup_result = 0;
+    sm_address_resolution_lookup(BD_ADDR_TYPE_LE_RANDOM, rpa);
+    deliver_hci_events();
+    if ((lookup_result != expected_result) || ((expected_result == SM_EVENT_IDENTITY_RESOLVING_SUCCEEDED) && (lookup_index != expected_index))){
+        printf("Lookup failed: result 0x%02x, index %u\n", lookup_result, lookup_index);
+        exit(EXIT_FAILURE);
+    }
+}
+
+static void benchmark_lookups(const char * name, int num_devices, uint32_t irk_value, bool new_rpa, int expected_result, int expected_index){
+    sm_key_t irk;
+    memset(irk, 0, sizeof(irk));
+    big_endian_store_32(irk, 12, irk_value);
+    static bd_addr_t rpas[NUM_LOOKUPS];
+    int i;
+    for (i = 0; i < NUM_LOOKUPS; i++){
+        create_rpa(irk, new_rpa ? (uint32_t) i : 0u, rpas[i]);
+    }
+    uint32_t count_before = hci_le_encrypt_count;
+    uint64_t start_ns = get_time_ns();
+    for (i = 0; i < NUM_LOOKUPS; i++){
+        lookup(rpas[i], expected_result, expected_index);
+    }
+    uint64_t duration_ns = get_time_ns() - start_ns;
+    printf("- %3u IRKs, %-22s %9.1f us per lookup, %3u HCI LE Encrypt per lookup\n", num_devices, name,
+           (double) duration_ns / NUM_LOOKUPS / 1000.0, (hci_le_encrypt_count - count_before) / NUM_LOOKUPS);
+}
+
+int main(void){
+#ifdef ENABLE_SOFTWARE_AES128
+    printf("AES128: software");
+#else
+    printf("AES128: HCI LE Encrypt (emulated Controller)");
+#endif
+#ifdef ENABLE_SM_ADDRESS_RESOLUTION_CACHE
+    printf(", resolved address cache\n");
+#else
+    printf(", no resolved address cache\n");
+#endif
+
+    btstack_memory_init();
+    btstack_run_loop_init(btstack_run_loop_posix_get_instance());
+    sm_init();
+    sm_key_t er;
+    sm_key_t ir;
+    memset(er, 0x11, sizeof(er));
+    memset(ir, 0x22, sizeof(ir));
+    sm_set_er(er);
+    sm_set_ir(ir);
+    sm_event_callback_registration.callback = &sm_packet_handler;
+    sm_add_event_handler(&sm_event_callback_registration);
+
+    uint8_t state_working[] = { BTSTACK_EVENT_STATE, 1, HCI_STATE_WORKING };
+    dispatch_hci_event(state_working, sizeof(state_working));
+    deliver_hci_events();
+
+    static const int device_counts[] = { 10, 100, 500 };
+    unsigned int i;
+    for (i = 0; i < sizeof(device_counts) / sizeof(int); i++){
+        int num_devices = device_counts[i];
+        setup_le_device_db(num_devices);
+        // last bonded device is worst case for a linear scan
+        benchmark_lookups("last device, new RPA:", num_devices, (uint32_t) num_devices, true, SM_EVENT_IDENTITY_RESOLVING_SUCCEEDED, num_devices - 1);
+        benchmark_lookups("last device, same RPA:", num_devices, (uint32_t) num_devices, false, SM_EVENT_IDENTITY_RESOLVING_SUCCEEDED, num_devices - 1);
+        benchmark_lookups("unknown, new RPA:", num_devices, 0xffffffffu, true, SM_EVENT_IDENTITY_RESOLVING_FAILED, 0);
+        benchmark_lookups("unknown, same RPA:", num_devices, 0xffffffffu, false, SM_EVENT_IDENTITY_RESOLVING_FAILED, 0);
+    }
+    return 0;
+}
@@ -0,0 +1,20 @@
+//
+// btstack_config.h for TLV Flash Bank benchmark
+//
+
+#ifndef __BTSTACK_CONFIG
+#define __BTSTACK_CONFIG
+
+// Port related features
+#define HAVE_MALLOC
+#define HAVE_POSIX_TIME
+
+// BTstack features that can be enabled
+#define ENABLE_LOG_ERROR
+
+// ENABLE_TLV_FLASH_BANK_INDEX and ENABLE_TLV_FLASH_BANK_WRITE_BUFFER are set by Makefile
+
+// BTstack configuration. buffers, sizes, ...
+#define HCI_ACL_PAYLOAD_SIZE 1024
+
+#endif
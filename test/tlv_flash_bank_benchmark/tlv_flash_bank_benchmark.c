@@ -0,0 +1,209 @@
+/*
+ * Copyright (C) 2020 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHIAS
+ * RINGWALD OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+#define BTSTACK_FILE__ "tlv_flash_bank_benchmark.c"
+
+/*
+ *  tlv_flash_bank_benchmark.c
+ *
+ *  Measure flash reads/writes and time for btstack_tlv_flash_bank lookups of bonding information
+ *  and for frequent updates of a single small tag, e.g. Mesh sequence number, using hal_flash_bank_memory.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "btstack_run_loop.h"
+#include "btstack_run_loop_posix.h"
+#include "btstack_tlv_flash_bank.h"
+#include "btstack_util.h"
+#include "hal_flash_bank_memory.h"
+
+#define FLASH_BANK_SIZE     (16 * 1024)
+#define NUM_DEVICE_TAGS     24
+#define DEVICE_VALUE_SIZE   52
+#define NUM_DEVICE_SLOTS    32
+#define NUM_LOOKUPS         20000
+#define NUM_UPDATES         20000
+// updates per write delay, e.g. 100 updates per second with a write delay of 1 second
+#define UPDATES_PER_FLUSH   100
+
+#define BTSTACK_TAG32(A,B,C,D) (((A) << 24) | ((B) << 16) | ((C) << 8) | (D))
+#define DEVICE_TAG(i)       BTSTACK_TAG32('B','T','D', (i))
+#define SEQ_TAG             BTSTACK_TAG32('M','S','E','Q')
+
+static uint8_t                  flash_storage[2 * FLASH_BANK_SIZE];
+static hal_flash_bank_memory_t  hal_flash_bank_context;
+static const hal_flash_bank_t * hal_flash_bank_memory_impl;
+
+static btstack_tlv_flash_bank_t btstack_tlv_context;
+static const btstack_tlv_t *    btstack_tlv_impl;
+
+static uint32_t flash_reads;
+static uint32_t flash_read_bytes;
+static uint32_t flash_writes;
+static uint32_t flash_erases;
+
+static uint64_t get_time_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t) ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+// hal_flash_bank that counts operations on hal_flash_bank_memory
+static uint32_t counting_get_size(void * context){
+    return (*hal_flash_bank_memory_impl->get_size)(context);
+}
+
+static uint32_t counting_get_alignment(void * context){
+    return (*hal_flash_bank_memory_impl->get_alignment)(context);
+}
+
+static void counting_erase(void * context, int bank){
+    flash_erases++;
+    (*hal_flash_bank_memory_impl->erase)(context, bank);
+}
+
+static void counting_read(void * context, int bank, uint32_t offset, uint8_t * buffer, uint32_t size){
+    flash_reads++;
+    flash_read_bytes += size;
+    (*hal_flash_bank_memory_impl->read)(context, bank, offset, buffer, size);
+}
+
+static void counting_write(void * context, int bank, uint32_t offset, const uint8_t * data, uint32_t size){
+    flash_writes++;
+    (*hal_flash_bank_memory_impl->write)(context, bank, offset, data, size);
+}
+
+static const hal_flash_bank_t hal_flash_bank_counting = {
+    &counting_get_size,
+    &counting_get_alignment,
+    &counting_erase,
+    &counting_read,
+    &counting_write,
+};
+
+static void reset_counters(void){
+    flash_reads = 0;
+    flash_read_bytes = 0;
+    flash_writes = 0;
+    flash_erases = 0;
+}
+
+static void setup_tlv(void){
+    hal_flash_bank_memory_impl = hal_flash_bank_memory_init_instance(&hal_flash_bank_context, flash_storage, sizeof(flash_storage));
+    (*hal_flash_bank_memory_impl->erase)(&hal_flash_bank_context, 0);
+    (*hal_flash_bank_memory_impl->erase)(&hal_flash_bank_context, 1);
+    btstack_tlv_impl = btstack_tlv_flash_bank_init_instance(&btstack_tlv_context, &hal_flash_bank_counting, &hal_flash_bank_context);
+
+    uint8_t value[DEVICE_VALUE_SIZE];
+    int i;
+    for (i = 0; i < NUM_DEVICE_TAGS; i++){
+        memset(value, i, sizeof(value));
+        btstack_tlv_impl->store_tag(&btstack_tlv_context, DEVICE_TAG(i), value, sizeof(value));
+    }
+    uint32_t seq = 0;
+    btstack_tlv_impl->store_tag(&btstack_tlv_context, SEQ_TAG, (const uint8_t *) &seq, sizeof(seq));
+}
+
+// le_device_db_tlv style: iterate over all slots, most of them unused
+static void benchmark_lookups(void){
+    uint8_t value[DEVICE_VALUE_SIZE];
+    reset_counters();
+    uint64_t start_ns = get_time_ns();
+    int i;
+    for (i = 0; i < NUM_LOOKUPS; i++){
+        int slot = i % NUM_DEVICE_SLOTS;
+        int size = btstack_tlv_impl->get_tag(&btstack_tlv_context, DEVICE_TAG(slot), value, sizeof(value));
+        int expected_size = (slot < NUM_DEVICE_TAGS) ? DEVICE_VALUE_SIZE : 0;
+        if ((size != expected_size) || ((size > 0) && (value[0] != slot))){
+            printf("Lookup of slot %u failed\n", slot);
+            exit(EXIT_FAILURE);
+        }
+    }
+    uint64_t duration_ns = get_time_ns() - start_ns;
+    printf("- get_tag:   %8.1f ns, %6.1f flash reads (%7.1f bytes) per lookup\n",
+           (double) duration_ns / NUM_LOOKUPS, (double) flash_reads / NUM_LOOKUPS, (double) flash_read_bytes / NUM_LOOKUPS);
+}
+
+static void benchmark_updates(void){
+    reset_counters();
+    uint64_t start_ns = get_time_ns();
+    uint32_t seq;
+    for (seq = 1; seq <= NUM_UPDATES; seq++){
+        btstack_tlv_impl->store_tag(&btstack_tlv_context, SEQ_TAG, (const uint8_t *) &seq, sizeof(seq));
+#ifdef ENABLE_TLV_FLASH_BANK_WRITE_BUFFER
+        // emulate expired write delay
+        if ((seq % UPDATES_PER_FLUSH) == 0){
+            btstack_tlv_flash_bank_flush(&btstack_tlv_context);
+        }
+#endif
+    }
+    uint64_t duration_ns = get_time_ns() - start_ns;
+    printf("- store_tag: %8.1f ns, %6.1f flash reads, %5.2f flash writes per update, %u bank erases\n",
+           (double) duration_ns / NUM_UPDATES, (double) flash_reads / NUM_UPDATES, (double) flash_writes / NUM_UPDATES, flash_erases);
+
+    // verify
+    uint32_t value = 0;
+    btstack_tlv_impl->get_tag(&btstack_tlv_context, SEQ_TAG, (uint8_t *) &value, sizeof(value));
+    if (value != NUM_UPDATES){
+        printf("Update failed\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+int main(void){
+    printf("btstack_tlv_flash_bank with %u tags in %u kB bank", NUM_DEVICE_TAGS + 1, FLASH_BANK_SIZE / 1024);
+#ifdef ENABLE_TLV_FLASH_BANK_INDEX
+    printf(", RAM index");
+#endif
+#ifdef ENABLE_TLV_FLASH_BANK_WRITE_BUFFER
+    printf(", write buffer with flush every %u updates", UPDATES_PER_FLUSH);
+#endif
+    printf("\n");
+
+    btstack_run_loop_init(btstack_run_loop_posix_get_instance());
+    setup_tlv();
+#ifdef ENABLE_TLV_FLASH_BANK_WRITE_BUFFER
+    btstack_tlv_flash_bank_set_write_delay(&btstack_tlv_context, 1000);
+#endif
+    benchmark_lookups();
+    benchmark_updates();
+    return 0;
+}
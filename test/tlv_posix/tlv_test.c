@@ -8,6 +8,8 @@
 #include "btstack_util.h"
 #include "btstack_config.h"
 #include "btstack_debug.h"
+#include "btstack_run_loop_posix.h"
+#include <sys/stat.h>
 #include <unistd.h>
 
 #define TEST_DB "/tmp/test.tlv"
@@ -28,14 +30,19 @@ TEST_GROUP(BSTACK_TLV){
     void reopen_db(void){
     	log_info("reopen");
     	// close file 
-    	fclose(btstack_tlv_context.file);
+    	btstack_tlv_posix_deinit(&btstack_tlv_context);
     	// reopen
 		btstack_tlv_impl = btstack_tlv_posix_init_instance(&btstack_tlv_context, TEST_DB);
     }
     void teardown(void){
     	log_info("teardown");
     	// close file
-    	fclose(btstack_tlv_context.file);
+    	btstack_tlv_posix_deinit(&btstack_tlv_context);
+    }
+    off_t db_size(void){
+    	struct stat st;
+    	if (stat(TEST_DB, &st) != 0) return 0;
+    	return st.st_size;
     }
 };
 
@@ -181,8 +188,113 @@ TEST(BSTACK_TLV, TestWriteDeleteResetReadDeleteRead){
     CHECK_EQUAL(size, 0);
 }
 
+TEST(BSTACK_TLV, TestManyTags){
+    int i;
+    for (i=0;i<1000;i++){
+        uint32_t value = i * 3;
+        btstack_tlv_impl->store_tag(&btstack_tlv_context, 0x10000 + i, (const uint8_t *) &value, sizeof(value));
+    }
+
+    reopen_db();
+
+    for (i=0;i<1000;i++){
+        uint32_t value = 0;
+        int size = btstack_tlv_impl->get_tag(&btstack_tlv_context, 0x10000 + i, (uint8_t *) &value, sizeof(value));
+        CHECK_EQUAL(size, 4);
+        CHECK_EQUAL(value, (uint32_t) (i * 3));
+    }
+}
+
+TEST(BSTACK_TLV, TestCompaction){
+    uint32_t tag_a = TAG('a','a','a','a');
+    uint32_t tag_b = TAG('b','b','b','b');
+    uint32_t tag_c = TAG('c','c','c','c');
+    uint8_t  data[32];
+    memset(data, 0x55, sizeof(data));
+    btstack_tlv_impl->store_tag(&btstack_tlv_context, tag_c, data, sizeof(data));
+    btstack_tlv_impl->delete_tag(&btstack_tlv_context, tag_c);
+
+    // 5000 updates with 40 bytes each would grow file to 200 kB without compaction
+    int i;
+    for (i=0;i<5000;i++){
+        data[0] = (uint8_t) i;
+        btstack_tlv_impl->store_tag(&btstack_tlv_context, (i & 1) ? tag_a : tag_b, data, sizeof(data));
+        CHECK(db_size() < 40000);
+    }
+
+    reopen_db();
+
+    uint8_t buffer[32];
+    int size = btstack_tlv_impl->get_tag(&btstack_tlv_context, tag_a, buffer, sizeof(buffer));
+    CHECK_EQUAL(size, 32);
+    CHECK_EQUAL(buffer[0], (uint8_t) 4999);
+    size = btstack_tlv_impl->get_tag(&btstack_tlv_context, tag_b, buffer, sizeof(buffer));
+    CHECK_EQUAL(size, 32);
+    CHECK_EQUAL(buffer[0], (uint8_t) 4998);
+    size = btstack_tlv_impl->get_tag(&btstack_tlv_context, tag_c, NULL, 0);
+    CHECK_EQUAL(size, 0);
+    // temp file removed
+    CHECK(access(TEST_DB ".tmp", F_OK) != 0);
+}
+
+TEST(BSTACK_TLV, TestCompactionOnStartup){
+    uint32_t tag = TAG('a','b','c','d');
+    uint8_t  data[100];
+    memset(data, 0x55, sizeof(data));
+
+    // write garbage directly to file: 500 updates of same tag
+    btstack_tlv_posix_deinit(&btstack_tlv_context);
+    FILE * file = fopen(TEST_DB, "a");
+    int i;
+    for (i=0;i<500;i++){
+        uint8_t header[8];
+        big_endian_store_32(header, 0, tag);
+        big_endian_store_32(header, 4, sizeof(data));
+        data[0] = (uint8_t) i;
+        fwrite(header, 1, sizeof(header), file);
+        fwrite(data, 1, sizeof(data), file);
+    }
+    fclose(file);
+    CHECK(db_size() > 50000);
+
+    btstack_tlv_impl = btstack_tlv_posix_init_instance(&btstack_tlv_context, TEST_DB);
+    CHECK_EQUAL(db_size(), 8 + 8 + sizeof(data));
+
+    uint8_t buffer[100];
+    int size = btstack_tlv_impl->get_tag(&btstack_tlv_context, tag, buffer, sizeof(buffer));
+    CHECK_EQUAL(size, 100);
+    CHECK_EQUAL(buffer[0], (uint8_t) 499);
+}
+
+TEST(BSTACK_TLV, TestSyncFsync){
+    uint32_t tag = TAG('a','b','c','d');
+    uint8_t  data = 7;
+    btstack_tlv_posix_set_sync_mode(&btstack_tlv_context, BTSTACK_TLV_POSIX_SYNC_FSYNC, 0);
+    btstack_tlv_impl->store_tag(&btstack_tlv_context, tag, &data, 1);
+    CHECK_EQUAL(db_size(), 8 + 8 + 1);
+}
+
+TEST(BSTACK_TLV, TestSyncDeferred){
+    uint32_t tag = TAG('a','b','c','d');
+    uint8_t  data = 7;
+    btstack_tlv_posix_set_sync_mode(&btstack_tlv_context, BTSTACK_TLV_POSIX_SYNC_DEFERRED, 1000);
+    btstack_tlv_impl->store_tag(&btstack_tlv_context, tag, &data, 1);
+    // still buffered
+    CHECK_EQUAL(db_size(), 8);
+    CHECK_EQUAL(btstack_tlv_context.sync_pending, true);
+    btstack_tlv_posix_flush(&btstack_tlv_context);
+    CHECK_EQUAL(btstack_tlv_context.sync_pending, false);
+    CHECK_EQUAL(db_size(), 8 + 8 + 1);
+
+    reopen_db();
+
+    uint8_t buffer = 0;
+    btstack_tlv_impl->get_tag(&btstack_tlv_context, tag, &buffer, 1);
+    CHECK_EQUAL(buffer, data);
+}
 
 int main (int argc, const char * argv[]){
+	btstack_run_loop_init(btstack_run_loop_posix_get_instance());
 	hci_dump_open("tlv_test.pklg", HCI_DUMP_PACKETLOGGER);
     return CommandLineTestRunner::RunAllTests(argc, argv);
 }
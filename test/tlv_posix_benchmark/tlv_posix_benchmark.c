@@ -0,0 +1,191 @@
+/*
+ * Copyright (C) 2020 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHIAS
+ * RINGWALD OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+#define BTSTACK_FILE__ "tlv_posix_benchmark.c"
+
+/*
+ *  tlv_posix_benchmark.c
+ *
+ *  Measure startup replay time of btstack_tlv_posix versus file size, store throughput for each sync mode,
+ *  and tag lookup time.
+ */
+
+#define _POSIX_C_SOURCE 200809
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "btstack_run_loop.h"
+#include "btstack_run_loop_posix.h"
+#include "btstack_tlv_posix.h"
+#include "btstack_util.h"
+
+#define BENCHMARK_DB    "/tmp/tlv_posix_benchmark.tlv"
+#define NUM_TAGS        200
+#define NUM_LOOKUPS     1000000
+
+static uint64_t get_time_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t) ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+static long file_size(const char * path){
+    struct stat st;
+    if (stat(path, &st) != 0) return 0;
+    return (long) st.st_size;
+}
+
+// value size similar to link keys, CCC state and mesh sequence numbers
+static uint32_t value_len_for_tag(uint32_t tag){
+    switch (tag % 3u){
+        case 0:
+            return 22;
+        case 1:
+            return 2;
+        default:
+            return 4;
+    }
+}
+
+// write log with num_updates random updates/deletes without compaction
+static void create_db(uint32_t num_updates){
+    FILE * file = fopen(BENCHMARK_DB, "w");
+    uint8_t header[8];
+    memset(header, 0, sizeof(header));
+    strcpy((char *) header, "BTstack");
+    fwrite(header, 1, sizeof(header), file);
+    uint32_t i;
+    for (i = 0; i < num_updates; i++){
+        uint32_t tag = (uint32_t) rand() % NUM_TAGS;
+        uint32_t len = ((i % 16u) == 15u) ? 0 : value_len_for_tag(tag);
+        uint8_t entry[8 + 32];
+        big_endian_store_32(entry, 0, 0x42000000u + tag);
+        big_endian_store_32(entry, 4, len);
+        memset(&entry[8], (uint8_t) i, len);
+        fwrite(entry, 1, 8 + len, file);
+    }
+    fclose(file);
+}
+
+static void benchmark_startup(void){
+    printf("Startup replay\n");
+    static const uint32_t num_updates[] = { 1000, 10000, 100000, 1000000 };
+    unsigned int i;
+    for (i = 0; i < sizeof(num_updates) / sizeof(uint32_t); i++){
+        create_db(num_updates[i]);
+        long size_before = file_size(BENCHMARK_DB);
+
+        btstack_tlv_posix_t context;
+        uint64_t start_ns = get_time_ns();
+        btstack_tlv_posix_init_instance(&context, BENCHMARK_DB);
+        uint64_t first_ns = get_time_ns() - start_ns;
+        btstack_tlv_posix_deinit(&context);
+        long size_after = file_size(BENCHMARK_DB);
+
+        start_ns = get_time_ns();
+        btstack_tlv_posix_init_instance(&context, BENCHMARK_DB);
+        uint64_t second_ns = get_time_ns() - start_ns;
+        uint32_t num_entries = context.num_entries;
+        btstack_tlv_posix_deinit(&context);
+
+        printf("- %7u updates, %3u tags: %8ld bytes -> %5ld bytes, replay + compaction %8.2f ms, replay compacted %6.3f ms\n",
+               num_updates[i], num_entries, size_before, size_after, (double) first_ns / 1e6, (double) second_ns / 1e6);
+    }
+}
+
+static void benchmark_store(const char * name, btstack_tlv_posix_sync_mode_t sync_mode, uint32_t num_stores){
+    unlink(BENCHMARK_DB);
+    btstack_tlv_posix_t context;
+    const btstack_tlv_t * tlv_impl = btstack_tlv_posix_init_instance(&context, BENCHMARK_DB);
+    btstack_tlv_posix_set_sync_mode(&context, sync_mode, 1000);
+    uint8_t value[32];
+    memset(value, 0x55, sizeof(value));
+    uint64_t start_ns = get_time_ns();
+    uint32_t i;
+    for (i = 0; i < num_stores; i++){
+        uint32_t tag = i % NUM_TAGS;
+        value[0] = (uint8_t) i;
+        tlv_impl->store_tag(&context, 0x42000000u + tag, value, value_len_for_tag(tag));
+    }
+    btstack_tlv_posix_flush(&context);
+    uint64_t duration_ns = get_time_ns() - start_ns;
+    printf("- %-8s: %6u stores, %9.0f ns per store, file size %ld bytes\n", name, num_stores, (double) duration_ns / num_stores, file_size(BENCHMARK_DB));
+    btstack_tlv_posix_deinit(&context);
+}
+
+static void benchmark_lookup(void){
+    unlink(BENCHMARK_DB);
+    btstack_tlv_posix_t context;
+    const btstack_tlv_t * tlv_impl = btstack_tlv_posix_init_instance(&context, BENCHMARK_DB);
+    uint8_t value[32];
+    memset(value, 0x55, sizeof(value));
+    uint32_t i;
+    for (i = 0; i < NUM_TAGS; i++){
+        tlv_impl->store_tag(&context, 0x42000000u + i, value, value_len_for_tag(i));
+    }
+    uint32_t total = 0;
+    uint64_t start_ns = get_time_ns();
+    for (i = 0; i < NUM_LOOKUPS; i++){
+        total += tlv_impl->get_tag(&context, 0x42000000u + (i % NUM_TAGS), value, sizeof(value));
+    }
+    uint64_t duration_ns = get_time_ns() - start_ns;
+    printf("Lookup: %u tags, %5.1f ns per get_tag (%u bytes read)\n", NUM_TAGS, (double) duration_ns / NUM_LOOKUPS, total);
+    btstack_tlv_posix_deinit(&context);
+}
+
+int main(void){
+    // run loop needed for deferred sync timer
+    btstack_run_loop_init(btstack_run_loop_posix_get_instance());
+    srand(0);
+
+    benchmark_startup();
+
+    printf("Store\n");
+    benchmark_store("flush",    BTSTACK_TLV_POSIX_SYNC_FLUSH,    100000);
+    benchmark_store("fsync",    BTSTACK_TLV_POSIX_SYNC_FSYNC,    1000);
+    benchmark_store("deferred", BTSTACK_TLV_POSIX_SYNC_DEFERRED, 100000);
+
+    benchmark_lookup();
+
+    unlink(BENCHMARK_DB);
+    return 0;
+}
@@ -0,0 +1,193 @@
+#!/usr/bin/env python3
+
+import os
+import sys
+
+import btstack_parser as parser
+
+# HCI Commands used while setting up connections, scanning and advertising
+commands = [
+    'hci_disconnect',
+    'hci_host_number_of_completed_packets',
+    'hci_le_connection_update',
+    'hci_le_create_connection',
+    'hci_le_set_advertising_data',
+    'hci_le_set_advertising_parameters',
+    'hci_le_set_scan_enable',
+    'hci_le_set_scan_parameters',
+    'hci_le_set_scan_response_data',
+]
+
+program_info = """
+BTstack HCI Command Builder Generator for BTstack
+Copyright 2020, BlueKitchen GmbH
+"""
+
+copyright = """/*
+ * Copyright (C) 2020 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHIAS
+ * RINGWALD OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+"""
+
+hfile_header_begin = """
+
+/*
+ *  hci_cmd_builder.h
+ *
+ *  @brief Create HCI Commands without interpreting the format string of hci_cmd_t
+ *  @note  Don't edit - generated by tool/btstack_hci_cmd_generator.py
+ *
+ */
+
+#ifndef HCI_CMD_BUILDER_H
+#define HCI_CMD_BUILDER_H
+
+#if defined __cplusplus
+extern "C" {
+#endif
+
+#include "btstack_util.h"
+#include "hci_cmd.h"
+#include <stdint.h>
+#include <string.h>
+
+/* API_START */
+
+"""
+
+hfile_header_end = """
+/* API_END */
+
+#if defined __cplusplus
+}
+#endif
+
+#endif // HCI_CMD_BUILDER_H
+"""
+
+c_prototype = """/**
+ * @brief Create {command_name} command, same result as hci_cmd_create_from_template with &{command_name}
+ * @param hci_cmd_buffer
+{param_docs} * @return size of command
+ * @note: btstack_type {format}
+ */
+static inline uint16_t {fn_name}({params}){{
+    little_endian_store_16(hci_cmd_buffer, 0, {opcode});
+    hci_cmd_buffer[2] = {param_len};
+{code}    return {size};
+}}
+
+"""
+
+param_types = {
+    '1' : 'uint8_t',
+    '2' : 'uint16_t',
+    '3' : 'uint32_t',
+    '4' : 'uint32_t',
+    'H' : 'hci_con_handle_t',
+    'B' : 'const bd_addr_t',
+    'D' : 'const uint8_t *',
+    'P' : 'const uint8_t *',
+    'A' : 'const uint8_t *',
+    'Q' : 'const uint8_t *',
+}
+
+param_sizes = {
+    '1' : 1, '2' : 2, '3' : 3, '4' : 4, 'H' : 2, 'B' : 6, 'D' : 8, 'P' : 16, 'A' : 31, 'Q' : 32,
+}
+
+param_write = {
+    '1' : 'hci_cmd_buffer[{offset}] = {name};',
+    '2' : 'little_endian_store_16(hci_cmd_buffer, {offset}, {name});',
+    '3' : 'little_endian_store_24(hci_cmd_buffer, {offset}, {name});',
+    '4' : 'little_endian_store_32(hci_cmd_buffer, {offset}, {name});',
+    'H' : 'little_endian_store_16(hci_cmd_buffer, {offset}, {name});',
+    'B' : 'reverse_bd_addr({name}, &hci_cmd_buffer[{offset}]);',
+    'D' : '(void)memcpy(&hci_cmd_buffer[{offset}], {name}, 8);',
+    'P' : '(void)memcpy(&hci_cmd_buffer[{offset}], {name}, 16);',
+    'A' : '(void)memcpy(&hci_cmd_buffer[{offset}], {name}, 31);',
+    'Q' : 'reverse_bytes({name}, &hci_cmd_buffer[{offset}], 32);',
+}
+
+def create_builder(command_name, format, params):
+    fn_name = 'hci_cmd_create_' + command_name[len('hci_'):]
+    offset = 3
+    code = ''
+    param_docs = ''
+    c_params = ['uint8_t * hci_cmd_buffer']
+    for field_type, name in zip(format, params):
+        if not field_type in param_write:
+            print("Format %s of %s not supported" % (field_type, command_name))
+            sys.exit(10)
+        c_params.append('%s %s' % (param_types[field_type], name))
+        param_docs += ' * @param %s\n' % name
+        code += '    ' + param_write[field_type].format(offset=offset, name=name) + '\n'
+        offset += param_sizes[field_type]
+    return c_prototype.format(command_name=command_name, fn_name=fn_name, params=', '.join(c_params), param_docs=param_docs,
+                              opcode=opcodes[command_name], param_len=offset-3, code=code, size=offset, format=format)
+
+def create_builders(hci_commands):
+    with open(gen_path, 'wt') as fout:
+        fout.write(copyright)
+        fout.write(hfile_header_begin)
+        for command_name, ogf, ocf, format, params in hci_commands:
+            if not command_name in commands:
+                continue
+            fout.write(create_builder(command_name, format, params))
+        fout.write(hfile_header_end)
+
+btstack_root = os.path.abspath(os.path.dirname(sys.argv[0]) + '/..')
+gen_path = btstack_root + '/src/hci_cmd_builder.h'
+
+print(program_info)
+
+# parse hci commands and map command name to opcode name
+hci_commands = parser.my_parse_commands(btstack_root + '/' + parser.hci_cmds_c_path, parser.parse_opcodes(False), False)
+opcodes = dict()
+with open(btstack_root + '/' + parser.hci_cmds_c_path, 'rt') as fin:
+    command_name = None
+    for line in fin:
+        parts = line.split()
+        if len(parts) >= 3 and parts[0] == 'const' and parts[1] == 'hci_cmd_t':
+            command_name = parts[2].rstrip('=')
+        elif command_name and line.strip().startswith('HCI_OPCODE_'):
+            opcodes[command_name] = line.strip().split(',')[0]
+            command_name = None
+
+# create hci command builders
+create_builders(hci_commands)
+
+# done
+print('Done!')
@@ -195,7 +195,7 @@ def replacePlaceholder(template, struct_name):
     return snippet
     
 list_of_structs = [
-    ["hci_connection"],
+    ["hci_connection", "hci_acl_recombination_buffer"],
     ["l2cap_service", "l2cap_channel"],
 ]
 list_of_classic_structs = [
@@ -976,6 +976,59 @@ def listHandles(fout):
         fout.write(define)
         fout.write('\n')
 
+def parseProfileData(lines):
+    # extract ATT DB bytes without version from generated profile_data[]
+    db = bytearray()
+    in_profile_data = False
+    for line in lines:
+        if line.startswith('const uint8_t profile_data[]'):
+            in_profile_data = True
+            continue
+        if not in_profile_data:
+            continue
+        if line.startswith('};'):
+            break
+        for part in line.split('//')[0].replace('{', '').split(','):
+            part = part.strip()
+            if len(part) > 0:
+                db.append(int(part, 0))
+    return db[1:]
+
+def uuid128ForAttribute(db, offset):
+    flags = db[offset+2] | (db[offset+3] << 8)
+    if flags & property_flags['LONG_UUID']:
+        return bytes(db[offset+6:offset+22])
+    # expand UUID16 with Bluetooth Base UUID, little endian
+    return bytes(bytearray([0xfb, 0x34, 0x9b, 0x5f, 0x80, 0x00, 0x00, 0x80, 0x00, 0x10, 0x00, 0x00, db[offset+6], db[offset+7], 0x00, 0x00]))
+
+def writeIndex(fout, db):
+    # offsets of all attributes plus end marker, followed by attribute positions sorted by UUID and position
+    offsets = []
+    offset = 0
+    while True:
+        size = db[offset] | (db[offset+1] << 8)
+        offsets.append(offset)
+        if size == 0:
+            break
+        offset += size
+    if offset > 0xffff:
+        print("ATT DB too large for index")
+        sys.exit(1)
+    num_attributes = len(offsets) - 1
+    uuid_list = sorted(range(num_attributes), key=lambda position: (uuid128ForAttribute(db, offsets[position]), position))
+
+    fout.write('\n')
+    fout.write('// ATT DB index for att_set_db_index, requires ENABLE_ATT_DB_INDEX\n')
+    fout.write('// - offsets of %u attributes and end marker, attribute positions sorted by UUID\n' % num_attributes)
+    fout.write('const uint16_t profile_data_index[] =\n')
+    fout.write('{\n')
+    entries = offsets + uuid_list
+    for i in range(0, len(entries), 8):
+        write_indent(fout)
+        fout.write(' '.join(['0x%04x,' % entry for entry in entries[i:i+8]]))
+        fout.write('\n')
+    fout.write('}; // %u entries\n' % len(entries))
+
 def getFile( fileName ):
     for d in include_paths:
         fullFile = os.path.normpath(d + os.sep + fileName) # because Windows exists
@@ -998,6 +1051,8 @@ parser.add_argument('gattfile', metavar='gattfile', type=str,
         help='gatt file to be compiled')
 parser.add_argument('hfile', metavar='hfile', type=str,
         help='header file to be generated')
+parser.add_argument('--index', action='store_true',
+        help='generate ATT DB index profile_data_index[] for att_set_db_index')
 
 args = parser.parse_args()
 
@@ -1037,11 +1092,14 @@ try:
     db_hash_sequence.reverse()
     db_hash_string = ', '.join(db_hash_sequence) + ', '
 
-    # pass 2: insert GATT Database Hash
+    # pass 2: insert GATT Database Hash and ATT DB index
     fout = open (filename, 'w')
     ftemp.seek(0)
-    for line in ftemp:
-        fout.write(line.replace('THE-DATABASE-HASH', db_hash_string))
+    lines = [line.replace('THE-DATABASE-HASH', db_hash_string) for line in ftemp]
+    for line in lines:
+        fout.write(line)
+        if args.index and line.startswith('}; // total size'):
+            writeIndex(fout, parseProfileData(lines))
     fout.close()
     ftemp.close()
 